@@ -43,6 +43,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h> 
 #include <netdb.h>
+#include <sys/un.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <errno.h>
@@ -56,7 +57,9 @@ int main(int argc, char *argv[])
     float loss_rate, burst_rate;
     int bandwidth, latency;
     int i1, i2, i3, i4;
-    struct sockaddr_in daemon, *daemon_ptr = NULL;
+    struct sockaddr_in daemon;
+    struct sockaddr_un unix_daemon;
+    struct sockaddr *daemon_ptr = NULL;
     int local_interf_id, remote_interf_id;
 
     port = DEFAULT_SPINES_PORT;   /* 8100 */
@@ -77,9 +80,16 @@ int main(int argc, char *argv[])
     sscanf(argv[6], "%d.%d.%d.%d", &i1, &i2, &i3, &i4);
     local_interf_id = ((i1 << 24 ) | (i2 << 16) | (i3 << 8) | i4);
 
-    if (argc > 7) {
+    if (argc > 7 && argv[7][0] == '/') {
+      /* unix domain path of the daemon, e.g. when several daemons share a host */
+      memset(&unix_daemon, 0, sizeof(unix_daemon));
+      unix_daemon.sun_family = AF_UNIX;
+      strncpy(unix_daemon.sun_path, argv[7], sizeof(unix_daemon.sun_path) - 1);
+      daemon_ptr = (struct sockaddr*) &unix_daemon;
+
+    } else if (argc > 7) {
       memset(&daemon, 0, sizeof(daemon));
-      daemon_ptr = &daemon;
+      daemon_ptr = (struct sockaddr*) &daemon;
 
       sscanf(argv[7], "%d.%d.%d.%d", &i1, &i2, &i3, &i4);
       daemon.sin_family = AF_INET;
@@ -88,12 +98,12 @@ int main(int argc, char *argv[])
       daemon.sin_port = htons(DEFAULT_SPINES_PORT);
     }
 
-    if (argc > 8) {
+    if (argc > 8 && daemon_ptr == (struct sockaddr*) &daemon) {
       sscanf(argv[8], "%d", &port);
       daemon.sin_port = htons(port);
     }
 
-    spines_init((struct sockaddr*) daemon_ptr);
+    spines_init(daemon_ptr);
 
     sk = spines_socket(PF_SPINES, SOCK_STREAM, 0, NULL);
     if (sk < 0) {
@@ -113,6 +123,6 @@ int main(int argc, char *argv[])
 }
 
 void print_usage(void) {
-  printf("Usage:\tsetlink bandwidth (kbps) latency (ms) loss_rate (%%) burst_rate (%%) remote_interf_id (src) local_interf_id (dst) [daemon_ip [daemon_port]]\n\n");
+  printf("Usage:\tsetlink bandwidth (kbps) latency (ms) loss_rate (%%) burst_rate (%%) remote_interf_id (src) local_interf_id (dst) [daemon_ip [daemon_port] | daemon_unix_path]\n\n");
 }
 
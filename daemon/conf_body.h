@@ -42,6 +42,7 @@
 
 int		yyparse();
 void    parser_init();
+void    yyrestart(FILE *input_file);
 
 #undef  ext
 #ifndef ext_conf_body
@@ -57,6 +58,9 @@ extern     FILE		*yyin;
 ext     char            ConfStringRep[MAX_CONF_STRING];
 ext     int             ConfStringLen;
 
+/* Set while Conf_Reload re-reads the file of a running daemon */
+ext     int             Conf_Reloading;
+
 #define YYSTYPE YYSTYPE
 
 #ifndef	ARCH_PC_WIN95
@@ -73,6 +73,7 @@
 void    parser_init()
 {
     /* Defaults Here */
+    line_num = 0;
 }
 
 /* static char *segment2str(int seg) {
@@ -307,14 +308,17 @@ static  int 	get_parsed_proc_info( char *name, proc *p )
 %}
 %start Config
 %token OPENBRACE CLOSEBRACE EQUALS COLON BANG
-%token DEBUGFLAGS CRYPTO SIGLENBITS MPBITMASKSIZE DIRECTEDEDGES PATHSTAMPDEBUG UNIXDOMAINPATH
+%token DEBUGFLAGS CRYPTO SIGLENBITS SIGSCHEME MPBITMASKSIZE DIRECTEDEDGES PATHSTAMPDEBUG UNIXDOMAINPATH
 %token REMOTECONNECTIONS
-%token RRCRYPTO
+%token RTFEC RTFECMINBLOCK RTFECMAXBLOCK RTFECFLUSHTO
+%token CCCONTROLLINKS CCRELIABLELINKS CCRELIABLESESSIONS
+%token FDFASTDETECT FDDETECTTIME FDDETECTMULT
+%token RRCRYPTO SOURCEDEDUPWINDOW
 %token ITCRYPTO ITENCRYPT ORDEREDDELIVERY REINTRODUCEMSGS TCPFAIRNESS SESSIONBLOCKING MSGPERSAA
 %token SENDBATCHSIZE ITMODE RELIABLETIMEOUTFACTOR NACKTIMEOUTFACTOR INITNACKTOFACTOR 
 %token ACKTO PINGTO DHTO INCARNATIONTO MINRTTMS ITDEFAULTRTT
 %token PRIOCRYPTO DEFAULTPRIO MAXMESSSTORED MINBELLYSIZE
-%token DEFAULTEXPIRESEC DEFAULTEXPIREUSEC GARBAGECOLLECTIONSEC
+%token DEFAULTEXPIRESEC DEFAULTEXPIREUSEC GARBAGECOLLECTIONSEC SIGBATCHUSEC
 %token RELCRYPTO RELSAATHRESHOLD HBHADVANCE HBHACKTIMEOUT HBHOPT E2EACKTIMEOUT E2EOPT
 %token LOSSTHRESHOLD LOSSCALCDECAY LOSSCALCTIMETRIGGER LOSSCALCPKTTRIGGER
 %token LOSSPENALTY PINGTHRESHOLD STATUSCHANGETIMEOUT
@@ -335,6 +339,7 @@ ConfigStructs	:	ParamStruct ConfigStructs
 ParamStruct	: 
         CRYPTO EQUALS SP_BOOL { Conf_set_all_crypto($3.boolean); } 
     |   SIGLENBITS EQUALS NUMBER { Conf_set_signature_len_bits($3.number); }
+    |   SIGSCHEME EQUALS STRING { Conf_set_signature_scheme($3.string); }
     |   MPBITMASKSIZE EQUALS NUMBER { Conf_set_multipath_bitmask_size($3.number); }
     |   DIRECTEDEDGES EQUALS SP_BOOL { Conf_set_directed_edges($3.boolean); }
     |   PATHSTAMPDEBUG EQUALS SP_BOOL { Conf_set_path_stamp_debug($3.boolean); }
@@ -360,7 +365,21 @@ ParamStruct	:
     |   MINRTTMS EQUALS NUMBER { Conf_set_IT_min_RTT_ms($3.number); }
     |   ITDEFAULTRTT EQUALS NUMBER { Conf_set_IT_default_RTT($3.number); }
     
+    |   RTFEC EQUALS SP_BOOL { Conf_set_RT_fec($3.boolean); }
+    |   RTFECMINBLOCK EQUALS NUMBER { Conf_set_RT_fec_min_block($3.number); }
+    |   RTFECMAXBLOCK EQUALS NUMBER { Conf_set_RT_fec_max_block($3.number); }
+    |   RTFECFLUSHTO EQUALS NUMBER { Conf_set_RT_fec_flush_timeout($3.number); }
+
+    |   CCCONTROLLINKS EQUALS STRING { Conf_set_CC_control_links($3.string); }
+    |   CCRELIABLELINKS EQUALS STRING { Conf_set_CC_reliable_links($3.string); }
+    |   CCRELIABLESESSIONS EQUALS STRING { Conf_set_CC_reliable_sessions($3.string); }
+
+    |   FDFASTDETECT EQUALS SP_BOOL { Conf_set_FD_fast_detect($3.boolean); }
+    |   FDDETECTTIME EQUALS NUMBER { Conf_set_FD_detect_time($3.number); }
+    |   FDDETECTMULT EQUALS NUMBER { Conf_set_FD_detect_mult($3.number); }
+
     |   RRCRYPTO EQUALS SP_BOOL { Conf_set_RR_crypto($3.boolean); }
+    |   SOURCEDEDUPWINDOW EQUALS NUMBER { Conf_set_RR_source_dedup_window($3.number); }
     
     |   PRIOCRYPTO EQUALS SP_BOOL { Conf_set_Prio_crypto($3.boolean); }
     |   DEFAULTPRIO EQUALS NUMBER { Conf_set_Prio_default_prio($3.number); }
@@ -369,6 +388,7 @@ ParamStruct	:
     |   DEFAULTEXPIRESEC EQUALS NUMBER { Conf_set_Prio_default_expire_sec($3.number); }
     |   DEFAULTEXPIREUSEC EQUALS NUMBER { Conf_set_Prio_default_expire_usec($3.number); }
     |   GARBAGECOLLECTIONSEC EQUALS NUMBER { Conf_set_Prio_garbage_collection_sec($3.number); }
+    |   SIGBATCHUSEC EQUALS NUMBER { Conf_set_Prio_sig_batch_usec($3.number); }
     
     |   RELCRYPTO EQUALS SP_BOOL { Conf_set_Rel_crypto($3.boolean); }
     |   RELSAATHRESHOLD EQUALS NUMBER { Conf_set_Rel_saa_threshold($3.number); }
@@ -419,5 +439,8 @@ int yyerror(char *str) {
   fprintf(stderr, "Parser error on or before line %d\n", line_num);
   fprintf(stderr, "Error type; %s\n", str);
   fprintf(stderr, "Offending token: %s\n", yytext);
+  /* A running daemon keeps its configuration instead of exiting */
+  if (Conf_Reloading)
+    return 1;
   exit(1);
 }
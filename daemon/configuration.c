@@ -46,6 +46,11 @@
 
 #include "spu_alarm.h"
 #include "spu_memory.h"
+#include "network.h"
+
+#ifdef ARCH_PC_WIN95
+#  define strcasecmp _stricmp
+#endif
 
 /* Configuration File Variables */
 extern char        Config_File_Found;
@@ -63,7 +68,48 @@ extern Network_Address   My_Interface_Addresses[];
 
 unsigned char Conf_Hash[SHA256_DIGEST_LENGTH];
 
+/* File the running configuration was read from, re-read by Conf_Reload */
+static char Conf_File_Path[MAXPATHLEN];
+
+/* Hosts and edges of a reloaded file. They replace the running topology
+ * only once the whole file parsed */
+static Network_Address Reload_Node_IP[MAX_NODES+1];
+static stdskl          Reload_Edges;
+static int             Reload_Topology_Error;
+
+/* Public keys of the hosts a reload adds, moved into Pub_Keys only when
+ * the new topology is installed */
+static EVP_PKEY       *Reload_Pub_Keys[MAX_NODES+1];
+
+/* Every parameter the file can set, so that a reload can be undone */
+typedef struct Conf_Params_d {
+    CONF_IT_LINK    it_link;
+    CONF_RT_LINK    rt_link;
+    CONF_CC         cc;
+    CONF_FD         fd;
+    CONF_RR         rr;
+    CONF_PRIO       prio;
+    CONF_REL        rel;
+    int16u          signature_len_bits;
+    unsigned char   signature_scheme;
+    int16u          multipath_bitmask_size;
+    unsigned char   directed_edges;
+    unsigned char   path_stamp_debug;
+    unsigned char   remote_connections;
+#ifndef ARCH_PC_WIN95
+    char            unix_domain_prefix[SUN_PATH_LEN];
+    char            unix_domain_use_default;
+#endif
+} Conf_Params;
+
 int Edge_Cmp(const void *l, const void *r);
+static void Conf_load_pub_key(int id);
+static EVP_PKEY *Conf_read_pub_key(int id, int severity);
+static void Conf_stage_pub_keys(void);
+static void Conf_free_staged_keys(void);
+static void Conf_stage_host(int id, int ip);
+static void Conf_stage_edge(int h1, int h2, int c);
+static void Conf_reload_topology(void);
 
 /* Hash function for string to 32 bit int */
 /* static LOC_INLINE int32u conf_hash_string(const void * key, int32u key_len)
@@ -113,10 +159,14 @@ void    Pre_Conf_Setup()
     HMAC_Key_Len = HMAC_KEY_LEN;
     DH_Key_Len = DH_PRIME_LEN_BITS / 8;
     Signature_Len_Bits = SIGNATURE_LEN_BITS;
+    Signature_Scheme = SIGNATURE_SCHEME;
     Path_Stamp_Debug = PATH_STAMP_DEBUG;
     Remote_Connections = REMOTE_CONNECTIONS;
 
     IT_Link_Pre_Conf_Setup();
+    RT_Link_Pre_Conf_Setup();
+    CC_Pre_Conf_Setup();
+    Hello_Pre_Conf_Setup();
     RR_Pre_Conf_Setup();
     Prio_Pre_Conf_Setup();
     Rel_Pre_Conf_Setup();
@@ -152,13 +202,19 @@ void    Post_Conf_Setup()
         if (key_fp == NULL)
             Alarm(EXIT, "Post_Conf_Setup: cannot find file "
                         "keys/private%d.pem\r\n", My_ID);
-        Priv_Key = PEM_read_PrivateKey(fopen(keyFile,"r"), 
-                NULL, NULL, NULL);
+        Priv_Key = PEM_read_PrivateKey(key_fp, NULL, NULL, NULL);
+        fclose(key_fp);
         if (Priv_Key == NULL)
             Alarm(EXIT, "Post_Conf_Setup: Unable to read key "
                         "from keys/private%d.pem\r\n", My_ID);
+        if (!Sec_key_matches_scheme(Priv_Key, Signature_Scheme))
+            Alarm(EXIT, "Post_Conf_Setup: keys/private%d.pem does not "
+                        "match Signature_Scheme\r\n", My_ID);
+        /* Ed25519 signatures are always 64 bytes, Signature_Len_Bits only
+         * sizes RSA keys */
         Signature_Len = EVP_PKEY_size(Priv_Key);
-        if (Signature_Len != Signature_Len_Bits / 8)
+        if (Signature_Scheme == SEC_SIG_RSA && 
+                Signature_Len != Signature_Len_Bits / 8)
             Alarm(EXIT, "Post_Conf_Setup: Key_Length mismatch\r\n");
     }
     else {
@@ -168,7 +224,11 @@ void    Post_Conf_Setup()
         Signature_Len = 0;
     }
 
-    if (Conf_Prio.Crypto == 1)
+    /* Messages signed in batches carry their path to the signed
+     * root after the signature */
+    if (Conf_Prio.Crypto == 1 && Conf_Prio.Sig_Batch_USec > 0)
+        Prio_Signature_Len = Signature_Len + PRIO_SIG_BATCH_TAIL_LEN;
+    else if (Conf_Prio.Crypto == 1)
         Prio_Signature_Len = Signature_Len;
     else
         Prio_Signature_Len = 0;
@@ -179,6 +239,8 @@ void    Post_Conf_Setup()
         Rel_Signature_Len = 0;
     
     IT_Link_Post_Conf_Setup();
+    RT_Link_Post_Conf_Setup();
+    Hello_Post_Conf_Setup();
     RR_Post_Conf_Setup();
     Prio_Post_Conf_Setup();
     Rel_Post_Conf_Setup();
@@ -226,12 +288,16 @@ void	Conf_load_conf_file( char *file_name /*, char *my_name*/ )
 
 	if (NULL != (yyin = fopen(file_name,"r")) )
                 Alarm( PRINT, "Conf_load_conf_file: using file: %s\n", file_name);
-	if (yyin == NULL) 
-		if (NULL != (yyin = fopen("./spines.conf", "r")) )
+	if (yyin == NULL) {
+		file_name = "./spines.conf";
+		if (NULL != (yyin = fopen(file_name, "r")) )
                         Alarm( PRINT, "Conf_load_conf_file: using file: ./spines.conf\n");
-	if (yyin == NULL)
-		if (NULL != (yyin = fopen(configfile_location, "r")) )
+	}
+	if (yyin == NULL) {
+		file_name = configfile_location;
+		if (NULL != (yyin = fopen(file_name, "r")) )
                         Alarm( PRINT, "Conf_load_conf_file: using file: %s\n", configfile_location);
+	}
 	if (yyin == NULL)
 		/* Alarm( EXIT, "Conf_load_conf_file: error opening config file %s\n",
 			file_name); */
@@ -247,6 +313,7 @@ void	Conf_load_conf_file( char *file_name /*, char *my_name*/ )
         fclose(yyin);
 
         Config_File_Found = 1;
+        snprintf(Conf_File_Path, sizeof(Conf_File_Path), "%s", file_name);
     }
 
         /* Final Error Checking? */
@@ -317,6 +384,342 @@ void	Conf_load_conf_file( char *file_name /*, char *my_name*/ )
 	return;
 }
 
+static void Conf_save_params(Conf_Params *p)
+{
+    p->it_link                = Conf_IT_Link;
+    p->rt_link                = Conf_RT_Link;
+    p->cc                     = Conf_CC;
+    p->fd                     = Conf_FD;
+    p->rr                     = Conf_RR;
+    p->prio                   = Conf_Prio;
+    p->rel                    = Conf_Rel;
+    p->signature_len_bits     = Signature_Len_Bits;
+    p->signature_scheme       = Signature_Scheme;
+    p->multipath_bitmask_size = MultiPath_Bitmask_Size;
+    p->directed_edges         = Directed_Edges;
+    p->path_stamp_debug       = Path_Stamp_Debug;
+    p->remote_connections     = Remote_Connections;
+#ifndef ARCH_PC_WIN95
+    memcpy(p->unix_domain_prefix, Unix_Domain_Prefix, SUN_PATH_LEN);
+    p->unix_domain_use_default = Unix_Domain_Use_Default;
+#endif
+}
+
+static void Conf_restore_params(const Conf_Params *p)
+{
+    Conf_IT_Link           = p->it_link;
+    Conf_RT_Link           = p->rt_link;
+    Conf_CC                = p->cc;
+    Conf_FD                = p->fd;
+    Conf_RR                = p->rr;
+    Conf_Prio              = p->prio;
+    Conf_Rel               = p->rel;
+    Signature_Len_Bits     = p->signature_len_bits;
+    Signature_Scheme       = p->signature_scheme;
+    MultiPath_Bitmask_Size = p->multipath_bitmask_size;
+    Directed_Edges         = p->directed_edges;
+    Path_Stamp_Debug       = p->path_stamp_debug;
+    Remote_Connections     = p->remote_connections;
+#ifndef ARCH_PC_WIN95
+    memcpy(Unix_Domain_Prefix, p->unix_domain_prefix, SUN_PATH_LEN);
+    Unix_Domain_Use_Default = p->unix_domain_use_default;
+#endif
+}
+
+static void Conf_keep(const char *name, int changed)
+{
+    if (changed)
+        Alarm(PRINT, "Conf_Reload: %s only changes on restart, keeping the "
+                "running value\n", name);
+}
+
+/***********************************************************/
+/* void Conf_Reload(void)                                  */
+/*                                                         */
+/* Re-reads the configuration file of the running daemon   */
+/* (on SIGHUP). Timeouts, thresholds and other parameters  */
+/* take effect right away; hosts and edges that were added */
+/* or removed are applied to the running network. Settings */
+/* that size packets or data structures (crypto, signature */
+/* length, bitmask size, directed edges, client sockets)   */
+/* keep their running value. A file that does not parse    */
+/* leaves the running configuration untouched.             */
+/*                                                         */
+/***********************************************************/
+
+void Conf_Reload(void)
+{
+    Conf_Params old;
+    int ret;
+
+    if (!Config_File_Found || Conf_File_Path[0] == '\0') {
+        Alarm(PRINT, "Conf_Reload: daemon was started without a "
+                "configuration file, nothing to reload\n");
+        return;
+    }
+
+    if (NULL == (yyin = fopen(Conf_File_Path, "r"))) {
+        Alarm(PRINT, "Conf_Reload: cannot open %s, keeping the running "
+                "configuration\n", Conf_File_Path);
+        return;
+    }
+    Alarm(PRINT, "Conf_Reload: reloading %s\n", Conf_File_Path);
+
+    /* Start from the defaults, as a restart would */
+    Conf_save_params(&old);
+    Signature_Len_Bits = SIGNATURE_LEN_BITS;
+    Signature_Scheme = SIGNATURE_SCHEME;
+    Path_Stamp_Debug = PATH_STAMP_DEBUG;
+    Remote_Connections = REMOTE_CONNECTIONS;
+    MultiPath_Bitmask_Size = MULTIPATH_BITMASK_SIZE_DEFAULT / 8;
+    Directed_Edges = DIRECTED_EDGES_DEFAULT;
+    IT_Link_Pre_Conf_Setup();
+    RT_Link_Pre_Conf_Setup();
+    CC_Pre_Conf_Setup();
+    Hello_Pre_Conf_Setup();
+    RR_Pre_Conf_Setup();
+    Prio_Pre_Conf_Setup();
+    Rel_Pre_Conf_Setup();
+
+    memset(Reload_Node_IP, 0, sizeof(Reload_Node_IP));
+    stdskl_construct(&Reload_Edges, sizeof(Edge_Key), sizeof(Edge_Value), Edge_Cmp);
+    Reload_Topology_Error = 0;
+
+    Conf_Reloading = 1;
+    parser_init();
+    yyrestart(yyin);
+    ret = yyparse();
+    fclose(yyin);
+    Conf_Reloading = 0;
+
+    if (ret != 0) {
+        Alarm(PRINT, "Conf_Reload: %s has errors, keeping the running "
+                "configuration\n", Conf_File_Path);
+        Conf_restore_params(&old);
+        stdskl_destruct(&Reload_Edges);
+        return;
+    }
+
+    Conf_keep("Signature_Len_Bits", Signature_Len_Bits != old.signature_len_bits);
+    Conf_keep("Signature_Scheme", Signature_Scheme != old.signature_scheme);
+    Conf_keep("MultiPath_Bitmask_Size", MultiPath_Bitmask_Size != old.multipath_bitmask_size);
+    Conf_keep("Directed_Edges", Directed_Edges != old.directed_edges);
+    Conf_keep("Remote_Connections", Remote_Connections != old.remote_connections);
+#ifndef ARCH_PC_WIN95
+    Conf_keep("Unix_Domain_Path", Unix_Domain_Use_Default != old.unix_domain_use_default ||
+            strcmp(Unix_Domain_Prefix, old.unix_domain_prefix) != 0);
+#endif
+    Conf_keep("IT_LinkCrypto", Conf_IT_Link.Crypto != old.it_link.Crypto);
+    Conf_keep("IT_LinkEncrypt", Conf_IT_Link.Encrypt != old.it_link.Encrypt);
+    Conf_keep("IT_IntrusionToleranceMode", 
+            Conf_IT_Link.Intrusion_Tolerance_Mode != old.it_link.Intrusion_Tolerance_Mode);
+    Conf_keep("RR_Crypto", Conf_RR.Crypto != old.rr.Crypto);
+    Conf_keep("RR_SourceDedupWindow", 
+            Conf_RR.Source_Dedup_Window != old.rr.Source_Dedup_Window);
+    Conf_keep("Prio_Crypto", Conf_Prio.Crypto != old.prio.Crypto);
+    Conf_keep("Prio_MinBellySize", Conf_Prio.Min_Belly_Size != old.prio.Min_Belly_Size);
+    Conf_keep("Prio_SignatureBatchUSec", 
+                Conf_Prio.Sig_Batch_USec != old.prio.Sig_Batch_USec);
+    Conf_keep("Rel_Crypto", Conf_Rel.Crypto != old.rel.Crypto);
+
+    Signature_Len_Bits     = old.signature_len_bits;
+    Signature_Scheme       = old.signature_scheme;
+    MultiPath_Bitmask_Size = old.multipath_bitmask_size;
+    Directed_Edges         = old.directed_edges;
+    Remote_Connections     = old.remote_connections;
+#ifndef ARCH_PC_WIN95
+    memcpy(Unix_Domain_Prefix, old.unix_domain_prefix, SUN_PATH_LEN);
+    Unix_Domain_Use_Default = old.unix_domain_use_default;
+#endif
+    Conf_IT_Link.Crypto                   = old.it_link.Crypto;
+    Conf_IT_Link.Encrypt                  = old.it_link.Encrypt;
+    Conf_IT_Link.Intrusion_Tolerance_Mode = old.it_link.Intrusion_Tolerance_Mode;
+    Conf_RR.Crypto                        = old.rr.Crypto;
+    Conf_RR.Source_Dedup_Window           = old.rr.Source_Dedup_Window;
+    Conf_Prio.Crypto                      = old.prio.Crypto;
+    Conf_Prio.Min_Belly_Size              = old.prio.Min_Belly_Size;
+    Conf_Prio.Sig_Batch_USec              = old.prio.Sig_Batch_USec;
+    Conf_Rel.Crypto                       = old.rel.Crypto;
+
+    IT_Link_Post_Conf_Setup();
+    RT_Link_Post_Conf_Setup();
+    Hello_Post_Conf_Setup();
+    RR_Post_Conf_Setup();
+    Prio_Post_Conf_Setup();
+    Rel_Post_Conf_Setup();
+
+    if (!Reload_Topology_Error)
+        Conf_stage_pub_keys();
+
+    if (Reload_Topology_Error)
+        Alarm(PRINT, "Conf_Reload: invalid Hosts, Edges or host keys, keeping the "
+                "running topology\n");
+    else
+        Conf_reload_topology();
+
+    Conf_free_staged_keys();
+    stdskl_destruct(&Reload_Edges);
+    Conf_compute_hash();
+
+    Alarm(PRINT, "Conf_Reload: done\n");
+}
+
+/* Replaces the running hosts and edges with the staged ones and rebuilds
+ * the neighbor lists. The slots of our current neighbors never move since
+ * the flooding protocols index their per-neighbor state by slot: a
+ * neighbor that was removed keeps its slot (with no edge), new neighbors
+ * are added after the last slot */
+static void Conf_reload_topology(void)
+{
+    Network_Address old_node_ip[MAX_NODES+1];
+    int16u  old_degree, count;
+    int16u  slot_id[MAX_NODES+1];
+    int32u  slot_addr[MAX_NODES+1];
+    int32   id32, addr32;
+    stdskl  old_edges;
+    stdit   it, it2;
+    Edge_Key   *key, *key2;
+    Edge_Value *val, *val2;
+    int     i, j, changed = 0;
+
+    if (Reload_Node_IP[My_ID] != My_Address) {
+        Alarm(PRINT, "Conf_Reload: host %d is no longer this machine, keeping"
+                " the running topology\n", My_ID);
+        return;
+    }
+
+    for (i = 1; i <= MAX_NODES && !changed; i++)
+        changed = (Reload_Node_IP[i] != temp_node_ip[i]);
+
+    stdskl_begin(&Sorted_Edges, &it);
+    stdskl_begin(&Reload_Edges, &it2);
+    while (!changed && !stdskl_is_end(&Sorted_Edges, &it) && 
+            !stdskl_is_end(&Reload_Edges, &it2))
+    {
+        key  = (Edge_Key*) stdskl_it_key(&it);
+        key2 = (Edge_Key*) stdskl_it_key(&it2);
+        val  = (Edge_Value*) stdskl_it_val(&it);
+        val2 = (Edge_Value*) stdskl_it_val(&it2);
+        changed = (Edge_Cmp(key, key2) != 0 || val->cost != val2->cost);
+        stdskl_it_next(&it);
+        stdskl_it_next(&it2);
+    }
+    if (!changed)
+        changed = (!stdskl_is_end(&Sorted_Edges, &it) || !stdskl_is_end(&Reload_Edges, &it2));
+
+    if (!changed) {
+        Alarm(PRINT, "Conf_Reload: topology unchanged\n");
+        return;
+    }
+
+    /* Hosts: drop the lookups of removed or readdressed hosts first, an
+     * address may have moved to another ID */
+    old_node_ip[0] = 0;
+    for (i = 1; i <= MAX_NODES; i++) {
+        old_node_ip[i] = temp_node_ip[i];
+        if (temp_node_ip[i] != 0 && Reload_Node_IP[i] != temp_node_ip[i]) {
+            id32   = i;
+            addr32 = temp_node_ip[i];
+            stdhash_erase_key(&Node_Lookup_Addr_to_ID, &addr32);
+            stdhash_erase_key(&Node_Lookup_ID_to_Addr, &id32);
+            Alarm(PRINT, "Conf_Reload: host %d ("IPF") removed\n", i, IP(temp_node_ip[i]));
+        }
+    }
+
+    count = 0;
+    for (i = 1; i <= MAX_NODES; i++) {
+        if (Reload_Node_IP[i] != 0 && Reload_Node_IP[i] != temp_node_ip[i]) {
+            id32   = i;
+            addr32 = Reload_Node_IP[i];
+            stdhash_insert(&Node_Lookup_Addr_to_ID, &it, &addr32, &id32);
+            stdhash_insert(&Node_Lookup_ID_to_Addr, &it, &id32, &addr32);
+            if (Reload_Pub_Keys[i] != NULL) {
+                if (Pub_Keys[i] != NULL)
+                    EVP_PKEY_free(Pub_Keys[i]);
+                Pub_Keys[i]        = Reload_Pub_Keys[i];
+                Reload_Pub_Keys[i] = NULL;
+            }
+            Alarm(PRINT, "Conf_Reload: host %d ("IPF") added\n", i, IP(Reload_Node_IP[i]));
+        }
+        temp_node_ip[i] = Reload_Node_IP[i];
+        if (temp_node_ip[i] != 0)
+            count++;
+    }
+    temp_num_nodes = Num_Nodes = count;
+
+    /* Edges */
+    old_edges    = Sorted_Edges;
+    Sorted_Edges = Reload_Edges;
+    Reload_Edges = old_edges;
+
+    old_degree = Degree[My_ID];
+    for (j = 1; j <= old_degree; j++) {
+        slot_id[j]   = Neighbor_IDs[My_ID][j];
+        slot_addr[j] = Neighbor_Addrs[My_ID][j];
+    }
+
+    for (i = 0; i <= MAX_NODES; i++) {
+        Degree[i] = 0;
+        for (j = 0; j <= MAX_NODES; j++)
+            temp_neighbor_id[i][j] = 0;
+    }
+    for (stdskl_begin(&Sorted_Edges, &it); !stdskl_is_end(&Sorted_Edges, &it); 
+            stdskl_it_next(&it)) 
+    {
+        key = (Edge_Key*) stdskl_it_key(&it);
+        if (key->src_id != My_ID)
+            temp_neighbor_id[key->src_id][++Degree[key->src_id]] = key->dst_id;
+        if (Directed_Edges == 0 && key->dst_id != My_ID)
+            temp_neighbor_id[key->dst_id][++Degree[key->dst_id]] = key->src_id;
+    }
+
+    /* Our own neighbors: keep every current slot, append the new ones */
+    Degree[My_ID] = old_degree;
+    for (j = 1; j <= old_degree; j++) {
+        temp_neighbor_id[My_ID][j] = slot_id[j];
+        if (temp_node_ip[slot_id[j]] != 0)
+            slot_addr[j] = temp_node_ip[slot_id[j]];
+    }
+    for (stdskl_begin(&Sorted_Edges, &it); !stdskl_is_end(&Sorted_Edges, &it); 
+            stdskl_it_next(&it)) 
+    {
+        key = (Edge_Key*) stdskl_it_key(&it);
+        if (key->src_id == My_ID)
+            i = key->dst_id;
+        else if (Directed_Edges == 0 && key->dst_id == My_ID)
+            i = key->src_id;
+        else
+            continue;
+
+        for (j = 1; j <= Degree[My_ID]; j++)
+            if (temp_neighbor_id[My_ID][j] == i)
+                break;
+        if (j > Degree[My_ID]) {
+            Degree[My_ID]++;
+            temp_neighbor_id[My_ID][j] = i;
+            slot_addr[j] = temp_node_ip[i];
+        }
+    }
+
+    for (i = 1; i <= MAX_NODES; i++) { 
+        dispose(Neighbor_IDs[i]);
+        dispose(Neighbor_Addrs[i]);
+        Neighbor_IDs[i]   = (int16u *) Mem_alloc( sizeof(int16u) * (Degree[i]+1) );
+        Neighbor_Addrs[i] = (int32u *) Mem_alloc( sizeof(int32u) * (Degree[i]+1) );
+
+        for (j=1; j <= Degree[i]; j++) {
+            Neighbor_IDs[i][j]    = temp_neighbor_id[i][j];
+            Neighbor_Addrs[i][j]  = (i == My_ID) ? slot_addr[j] : temp_node_ip[temp_neighbor_id[i][j]];
+        }
+    }
+
+    Alarm(PRINT, "Conf_Reload: Degree = %d\n", Degree[My_ID]);
+    for (j=1; j <= Degree[My_ID]; j++)
+        Alarm(PRINT, "Conf_Reload: Ngbr[%d] = (%d,"IPF")\n", j, Neighbor_IDs[My_ID][j], IP(Neighbor_Addrs[My_ID][j]));
+
+    Reconfigure_Network(old_node_ip, &Reload_Edges, old_degree);
+}
+
 void Conf_set_all_crypto(bool new_state) 
 {
     /* Crypto = new_state; */
@@ -330,18 +733,34 @@ void Conf_set_all_crypto(bool new_state)
 void Conf_set_signature_len_bits(int new_value)
 {
     if (new_value != 2048 && new_value != 1024 && new_value != 512)
-        Alarm(EXIT, "Conf_signature_len_bits: Configuration File must "
+        Alarm(Conf_Reloading ? PRINT : EXIT, "Conf_signature_len_bits: Configuration File must "
                 "specify either 512 or 1024 or 2048 bit signatures\r\n");
     Signature_Len_Bits = new_value;
 }
 
+void Conf_set_signature_scheme(char *name)
+{
+    if (My_ID != 0 && !Conf_Reloading)
+        Alarm(EXIT, "Conf_set_signature_scheme: Signature_Scheme cannot be "
+                "altered once hosts are loaded. Please move it before the "
+                "host lists in the configuration file.\n");
+
+    if (strcasecmp(name, "RSA") == 0)
+        Signature_Scheme = SEC_SIG_RSA;
+    else if (strcasecmp(name, "Ed25519") == 0)
+        Signature_Scheme = SEC_SIG_ED25519;
+    else
+        Alarm(Conf_Reloading ? PRINT : EXIT, "Conf_set_signature_scheme: Invalid "
+                "value (%s), must be RSA or Ed25519\n", name);
+}
+
 void Conf_set_multipath_bitmask_size(int new_value)
 {
     if (new_value % 64 != 0)
-        Alarm(EXIT, "Conf_set_multipath_bitmask_size: bitmask size must "
+        Alarm(Conf_Reloading ? PRINT : EXIT, "Conf_set_multipath_bitmask_size: bitmask size must "
                     "be a multiple of 64\r\n");
     if (new_value <= 0)
-        Alarm(EXIT, "Conf_set_multipath_bitmask_size: bitmask size must "
+        Alarm(Conf_Reloading ? PRINT : EXIT, "Conf_set_multipath_bitmask_size: bitmask size must "
                     "be greater than 0 \r\n");
     MultiPath_Bitmask_Size = new_value / 8;
 }
@@ -366,7 +785,7 @@ void Conf_set_unix_domain_path(char *new_prefix)
     s_len = SUN_PATH_LEN - strlen(SPINES_UNIX_DATA_SUFFIX) - 1;
     ret = snprintf(Unix_Domain_Prefix, s_len, "%s", new_prefix);
     if (ret > s_len) {
-        Alarm(EXIT, "Conf_set_unix_domain_path: path name too long (%d), "
+        Alarm(Conf_Reloading ? PRINT : EXIT, "Conf_set_unix_domain_path: path name too long (%d), "
                         "max allowed = %u\n", ret, s_len);
     }
     Unix_Domain_Use_Default = 0;
@@ -380,7 +799,7 @@ void Conf_set_remote_connections(bool new_state)
 
 void Conf_set_IT_crypto(bool new_state)
 {
-    if (My_ID != 0)
+    if (My_ID != 0 && !Conf_Reloading)
         Alarm(EXIT, "Conf_set_IT_crypto: Crypto settings cannot be altered "
                 "once hosts are loaded. Please move Crypto settings before "
                 "the host lists in the configuration file.\n");
@@ -395,7 +814,7 @@ void Conf_set_IT_crypto(bool new_state)
 
 void Conf_set_IT_encrypt(bool new_state)
 {
-    if (My_ID != 0)
+    if (My_ID != 0 && !Conf_Reloading)
         Alarm(EXIT, "Conf_set_IT_encrypt: Crypto settings cannot be altered "
                 "once hosts are loaded. Please move Crypto settings before "
                 "the host lists in the configuration file.\n");
@@ -543,9 +962,105 @@ void Conf_set_IT_default_RTT(int new_value)
     Conf_IT_Link.Default_RTT = new_value;
 }
 
-void Conf_set_RR_crypto(bool new_state) 
+void Conf_set_RT_fec(bool new_state)
+{
+    Conf_RT_Link.FEC = new_state;
+}
+
+void Conf_set_RT_fec_min_block(int new_value)
+{
+    if (new_value <= 0 || new_value > RT_FEC_MAX_BLOCK) {
+        Alarm(PRINT, "Conf_set_RT_fec_min_block: Invalid value (%d), must "
+                "be between 1 and %d\n", new_value, RT_FEC_MAX_BLOCK);
+        return;
+    }
+    Conf_RT_Link.FEC_Min_Block = new_value;
+}
+
+void Conf_set_RT_fec_max_block(int new_value)
 {
-    if (My_ID != 0)
+    if (new_value <= 0 || new_value > RT_FEC_MAX_BLOCK) {
+        Alarm(PRINT, "Conf_set_RT_fec_max_block: Invalid value (%d), must "
+                "be between 1 and %d\n", new_value, RT_FEC_MAX_BLOCK);
+        return;
+    }
+    Conf_RT_Link.FEC_Max_Block = new_value;
+}
+
+void Conf_set_RT_fec_flush_timeout(int new_value)
+{
+    if (new_value <= 0) {
+        Alarm(PRINT, "Conf_set_RT_fec_flush_timeout: Invalid value (%d)\n",
+                new_value);
+        return;
+    }
+    Conf_RT_Link.FEC_Flush_Timeout = new_value;
+}
+
+void Conf_set_CC_control_links(char *name)
+{
+    int algorithm = CC_Algorithm_ID(name);
+
+    if (algorithm < 0) {
+        Alarm(PRINT, "Conf_set_CC_control_links: Invalid value (%s), must "
+                "be AIMD, CUBIC or BBR\n", name);
+        return;
+    }
+    Conf_CC.Control_Links = algorithm;
+}
+
+void Conf_set_CC_reliable_links(char *name)
+{
+    int algorithm = CC_Algorithm_ID(name);
+
+    if (algorithm < 0) {
+        Alarm(PRINT, "Conf_set_CC_reliable_links: Invalid value (%s), must "
+                "be AIMD, CUBIC or BBR\n", name);
+        return;
+    }
+    Conf_CC.Reliable_Links = algorithm;
+}
+
+void Conf_set_CC_reliable_sessions(char *name)
+{
+    int algorithm = CC_Algorithm_ID(name);
+
+    if (algorithm < 0) {
+        Alarm(PRINT, "Conf_set_CC_reliable_sessions: Invalid value (%s), must "
+                "be AIMD, CUBIC or BBR\n", name);
+        return;
+    }
+    Conf_CC.Reliable_Sessions = algorithm;
+}
+
+void Conf_set_FD_fast_detect(bool new_state)
+{
+    Conf_FD.Fast_Detect = new_state;
+}
+
+void Conf_set_FD_detect_time(int new_value)
+{
+    if (new_value <= 0) {
+        Alarm(PRINT, "Conf_set_FD_detect_time: Invalid value (%d)\n",
+                new_value);
+        return;
+    }
+    Conf_FD.Detect_Time = new_value;
+}
+
+void Conf_set_FD_detect_mult(int new_value)
+{
+    if (new_value <= 0) {
+        Alarm(PRINT, "Conf_set_FD_detect_mult: Invalid value (%d)\n",
+                new_value);
+        return;
+    }
+    Conf_FD.Detect_Mult = new_value;
+}
+
+void Conf_set_RR_crypto(bool new_state)
+{
+    if (My_ID != 0 && !Conf_Reloading)
         Alarm(EXIT, "Conf_set_RR_crypto: Crypto settings cannot be altered "
                 "once hosts are loaded. Please move Crypto settings before "
                 "the host lists in the configuration file.\n");
@@ -556,9 +1071,20 @@ void Conf_set_RR_crypto(bool new_state)
     Conf_RR.Crypto = new_state;
 }
 
+void Conf_set_RR_source_dedup_window(int new_value)
+{
+    if (new_value <= 0 || new_value > (1 << 24)) {
+        Alarm(PRINT, "Conf_set_RR_source_dedup_window: Invalid value (%d)\n",
+            new_value);
+        return;
+    }
+    /* Whole 64-bit words of the bitmap */
+    Conf_RR.Source_Dedup_Window = (new_value + 63) & ~63;
+}
+
 void Conf_set_Prio_crypto(bool new_state)
 {
-    if (My_ID != 0)
+    if (My_ID != 0 && !Conf_Reloading)
         Alarm(EXIT, "Conf_set_Prio_crypto: Crypto settings cannot be altered "
                 "once hosts are loaded. Please move Crypto settings before "
                 "the host lists in the configuration file.\n");
@@ -629,9 +1155,19 @@ void Conf_set_Prio_garbage_collection_sec(int new_value)
     Conf_Prio.Garbage_Collection_Sec = new_value;
 }
 
+void Conf_set_Prio_sig_batch_usec(int new_value)
+{
+    if (new_value < 0 || new_value >= 1000000) {
+        Alarm(PRINT, "Conf_set_Prio_sig_batch_usec: Invalid value (%d)\n",
+            new_value);
+        return;
+    }
+    Conf_Prio.Sig_Batch_USec = new_value;
+}
+
 void Conf_set_Rel_crypto(bool new_state)
 {
-    if (My_ID != 0)
+    if (My_ID != 0 && !Conf_Reloading)
         Alarm(EXIT, "Conf_set_Rel_crypto: Crypto settings cannot be altered "
                 "once hosts are loaded. Please move Crypto settings before "
                 "the host lists in the configuration file.\n");
@@ -760,11 +1296,14 @@ void Conf_set_Reroute_status_change_timeout(int new_value)
 void Conf_add_host(int id, int ip)
 {
     stdit   ip_it;
-    char    keyFile[80];
-    FILE    *key_fp;
 
     /* Alarm(PRINT, "Conf_add_host invoked (%d)\n", id); */
 
+    if (Conf_Reloading) {
+        Conf_stage_host(id, ip);
+        return;
+    }
+
     if (id <= 0) {
         Alarm(EXIT, "Conf_add_host: Invalid ID (%d) - Too Low\n", id);
     }
@@ -786,23 +1325,107 @@ void Conf_add_host(int id, int ip)
     temp_node_ip[id] = ip;
     temp_num_nodes++;
 
-    if (Conf_IT_Link.Crypto == 1 || Conf_Prio.Crypto == 1 || Conf_Rel.Crypto == 1) {
-        snprintf(keyFile, 80, "keys/public%d.pem", id);
-        key_fp = fopen(keyFile, "r");
-        if (key_fp == NULL)
-            Alarm(EXIT, "Util_Load_Addresses: cannot find file "
-                        "keys/public%d.pem\r\n", id);
-        Pub_Keys[id] = PEM_read_PUBKEY(fopen(keyFile,"r"), 
-                NULL, NULL, NULL);
-        if (Pub_Keys[id] == NULL)
-            Alarm(EXIT, "Util_Load_Addresses: Unable to read key "
-                        "from keys/public%d.pem\r\n", id);
+    Conf_load_pub_key(id);
+}
+
+static void Conf_load_pub_key(int id)
+{
+    if (Conf_IT_Link.Crypto == 1 || Conf_Prio.Crypto == 1 || Conf_Rel.Crypto == 1)
+        Pub_Keys[id] = Conf_read_pub_key(id, EXIT);
+}
+
+/* Reads keys/public<id>.pem. Problems are reported at the given
+ * severity, NULL is returned if it is not EXIT */
+static EVP_PKEY *Conf_read_pub_key(int id, int severity)
+{
+    char     keyFile[80];
+    FILE     *key_fp;
+    EVP_PKEY *key;
+
+    snprintf(keyFile, 80, "keys/public%d.pem", id);
+    key_fp = fopen(keyFile, "r");
+    if (key_fp == NULL) {
+        Alarm(severity, "Util_Load_Addresses: cannot find file "
+                    "keys/public%d.pem\r\n", id);
+        return NULL;
+    }
+    key = PEM_read_PUBKEY(key_fp, NULL, NULL, NULL);
+    fclose(key_fp);
+    if (key == NULL) {
+        Alarm(severity, "Util_Load_Addresses: Unable to read key "
+                    "from keys/public%d.pem\r\n", id);
+        return NULL;
+    }
+    if (!Sec_key_matches_scheme(key, Signature_Scheme)) {
+        Alarm(severity, "Util_Load_Addresses: keys/public%d.pem does not "
+                    "match Signature_Scheme\r\n", id);
+        EVP_PKEY_free(key);
+        return NULL;
     }
+    return key;
+}
+
+/* Loads the keys of the hosts a reload adds. A missing or bad key
+ * rejects the new topology, as an invalid Hosts entry would */
+static void Conf_stage_pub_keys(void)
+{
+    int i;
+
+    if (Conf_IT_Link.Crypto != 1 && Conf_Prio.Crypto != 1 && Conf_Rel.Crypto != 1)
+        return;
 
+    for (i = 1; i <= MAX_NODES && !Reload_Topology_Error; i++) {
+        if (Reload_Node_IP[i] != 0 && Reload_Node_IP[i] != temp_node_ip[i]) {
+            Reload_Pub_Keys[i] = Conf_read_pub_key(i, PRINT);
+            if (Reload_Pub_Keys[i] == NULL)
+                Reload_Topology_Error = 1;
+        }
+    }
+}
+
+/* Drops the staged keys the reload did not install */
+static void Conf_free_staged_keys(void)
+{
+    int i;
+
+    for (i = 1; i <= MAX_NODES; i++) {
+        if (Reload_Pub_Keys[i] != NULL) {
+            EVP_PKEY_free(Reload_Pub_Keys[i]);
+            Reload_Pub_Keys[i] = NULL;
+        }
+    }
+}
+
+/* Conf_add_host for a reloaded file: errors reject the new topology
+ * instead of stopping the daemon */
+static void Conf_stage_host(int id, int ip)
+{
+    if (id <= 0 || id > MAX_NODES) {
+        Alarm(PRINT, "Conf_Reload: Invalid host ID (%d)\n", id);
+        Reload_Topology_Error = 1;
+        return;
+    }
+
+    if (Reload_Node_IP[id] != 0) {
+        Alarm(PRINT, "Conf_Reload: Ignoring host [%d]: "IPF", entry already"
+                " exists for this ID\r\n", id, IP(ip));
+        return;
+    }
+
+    Reload_Node_IP[id] = ip;
 }
 
 void    Conf_validate_hosts()
 {
+    if (Conf_Reloading) {
+        if (Reload_Node_IP[My_ID] != My_Address) {
+            Alarm(PRINT, "Conf_Reload: host %d is no longer this machine ("IPF")\n",
+                    My_ID, IP(My_Address));
+            Reload_Topology_Error = 1;
+        }
+        return;
+    }
+
     if (My_ID == 0)
         Alarm(EXIT, "Conf_validate_hosts: This machine is not specified"
                 " as a host in the configuration file\n");
@@ -816,6 +1439,11 @@ void    Conf_add_edge(int h1, int h2, int c)
 
 
     Alarm(DEBUG, "Conf_add_edge invoked between %d and %d\n", h1, h2);
+
+    if (Conf_Reloading) {
+        Conf_stage_edge(h1, h2, c);
+        return;
+    }
  
     if (temp_node_ip[h1] == 0 || temp_node_ip[h2] == 0) {
         Alarm(EXIT, "Conf_add_edge: Adding an edge between logical"
@@ -877,6 +1505,43 @@ void    Conf_add_edge(int h1, int h2, int c)
     stdskl_insert(&Sorted_Edges, &it, &key, &val, STDFALSE);
 }
 
+/* Conf_add_edge for a reloaded file. The neighbor lists are derived from
+ * the whole edge list once the file parsed */
+static void Conf_stage_edge(int h1, int h2, int c)
+{
+    stdit it;
+    Edge_Key key;
+    Edge_Value val;
+
+    if (h1 <= 0 || h1 > MAX_NODES || h2 <= 0 || h2 > MAX_NODES ||
+            Reload_Node_IP[h1] == 0 || Reload_Node_IP[h2] == 0) 
+    {
+        Alarm(PRINT, "Conf_Reload: Adding an edge between logical"
+                " IDs that are not both defined (%d, %d)\r\n", h1, h2);
+        Reload_Topology_Error = 1;
+        return;
+    }
+
+    if (h1 == h2) {
+        Alarm(PRINT, "Conf_Reload: Ignoring edge (%d, %d) since both"
+                " endpoints are the same node\r\n", h1, h2);
+        return;
+    }
+
+    if (Directed_Edges == 0 && h1 > h2) {
+        key.src_id = h2;
+        key.dst_id = h1;
+    }
+    else {
+        key.src_id = h1;
+        key.dst_id = h2;
+    }
+    val.cost = c;
+    val.index = 0;
+
+    stdskl_insert(&Reload_Edges, &it, &key, &val, STDFALSE);
+}
+
 void    Conf_compute_hash()
 {
     unsigned char buff[2048] = { 0 };
@@ -894,6 +1559,10 @@ void    Conf_compute_hash()
     *(int16u*)(buff + written) = Signature_Len_Bits;
         written += sizeof(int16u);
 
+    /* Add Signature_Scheme */
+    *(unsigned char*)(buff + written) = Signature_Scheme;
+        written += sizeof(unsigned char);
+
     /* Add MultiPath_Bitmask_Size */
     *(int16u*)(buff + written) = MultiPath_Bitmask_Size;
         written += sizeof(int16u);
@@ -39,11 +39,15 @@
 
 #include "arch.h"
 #include "intrusion_tol_udp.h"
+#include "realtime_udp.h"
+#include "congestion.h"
+#include "hello.h"
 #include "priority_flood.h"
 #include "reliable_flood.h"
 #include "net_types.h"
 #include "multipath.h"
 #include "spines.h"
+#include "security.h"
 
 #include <stdio.h>
 #include <openssl/sha.h>
@@ -52,6 +56,7 @@
 #define HMAC_KEY_LEN 32            /* SHA-2-256 */
 #define DH_PRIME_LEN_BITS 2048
 #define SIGNATURE_LEN_BITS  1024   /* RSA 1024 */
+#define SIGNATURE_SCHEME    SEC_SIG_RSA
 #define PATH_STAMP_DEBUG 0
 #define REMOTE_CONNECTIONS 1
 
@@ -77,6 +82,7 @@ extern int16u HMAC_Key_Len;
 extern int16u DH_Key_Len;
 extern int16u Signature_Len;
 extern int16u Signature_Len_Bits;
+ext unsigned char Signature_Scheme;
 extern EVP_PKEY *Pub_Keys[MAX_NODES + 1];
 extern EVP_PKEY *Priv_Key;
 ext unsigned char Path_Stamp_Debug;
@@ -92,9 +98,11 @@ void        Pre_Conf_Setup(void);
 void        Post_Conf_Setup(void);
 void		Conf_init( char *file_name /*, char *my_name*/ );
 void	    Conf_load_conf_file( char *file_name /*, char *my_name*/ );
+void        Conf_Reload(void);
 
 void        Conf_set_all_crypto(bool new_state);
 void        Conf_set_signature_len_bits(int new_value);
+void        Conf_set_signature_scheme(char *name);
 void        Conf_set_multipath_bitmask_size(int new_value);
 void        Conf_set_directed_edges(bool new_state);
 void        Conf_set_path_stamp_debug(bool new_state);
@@ -120,7 +128,21 @@ void        Conf_set_IT_incarnation_timeout(int new_value);
 void        Conf_set_IT_min_RTT_ms(int new_value);
 void        Conf_set_IT_default_RTT(int new_value);
 
+void        Conf_set_RT_fec(bool new_state);
+void        Conf_set_RT_fec_min_block(int new_value);
+void        Conf_set_RT_fec_max_block(int new_value);
+void        Conf_set_RT_fec_flush_timeout(int new_value);
+
+void        Conf_set_CC_control_links(char *name);
+void        Conf_set_CC_reliable_links(char *name);
+void        Conf_set_CC_reliable_sessions(char *name);
+
+void        Conf_set_FD_fast_detect(bool new_state);
+void        Conf_set_FD_detect_time(int new_value);
+void        Conf_set_FD_detect_mult(int new_value);
+
 void        Conf_set_RR_crypto(bool new_state);
+void        Conf_set_RR_source_dedup_window(int new_value);
 
 void        Conf_set_Prio_crypto(bool new_state);
 void        Conf_set_Prio_default_prio(int new_value);
@@ -129,6 +151,7 @@ void        Conf_set_Prio_min_belly_size(int new_value);
 void        Conf_set_Prio_default_expire_sec(int new_value);
 void        Conf_set_Prio_default_expire_usec(int new_value);
 void        Conf_set_Prio_garbage_collection_sec(int new_value);
+void        Conf_set_Prio_sig_batch_usec(int new_value);
     
 void        Conf_set_Rel_crypto(bool new_state);
 void        Conf_set_Rel_saa_threshold(int new_value);
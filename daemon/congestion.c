@@ -0,0 +1,770 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "arch.h"
+#include "spu_alarm.h"
+#include "spu_events.h"
+#include "stdutil/stdcarr.h"
+
+#include "net_types.h"
+#include "node.h"
+#include "link.h"
+#include "congestion.h"
+#include "spines.h"
+
+#ifdef ARCH_PC_WIN95
+#  define strcasecmp _stricmp
+#endif
+
+/* BBR modes */
+#define BBR_STARTUP     0
+#define BBR_DRAIN       1
+#define BBR_PROBE_BW    2
+#define BBR_PROBE_RTT   3
+
+CONF_CC Conf_CC;
+
+static const double BBR_Cycle_Gain[CC_BBR_CYCLE_LEN] =
+    { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+static double CC_Usec(sp_time t)
+{
+    return (double)t.sec * 1000000.0 + (double)t.usec;
+}
+
+static void CC_Clamp_Window(Reliable_Data *r_data)
+{
+    if(r_data->window_size < r_data->cc.min_window) {
+        r_data->window_size = r_data->cc.min_window;
+    }
+    if(r_data->window_size > r_data->max_window) {
+        r_data->window_size = (float)r_data->max_window;
+    }
+}
+
+/* Only the first loss of a window reduces it again. The recovery lasts
+ * one smoothed RTT from the reduction (a second if none was measured) */
+static int CC_In_Recovery(Reliable_Data *r_data, sp_time now)
+{
+    sp_time rtt;
+
+    if(E_compare_time(now, r_data->cc.recovery_end) < 0) {
+        return 1;
+    }
+    if(r_data->cc.srtt == 0) {
+        rtt.sec  = 1;
+        rtt.usec = 0;
+    }
+    else {
+        rtt.sec  = r_data->cc.srtt/1000000;
+        rtt.usec = r_data->cc.srtt%1000000;
+    }
+    r_data->cc.recovery_end = E_add_time(now, rtt);
+    return 0;
+}
+
+/***********************************************************/
+/* AIMD: the original Spines window adjustment             */
+/***********************************************************/
+
+static void AIMD_Init(Reliable_Data *r_data)
+{
+    UNUSED(r_data);
+}
+
+static void AIMD_On_Ack(Reliable_Data *r_data, float stream_window,
+                        sp_time sent, int flags, sp_time now)
+{
+    UNUSED(sent);
+    UNUSED(now);
+
+    if(!TCP_Fairness || flags != 0) {
+        return;
+    }
+    if(r_data->window_size < r_data->ssthresh) {
+        /* Slow start */
+        r_data->window_size += 1;
+    }
+    else {
+        /* Congestion avoidance */
+        r_data->window_size += 1/stream_window;
+    }
+    if(r_data->window_size > r_data->max_window) {
+        r_data->window_size = (float)r_data->max_window;
+    }
+}
+
+static void AIMD_On_Loss(Reliable_Data *r_data, int event,
+                         float stream_window, sp_time now)
+{
+    float min_window = r_data->cc.min_window;
+
+    UNUSED(now);
+
+    if(!TCP_Fairness) {
+        return;
+    }
+
+    switch(event) {
+    case CC_LOSS_NACK:
+        r_data->ssthresh = (unsigned int)(r_data->window_size - stream_window/2);
+        r_data->window_size = r_data->window_size - stream_window/2;
+        break;
+    case CC_LOSS_TIMEOUT:
+        r_data->ssthresh = (unsigned int)(r_data->window_size - stream_window/2);
+        r_data->window_size = r_data->window_size - stream_window + 1;
+        break;
+    case CC_ECN_MODERATE:
+        r_data->ssthresh /= 2;
+        r_data->window_size /= 2;
+        break;
+    case CC_ECN_SEVERE:
+        r_data->ssthresh /= 2;
+        r_data->window_size = min_window;
+        break;
+    }
+    if(r_data->ssthresh < (unsigned int)min_window) {
+        r_data->ssthresh = (unsigned int)min_window;
+    }
+    if(r_data->window_size < min_window) {
+        r_data->window_size = min_window;
+    }
+}
+
+static void AIMD_On_RTT_Sample(Reliable_Data *r_data, int32u rtt, sp_time now)
+{
+    UNUSED(r_data);
+    UNUSED(rtt);
+    UNUSED(now);
+}
+
+static double AIMD_Pacing_Rate(Reliable_Data *r_data)
+{
+    UNUSED(r_data);
+    return 0;
+}
+
+/***********************************************************/
+/* CUBIC (RFC 8312)                                        */
+/***********************************************************/
+
+static void CUBIC_Init(Reliable_Data *r_data)
+{
+    r_data->window_size = CC_INIT_WINDOW;
+    r_data->ssthresh    = r_data->max_window;
+    CC_Clamp_Window(r_data);
+}
+
+static void CUBIC_On_Ack(Reliable_Data *r_data, float stream_window,
+                         sp_time sent, int flags, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+    double t, target, w;
+
+    UNUSED(sent);
+    UNUSED(stream_window);
+
+    if(flags != 0) {
+        return;
+    }
+
+    if(r_data->window_size < r_data->ssthresh) {
+        r_data->window_size += 1;
+        CC_Clamp_Window(r_data);
+        return;
+    }
+
+    w = r_data->window_size;
+    if(!cc->epoch_valid) {
+        cc->epoch_valid = 1;
+        cc->epoch_start = now;
+        if(w < cc->w_max) {
+            cc->k      = cbrt((cc->w_max - w) / CC_CUBIC_C);
+            cc->origin = cc->w_max;
+        }
+        else {
+            cc->k      = 0;
+            cc->origin = w;
+        }
+        cc->w_est = w;
+    }
+
+    t = (CC_Usec(E_sub_time(now, cc->epoch_start)) + cc->min_rtt) / 1000000.0;
+    target = cc->origin + CC_CUBIC_C * (t - cc->k) * (t - cc->k) * (t - cc->k);
+
+    /* Grow towards the cubic target over the next RTT, but by no more
+     * than half a packet per ack */
+    if(target > w) {
+        if(target > 1.5 * w) {
+            target = 1.5 * w;
+        }
+        w += (target - w) / w;
+    }
+    else {
+        w += 0.01 / w;
+    }
+
+    /* Never grow slower than a Reno flow would */
+    cc->w_est += 3 * (1 - CC_CUBIC_BETA) / (1 + CC_CUBIC_BETA) / r_data->window_size;
+    if(cc->w_est > w) {
+        w = cc->w_est;
+    }
+
+    r_data->window_size = (float)w;
+    CC_Clamp_Window(r_data);
+}
+
+static void CUBIC_On_Loss(Reliable_Data *r_data, int event,
+                          float stream_window, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+    double w = r_data->window_size;
+
+    UNUSED(stream_window);
+
+    if(event != CC_LOSS_TIMEOUT && event != CC_ECN_SEVERE &&
+       CC_In_Recovery(r_data, now)) {
+        return;
+    }
+
+    cc->epoch_valid = 0;
+    /* Fast convergence: give up bandwidth to newer flows */
+    if(w < cc->w_max) {
+        cc->w_max = w * (1 + CC_CUBIC_BETA) / 2;
+    }
+    else {
+        cc->w_max = w;
+    }
+
+    r_data->ssthresh = (int32u)(w * CC_CUBIC_BETA);
+    if(r_data->ssthresh < (int32u)cc->min_window) {
+        r_data->ssthresh = (int32u)cc->min_window;
+    }
+
+    if(event == CC_LOSS_TIMEOUT || event == CC_ECN_SEVERE) {
+        r_data->window_size = cc->min_window;
+    }
+    else {
+        r_data->window_size = (float)(w * CC_CUBIC_BETA);
+    }
+    CC_Clamp_Window(r_data);
+}
+
+static void CUBIC_On_RTT_Sample(Reliable_Data *r_data, int32u rtt, sp_time now)
+{
+    UNUSED(r_data);
+    UNUSED(rtt);
+    UNUSED(now);
+}
+
+static double CUBIC_Pacing_Rate(Reliable_Data *r_data)
+{
+    double gain;
+
+    if(r_data->cc.srtt == 0) {
+        return 0;
+    }
+    /* Leave room for the window to grow: twice the current rate in slow
+     * start, 20% more in congestion avoidance */
+    gain = (r_data->window_size < r_data->ssthresh) ? 2.0 : 1.2;
+    return gain * r_data->window_size * 1000000.0 / r_data->cc.srtt;
+}
+
+/***********************************************************/
+/* BBR: paces at the measured bottleneck bandwidth and     */
+/* keeps about two bandwidth-delay products in flight      */
+/***********************************************************/
+
+static void BBR_Enter_Probe_BW(Reliable_Data *r_data, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+
+    cc->mode        = BBR_PROBE_BW;
+    cc->cwnd_gain   = 2;
+    cc->cycle_idx   = 1 + rand() % (CC_BBR_CYCLE_LEN - 1);
+    cc->pacing_gain = BBR_Cycle_Gain[cc->cycle_idx];
+    cc->cycle_start = now;
+}
+
+static void BBR_Init(Reliable_Data *r_data)
+{
+    CC_State *cc = &r_data->cc;
+
+    if(cc->min_window < CC_BBR_MIN_WINDOW) {
+        cc->min_window = CC_BBR_MIN_WINDOW;
+    }
+    cc->mode        = BBR_STARTUP;
+    cc->pacing_gain = CC_BBR_HIGH_GAIN;
+    cc->cwnd_gain   = CC_BBR_HIGH_GAIN;
+
+    r_data->window_size = CC_INIT_WINDOW;
+    r_data->ssthresh    = r_data->max_window;
+    CC_Clamp_Window(r_data);
+}
+
+static double BBR_BDP(Reliable_Data *r_data)
+{
+    return r_data->cc.btl_bw * r_data->cc.min_rtt / 1000000.0;
+}
+
+/* Called once per round trip with the delivery rate of that round.
+ * When a loss was reported during the round, the repaired hole may
+ * have acked packets that went out faster than the path delivers
+ * them, so such a round can confirm the bandwidth but not raise it */
+static void BBR_Update_Model(Reliable_Data *r_data, double bw, int app_limited,
+                             int lossy, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+    int i;
+
+    if(lossy && cc->btl_bw > 0 && bw > cc->btl_bw) {
+        bw = cc->btl_bw;
+    }
+    if(!app_limited || bw > cc->btl_bw) {
+        cc->bw_samples[cc->bw_idx] = bw;
+        cc->bw_idx = (cc->bw_idx + 1) % CC_BBR_BW_ROUNDS;
+        cc->btl_bw = 0;
+        for(i = 0; i < CC_BBR_BW_ROUNDS; i++) {
+            if(cc->bw_samples[i] > cc->btl_bw) {
+                cc->btl_bw = cc->bw_samples[i];
+            }
+        }
+    }
+
+    if(cc->mode == BBR_STARTUP && !app_limited) {
+        /* The pipe is full once the bandwidth stops growing by 25% */
+        if(cc->btl_bw >= cc->full_bw * 1.25) {
+            cc->full_bw     = cc->btl_bw;
+            cc->full_bw_cnt = 0;
+        }
+        else if(++cc->full_bw_cnt >= 3) {
+            cc->mode        = BBR_DRAIN;
+            cc->pacing_gain = 1 / CC_BBR_HIGH_GAIN;
+            cc->cwnd_gain   = CC_BBR_HIGH_GAIN;
+        }
+    }
+    if(cc->mode == BBR_DRAIN &&
+       (double)(r_data->head - r_data->tail) <= BBR_BDP(r_data)) {
+        BBR_Enter_Probe_BW(r_data, now);
+    }
+}
+
+static void BBR_On_Ack(Reliable_Data *r_data, float stream_window,
+                       sp_time sent, int flags, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+    double elapsed, sent_elapsed, target, round_len;
+    sp_time probe;
+
+    UNUSED(stream_window);
+
+    cc->delivered++;
+    if(cc->round_start.sec == 0 && cc->round_start.usec == 0) {
+        cc->round_start     = now;
+        cc->round_sent      = sent;
+        cc->round_delivered = cc->delivered - 1;
+    }
+
+    /* A round lasts one min_rtt (1 ms until there is a sample). The
+     * delivery rate is taken over the longer of the time the packets
+     * took to be acked and to be sent: a hole that gets repaired acks
+     * many packets at once, faster than they could have gone through */
+    round_len = cc->min_rtt ? cc->min_rtt : 1000;
+    elapsed = CC_Usec(E_sub_time(now, cc->round_start));
+    if(elapsed >= round_len) {
+        sent_elapsed = CC_Usec(E_sub_time(sent, cc->round_sent));
+        if(sent_elapsed > elapsed) {
+            elapsed = sent_elapsed;
+        }
+        BBR_Update_Model(r_data,
+                         (cc->delivered - cc->round_delivered) * 1000000.0 / elapsed,
+                         flags & CC_ACK_APP_LIMITED, cc->round_loss, now);
+        cc->round_loss      = 0;
+        cc->round_start     = now;
+        cc->round_sent      = sent;
+        cc->round_delivered = cc->delivered;
+    }
+
+    if(cc->mode == BBR_PROBE_BW &&
+       CC_Usec(E_sub_time(now, cc->cycle_start)) >= round_len) {
+        cc->cycle_idx   = (cc->cycle_idx + 1) % CC_BBR_CYCLE_LEN;
+        cc->pacing_gain = BBR_Cycle_Gain[cc->cycle_idx];
+        cc->cycle_start = now;
+    }
+
+    /* Drain the queue now and then so min_rtt stays accurate */
+    if(cc->mode != BBR_PROBE_RTT && cc->min_rtt != 0 &&
+       now.sec - cc->min_rtt_stamp.sec > CC_BBR_MIN_RTT_SEC) {
+        cc->mode           = BBR_PROBE_RTT;
+        cc->pacing_gain    = 1;
+        cc->prior_window   = r_data->window_size;
+        probe.sec          = CC_BBR_PROBE_RTT/1000000;
+        probe.usec         = CC_BBR_PROBE_RTT%1000000;
+        cc->probe_rtt_done = E_add_time(now, probe);
+    }
+    if(cc->mode == BBR_PROBE_RTT) {
+        r_data->window_size = CC_BBR_MIN_WINDOW;
+        if(E_compare_time(now, cc->probe_rtt_done) >= 0) {
+            cc->min_rtt_stamp   = now;
+            r_data->window_size = cc->prior_window;
+            if(cc->full_bw_cnt >= 3) {
+                BBR_Enter_Probe_BW(r_data, now);
+            }
+            else {
+                cc->mode        = BBR_STARTUP;
+                cc->pacing_gain = CC_BBR_HIGH_GAIN;
+                cc->cwnd_gain   = CC_BBR_HIGH_GAIN;
+            }
+        }
+        CC_Clamp_Window(r_data);
+        return;
+    }
+
+    target = cc->cwnd_gain * BBR_BDP(r_data);
+    if(cc->btl_bw == 0 || (cc->mode == BBR_STARTUP && r_data->window_size < target)) {
+        /* No model yet, or still filling the pipe */
+        r_data->window_size += 1;
+    }
+    else {
+        r_data->window_size = (float)(target + 2);
+    }
+    CC_Clamp_Window(r_data);
+}
+
+static void BBR_On_Loss(Reliable_Data *r_data, int event,
+                        float stream_window, sp_time now)
+{
+    UNUSED(stream_window);
+    UNUSED(now);
+
+    if(event == CC_LOSS_NACK || event == CC_LOSS_TIMEOUT) {
+        r_data->cc.round_loss = 1;
+    }
+
+    /* The model does not react to individual losses. After a timeout
+     * only a few packets are let out until acks rebuild the window */
+    if(event == CC_LOSS_TIMEOUT) {
+        r_data->window_size = r_data->cc.min_window;
+    }
+}
+
+static void BBR_On_RTT_Sample(Reliable_Data *r_data, int32u rtt, sp_time now)
+{
+    UNUSED(r_data);
+    UNUSED(rtt);
+    UNUSED(now);
+}
+
+static double BBR_Pacing_Rate(Reliable_Data *r_data)
+{
+    CC_State *cc = &r_data->cc;
+
+    if(cc->btl_bw == 0) {
+        if(cc->srtt == 0) {
+            return 0;
+        }
+        return cc->pacing_gain * r_data->window_size * 1000000.0 / cc->srtt;
+    }
+    return cc->pacing_gain * cc->btl_bw;
+}
+
+static const CC_Ops CC_Algorithms[CC_NUM_ALGORITHMS] = {
+    { "AIMD",  AIMD_Init,  AIMD_On_Ack,  AIMD_On_Loss,
+               AIMD_On_RTT_Sample,  AIMD_Pacing_Rate },
+    { "CUBIC", CUBIC_Init, CUBIC_On_Ack, CUBIC_On_Loss,
+               CUBIC_On_RTT_Sample, CUBIC_Pacing_Rate },
+    { "BBR",   BBR_Init,   BBR_On_Ack,   BBR_On_Loss,
+               BBR_On_RTT_Sample,   BBR_Pacing_Rate },
+};
+
+/***********************************************************/
+/* void CC_Pre_Conf_Setup()                                */
+/*                                                         */
+/* Sets up the configuration file defaults for congestion  */
+/* control                                                 */
+/*                                                         */
+/* Return: NONE                                            */
+/*                                                         */
+/***********************************************************/
+
+void CC_Pre_Conf_Setup(void)
+{
+    Conf_CC.Control_Links     = CC_AIMD;
+    Conf_CC.Reliable_Links    = CC_AIMD;
+    Conf_CC.Reliable_Sessions = CC_AIMD;
+}
+
+/***********************************************************/
+/* int CC_Algorithm_ID(const char *name)                   */
+/*                                                         */
+/* Looks up a congestion control algorithm by name         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* name:      AIMD, CUBIC or BBR (case insensitive)        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the algorithm, -1 if the name is unknown          */
+/*                                                         */
+/***********************************************************/
+
+int CC_Algorithm_ID(const char *name)
+{
+    int i;
+
+    for(i = 0; i < CC_NUM_ALGORITHMS; i++) {
+        if(strcasecmp(name, CC_Algorithms[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *CC_Algorithm_Name(int algorithm)
+{
+    if(algorithm < 0 || algorithm >= CC_NUM_ALGORITHMS) {
+        return "unknown";
+    }
+    return CC_Algorithms[algorithm].name;
+}
+
+/***********************************************************/
+/* void CC_Init(Reliable_Data *r_data, int algorithm,      */
+/*              float min_window)                          */
+/*                                                         */
+/* Attaches a congestion control algorithm to a reliable   */
+/* link or session. window_size, max_window and ssthresh   */
+/* must already be set; the algorithm may override them    */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:     the reliable data of the link or session    */
+/* algorithm:  CC_AIMD, CC_CUBIC or CC_BBR                 */
+/* min_window: smallest window after a loss                */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void CC_Init(Reliable_Data *r_data, int algorithm, float min_window)
+{
+    if(algorithm < 0 || algorithm >= CC_NUM_ALGORITHMS) {
+        algorithm = CC_AIMD;
+    }
+    memset(&r_data->cc, 0, sizeof(r_data->cc));
+    r_data->cc.ops        = &CC_Algorithms[algorithm];
+    r_data->cc.min_window = min_window;
+    r_data->cc.ops->init(r_data);
+}
+
+/***********************************************************/
+/* void CC_On_Ack(Reliable_Data *r_data,                   */
+/*                float stream_window, sp_time sent,       */
+/*                int flags, sp_time now)                  */
+/*                                                         */
+/* Reports one newly acknowledged packet                   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:        the reliable data of the link or session */
+/* stream_window: packets of the acked stream in flight    */
+/*                (the whole window without -sf)           */
+/* sent:          when the packet was (last) sent          */
+/* flags:         CC_ACK_APP_LIMITED, CC_ACK_HOLD          */
+/* now:           current time                             */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void CC_On_Ack(Reliable_Data *r_data, float stream_window, sp_time sent,
+               int flags, sp_time now)
+{
+    r_data->cc.ops->on_ack(r_data, stream_window, sent, flags, now);
+}
+
+/***********************************************************/
+/* void CC_On_Loss(Reliable_Data *r_data, int event,       */
+/*                 float stream_window, sp_time now)       */
+/*                                                         */
+/* Reports a congestion event                              */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:        the reliable data of the link or session */
+/* event:         CC_LOSS_NACK, CC_LOSS_TIMEOUT,           */
+/*                CC_ECN_MODERATE or CC_ECN_SEVERE         */
+/* stream_window: packets of the affected stream in flight */
+/* now:           current time                             */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void CC_On_Loss(Reliable_Data *r_data, int event, float stream_window, sp_time now)
+{
+    r_data->cc.ops->on_loss(r_data, event, stream_window, now);
+    Alarm(DEBUG, "%s window adjusted: %5.3f (event %d)\n",
+          r_data->cc.ops->name, r_data->window_size, event);
+}
+
+/***********************************************************/
+/* void CC_On_RTT_Sample(Reliable_Data *r_data,            */
+/*                       int32u rtt, sp_time now)          */
+/*                                                         */
+/* Reports a round trip time measured on an original (not  */
+/* retransmitted) packet                                   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:    the reliable data of the link or session     */
+/* rtt:       the sample, in microseconds                  */
+/* now:       current time                                 */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void CC_On_RTT_Sample(Reliable_Data *r_data, int32u rtt, sp_time now)
+{
+    CC_State *cc = &r_data->cc;
+
+    if(rtt == 0) {
+        rtt = 1;
+    }
+    if(cc->srtt == 0) {
+        cc->srtt = rtt;
+    }
+    else {
+        cc->srtt = (7 * cc->srtt + rtt) / 8;
+    }
+    if(cc->min_rtt == 0 || rtt <= cc->min_rtt ||
+       now.sec - cc->min_rtt_stamp.sec > CC_BBR_MIN_RTT_SEC) {
+        cc->min_rtt       = rtt;
+        cc->min_rtt_stamp = now;
+    }
+    cc->ops->on_rtt_sample(r_data, rtt, now);
+}
+
+/***********************************************************/
+/* int CC_Paced(Reliable_Data *r_data)                     */
+/*                                                         */
+/* Tells whether packets of a link or session are paced    */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:    the reliable data of the link or session     */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 1 if the algorithm currently has a pacing rate,   */
+/*       0 if the whole window may go out at once          */
+/*                                                         */
+/***********************************************************/
+
+int CC_Paced(Reliable_Data *r_data)
+{
+    return r_data->cc.ops->pacing_rate(r_data) > 0;
+}
+
+/***********************************************************/
+/* int CC_Pace_Send(Reliable_Data *r_data, sp_time now,    */
+/*                  sp_time *delay)                        */
+/*                                                         */
+/* Asks the pacer whether one more packet may be sent now. */
+/* Packets are released at the pacing rate of the          */
+/* algorithm, at most CC_PACE_QUANTUM worth back to back   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* r_data:    the reliable data of the link or session     */
+/* now:       current time                                 */
+/* delay:     set to the time until the next packet may    */
+/*            go out when 0 is returned                    */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 1 if the packet may be sent (and is accounted     */
+/*       for), 0 otherwise                                 */
+/*                                                         */
+/***********************************************************/
+
+int CC_Pace_Send(Reliable_Data *r_data, sp_time now, sp_time *delay)
+{
+    CC_State *cc = &r_data->cc;
+    double rate, burst, wait;
+
+    rate = cc->ops->pacing_rate(r_data);
+    if(rate <= 0) {
+        return 1;
+    }
+
+    burst = rate * CC_PACE_QUANTUM / 1000000.0;
+    if(burst < CC_PACE_MIN_BURST) {
+        burst = CC_PACE_MIN_BURST;
+    }
+    cc->pace_tokens += rate * CC_Usec(E_sub_time(now, cc->pace_last)) / 1000000.0;
+    if(cc->pace_tokens > burst) {
+        cc->pace_tokens = burst;
+    }
+    cc->pace_last = now;
+
+    if(cc->pace_tokens >= 1) {
+        cc->pace_tokens -= 1;
+        return 1;
+    }
+
+    wait = (1 - cc->pace_tokens) * 1000000.0 / rate;
+    if(wait < 1) {
+        wait = 1;
+    }
+    delay->sec  = (long)(wait / 1000000);
+    delay->usec = (long)wait % 1000000;
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include "arch.h"
+#include "spu_events.h"
+
+/* Congestion control algorithms */
+#define CC_AIMD             0   /* Original window adjustment, needs -tf */
+#define CC_CUBIC            1
+#define CC_BBR              2
+#define CC_NUM_ALGORITHMS   3
+
+/* Congestion events reported through CC_On_Loss */
+#define CC_LOSS_NACK        1   /* Packets reported missing by the receiver */
+#define CC_LOSS_TIMEOUT     2   /* Retransmission timeout */
+#define CC_ECN_MODERATE     3   /* A buffer on the path is half-way full */
+#define CC_ECN_SEVERE       4   /* A buffer on the path overflowed */
+
+/* Flags passed to CC_On_Ack */
+#define CC_ACK_APP_LIMITED  0x1 /* Nothing was waiting to be sent */
+#define CC_ACK_HOLD         0x2 /* ECN asks not to grow the window */
+
+#define CC_INIT_WINDOW      10      /* Initial window of CUBIC and BBR */
+#define CC_PACE_QUANTUM     1000    /* usec worth of packets sent back to back */
+#define CC_PACE_MIN_BURST   2       /* Packets sent back to back at low rates */
+
+#define CC_CUBIC_C          0.4
+#define CC_CUBIC_BETA       0.7
+
+#define CC_BBR_HIGH_GAIN    2.885   /* 2/ln(2) */
+#define CC_BBR_BW_ROUNDS    10      /* Rounds covered by the bandwidth filter */
+#define CC_BBR_MIN_RTT_SEC  10      /* Lifetime of a min_rtt sample */
+#define CC_BBR_PROBE_RTT    200000  /* usec spent at the minimum window */
+#define CC_BBR_MIN_WINDOW   4
+#define CC_BBR_CYCLE_LEN    8
+
+struct Reliable_Data_d;
+
+/* Per-connection congestion control state, kept in Reliable_Data next to
+ * the window it drives. Only the fields of the configured algorithm are
+ * used */
+typedef struct CC_State_d {
+    const struct CC_Ops_d *ops;
+    float   min_window;         /* Smallest window the algorithm may set */
+    int32u  srtt;               /* Smoothed RTT from on_rtt_sample (usec) */
+    int32u  min_rtt;            /* Smallest recent RTT (usec) */
+    sp_time min_rtt_stamp;      /* When min_rtt was measured */
+    sp_time recovery_end;       /* Losses before this belong to the last event */
+
+    double  pace_tokens;        /* Packets that may be sent right away */
+    sp_time pace_last;          /* Last time the tokens were refilled */
+
+    /* CUBIC */
+    int     epoch_valid;
+    sp_time epoch_start;        /* Start of the current growth epoch */
+    double  w_max;              /* Window before the last reduction */
+    double  k;                  /* Time (sec) to grow back to w_max */
+    double  origin;
+    double  w_est;              /* Window a Reno flow would have */
+
+    /* BBR */
+    int     mode;
+    double  btl_bw;             /* Bottleneck bandwidth (packets/sec) */
+    double  bw_samples[CC_BBR_BW_ROUNDS];
+    int     bw_idx;
+    int64u  delivered;          /* Packets acknowledged so far */
+    int64u  round_delivered;    /* delivered at the start of the round */
+    sp_time round_start;
+    sp_time round_sent;         /* Send time of the first packet acked in the round */
+    int     round_loss;         /* A loss was reported during the round */
+    double  pacing_gain;
+    double  cwnd_gain;
+    int     cycle_idx;
+    sp_time cycle_start;
+    double  full_bw;            /* Bandwidth at the last STARTUP plateau check */
+    int     full_bw_cnt;
+    sp_time probe_rtt_done;
+    float   prior_window;       /* Window to restore after PROBE_RTT */
+} CC_State;
+
+/* A congestion control algorithm. The window (r_data->window_size) and
+ * slow-start threshold it adjusts are in packets, the pacing rate in
+ * packets per second, 0 meaning unpaced */
+typedef struct CC_Ops_d {
+    const char *name;
+    void   (*init)(struct Reliable_Data_d *r_data);
+    void   (*on_ack)(struct Reliable_Data_d *r_data, float stream_window,
+                     sp_time sent, int flags, sp_time now);
+    void   (*on_loss)(struct Reliable_Data_d *r_data, int event,
+                      float stream_window, sp_time now);
+    void   (*on_rtt_sample)(struct Reliable_Data_d *r_data, int32u rtt,
+                            sp_time now);
+    double (*pacing_rate)(struct Reliable_Data_d *r_data);
+} CC_Ops;
+
+typedef struct CONF_CC_d {
+    int Control_Links;
+    int Reliable_Links;
+    int Reliable_Sessions;
+} CONF_CC;
+
+extern CONF_CC Conf_CC;
+
+void        CC_Pre_Conf_Setup(void);
+int         CC_Algorithm_ID(const char *name);
+const char *CC_Algorithm_Name(int algorithm);
+
+void        CC_Init(struct Reliable_Data_d *r_data, int algorithm, float min_window);
+void        CC_On_Ack(struct Reliable_Data_d *r_data, float stream_window,
+                      sp_time sent, int flags, sp_time now);
+void        CC_On_Loss(struct Reliable_Data_d *r_data, int event,
+                       float stream_window, sp_time now);
+void        CC_On_RTT_Sample(struct Reliable_Data_d *r_data, int32u rtt, sp_time now);
+int         CC_Paced(struct Reliable_Data_d *r_data);
+int         CC_Pace_Send(struct Reliable_Data_d *r_data, sp_time now, sp_time *delay);
+
+#endif
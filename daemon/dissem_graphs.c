@@ -1362,6 +1362,11 @@ void DG_Compute_Graphs(void)
     sp_time start, stop;
     long duration = 0;
     int num_paths;
+    int16u dest_ids[MAX_NODES+1];
+    unsigned char *k2_masks[MAX_NODES+1];
+    int batch_paths[MAX_NODES+1];
+    int k2_paths[MAX_NODES+1];
+    int num_dests = 0;
     
     zero_mask = new(MP_BITMASK);
     memset(zero_mask, 0x00, MultiPath_Bitmask_Size);
@@ -1402,6 +1407,25 @@ void DG_Compute_Graphs(void)
         Graph_add_edge(&base_graph, key.src_id, key.dst_id, val.cost, val.index);
     }
 
+    /* Compute static 2 paths bitmasks for all destinations at once */
+    for (stdhash_begin(&Node_Lookup_ID_to_Addr, &it);
+         !stdhash_is_end(&Node_Lookup_ID_to_Addr, &it);
+         stdhash_it_next(&it))
+    {
+        dest_ids[num_dests++] = *(Node_ID*) stdit_key(&it);
+    }
+
+    start = E_get_time();
+    MultiPath_Compute_Batch(dest_ids, num_dests, 2, k2_masks, batch_paths, 1, 0);
+    stop = E_get_time();
+    duration += (stop.sec - start.sec) * 1000000;
+    duration += stop.usec - start.usec;
+
+    for (i = 0; i < num_dests; i++) {
+        DG_Destinations[dest_ids[i]].bitmasks[DG_K2_GRAPH] = k2_masks[i];
+        k2_paths[dest_ids[i]] = batch_paths[i];
+    }
+
     /* Compute graphs from myself to  each destination */
     for (stdhash_begin(&Node_Lookup_ID_to_Addr, &it);
          !stdhash_is_end(&Node_Lookup_ID_to_Addr, &it);
@@ -1413,9 +1437,7 @@ void DG_Compute_Graphs(void)
 
         start = E_get_time();
 
-        /* Compute static 2 paths bitmask */
-        num_paths = MultiPath_Compute(dest_id, 2,
-                      &DG_Destinations[dest_id].bitmasks[DG_K2_GRAPH], 1, 0);
+        num_paths = k2_paths[dest_id];
         if (num_paths < 2) {
             Alarm(PRINT, "Warning: failed to find 2 disjoint paths for destination %d\n", dest_id);
         }
@@ -1515,6 +1537,25 @@ void DG_Compute_Graphs(void)
     Alarm(PRINT, "Dissemination graphs computation took %ld usec\n", duration);
 }
 
+/* Frees what DG_Compute_Graphs built, before the graphs are computed again
+ * for a new topology */
+void DG_Clear_Graphs(void)
+{
+    int i, j;
+
+    for (i = 0; i <= MAX_NODES; i++)
+    {
+        for (j = 0; j <= DG_NUM_GRAPHS; j++)
+        {
+            if (DG_Destinations[i].bitmasks[j] != NULL)
+                dispose(DG_Destinations[i].bitmasks[j]);
+            DG_Destinations[i].bitmasks[j] = NULL;
+            stdskl_destruct(&DG_Destinations[i].edge_lists[j]);
+        }
+    }
+    stdskl_destruct(&DG_Problem_List);
+}
+
 int DG_Edge_In_Graph(int16u edge_index, unsigned char *graph_mask)
 {
     unsigned char *edge_mask;
@@ -83,6 +83,7 @@ typedef struct DG_Src_d {
 ext DG_Dst  DG_Destinations[MAX_NODES+1];
 
 void DG_Compute_Graphs(void);
+void DG_Clear_Graphs(void);
 void DG_Process_Edge_Update(Edge *edge, int16 new_cost);
 
 #endif /* DISSEMGRAPHS_H */
@@ -0,0 +1,262 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <limits.h>
+
+#include "arch.h"
+#include "spu_alarm.h"
+#include "flow_paths.h"
+
+/* Binary min-heap of the flow nodes reached by a Dijkstra pass, keyed on
+ * distance */
+static void Flow_Heap_Up(Flow_Graph *g, Flow_Node *n)
+{
+    int pos = n->heap_pos, parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (g->heap[parent]->distance <= n->distance)
+            break;
+        g->heap[pos] = g->heap[parent];
+        g->heap[pos]->heap_pos = pos;
+        pos = parent;
+    }
+    g->heap[pos] = n;
+    n->heap_pos = pos;
+}
+
+static Flow_Node *Flow_Heap_Pop(Flow_Graph *g)
+{
+    Flow_Node *top = g->heap[0], *n;
+    int pos = 0, child;
+
+    top->heap_pos = USHRT_MAX;
+    if (--g->heap_size == 0)
+        return top;
+
+    n = g->heap[g->heap_size];
+    while ((child = 2 * pos + 1) < g->heap_size) {
+        if (child + 1 < g->heap_size &&
+            g->heap[child + 1]->distance < g->heap[child]->distance)
+            child++;
+        if (n->distance <= g->heap[child]->distance)
+            break;
+        g->heap[pos] = g->heap[child];
+        g->heap[pos]->heap_pos = pos;
+        pos = child;
+    }
+    g->heap[pos] = n;
+    n->heap_pos = pos;
+
+    return top;
+}
+
+/* Real edges get flow = 0, residual get flow = capacity, and every node
+ * starts with a zero potential */
+void Flow_Reset(Flow_Graph *g)
+{
+    int i;
+    Flow_Edge *e;
+
+    for (e = g->edges; e != NULL; e = e->next) {
+        if (e->residual == 0)
+            e->flow = 0;
+        else
+            e->flow = e->capacity;
+    }
+
+    for (i = 1; i <= g->max_id; i++) {
+        if (g->inbound[i] != NULL)
+            g->inbound[i]->potential = 0;
+        if (g->outbound[i] != NULL)
+            g->outbound[i]->potential = 0;
+    }
+}
+
+/* Finds the cheapest path from the source to dst over the edges with
+ * spare capacity, using the node potentials to make every residual cost
+ * non-negative (Johnson).  The search stops once dst is settled; a NULL
+ * dst settles the whole graph.  Afterwards each potential is raised by
+ * its node's distance, capped at the last settled distance, which keeps
+ * the reduced costs non-negative for the next pass.  Returns 1 if dst was
+ * reached */
+int Flow_Dijkstra(Flow_Graph *g, Flow_Node *dst)
+{
+    int i, j;
+    int32 cost, limit = 0;
+    Flow_Node *n, *u, *v;
+    Flow_Edge *e;
+
+    for (i = 1; i <= g->max_id; i++) {
+        for (j = 0; j < 2; j++) {
+            n = (j == 0) ? g->inbound[i] : g->outbound[i];
+            if (n == NULL)
+                continue;
+            n->previous_edge = NULL;
+            n->distance = INT_MAX;
+            n->heap_pos = USHRT_MAX;
+        }
+    }
+
+    u = g->outbound[g->src_id];
+    u->distance = 0;
+    g->heap_size = 1;
+    g->heap[0] = u;
+    u->heap_pos = 0;
+
+    while (g->heap_size > 0) {
+        u = Flow_Heap_Pop(g);
+        limit = u->distance;
+        if (u == dst)
+            break;
+
+        for (i = 0; i < u->outgoing_num; i++) {
+            e = u->outgoing[i];
+            v = e->end;
+            if (e->flow >= e->capacity || !g->edge_cost(e, g->cost_arg, &cost))
+                continue;
+
+            cost += u->potential - v->potential;
+            if (cost < 0)
+                Alarm(EXIT, "Flow_Dijkstra: Negative reduced cost found\r\n");
+
+            if (v->distance > u->distance + cost) {
+                v->distance = u->distance + cost;
+                v->previous_edge = e;
+                if (v->heap_pos == USHRT_MAX)
+                    v->heap_pos = g->heap_size++;
+                Flow_Heap_Up(g, v);
+            }
+        }
+    }
+
+    if (dst != NULL && dst->distance == INT_MAX)
+        return 0;
+
+    for (i = 1; i <= g->max_id; i++) {
+        for (j = 0; j < 2; j++) {
+            n = (j == 0) ? g->inbound[i] : g->outbound[i];
+            if (n != NULL)
+                n->potential += (n->distance < limit) ? n->distance : limit;
+        }
+    }
+
+    return 1;
+}
+
+/* Pushes one unit of flow along the path the last Dijkstra pass found to t */
+void Flow_Augment(Flow_Graph *g, Flow_Node *t)
+{
+    while (t != g->outbound[g->src_id]) {
+        t->previous_edge->flow = t->previous_edge->capacity;
+        t->previous_edge->twin->flow = 0;
+        t = t->previous_edge->start;
+    }
+}
+
+/* Min-cost k node-disjoint paths from the source to dst_id by successive
+ * shortest paths: each Dijkstra pass over the residual graph adds one
+ * path, rerouting the earlier ones where that is cheaper (Suurballe).
+ * The real edges left carrying flow are the paths; returns how many were
+ * found */
+int Flow_Compute_Paths(Flow_Graph *g, int dst_id, int k)
+{
+    int path_index;
+
+    Flow_Reset(g);
+
+    for (path_index = 1; path_index <= k; path_index++) {
+        if (!Flow_Dijkstra(g, g->inbound[dst_id]))
+            break;
+        Flow_Augment(g, g->inbound[dst_id]);
+    }
+
+    return path_index - 1;
+}
+
+/* Computes the shortest path tree of the whole graph from the source and
+ * saves it, with the potentials it leaves, for Flow_Compute_Tree_Paths */
+void Flow_Compute_Tree(Flow_Graph *g)
+{
+    int i, j;
+    Flow_Node *n;
+
+    Flow_Reset(g);
+    Flow_Dijkstra(g, NULL);
+
+    for (i = 1; i <= g->max_id; i++) {
+        for (j = 0; j < 2; j++) {
+            n = (j == 0) ? g->inbound[i] : g->outbound[i];
+            if (n == NULL)
+                continue;
+            n->tree_potential = n->potential;
+            n->tree_edge = n->previous_edge;
+        }
+    }
+}
+
+/* Same as Flow_Compute_Paths, but the first path comes from the tree
+ * saved by Flow_Compute_Tree, which is also the starting potential for
+ * the remaining passes */
+int Flow_Compute_Tree_Paths(Flow_Graph *g, int dst_id, int k)
+{
+    int i, j, path_index;
+    Flow_Node *n, *t;
+
+    Flow_Reset(g);
+    for (i = 1; i <= g->max_id; i++) {
+        for (j = 0; j < 2; j++) {
+            n = (j == 0) ? g->inbound[i] : g->outbound[i];
+            if (n == NULL)
+                continue;
+            n->potential = n->tree_potential;
+            n->previous_edge = n->tree_edge;
+        }
+    }
+
+    t = g->inbound[dst_id];
+    path_index = 1;
+    if (k > 0 && t->tree_edge != NULL) {
+        Flow_Augment(g, t);
+        for (path_index = 2; path_index <= k; path_index++) {
+            if (!Flow_Dijkstra(g, t))
+                break;
+            Flow_Augment(g, t);
+        }
+    }
+
+    return path_index - 1;
+}
@@ -0,0 +1,104 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+#ifndef FLOW_PATHS_H
+#define FLOW_PATHS_H
+
+#include "arch.h"
+
+/* Min-cost node-disjoint paths over a flow graph in which every node is
+ * split into an inbound and an outbound flow node joined by a capacity 1
+ * edge, and every edge has a residual twin.  The graph itself is built
+ * and its edge costs supplied by the caller (multipath.c) */
+
+struct Edge_d;
+struct Flow_Node_d;
+struct Flow_Edge_d;
+
+typedef struct Flow_Node_d {
+    /* Node *nd; */
+    struct Flow_Edge_d  **outgoing;
+    struct Flow_Edge_d  **incoming;
+    struct Flow_Node_d   *twin;
+    struct Flow_Edge_d   *previous_edge;
+    unsigned char         inbound_node; 
+    int16u                outgoing_num;
+    int16u                incoming_num;
+    int16u                heap_pos;       /* Slot in the Dijkstra heap */
+    int32                 distance;       /* Reduced cost from the source */
+    int32                 potential;      /* Johnson potential */
+    int32                 tree_potential; /* Potential and previous edge */
+    struct Flow_Edge_d   *tree_edge;      /*   after a batch's first pass */
+        /* True if all edges to other real nodes are incoming to this node 
+             (one outgoing edge to twin), 
+           False if all edges to other real nodes are outgoing from this 
+             node (one incoming edge from twin) */
+} Flow_Node;
+
+typedef struct Flow_Edge_d {
+    int16u                flow;
+    int16u                capacity;
+    struct Edge_d        *edge;
+    struct Edge_d        *reverse_edge;
+    Flow_Node            *start;
+    Flow_Node            *end;
+    int16u                index;
+    unsigned char         residual; /* True if edge is residual, False if real */
+    struct Flow_Edge_d   *twin;
+    struct Flow_Edge_d   *next;
+} Flow_Edge;
+
+typedef struct Flow_Graph_d {
+    Flow_Node   **inbound;      /* By node ID, 1 .. max_id; NULL if absent */
+    Flow_Node   **outbound;
+    int           max_id;
+    int           src_id;       /* Where every path starts */
+    Flow_Edge    *edges;        /* Every edge, linked through next */
+    Flow_Node   **heap;         /* Room for 2 * max_id + 1 nodes */
+    int           heap_size;
+    /* Sets *ret_cost to the cost of crossing e (negated on residual
+     * edges), or returns 0 if e cannot be used */
+    int         (*edge_cost)(Flow_Edge *e, void *cost_arg, int32 *ret_cost);
+    void         *cost_arg;
+} Flow_Graph;
+
+void   Flow_Reset(Flow_Graph *g);
+int    Flow_Dijkstra(Flow_Graph *g, Flow_Node *dst);
+void   Flow_Augment(Flow_Graph *g, Flow_Node *t);
+int    Flow_Compute_Paths(Flow_Graph *g, int dst_id, int k);
+void   Flow_Compute_Tree(Flow_Graph *g);
+int    Flow_Compute_Tree_Paths(Flow_Graph *g, int dst_id, int k);
+
+#endif /* FLOW_PATHS_H */
@@ -0,0 +1,116 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef FLOW_READY_SET_H
+#define FLOW_READY_SET_H
+
+#include "arch.h"
+#include "net_types.h"
+
+/***********************************************************/
+/* Flow ready sets                                         */
+/*                                                         */
+/* The flows that may have something to send toward a      */
+/* neighbor are kept as bits in a two-level bitmap indexed */
+/* by src * (MAX_NODES + 1) + dest, so queueing a flow and */
+/* finding the next one round-robin never allocates and    */
+/* skips 64 idle flows per word.                           */
+/***********************************************************/
+
+/* Flow (src, dest) is bit src * (MAX_NODES + 1) + dest of word[],
+ *      and bit w of summary is set when word[w] is not empty */
+#define RF_FLOWS            ((MAX_NODES + 1) * (MAX_NODES + 1))
+#define RF_FLOW_WORDS       ((RF_FLOWS + 63) / 64)
+
+#if RF_FLOW_WORDS > 64
+#error "Flow_Ready_Set summary word too small for MAX_NODES"
+#endif
+
+typedef struct Flow_Ready_Set_d {
+    int64u summary;
+    int64u word[RF_FLOW_WORDS];
+} Flow_Ready_Set;
+
+#if defined(__GNUC__)
+#  define RF_CTZ64(x) __builtin_ctzll(x)
+#else
+static LOC_INLINE int RF_CTZ64(int64u x)
+{
+    int n = 0;
+
+    while ((x & 1) == 0) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+#endif
+
+static LOC_INLINE void RF_Ready_Set_Add(Flow_Ready_Set *set, int32u flow)
+{
+    set->word[flow / 64] |= ((int64u) 1) << (flow % 64);
+    set->summary |= ((int64u) 1) << (flow / 64);
+}
+
+static LOC_INLINE void RF_Ready_Set_Remove(Flow_Ready_Set *set, int32u flow)
+{
+    set->word[flow / 64] &= ~(((int64u) 1) << (flow % 64));
+    if (set->word[flow / 64] == 0)
+        set->summary &= ~(((int64u) 1) << (flow / 64));
+}
+
+/* Returns the first flow in the set at or after from (wrapping
+ * around), or -1 if the set is empty */
+static LOC_INLINE int32 RF_Ready_Set_Next(const Flow_Ready_Set *set, int32u from)
+{
+    int32u w = from / 64;
+    int64u bits, sum;
+
+    if (set->summary == 0)
+        return -1;
+
+    bits = set->word[w] & (~((int64u) 0) << (from % 64));
+    if (bits != 0)
+        return w * 64 + RF_CTZ64(bits);
+
+    sum = (w + 1 < 64) ? set->summary & (~((int64u) 0) << (w + 1)) : 0;
+    if (sum == 0)
+        sum = set->summary;
+    w = RF_CTZ64(sum);
+    return w * 64 + RF_CTZ64(set->word[w]);
+}
+
+#endif
@@ -1,5 +1,8 @@
 #!/bin/bash
 
+# Usage: gen_keys.sh [rsa|ed25519]   (default rsa, must match Signature_Scheme)
+SCHEME=${1:-rsa}
+
 mkdir -p keys
 
 openssl dhparam -outform PEM -out keys/dhparam.pem 2048
@@ -12,6 +15,11 @@ openssl dhparam -outform PEM -out keys/dhparam.pem 2048
 
 for i in {1..10}
 do
-  openssl genrsa -out keys/private$i.pem 1024
-  openssl rsa -in keys/private$i.pem -out keys/public$i.pem -outform PEM -pubout
+  if [ "$SCHEME" = "ed25519" ]; then
+    openssl genpkey -algorithm ed25519 -out keys/private$i.pem
+    openssl pkey -in keys/private$i.pem -out keys/public$i.pem -outform PEM -pubout
+  else
+    openssl genrsa -out keys/private$i.pem 1024
+    openssl rsa -in keys/private$i.pem -out keys/public$i.pem -outform PEM -pubout
+  fi
 done
@@ -103,6 +103,18 @@ int          stable_delay_flag      = 1;
 /*int          stable_delay_flag      = 0;*/
 double       stable_timeout         = 0.0;
 
+CONF_FD      Conf_FD;
+
+/* Probe wheel of fast failure detection: slot i holds the legs to look
+ * at FD_WHEEL_TICK * i usec after the slot at Wheel_Pos */
+static Network_Leg *Wheel[FD_WHEEL_SLOTS];
+static int          Wheel_Pos;
+static sp_time      Wheel_Time;     /* time of the slot at Wheel_Pos */
+static int          Wheel_Legs;
+static const sp_time wheel_tick     = {     0,    FD_WHEEL_TICK};
+
+static void Fast_Detect_Tick(int dummy_int, void *dummy);
+
 void Flip_hello_pkt( hello_packet *hello_pkt )
 {
     hello_pkt->seq_no          = Flip_int32(hello_pkt->seq_no);
@@ -113,6 +125,50 @@ void Flip_hello_pkt( hello_packet *hello_pkt )
     hello_pkt->loss_rate       = Flip_int32(hello_pkt->loss_rate);
 }
 
+static void Flip_hello_pkt_fd( hello_packet *hello_pkt )
+{
+    hello_pkt->fd_tx_interval  = Flip_int32(hello_pkt->fd_tx_interval);
+    hello_pkt->fd_rx_interval  = Flip_int32(hello_pkt->fd_rx_interval);
+    hello_pkt->fd_detect_mult  = Flip_int32(hello_pkt->fd_detect_mult);
+}
+
+/***********************************************************/
+/* void Hello_Pre_Conf_Setup()                             */
+/*                                                         */
+/* Sets up the configuration file defaults for failure     */
+/* detection                                               */
+/*                                                         */
+/* Return: NONE                                            */
+/*                                                         */
+/***********************************************************/
+
+void Hello_Pre_Conf_Setup(void)
+{
+    Conf_FD.Fast_Detect = FD_FAST_DETECT;
+    Conf_FD.Detect_Time = FD_DETECT_TIME;
+    Conf_FD.Detect_Mult = FD_DETECT_MULT;
+}
+
+/***********************************************************/
+/* void Hello_Post_Conf_Setup()                            */
+/*                                                         */
+/* Checks the failure detection parameters read from the   */
+/* configuration file                                      */
+/*                                                         */
+/* Return: NONE                                            */
+/*                                                         */
+/***********************************************************/
+
+void Hello_Post_Conf_Setup(void)
+{
+    if (Conf_FD.Detect_Time / Conf_FD.Detect_Mult < 2 * FD_WHEEL_TICK) {
+        Alarm(PRINT, "Hello_Post_Conf_Setup: FD_DetectTime (%u) / FD_DetectMult (%u) "
+              "is below the smallest probe interval, using %u usec\n",
+              Conf_FD.Detect_Time, Conf_FD.Detect_Mult, 2 * FD_WHEEL_TICK);
+        Conf_FD.Detect_Time = 2 * FD_WHEEL_TICK * Conf_FD.Detect_Mult;
+    }
+}
+
 /***********************************************************/
 /* Init_Connections(void)                                  */
 /*                                                         */
@@ -176,6 +232,239 @@ static void Dead_Leg(int linkid, void *dummy)
   Disconnect_Network_Leg(lk->leg);
 }
 
+/***********************************************************/
+/* Fast failure detection                                  */
+/***********************************************************/
+
+static void Wheel_Insert(Network_Leg *leg, sp_time due)
+{
+  sp_time now = E_get_time();
+  sp_time delta;
+  long    ticks;
+  int     slot;
+
+  if (Wheel_Legs == 0) {
+    /* Wheel was idle: restart it from now */
+    Wheel_Pos  = 0;
+    Wheel_Time = now;
+    E_queue(Fast_Detect_Tick, 0, NULL, wheel_tick);
+  }
+
+  ticks = 1;
+  if (E_compare_time(due, Wheel_Time) > 0) {
+    delta = E_sub_time(due, Wheel_Time);
+    ticks = (delta.sec * 1000000L + delta.usec + FD_WHEEL_TICK - 1) / FD_WHEEL_TICK;
+    if (ticks < 1) {
+      ticks = 1;
+    } else if (ticks >= FD_WHEEL_SLOTS) {
+      ticks = FD_WHEEL_SLOTS - 1;  /* looked at early, goes back in */
+    }
+  }
+
+  slot                  = (Wheel_Pos + ticks) % FD_WHEEL_SLOTS;
+  leg->live.wheel_next  = Wheel[slot];
+  leg->live.in_wheel    = 1;
+  Wheel[slot]           = leg;
+  ++Wheel_Legs;
+}
+
+static sp_time Add_Usec(sp_time t, double usec)
+{
+  sp_time d;
+
+  d.sec  = (long) (usec / 1000000);
+  d.usec = (long) (usec - d.sec * 1000000.0);
+
+  return E_add_time(t, d);
+}
+
+static double Usec_Since(sp_time now, sp_time t)
+{
+  sp_time d = E_sub_time(now, t);
+
+  return d.sec * 1000000.0 + d.usec;
+}
+
+/* Sends the periodic hello (for rtt and loss rate) of a leg */
+static void Send_Periodic_Hello(Link *lk)
+{
+  Net_Send_Hello(lk->link_id, 0);
+  Clean_RT_history(lk->leg->links[REALTIME_UDP_LINK]);     /* TODO: move to realtime_udp.c where it belongs */
+}
+
+/* Probes the leg if nothing else was sent on it for a probe interval
+ * and disconnects it once the other side has been silent for the
+ * detection time. Returns 1 if the leg stays in the wheel */
+static int Fast_Detect_Check(Network_Leg *leg, sp_time now)
+{
+  Leg_Liveness *live = &leg->live;
+  Link         *lk   = leg->links[CONTROL_LINK];
+  double        silence;
+  sp_time       due;
+
+  if (!live->active || leg->status != CONNECTED_LEG || lk == NULL) {
+    live->active = 0;
+    return 0;
+  }
+
+  silence = Usec_Since(now, live->last_heard);
+
+  if (silence > live->detect_time) {
+    Alarm(PRINT, "Fast_Detect_Check: nothing heard from (" IPF ") for %.3f ms, detection time is %.3f ms; DISCONNECTING!\n",
+          IP(leg->remote_interf->net_addr), silence / 1000.0, live->detect_time / 1000.0);
+    live->active = 0;
+    Disconnect_Network_Leg(leg);
+    return 0;
+  }
+
+  if (E_compare_time(now, live->next_hello) >= 0) {
+    /* Full hello for rtt and loss rate, sent even while data flows */
+    Send_Periodic_Hello(lk);
+    live->next_hello = E_add_time(now, hello_timeout);
+    live->next_probe = Add_Usec(now, live->tx_interval * (0.75 + 0.25 * rand() / (RAND_MAX + 1.0)));
+
+  } else if (E_compare_time(now, live->next_probe) >= 0) {
+    /* Packets sent on the leg tell the other side we are alive too */
+    if (Usec_Since(now, live->last_sent) >= live->tx_interval * 0.75) {
+      Net_Send_Hello(lk->link_id, 0);
+      live->next_probe = Add_Usec(now, live->tx_interval * (0.75 + 0.25 * rand() / (RAND_MAX + 1.0)));
+    } else {
+      live->next_probe = Add_Usec(live->last_sent, live->tx_interval);
+    }
+  }
+
+  due = Add_Usec(live->last_heard, live->detect_time);
+  if (E_compare_time(live->next_probe, due) < 0) {
+    due = live->next_probe;
+  }
+  if (E_compare_time(live->next_hello, due) < 0) {
+    due = live->next_hello;
+  }
+  Wheel_Insert(leg, due);
+
+  return 1;
+}
+
+/* One timer drives the probes and failure checks of all the legs */
+static void Fast_Detect_Tick(int dummy_int, void *dummy)
+{
+  sp_time      now = E_get_time();
+  Network_Leg *due = NULL, *leg, *next;
+  long         ticks;
+
+  /* Catch up on the slots passed since the last tick */
+  ticks = (long) (Usec_Since(now, Wheel_Time) / FD_WHEEL_TICK);
+  if (ticks < 1) {
+    ticks = 1;
+  } else if (ticks > FD_WHEEL_SLOTS) {
+    ticks = FD_WHEEL_SLOTS;
+  }
+
+  for (; ticks > 0; --ticks) {
+    Wheel_Pos  = (Wheel_Pos + 1) % FD_WHEEL_SLOTS;
+    Wheel_Time = Add_Usec(Wheel_Time, FD_WHEEL_TICK);
+
+    for (leg = Wheel[Wheel_Pos]; leg != NULL; leg = next) {
+      next                 = leg->live.wheel_next;
+      leg->live.wheel_next = due;
+      due                  = leg;
+      --Wheel_Legs;
+    }
+    Wheel[Wheel_Pos] = NULL;
+  }
+  if (Usec_Since(now, Wheel_Time) > FD_WHEEL_TICK * FD_WHEEL_SLOTS) {
+    Wheel_Time = now;
+  }
+
+  /* Keep the timer going while legs are left, Wheel_Insert restarts it */
+  if (Wheel_Legs > 0) {
+    E_queue(Fast_Detect_Tick, 0, NULL, wheel_tick);
+  }
+
+  for (leg = due; leg != NULL; leg = next) {
+    next                 = leg->live.wheel_next;
+    leg->live.wheel_next = NULL;
+    leg->live.in_wheel   = 0;
+    Fast_Detect_Check(leg, now);
+  }
+}
+
+/* Takes the other side's fast detection parameters from a hello and
+ * starts probing the leg once it is connected. Any hello proves the
+ * other side alive */
+static void Fast_Detect_Negotiate(Network_Leg *leg, hello_packet *pkt, sp_time now)
+{
+  Leg_Liveness *live = &leg->live;
+  int32u        my_interval = Conf_FD.Detect_Time / Conf_FD.Detect_Mult;
+  int32u        tx, detect;
+
+  live->last_heard = now;
+
+  if (pkt == NULL || pkt->fd_tx_interval == 0 || pkt->fd_detect_mult == 0) {
+    return;
+  }
+
+  live->peer_tx_interval = pkt->fd_tx_interval;
+  live->peer_rx_interval = pkt->fd_rx_interval;
+  live->peer_detect_mult = pkt->fd_detect_mult;
+
+  /* Neither side probes faster than the other accepts */
+  tx     = (my_interval > pkt->fd_rx_interval ? my_interval : pkt->fd_rx_interval);
+  detect = pkt->fd_detect_mult * (my_interval > pkt->fd_tx_interval ? my_interval : pkt->fd_tx_interval);
+
+  if (leg->status != CONNECTED_LEG) {
+    return;
+  }
+
+  if (!live->active || tx != live->tx_interval || detect != live->detect_time) {
+
+    Alarm(PRINT, "Fast_Detect_Negotiate: leg (" IPF " -> " IPF "): probing every %.1f ms, detection time %.1f ms\n",
+          IP(leg->local_interf->net_addr), IP(leg->remote_interf->net_addr), tx / 1000.0, detect / 1000.0);
+
+    if (detect > Conf_FD.Detect_Time) {
+      Alarm(PRINT, "Fast_Detect_Negotiate: detection time of leg (" IPF " -> " IPF ") exceeds FD_DetectTime (%.1f ms)\n",
+            IP(leg->local_interf->net_addr), IP(leg->remote_interf->net_addr), Conf_FD.Detect_Time / 1000.0);
+    }
+
+    live->tx_interval = tx;
+    live->detect_time = detect;
+  }
+
+  if (!live->active) {
+    live->active     = 1;
+    live->next_probe = now;
+    live->next_hello = E_add_time(now, hello_timeout);
+
+    if (!live->in_wheel) {
+      Wheel_Insert(leg, now);
+    }
+  }
+}
+
+/***********************************************************/
+/* void Fast_Detect_Reset(Network_Leg *leg)                */
+/*                                                         */
+/* Stops fast failure detection on a leg until the other   */
+/* side negotiates it again (new control link)             */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* leg: the network leg                                    */
+/*                                                         */
+/***********************************************************/
+
+void Fast_Detect_Reset(Network_Leg *leg)
+{
+  /* A leg still in a wheel slot stays there and is dropped or picked
+   * up again when its slot comes */
+  leg->live.active           = 0;
+  leg->live.peer_tx_interval = 0;
+  leg->live.peer_rx_interval = 0;
+  leg->live.peer_detect_mult = 0;
+  leg->live.tx_interval      = 0;
+  leg->live.detect_time      = 0;
+}
+
 /***********************************************************/
 /* Send_Hello(int linkid, void *dummy)                     */
 /*                                                         */
@@ -199,6 +488,12 @@ void Send_Hello(int linkid, void *dummy)
     Alarm(EXIT, "Send_Hello: invalid control link!\r\n");
   }
 
+  /* The probe wheel sends the hellos of this leg and watches it */
+  if (lk->leg->live.active) {
+    Net_Send_Hello((int16u) linkid, 0);
+    return;
+  }
+
   if (lk->leg->hellos_out > 1) {
     dead_timeout = E_sub_time(E_get_time(), lk->leg->last_recv_hello);  /* just tmp used for following print */
 
@@ -225,10 +520,9 @@ void Send_Hello(int linkid, void *dummy)
     E_queue(Dead_Leg, linkid, NULL, dead_timeout);
   }
 
-  Net_Send_Hello((int16u) linkid, 0);
+  Send_Periodic_Hello(lk);
   ++lk->leg->hellos_out;
 
-  Clean_RT_history(lk->leg->links[REALTIME_UDP_LINK]);     /* TODO: move to realtime_udp.c where it belongs */
   E_queue(Send_Hello, linkid, NULL, hello_timeout);	
 }
 
@@ -329,6 +623,11 @@ void Send_Hello_Ping(int dummy_int, void* dummy)
 
     Network_Leg *leg = *(Network_Leg**) stdhash_it_val(&tit);
 
+    /* Edges removed from the configuration file by a reload stay quiet */
+    if (leg->removed) {
+      continue;
+    }
+
     if (leg->status == DISCONNECTED_LEG) {
 
       Alarm(DEBUG, "Send_Hello_Ping: pinging on edge (" IPF " -> " IPF "); leg (" IPF " -> " IPF "); net (" IPF " -> " IPF")\r\n",
@@ -380,7 +679,7 @@ void Net_Send_Hello(int16 linkid, int mode)
   scat.elements[1].len = sizeof(hello_packet);
   scat.elements[1].buf = (char*) &pkt;
 
-  hdr.type             = (mode == 0 ? HELLO_TYPE : HELLO_REQ_TYPE);
+  hdr.type             = (mode == 0 ? HELLO_TYPE : HELLO_REQ_TYPE) | STATE_COMPACT_TYPE;
   hdr.type             = Set_endian(hdr.type);
 
   hdr.sender_id        = My_Address;
@@ -395,6 +694,15 @@ void Net_Send_Hello(int16 linkid, int mode)
   pkt.response_seq_no  = c_data->other_side_hello_seq;
   pkt.diff_time        = c_data->diff_time;
   pkt.loss_rate        = Compute_Loss_Rate(link->leg);
+
+  if (Conf_FD.Fast_Detect) {
+    pkt.fd_tx_interval = Conf_FD.Detect_Time / Conf_FD.Detect_Mult;
+    pkt.fd_rx_interval = Conf_FD.Detect_Time / Conf_FD.Detect_Mult;
+    pkt.fd_detect_mult = Conf_FD.Detect_Mult;
+  } else {
+    scat.elements[1].len = HELLO_BASE_LEN;
+    hdr.data_len         = HELLO_BASE_LEN;
+  }
     
   if(network_flag == 1) {
     ret = Link_Send(link, &scat);
@@ -421,7 +729,7 @@ void Net_Send_Hello_Ping(channel chan, Network_Address addr)
   scat.num_elements    = 2;
   scat.elements[0].len = sizeof(packet_header);
   scat.elements[0].buf = (char*) &hdr;
-  scat.elements[1].len = sizeof(hello_packet);
+  scat.elements[1].len = HELLO_BASE_LEN;
   scat.elements[1].buf = (char*) &pkt;
 
   hdr.type             = HELLO_PING_TYPE;	
@@ -429,7 +737,7 @@ void Net_Send_Hello_Ping(channel chan, Network_Address addr)
 
   hdr.sender_id        = My_Address;
   hdr.ctrl_link_id     = 0;
-  hdr.data_len         = sizeof(hello_packet);
+  hdr.data_len         = HELLO_BASE_LEN;
   hdr.ack_len          = 0;
   hdr.seq_no           = 0;
 
@@ -472,7 +780,7 @@ void Process_hello_packet(Link *lk, packet_header *pack_hdr, char *buf,
   Loss_Data     *l_data;
   int           i;
 
-  if (remaining_bytes != sizeof(hello_packet))
+  if (remaining_bytes != sizeof(hello_packet) && remaining_bytes != HELLO_BASE_LEN)
   {
     Alarmp(SPLOG_WARNING, PRINT, "Process_hello_packet: Wrong # of bytes for "
                                  "hello: %d\n", remaining_bytes);
@@ -481,6 +789,9 @@ void Process_hello_packet(Link *lk, packet_header *pack_hdr, char *buf,
 
   if (!Same_endian(type)) {
     Flip_hello_pkt(pkt);
+    if (remaining_bytes == sizeof(hello_packet)) {
+      Flip_hello_pkt_fd(pkt);
+    }
   }
 
   /* Check if other side crashed and came back up before I disconnected it */
@@ -511,6 +822,9 @@ void Process_hello_packet(Link *lk, packet_header *pack_hdr, char *buf,
   /* Check for loss */
   Check_Link_Loss(leg, pack_hdr->seq_no, CONTROL_LINK);
 
+  /* Older daemons don't read compact state packets */
+  leg->state_compact = Is_state_compact(pack_hdr->type);
+
   /* Make sure that this is not an old hello that took too long to get here */
   if (c_data->other_side_hello_seq > pkt->seq_no + 3) { 
     return;
@@ -695,6 +1009,10 @@ void Process_hello_packet(Link *lk, packet_header *pack_hdr, char *buf,
   } else {
     Alarm(EXIT, "Bad leg status %d!\r\n", leg->status);
   }
+
+  if (Conf_FD.Fast_Detect) {
+    Fast_Detect_Negotiate(leg, (remaining_bytes == sizeof(hello_packet) ? pkt : NULL), now);
+  }
 }
 
 /***********************************************************/
@@ -734,6 +1052,12 @@ void Process_hello_ping(packet_header *pack_hdr, Network_Address from_addr,
     double  nowf      = now.sec + now.usec / 1000000.0;
     double  last_conn = (*leg)->last_connected.sec + (*leg)->last_connected.usec / 1000000.0;
 
+    if ((*leg)->removed) {
+      Alarm(DEBUG, "Process_hello_ping: ignoring ("IPF"), edge removed from the configuration\n", 
+	    IP((*leg)->remote_interf->net_addr));
+      return;
+    }
+
     if (stable_delay_flag && nowf - last_conn < stable_timeout) {
       Alarm(PRINT, "Process_hello_ping: stable delay disallowing ctrl link creation to ("IPF")! Stable delay is %.03f; diff is %.03f; now is %.03f, last_conn is %.03f\n", 
 	    IP((*leg)->remote_interf->net_addr), stable_timeout, nowf - last_conn, nowf, last_conn);
@@ -37,6 +37,8 @@
 #ifndef HELLO_H
 #define HELLO_H
 
+#include <stddef.h>
+
 #include "net_types.h"
 #include "network.h"
 #include "link.h"
@@ -44,6 +46,27 @@
 #define DEAD_LINK_CNT     10                        /* Number of hellos unacked until declaring a dead link */
 #define CONNECT_LINK_CNT  (1 + DEAD_LINK_CNT / 2)  /* Number of hellos needed b4 connection established */
 
+/* Hellos of daemons not running fast failure detection end before the
+ * fd_* fields */
+#define HELLO_BASE_LEN    (offsetof(hello_packet, fd_tx_interval))
+
+/* Fast failure detection: connected legs are probed every few tens of
+ * ms and declared dead after Detect_Mult probe intervals without
+ * hearing any packet from the other side. Both sides must run it */
+#define FD_FAST_DETECT    0
+#define FD_DETECT_TIME    90000   /* Detection time aimed for, 90 ms */
+#define FD_DETECT_MULT    3
+#define FD_WHEEL_TICK     5000    /* usec covered by one slot of the probe wheel */
+#define FD_WHEEL_SLOTS    256
+
+typedef struct CONF_FD_d {
+    unsigned char Fast_Detect;
+    int32u        Detect_Time;
+    int32u        Detect_Mult;
+} CONF_FD;
+
+extern CONF_FD Conf_FD;
+
 struct Node_d;
 struct Edge_d;
 struct Interface_d;
@@ -52,6 +75,10 @@ struct Link_d;
 
 extern sp_time hello_timeout;
 
+/* Configuration File Functions */
+void Hello_Pre_Conf_Setup(void);
+void Hello_Post_Conf_Setup(void);
+
 void Init_Connections(void);
 void Send_Hello(int linkid, void* dummy);
 void Send_Hello_Request(int linkid, void* dummy);
@@ -63,6 +90,8 @@ void Net_Send_Hello_Ping(channel chan, Network_Address addr);
 
 void Process_hello_packet(struct Link_d *lk, packet_header *pack_hdr, char *buf, int remaining_bytes, int32u type);
 
+void Fast_Detect_Reset(struct Network_Leg_d *leg);
+
 void Process_hello_ping(packet_header *pack_hdr, Network_Address from_addr, 
 			struct Interface_d *local_interf, struct Interface_d **remote_interf, struct Network_Leg_d **leg, struct Link_d **link);
 
@@ -996,7 +996,7 @@ void Process_DH_IT(Link *lk, sys_scatter *scat,
     src_id = *(int32u *)stdhash_it_val(&it);
     /* printf("SRC_ID = %d, MSG_LEN = %d, DATA_LEN = %d\n", src_id, data_len - sign_len, data_len); */
 
-    ret = EVP_VerifyFinal(md_ctx, (unsigned char*)read_ptr, sign_len, 
+    ret = Sec_verify_final(md_ctx, (unsigned char*)read_ptr, sign_len, 
                             Pub_Keys[src_id]);
     if (ret != 1) {
         Alarm(PRINT, "Process_DH_IT: VerifyFinal failed\r\n");
@@ -1160,7 +1160,7 @@ int Forward_Intru_Tol_Data(Node *next_hop, sys_scatter *scat)
     /* For client session blocking */
     if (Conf_IT_Link.Session_Blocking == 1 &&
         (itdata->out_head_seq - itdata->out_tail_seq) >= MAX_SEND_ON_LINK) {
-        Block_All_Sessions();
+        Block_Link_Sessions(lk->link_id);
     }
     
     now = E_get_time();
@@ -2208,7 +2208,7 @@ int Process_IT_Ack(int link_id, char* buff, int16u data_len, int16u ack_len)
         /* post = itdata->tcp_head_seq; */
         if (Conf_IT_Link.Session_Blocking == 1 && 
             (itdata->out_head_seq - itdata->out_tail_seq) < MAX_SEND_ON_LINK) {
-            Resume_All_Sessions();
+            Resume_Link_Sessions(lk->link_id);
         }
         /* if (post - pre > 15) {
             printf("\tBURST OF %d.    pre = %llu  post = %llu\n", 
@@ -3061,7 +3061,7 @@ void Key_Exchange_IT(int link_id, void *dummy)
     if (ret != 1) 
         Alarm(PRINT, "Key_Exchange_IT: SignUpdate of scat body failed\r\n");
 
-    ret = EVP_SignFinal(md_ctx, (unsigned char*)write_ptr, &sign_len, Priv_Key);
+    ret = Sec_sign_final(md_ctx, (unsigned char*)write_ptr, &sign_len, Priv_Key);
     if (ret != 1) 
         Alarm(PRINT, "Key_Exchange_IT: SignFinal failed\r\n");
 
@@ -3084,7 +3084,7 @@ void Key_Exchange_IT(int link_id, void *dummy)
         return;
     }
 
-    ret = EVP_VerifyFinal(md_ctx, (unsigned char*)write_ptr, sign_len, 
+    ret = Sec_verify_final(md_ctx, (unsigned char*)write_ptr, sign_len, 
                             Pub_Keys[My_ID]);
     if (ret != 1) {
         Alarm(PRINT, "Key_Exchange_IT: VerifyFinal failed\r\n");
@@ -0,0 +1,546 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arch.h"
+#include "spu_alarm.h"
+#include "spu_events.h"
+#include "spu_memory.h"
+#include "spu_data_link.h"
+
+#include "objects.h"
+#include "net_types.h"
+#include "node.h"
+#include "link.h"
+#include "network.h"
+#include "leg_sched.h"
+#include "spines.h"
+
+static sys_scatter Leg_Sched_Scat;
+
+/* Adds a buffer to the packet, merging it with the previous element if
+ * both were copied next to each other into the trailer */
+static void Leg_Cell_Add(Leg_Buf_Cell *cell, char *buf, int32u len, int ref)
+{
+    scat_element *prev;
+
+    if(cell->num_elements > 0 && !ref) {
+        prev = &cell->elements[cell->num_elements-1];
+        if(!(cell->refs & (1u << (cell->num_elements-1))) &&
+           prev->buf + prev->len == buf) {
+            prev->len += len;
+            return;
+        }
+    }
+    assert(cell->num_elements < LEG_CELL_ELEMENTS);
+    if(ref) {
+        cell->refs |= (1u << cell->num_elements);
+    }
+    cell->elements[cell->num_elements].buf = buf;
+    cell->elements[cell->num_elements].len = len;
+    cell->num_elements++;
+}
+
+/* Copies a buffer into the packet: into the trailer if it still fits,
+ * otherwise into a packet object of its own */
+static void Leg_Cell_Copy(Leg_Buf_Cell *cell, int32u *trailer_used,
+                          const char *buf, int32u len)
+{
+    char *obj;
+
+    if(len == 0) {
+        return;
+    }
+    if(*trailer_used + len <= LEG_CELL_TRAILER) {
+        memcpy(cell->trailer + *trailer_used, buf, len);
+        Leg_Cell_Add(cell, cell->trailer + *trailer_used, len, 0);
+        *trailer_used += len;
+        return;
+    }
+    if(len > MAX_PACKET_SIZE) {
+        Alarm(EXIT, "Leg_Cell_Copy: invalid buffer size %d, should be <= %d\n",
+              len, MAX_PACKET_SIZE);
+    }
+    if((obj = (char*) new_ref_cnt(PACK_OBJ)) == NULL) {
+        Alarm(EXIT, "Leg_Cell_Copy: failed to allocate buffer\n");
+    }
+    memcpy(obj, buf, len);
+    Leg_Cell_Add(cell, obj, len, 1);
+}
+
+/* Builds a queued copy of scat. The header and whatever follows the
+ * packet data are copied since the senders reuse or rewrite them per
+ * link. With ref_body, the data of the packet body (elements[1]) is a
+ * ref-counted object that is not modified once sent and is only held */
+static Leg_Buf_Cell* Leg_Cell_Create(int link_type, sys_scatter *scat,
+                                     int32u total_bytes, int ref_body)
+{
+    Leg_Buf_Cell  *cell;
+    packet_header *hdr;
+    int32u         trailer_used = 0;
+    int32u         held, rest;
+    char          *obj;
+    int            i, j;
+
+    if((cell = (Leg_Buf_Cell*) new(LEG_BUF_CELL)) == NULL) {
+        Alarm(EXIT, "Leg_Cell_Create: failed to allocate cell\n");
+    }
+    cell->next         = NULL;
+    cell->link_type    = link_type;
+    cell->num_elements = 0;
+    cell->total_bytes  = total_bytes;
+    cell->refs         = 0;
+
+    hdr = (packet_header*) scat->elements[0].buf;
+    if(scat->elements[0].len <= sizeof(packet_header)) {
+        memcpy(&cell->hdr, scat->elements[0].buf, scat->elements[0].len);
+        Leg_Cell_Add(cell, (char*) &cell->hdr, scat->elements[0].len, 0);
+    }
+    else {
+        Leg_Cell_Copy(cell, &trailer_used, scat->elements[0].buf,
+                      scat->elements[0].len);
+    }
+
+    for(i = 1; i < scat->num_elements; i++) {
+        /* Out of elements: the rest of the packet goes in one buffer */
+        if(cell->num_elements >= LEG_CELL_ELEMENTS-2 && i < scat->num_elements-1) {
+            for(j = i, rest = 0; j < scat->num_elements; j++) {
+                rest += scat->elements[j].len;
+            }
+            if(rest > MAX_PACKET_SIZE) {
+                Alarm(EXIT, "Leg_Cell_Create: packet of %d bytes too large\n",
+                      total_bytes);
+            }
+            if((obj = (char*) new_ref_cnt(PACK_OBJ)) == NULL) {
+                Alarm(EXIT, "Leg_Cell_Create: failed to allocate buffer\n");
+            }
+            for(rest = 0; i < scat->num_elements; i++) {
+                memcpy(obj + rest, scat->elements[i].buf, scat->elements[i].len);
+                rest += scat->elements[i].len;
+            }
+            Leg_Cell_Add(cell, obj, rest, 1);
+            break;
+        }
+
+        held = 0;
+        if(i == 1 && ref_body) {
+            held = scat->elements[1].len;
+            if(held > hdr->data_len) {
+                held = hdr->data_len;
+            }
+            if(held > 0) {
+                inc_ref_cnt(scat->elements[1].buf);
+                Leg_Cell_Add(cell, scat->elements[1].buf, held, 1);
+            }
+        }
+        Leg_Cell_Copy(cell, &trailer_used, scat->elements[i].buf + held,
+                      scat->elements[i].len - held);
+    }
+
+    return cell;
+}
+
+static void Leg_Cell_Dispose(Leg_Buf_Cell *cell)
+{
+    int i;
+
+    for(i = 0; i < cell->num_elements; i++) {
+        if(cell->refs & (1u << i)) {
+            dec_ref_cnt(cell->elements[i].buf);
+        }
+    }
+    dispose(cell);
+}
+
+/* Control link traffic and the standalone acks, nacks and pings of the
+ * other links go ahead of data. Data is told apart by link type and
+ * dissemination protocol */
+static Leg_Queue* Leg_Sched_Classify(Leg_Sched *sched, int link_type,
+                                     sys_scatter *scat)
+{
+    packet_header *hdr;
+    udp_header    *uhdr;
+    int            dissem = 0;
+
+    hdr = (packet_header*) scat->elements[0].buf;
+    if(link_type == CONTROL_LINK || Is_hello_type(hdr->type) ||
+       Is_link_ack(hdr->type) || Is_realtime_nack(hdr->type) ||
+       Is_intru_tol_ack(hdr->type) || Is_intru_tol_ping(hdr->type) ||
+       Is_diffie_hellman(hdr->type)) {
+        return &sched->ctrl;
+    }
+    if(Is_data_type(hdr->type) && scat->num_elements > 1 &&
+       scat->elements[1].len >= sizeof(udp_header)) {
+        uhdr = (udp_header*) scat->elements[1].buf;
+        dissem = uhdr->routing % LEG_SCHED_DISSEMS;
+    }
+    return &sched->data[link_type * LEG_SCHED_DISSEMS + dissem];
+}
+
+static void Leg_Sched_Refill(Leg_Sched *sched, sp_time now)
+{
+    sp_time delta;
+    int64   to_add;
+
+    if(sched->bucket_bytes >= Leg_Bucket_Cap) {
+        sched->bucket_last_filled = now;
+        return;
+    }
+    delta  = E_sub_time(now, sched->bucket_last_filled);
+    to_add = (int64) ((Leg_Rate_Limit_kbps / 8000.0) *
+                      ((double) delta.sec * 1000000.0 + delta.usec));
+
+    /* Keep the fraction of a byte for the next refill */
+    if(to_add <= 0) {
+        return;
+    }
+    sched->bucket_bytes      += to_add;
+    sched->bucket_last_filled = now;
+    if(sched->bucket_bytes > Leg_Bucket_Cap) {
+        sched->bucket_bytes = Leg_Bucket_Cap;
+    }
+}
+
+static int Leg_Sched_Transmit(Network_Leg *leg, Leg_Buf_Cell *cell)
+{
+    int ret, i;
+
+    for(i = 0; i < cell->num_elements; i++) {
+        Leg_Sched_Scat.elements[i] = cell->elements[i];
+    }
+    Leg_Sched_Scat.num_elements = cell->num_elements;
+
+    ret = DL_send(leg->local_interf->channels[cell->link_type],
+                  leg->remote_interf->net_addr,
+                  Port + cell->link_type,
+                  &Leg_Sched_Scat);
+    leg->sched.bucket_bytes -= cell->total_bytes;
+    Leg_Cell_Dispose(cell);
+
+    return ret;
+}
+
+static Leg_Buf_Cell* Leg_Queue_Pop(Leg_Queue *q)
+{
+    Leg_Buf_Cell *cell = q->head;
+
+    q->head = cell->next;
+    if(q->head == NULL) {
+        q->tail = NULL;
+    }
+    q->packets--;
+    return cell;
+}
+
+static void Leg_Sched_Deactivate(Leg_Sched *sched, Leg_Queue *q)
+{
+    Leg_Queue *prev = NULL, *it;
+
+    for(it = sched->active_head; it != q; it = it->next_active) {
+        prev = it;
+    }
+    if(prev != NULL) {
+        prev->next_active = q->next_active;
+    }
+    else {
+        sched->active_head = q->next_active;
+    }
+    if(sched->active_tail == q) {
+        sched->active_tail = prev;
+    }
+    q->next_active = NULL;
+    q->active      = 0;
+    q->deficit     = 0;
+    q->credited    = 0;
+}
+
+/* Makes room in a full buffer by dropping the oldest packet of the
+ * data class holding the most, so that one class cannot lock the
+ * others out of the buffer */
+static void Leg_Sched_Drop(Leg_Sched *sched)
+{
+    Leg_Queue *q, *longest = NULL;
+
+    for(q = sched->active_head; q != NULL; q = q->next_active) {
+        if(longest == NULL || q->packets > longest->packets) {
+            longest = q;
+        }
+    }
+    if(longest == NULL) {
+        return;
+    }
+    Leg_Cell_Dispose(Leg_Queue_Pop(longest));
+    sched->queued_data--;
+    if(longest->head == NULL) {
+        Leg_Sched_Deactivate(sched, longest);
+    }
+}
+
+/* Sends from the queues while the bucket has tokens. Returns the size
+ * of the packet that is next in line, 0 if nothing is left */
+static int32u Leg_Sched_Drain(Network_Leg *leg)
+{
+    Leg_Sched *sched = &leg->sched;
+    Leg_Queue *q;
+
+    while(sched->ctrl.head != NULL) {
+        if(sched->ctrl.head->total_bytes > sched->bucket_bytes) {
+            return sched->ctrl.head->total_bytes;
+        }
+        Leg_Sched_Transmit(leg, Leg_Queue_Pop(&sched->ctrl));
+    }
+
+    while((q = sched->active_head) != NULL) {
+        if(!q->credited) {
+            q->deficit += LEG_SCHED_QUANTUM;
+            q->credited = 1;
+        }
+        if(q->head->total_bytes > q->deficit) {
+            /* Round over for this class, keep its deficit for the next */
+            q->credited = 0;
+            if(q->next_active != NULL) {
+                sched->active_head = q->next_active;
+                sched->active_tail->next_active = q;
+                sched->active_tail = q;
+                q->next_active = NULL;
+            }
+            continue;
+        }
+        if(q->head->total_bytes > sched->bucket_bytes) {
+            return q->head->total_bytes;
+        }
+        q->deficit -= q->head->total_bytes;
+        sched->queued_data--;
+        Leg_Sched_Transmit(leg, Leg_Queue_Pop(q));
+
+        if(q->head == NULL) {
+            Leg_Sched_Deactivate(sched, q);
+        }
+    }
+    return 0;
+}
+
+/* Puts the leg on its interface's pacing list and makes sure the
+ * interface timer fires once the next packet has its tokens */
+static void Leg_Sched_Wait(Network_Leg *leg, int32u next_bytes, sp_time now)
+{
+    Interface_Sched *isched = &leg->local_interf->sched;
+    sp_time          delay, wakeup;
+    double           usec;
+
+    if(!leg->sched.waiting) {
+        leg->sched.waiting      = 1;
+        leg->sched.next_waiting = isched->waiting;
+        isched->waiting         = leg;
+    }
+    if(Leg_Rate_Limit_kbps == 0) {
+        return;
+    }
+
+    usec = (next_bytes - leg->sched.bucket_bytes) * 8000.0 / Leg_Rate_Limit_kbps;
+    if(usec < 1) {
+        usec = 1;
+    }
+    delay.sec  = (long) (usec / 1000000);
+    delay.usec = (long) (usec - delay.sec * 1000000.0);
+    wakeup = E_add_time(now, delay);
+
+    if(isched->armed && E_compare_time(isched->wakeup, wakeup) <= 0) {
+        return;
+    }
+    isched->armed  = 1;
+    isched->wakeup = wakeup;
+    E_queue(Leg_Sched_Timer, 0, leg->local_interf, delay);
+}
+
+/***********************************************************/
+/* void Leg_Sched_Init(Network_Leg *leg)                   */
+/*                                                         */
+/* Starts the leg with a full bucket and empty queues      */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* leg:        network leg                                 */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Leg_Sched_Init(Network_Leg *leg)
+{
+    memset(&leg->sched, 0, sizeof(leg->sched));
+    leg->sched.bucket_bytes       = Leg_Bucket_Cap;
+    leg->sched.bucket_last_filled = E_get_time();
+}
+
+/***********************************************************/
+/* int Leg_Sched_Send(Network_Leg *leg, int link_type,     */
+/*                    sys_scatter *scat, int ref_body)     */
+/*                                                         */
+/* Sends a packet on the leg subject to its rate limit,    */
+/*  queuing it if the bucket is short of tokens or other   */
+/*  packets of its class are waiting                       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* leg:        network leg                                 */
+/* link_type:  type of the link the packet is sent on      */
+/* scat:       packet, header in elements[0]               */
+/* ref_body:   elements[1] is a ref-counted object whose   */
+/*             first data_len bytes can be held instead of */
+/*             copied                                      */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) result of DL_send if sent right away, 0 otherwise */
+/*                                                         */
+/***********************************************************/
+int Leg_Sched_Send(Network_Leg *leg, int link_type, sys_scatter *scat,
+                   int ref_body)
+{
+    Leg_Sched    *sched = &leg->sched;
+    Leg_Queue    *q;
+    Leg_Buf_Cell *cell;
+    sp_time       now;
+    int32u        total_bytes, next_bytes;
+    int           i;
+
+    for(i = 0, total_bytes = 0; i < scat->num_elements; i++) {
+        total_bytes += scat->elements[i].len;
+    }
+
+    q = Leg_Sched_Classify(sched, link_type, scat);
+
+    now = E_get_time();
+    Leg_Sched_Refill(sched, now);
+    Leg_Sched_Drain(leg);
+
+    /* Nothing of the same or higher priority is waiting and we have the
+     * bandwidth: send now */
+    if(sched->ctrl.head == NULL &&
+       (q == &sched->ctrl || sched->active_head == NULL) &&
+       total_bytes <= sched->bucket_bytes)
+    {
+        sched->bucket_bytes -= total_bytes;
+        return DL_send(leg->local_interf->channels[link_type],
+                       leg->remote_interf->net_addr,
+                       Port + link_type,
+                       scat);
+    }
+
+    /* If we don't have space to buffer this packet, make some. Control
+     * traffic is small and is never dropped for the data backlog */
+    if(q != &sched->ctrl && sched->queued_data >= Leg_Max_Buffered) {
+        Leg_Sched_Drop(sched);
+    }
+
+    cell = Leg_Cell_Create(link_type, scat, total_bytes, ref_body);
+    q->packets++;
+    if(q->tail != NULL) {
+        q->tail->next = cell;
+    }
+    else {
+        q->head = cell;
+    }
+    q->tail = cell;
+
+    if(q != &sched->ctrl) {
+        sched->queued_data++;
+        if(!q->active) {
+            q->active      = 1;
+            q->next_active = NULL;
+            if(sched->active_tail != NULL) {
+                sched->active_tail->next_active = q;
+            }
+            else {
+                sched->active_head = q;
+            }
+            sched->active_tail = q;
+        }
+    }
+
+    if((next_bytes = Leg_Sched_Drain(leg)) > 0) {
+        Leg_Sched_Wait(leg, next_bytes, now);
+    }
+    return 0;
+}
+
+/***********************************************************/
+/* void Leg_Sched_Timer(int dummy, void *input_interf)     */
+/*                                                         */
+/* Pacing timer of a local interface: sends what the       */
+/*  waiting legs have tokens for and rearms for the ones   */
+/*  that still have packets queued                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* dummy:        not used                                  */
+/* input_interf: local interface                           */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Leg_Sched_Timer(int dummy, void *input_interf)
+{
+    Interface   *interf = (Interface*) input_interf;
+    Network_Leg *leg, *next;
+    sp_time      now;
+    int32u       next_bytes;
+
+    UNUSED(dummy);
+
+    interf->sched.armed = 0;
+    leg = interf->sched.waiting;
+    interf->sched.waiting = NULL;
+    now = E_get_time();
+
+    for(; leg != NULL; leg = next) {
+        next = leg->sched.next_waiting;
+        leg->sched.waiting      = 0;
+        leg->sched.next_waiting = NULL;
+
+        Leg_Sched_Refill(&leg->sched, now);
+        if((next_bytes = Leg_Sched_Drain(leg)) > 0) {
+            Leg_Sched_Wait(leg, next_bytes, now);
+        }
+    }
+}
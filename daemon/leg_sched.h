@@ -0,0 +1,113 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef LEG_SCHED_H
+#define LEG_SCHED_H
+
+#include "arch.h"
+#include "spu_scatter.h"
+#include "spu_events.h"
+#include "spu_data_link.h"
+#include "net_types.h"
+#include "link.h"
+
+/* Egress scheduler of a network leg (used with -rl rate limiting).
+ *
+ * Packets the leg's token bucket cannot send right away are queued by
+ * class: control link traffic and standalone acks/nacks/pings have
+ * strict priority, data is shared among link types and dissemination
+ * protocols by deficit round robin. When the buffer is full the oldest
+ * packet of the longest data queue is dropped. Legs waiting for tokens
+ * are paced by a single timer per local interface. */
+
+#define LEG_SCHED_DISSEMS   16      /* Dissemination protocols told apart per link type */
+#define LEG_SCHED_FLOWS     (MAX_LINKS_4_EDGE * LEG_SCHED_DISSEMS)
+#define LEG_SCHED_QUANTUM   MAX_PACKET_SIZE  /* Bytes a data class may send per round */
+
+#define LEG_CELL_ELEMENTS   8       /* Scatter elements kept per queued packet */
+#define LEG_CELL_TRAILER    128     /* Bytes of link trailer copied per packet */
+
+struct Interface_d;
+struct Network_Leg_d;
+
+/* A queued packet. The header and the link-specific trailer are copied,
+ * packet bodies are held by reference when the sender allows it */
+typedef struct Leg_Buf_Cell_d {
+    struct Leg_Buf_Cell_d *next;
+    int16         link_type;
+    int16         num_elements;
+    int32u        total_bytes;
+    int32u        refs;                  /* Elements holding a reference to release */
+    scat_element  elements[LEG_CELL_ELEMENTS];
+    packet_header hdr;
+    char          trailer[LEG_CELL_TRAILER];
+} Leg_Buf_Cell;
+
+typedef struct Leg_Queue_d {
+    Leg_Buf_Cell       *head;
+    Leg_Buf_Cell       *tail;
+    int32               packets;
+    int32               deficit;         /* DRR bytes left for this round */
+    int16               active;          /* On the round robin list */
+    int16               credited;        /* Got its quantum for the current visit */
+    struct Leg_Queue_d *next_active;
+} Leg_Queue;
+
+typedef struct Leg_Sched_d {
+    int64               bucket_bytes;    /* Bytes currently available in the token bucket */
+    sp_time             bucket_last_filled;
+    Leg_Queue           ctrl;            /* Strict priority */
+    Leg_Queue           data[LEG_SCHED_FLOWS];
+    Leg_Queue          *active_head;     /* Data queues with packets, in round robin order */
+    Leg_Queue          *active_tail;
+    int32               queued_data;     /* Data packets waiting */
+    int16               waiting;         /* On the interface's pacing list */
+    struct Network_Leg_d *next_waiting;
+} Leg_Sched;
+
+/* Pacing state of a local interface */
+typedef struct Interface_Sched_d {
+    struct Network_Leg_d *waiting;       /* Legs waiting for tokens */
+    int16               armed;
+    sp_time             wakeup;          /* When the pacing timer fires */
+} Interface_Sched;
+
+void Leg_Sched_Init(struct Network_Leg_d *leg);
+int  Leg_Sched_Send(struct Network_Leg_d *leg, int link_type, sys_scatter *scat,
+                    int ref_body);
+void Leg_Sched_Timer(int dummy, void *input_interf);
+
+#endif
@@ -208,6 +208,9 @@ int16 Create_Link(Network_Leg *leg,
     }
     r_data->max_window = MAX_CG_WINDOW;
     r_data->ssthresh = MAX_CG_WINDOW;
+    CC_Init(r_data, (mode == CONTROL_LINK) ? Conf_CC.Control_Links
+                                           : Conf_CC.Reliable_Links,
+            (float)Minimum_Window);
       
     lk->r_data = r_data;
   }
@@ -228,6 +231,7 @@ int16 Create_Link(Network_Leg *leg,
 
     leg->hellos_out          = 0;
     leg->connect_cnter       = 0;
+    Fast_Detect_Reset(leg);
 
     if ((c_data = (Control_Data*) new(CONTROL_DATA)) == NULL) {
       Alarm(EXIT, "Create_Link: Cannot allocate ctrl_data object\r\n");
@@ -286,6 +290,10 @@ int16 Create_Link(Network_Leg *leg,
       }
 
       Neighbor_Nodes[nd->neighbor_id] = nd;
+
+      /* multicast forwarding refers to neighbors by neighbor_id */
+
+      Discard_Mcast_Neighbors(MCAST_ALL_GROUPS);
     }
 
     /* set up hello's on this link at a random offset to avoid synchronizing all hello's */
@@ -640,14 +648,11 @@ void Destroy_Link(int16 linkid)
 	    E_dequeue(Net_Send_State_All, (int)linkid, &Groups_Prot_Def);
 	}
 	dispose(r_data);
-
-	if(Link_Sessions_Blocked_On == linkid) {
-            Alarm(DEBUG, "Resuming sessions\n");
-	    Resume_All_Sessions();
-	    Link_Sessions_Blocked_On = -1;
-	}
     }
 
+    /* Nothing will drain this link anymore */
+    Resume_Link_Sessions(linkid);
+
     /* Protocol data */
 
     if(lk->prot_data != NULL) {
@@ -665,6 +670,8 @@ void Destroy_Link(int16 linkid)
 	    }	
 	    E_dequeue(Send_RT_Nack, (int)linkid, NULL);
 	    E_dequeue(Send_RT_Retransm, (int)linkid, NULL);
+	    E_dequeue(Send_RT_FEC, (int)linkid, NULL);
+	    Clean_RT_FEC(rt_data);
 
 	    if(rt_data->retransm_buff != NULL) {
 		dec_ref_cnt(rt_data->retransm_buff);
@@ -728,15 +735,10 @@ Link *Get_Best_Link(Node_ID node_id, int mode)
   return link;
 }
 
-int Link_Send(Link *lk, sys_scatter *scat)
+static int Link_Send_Sched(Link *lk, sys_scatter *scat, int ref_body)
 {
   Network_Leg *leg;
-  Leg_Buf_Cell cell;
-  int total_bytes;
   int ret = 0;
-  int i;
-  /* sp_time diff;
-  sp_time delta = {1,0}; */
 
   /* AB: added for cost accounting */
   packet_header *hdr;
@@ -745,22 +747,10 @@ int Link_Send(Link *lk, sys_scatter *scat)
   int32 cost_count, *cost_count_ptr;
   stdit it;
 
-  /* ret = DL_send(lk->leg->local_interf->channels[lk->link_type], 
-		 lk->leg->remote_interf->net_addr,
-		 Port + lk->link_type,
-		 scat); */
-
   leg = lk->leg;
 
-  /* Calculate size of this packet */
-  for (i = 0, total_bytes = 0; i < scat->num_elements; i++)
-  {
-    total_bytes += scat->elements[i].len;
-  }
-
-  /* If we don't have space to buffer this packet, drop it */
-  if (Leg_Rate_Limit_kbps >= 0 && stdcarr_size(&leg->bucket_buf) >= Leg_Max_Buffered) {
-    return ret;
+  if (leg->live.active) {
+    leg->live.last_sent = E_get_time();
   }
 
   /* AB: added for cost accounting */
@@ -787,92 +777,31 @@ int Link_Send(Link *lk, sys_scatter *scat)
     }
   }
 
-  /* If no packets are currently waiting and we have the available bandwidth
-   * (subject to rate limiting), just go ahead and send now */
-  if (Leg_Rate_Limit_kbps < 0 || 
-     (stdcarr_empty(&leg->bucket_buf) && total_bytes <= leg->bucket_bytes))
+  /* Without rate limiting, just go ahead and send now. Otherwise the
+   * leg's scheduler sends it or queues it behind its class */
+  if (Leg_Rate_Limit_kbps < 0)
   {
-    Alarm(DEBUG, "Link_Send: sending %d bytes directly, %d bytes available\n", total_bytes, leg->bucket_bytes);
-    ret = DL_send(lk->leg->local_interf->channels[lk->link_type], 
-           lk->leg->remote_interf->net_addr,
+    ret = DL_send(leg->local_interf->channels[lk->link_type], 
+           leg->remote_interf->net_addr,
            Port + lk->link_type,
            scat);
-    leg->bucket_bytes -= total_bytes;
     return ret;
   }
 
-  /* Otherwise, we add this packet to the end of the queue of waiting packets
-   * and then try to send from the front of the queue if possible */
-  Alarm(DEBUG, "Link_Send: buffering packet, total_bytes = %d, available bytes = %d\n", total_bytes, leg->bucket_bytes);
-  cell.link_type = lk->link_type;
-  cell.scat.num_elements = scat->num_elements;
-  cell.total_bytes = total_bytes;
-  for (i = 0; i < scat->num_elements; i++)
-  {
-    cell.scat.elements[i].len = scat->elements[i].len;
-    cell.scat.elements[i].buf = new_ref_cnt(PACK_OBJ);
-    if (cell.scat.elements[i].buf == NULL) {
-        Alarm(EXIT, "Link_Send: failed to allocate buffer\n");
-    }
-    if (scat->elements[i].len > MAX_PACKET_SIZE) {
-        Alarm(EXIT, "Link_Send: invalid buffer size. For element %d, len is %d, "
-                    "should be <= %d\n", i, scat->elements[i].len,
-                    MAX_PACKET_SIZE);
-    }
-    memcpy(cell.scat.elements[i].buf, scat->elements[i].buf, scat->elements[i].len);
-  }
-  stdcarr_push_back(&leg->bucket_buf, &cell);
-
-  Leg_Try_Send_Buffered(leg);
-
-  /* Suicide_Count += ret; */
-  /* if (Suicide_Count > 16000000) {
-    diff = E_sub_time(E_get_time(),Suicide_Timer); */
-    /* printf("\tSuicide_Count = %d, Suicide_Timer = %ld.%.6ld, Diff = %ld.%.6ld\n", Suicide_Count, 
-                    Suicide_Timer.sec, Suicide_Timer.usec, diff.sec, diff.usec); */
-   /* if (E_compare_time(delta, diff) > 0) {
-        Alarm(EXIT, "Link_Send: Suicide Conditions Met\r\n"); 
-    }
-    Suicide_Count = 0;
-    Suicide_Timer = E_get_time();
-  }*/
-
-  return ret;
+  return Leg_Sched_Send(leg, lk->link_type, scat, ref_body);
 }
 
-int Leg_Try_Send_Buffered(Network_Leg *leg)
+int Link_Send(Link *lk, sys_scatter *scat)
 {
-  Leg_Buf_Cell *cell;
-  stdit it;
-  int ret = 0;
-  int i;
-
-  while (!stdcarr_empty(&leg->bucket_buf))
-  {
-    stdcarr_begin(&leg->bucket_buf, &it);
-    cell = (Leg_Buf_Cell *)stdcarr_it_val(&it);
-
-    /* If we can't send the next packet, stop */
-    if (cell->total_bytes > leg->bucket_bytes)
-        break;
-
-    Alarm(DEBUG, "Leg_Try_Send_Buffered: sending %d bytes from buffer, %d bytes available\n", cell->total_bytes, leg->bucket_bytes);
-    ret = DL_send(leg->local_interf->channels[cell->link_type], 
-           leg->remote_interf->net_addr,
-           Port + cell->link_type,
-           &cell->scat);
-    leg->bucket_bytes -= cell->total_bytes;
-
-    for (i = 0; i < cell->scat.num_elements; i++)
-    {
-        dec_ref_cnt(cell->scat.elements[i].buf);
-    }
-
-    stdcarr_pop_front(&leg->bucket_buf);
-  }
-
-  return ret;
+  return Link_Send_Sched(lk, scat, 0);
+}
 
+/* Same as Link_Send, for senders whose packet body (elements[1]) is a
+ * ref-counted object they do not change once sent: if the packet has to
+ * wait for the rate limit, its data is held by reference, not copied */
+int Link_Send_Ref(Link *lk, sys_scatter *scat)
+{
+  return Link_Send_Sched(lk, scat, 1);
 }
 
 /***********************************************************/
@@ -1040,65 +969,3 @@ int16u Set_Loss_SeqNo(Network_Leg *leg, int link_type)
   Alarm(DEBUG, "Seq no %d, type %d\n", *seq_ptr, link_type);
   return *seq_ptr;
 }
-
-/***********************************************************/
-/* void Fill_Leg_Bucket(int dummy, void* input_leg)        */
-/*                                                         */
-/* Method that refills the bucket for this leg             */
-/*  at the specified rate and up to the specified          */
-/*  capacity                                               */
-/*                                                         */
-/*                                                         */
-/* Arguments                                               */
-/*                                                         */
-/* dummy:      not used                                    */
-/* input_leg:  network leg                                 */
-/*                                                         */
-/* Return Value                                            */
-/*                                                         */
-/* NONE                                                    */
-/*                                                         */
-/***********************************************************/
-void Fill_Leg_Bucket(int dummy, void* input_leg)
-{
-    sp_time now, delta;
-    unsigned int to_add;
-    Network_Leg *leg;
-
-    UNUSED(dummy);
-    assert(Leg_Rate_Limit_kbps >= 0);
-    
-    leg = (Network_Leg *)input_leg;
-
-    E_queue(Fill_Leg_Bucket, 0, input_leg, leg_bucket_to);
-
-    if (leg == NULL) {
-        Alarm(PRINT, "Fill_Leg_Bucket: trying to look at NULL leg\r\n");
-        return;
-    }
-
-    if (leg->bucket_bytes > Leg_Bucket_Cap)
-        Alarm(EXIT, "Fill_Leg_Bucket(): Bucket grew larger than max capacity\r\n");
-
-    if (leg->bucket_bytes == Leg_Bucket_Cap) {
-        Alarm(DEBUG, "Fill_Leg_Bucket(): bucket was full!!\r\n");
-        return;
-    }
-
-    now = E_get_time();
-    delta = E_sub_time(now, leg->bucket_last_filled);
-    
-    to_add = (Leg_Rate_Limit_kbps / 8000.0) * (delta.sec * 1000000 + delta.usec);
-    leg->bucket_bytes += to_add;
-    leg->bucket_last_filled = now;
-    Alarm(DEBUG, "Fill_Leg_Bucket(): filled bucket to %d bytes, adding %d bytes\r\n", leg->bucket_bytes, to_add);
-
-    if (leg->bucket_bytes > Leg_Bucket_Cap)
-        leg->bucket_bytes = Leg_Bucket_Cap;
-
-    if (!stdcarr_empty(&leg->bucket_buf) && leg->bucket_bytes > 0)
-    {
-        /* try to send any pkts we can */
-        Leg_Try_Send_Buffered(leg);
-    }
-}
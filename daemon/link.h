@@ -37,6 +37,8 @@
 #ifndef LINK_H
 #define LINK_H
 
+#include "congestion.h"
+
 /* Window (for reliability) */
 #define MAX_WINDOW       20000
 #define MAX_CG_WINDOW    20000
@@ -131,6 +133,8 @@ typedef enum {
 
 #define MAX_BUCKET       500
 #define RT_RETRANSM_TOK  2   /* 1/2 = 50% max retransmissions */
+#define RT_FEC_MAX_BLOCK   32 /* max data packets covered by one parity packet */
+#define RT_FEC_RECV_WINDOW 64 /* received packets kept for FEC, > RT_FEC_MAX_BLOCK */
 
 #define BWTH_BUCKET      536064 /* 64K + 1.472K for one packet*/
 
@@ -166,12 +170,6 @@ typedef struct Lk_Param_d {
     sp_time delay;
 } Lk_Param;
 
-typedef struct Leg_Buf_Cell_d {
-  Link_Type   link_type;  /* type for specific link the packet should be sent on */
-  sys_scatter scat;       /* packet to send */
-  int32u      total_bytes;
-} Leg_Buf_Cell;
-
 typedef struct Buffer_Cell_d {
     int32u seq_no;
     char*  buff;
@@ -213,6 +211,7 @@ typedef struct Reliable_Data_d {
     float window_size;            /* Congestion window. */
     int32u max_window;            /* Maximum congestion window */
     int32u ssthresh;              /* Slow-start threshold */
+    CC_State cc;                  /* Congestion control adjusting the above */
 
     struct Buffer_Cell_d window[MAX_WINDOW]; /* Sending window 
 						(keeps actual pakets) */
@@ -275,6 +274,13 @@ typedef struct Control_Data_d {
 
 typedef int64u rt_seq_type;
 
+typedef struct RT_FEC_Cell_d {
+    rt_seq_type seq;              /* Sequence of the packet kept in buff */
+    int16u      len;              /* Bytes of buff covered by the parity */
+    int16u      data_len;         /* data_len of the packet */
+    char       *buff;             /* Copy of the packet as received */
+} RT_FEC_Cell;
+
 typedef struct Realtime_Data_d {
     rt_seq_type    head;
     rt_seq_type    tail;
@@ -289,6 +295,16 @@ typedef struct Realtime_Data_d {
     char *retransm_buff;
     int num_retransm;
     int bucket;
+    /* Forward error correction, sending side */
+    rt_seq_type fec_base;         /* First packet of the current parity block */
+    int    fec_block;             /* Packets in the current parity block */
+    int    fec_count;             /* Packets XORed into fec_buff so far */
+    int16u fec_len;               /* Longest packet in the current block */
+    int16u fec_data_len;          /* XOR of the data_len of the block packets */
+    char  *fec_buff;              /* rt_fec_header followed by the parity */
+    /* Forward error correction, receiving side */
+    int    fec_seen;              /* The other side sends parity packets */
+    RT_FEC_Cell fec_window[RT_FEC_RECV_WINDOW];
 } Realtime_Data;
 
 typedef struct IT_Recv_Cell_d {
@@ -403,13 +419,12 @@ void    Destroy_Link(int16 linkid);
 
 Link   *Get_Best_Link(Node_ID node_id, int mode);
 int     Link_Send(Link *lk, sys_scatter *scat);
+int     Link_Send_Ref(Link *lk, sys_scatter *scat);
 
 int32   Relative_Position(int32 base, int32 seq);
 
 void    Check_Link_Loss(struct Network_Leg_d *leg, int16u seq_no, int link_type);
 int32   Compute_Loss_Rate(struct Network_Leg_d *leg);
 int16u  Set_Loss_SeqNo(struct Network_Leg_d *leg, int link_type);
-void    Fill_Leg_Bucket(int dummy, void* input_leg);
-int     Leg_Try_Send_Buffered(struct Network_Leg_d *leg);
 
 #endif
@@ -98,6 +98,15 @@ stdhash *Edge_Changed_States(void)
   return &Changed_Edges;
 }
 
+/***********************************************************/
+/* Returns the log of changed edges                        */
+/***********************************************************/
+
+State_Log *Edge_Changed_Log(void)
+{
+  return &Changed_Edges_Log;
+}
+
 /***********************************************************/
 /* Returns the packet header type for link-state msgs.     */
 /***********************************************************/
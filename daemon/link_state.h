@@ -91,6 +91,7 @@ typedef struct Edge_Value_d
 stdhash *Edge_All_States(void); 
 stdhash *Edge_All_States_by_Dest(void); 
 stdhash *Edge_Changed_States(void); 
+struct State_Log_d *Edge_Changed_Log(void);
 int      Edge_State_type(void);
 int      Edge_State_header_size(void);
 int      Edge_Cell_packet_size(void);
@@ -91,6 +91,15 @@ stdhash *Groups_Changed_States(void)
   return &Changed_Group_States;
 }
 
+/***********************************************************/
+/* Returns the log of changed groups                       */
+/***********************************************************/
+
+State_Log *Groups_Changed_Log(void)
+{
+  return &Changed_Group_States_Log;
+}
+
 /***********************************************************/
 /* Returns the packet header type for group msgs           */
 /***********************************************************/
@@ -61,6 +61,7 @@ typedef struct Group_State_d
 stdhash* Groups_All_States(void); 
 stdhash* Groups_All_States_by_Name(void); 
 stdhash* Groups_Changed_States(void); 
+struct State_Log_d* Groups_Changed_Log(void);
 int Groups_State_type(void);
 int Groups_State_header_size(void);
 int Groups_Cell_packet_size(void);
@@ -47,6 +47,9 @@ extern int16u *Neighbor_IDs[];
 unsigned char  *MP_Cache[MAX_NODES+1][MULTIPATH_MAX_K+1];
 unsigned char  *MP_Flooding_Bitmask;
 unsigned char **MP_Neighbor_Mask;
+static int16u   MP_Neighbor_Mask_Count;
+
+static void MultiPath_Build_Graph(void);
 
 void MultiPath_Pre_Conf_Setup()
 {
@@ -81,15 +84,6 @@ void MultiPath_Pre_Conf_Setup()
 
 void Init_MultiPath()
 {
-    int i;
-    int16u index = 0;
-    stdit it;
-    Flow_Node *a, *b;
-    Flow_Edge *real, *resid;
-    Edge_Key key;
-    Edge_Value val;
-    int16u s, d;
-
     /* ~~~~~~~~ INIT FLOODING AND NEIGHBOR BITMASKS ~~~~~~~~ */
 
     /* Initialize the Flooding and Neighbor Masks */
@@ -102,7 +96,64 @@ void Init_MultiPath()
                 "MP_Flooding_Bitmask object\r\n");
     memset(MP_Flooding_Bitmask, 0xFF, MultiPath_Bitmask_Size);
 
+    MultiPath_Build_Graph();
+
+    /* Init Static Dissemination Graphs */
+    DG_Compute_Graphs();
+}
+
+/* Rebuilds the neighbor masks and the flow graph after the edges from the
+ * configuration file changed (and with them the edge indexes) */
+void MultiPath_Reconfigure()
+{
+    int i;
+    Flow_Edge *e, *next;
+
+    for (i = 1; i <= MP_Neighbor_Mask_Count; i++)
+        dispose(MP_Neighbor_Mask[i]);
+    dispose(MP_Neighbor_Mask);
+
+    for (i = 0; i <= MAX_NODES; i++) {
+        if (Flow_Nodes_Inbound[i] != NULL) {
+            dispose(Flow_Nodes_Inbound[i]->incoming);
+            dispose(Flow_Nodes_Inbound[i]->outgoing);
+            dispose(Flow_Nodes_Inbound[i]);
+            Flow_Nodes_Inbound[i] = NULL;
+        }
+        if (Flow_Nodes_Outbound[i] != NULL) {
+            dispose(Flow_Nodes_Outbound[i]->incoming);
+            dispose(Flow_Nodes_Outbound[i]->outgoing);
+            dispose(Flow_Nodes_Outbound[i]);
+            Flow_Nodes_Outbound[i] = NULL;
+        }
+    }
+
+    for (e = Flow_Edge_Head.next; e != NULL; e = next) {
+        next = e->next;
+        dispose(e);
+    }
+    Flow_Edge_Head.next = NULL;
+
+    MultiPath_Clear_Cache();
+    MultiPath_Build_Graph();
+
+    DG_Clear_Graphs();
+    DG_Compute_Graphs();
+}
+
+static void MultiPath_Build_Graph()
+{
+    int i;
+    int16u index = 0;
+    stdit it;
+    Flow_Node *a, *b;
+    Flow_Edge *real, *resid;
+    Edge_Key key;
+    Edge_Value val;
+    int16u s, d;
+
     /* Allocate and Initialize the Bitmask for each neighbor */
+    MP_Neighbor_Mask_Count = Degree[My_ID];
     MP_Neighbor_Mask = Mem_alloc(sizeof(unsigned char*) * (Degree[My_ID] + 1));
     MP_Neighbor_Mask[0] = NULL;
     for (i = 1; i <= Degree[My_ID]; i++) {
@@ -127,10 +178,11 @@ void Init_MultiPath()
             key.dst_id = Neighbor_IDs[My_ID][i];
         }
 
+        /* A neighbor removed by a configuration reload keeps its slot, but
+         * is on no path */
         stdskl_find(&Sorted_Edges, &it, &key);
         if (stdskl_is_end(&Sorted_Edges, &it))
-            Alarm(EXIT, "MultiPath_Post_Conf_Setup: Edge from config file not"
-                        " in Sorted_Edges skip list (%d,%d)\r\n", key.src_id, key.dst_id);
+            continue;
 
         index = ((Edge_Value*)stdskl_it_val(&it))->index;
         *(MP_Neighbor_Mask[i] + (index / 8)) = 0x80 >> (index % 8);
@@ -314,9 +366,6 @@ void Init_MultiPath()
 
         stdskl_it_next(&it);
     }
-
-    /* Init Static Dissemination Graphs */
-    DG_Compute_Graphs();
 }
 
 void MultiPath_Clear_Cache()
@@ -332,15 +381,97 @@ void MultiPath_Clear_Cache()
     }
 }
 
-int MultiPath_Compute(int16u dest_id, int16u k, unsigned char **ret_mask, int use_base_cost, int require_reverse)
+/* Which costs MultiPath_Edge_Cost uses, see MultiPath_Compute */
+typedef struct MultiPath_Cost_Arg_d {
+    int use_base_cost;
+    int require_reverse;
+} MultiPath_Cost_Arg;
+
+/* Cost of crossing flow edge e (negated on residual edges), or returns 0 if
+ * the link under it is considered broken */
+static int MultiPath_Edge_Cost(Flow_Edge *e, void *cost_arg, int32 *ret_cost)
 {
-    int i, path_index, progress = 0; /* total_cost; */
-    unsigned char *mask;
-    stdhash bag_of_edges;
+    MultiPath_Cost_Arg *arg = (MultiPath_Cost_Arg*) cost_arg;
     int16 cost = 0, c1, c2;
+
+    if (e->edge == NULL && e->reverse_edge == NULL)
+        cost = 0;
+    else if (e->edge == NULL || e->reverse_edge == NULL)
+        Alarm(EXIT, "Multipath_Compute: Edge or Reverse is NULL\n");
+    else {
+        if (arg->use_base_cost) {
+            c1 = e->edge->base_cost;
+            c2 = e->reverse_edge->base_cost;
+        } else {
+            c1 = e->edge->cost;
+            c2 = e->reverse_edge->cost;
+            /* link is considered broken if either is -1 */
+            if (c1 == -1 || (arg->require_reverse && c2 == -1))
+                return 0;
+            /* AB: negative costs are legal now */
+            c1 = abs(e->edge->cost);
+            c2 = abs(e->reverse_edge->cost);
+        }
+        if (arg->require_reverse)
+            cost = (c1 > c2) ? c1 : c2;
+        else
+            cost = c1;
+    }
+    /* if edge is residual, flip cost */
+    if (e->residual == 1)
+        cost = -cost;
+
+    *ret_cost = cost;
+    return 1;
+}
+
+static Flow_Graph         MP_Graph;
+static Flow_Node         *MP_Heap[2 * MAX_NODES + 1];
+static MultiPath_Cost_Arg MP_Cost_Arg;
+
+/* Points MP_Graph at the current flow graph, with paths from My_ID */
+static Flow_Graph *MultiPath_Graph(int use_base_cost, int require_reverse)
+{
+    MP_Cost_Arg.use_base_cost = use_base_cost;
+    MP_Cost_Arg.require_reverse = require_reverse;
+
+    MP_Graph.inbound = Flow_Nodes_Inbound;
+    MP_Graph.outbound = Flow_Nodes_Outbound;
+    MP_Graph.max_id = MAX_NODES;
+    MP_Graph.src_id = My_ID;
+    MP_Graph.edges = Flow_Edge_Head.next;
+    MP_Graph.heap = MP_Heap;
+    MP_Graph.heap_size = 0;
+    MP_Graph.edge_cost = MultiPath_Edge_Cost;
+    MP_Graph.cost_arg = &MP_Cost_Arg;
+
+    return &MP_Graph;
+}
+
+/* The real edges carrying flow are the union of the disjoint paths */
+static unsigned char *MultiPath_Flow_Mask(void)
+{
+    unsigned char *mask;
     Flow_Edge *e;
-    Flow_Node *t;
-    stdit it;
+
+    mask = new(MP_BITMASK);
+    memset(mask, 0x00, MultiPath_Bitmask_Size);
+
+    for (e = Flow_Edge_Head.next; e != NULL; e = e->next) {
+        if (e->residual == 0 && e->edge != NULL && e->flow == e->capacity)
+            *(mask + (e->index / 8)) |= 0x80 >> (e->index % 8);
+    }
+
+    return mask;
+}
+
+/* Min-cost k node-disjoint paths from My_ID to dest_id by successive
+ * shortest paths: each Dijkstra pass over the residual graph adds one
+ * path, rerouting the earlier ones where that is cheaper (Suurballe) */
+int MultiPath_Compute(int16u dest_id, int16u k, unsigned char **ret_mask, int use_base_cost, int require_reverse)
+{
+    int paths;
+    unsigned char *mask;
     sp_time start, stop;
 
     start = E_get_time();
@@ -358,149 +489,53 @@ int MultiPath_Compute(int16u dest_id, int16u k, unsigned char **ret_mask, int us
         return k;
     }
 
-    /* Iterate through Flow_Edges to initalize flow on each edge, 
-     *      real edges get flow = 0, residual get flow = capacity */
-    e = Flow_Edge_Head.next;
-    while (e != NULL) {
-        if (e->residual == 0)
-            e->flow = 0;
-        else
-            e->flow = e->capacity;
-        e = e->next;
-    }
+    paths = Flow_Compute_Paths(MultiPath_Graph(use_base_cost, require_reverse), dest_id, k);
 
-    /* Construct the hash table which will keep track of the edges
-     *      traversed by the Bellman-Ford iterations */
-    stdhash_construct(&bag_of_edges, sizeof(Flow_Edge*), 0, NULL, NULL, 0);
+    /* Return the computed mask as ret_mask */
+    if (ret_mask != NULL)
+        *ret_mask = MultiPath_Flow_Mask();
 
-    /* FORD-FULKERSON START */
-    for (path_index = 1; path_index <= k; path_index++) {
+    stop = E_get_time();
 
-        /* BELLMAN-FORD START */
-        /* Step 1: Initialize the graph: 
-         *      Each vertex gets distance = "INF" and predecessor = NULL */
-        for (i = 1; i <= MAX_NODES; i++) {
-            if (Flow_Nodes_Inbound[i] != NULL) {
-                Flow_Nodes_Inbound[i]->previous_edge = NULL;
-                Flow_Nodes_Inbound[i]->distance = USHRT_MAX;
-            }
-            if (Flow_Nodes_Outbound[i] != NULL) {
-                Flow_Nodes_Outbound[i]->previous_edge = NULL;
-                Flow_Nodes_Outbound[i]->distance = USHRT_MAX;
-            }
-        }
-        Flow_Nodes_Outbound[My_ID]->distance = 0;
-
-        /* Step 2: Relax edges repeatedly */
-        for (i = 1; i <= Num_Nodes * 2 + 1; i++) {
-            progress = 0;
-            e = Flow_Edge_Head.next;
-            while (e != NULL) {
-                if (e->edge == NULL && e->reverse_edge == NULL)
-                    cost = 0;
-                else if (e->edge == NULL || e->reverse_edge == NULL)
-                    Alarm(EXIT, "Multipath_Compute: Edge or Reverse is NULL\n");
-                else {
-                    if (use_base_cost) {
-                        c1 = e->edge->base_cost;
-                        c2 = e->reverse_edge->base_cost;
-                    } else {
-                        c1 = e->edge->cost;
-                        c2 = e->reverse_edge->cost;
-                        /* link is considered broken if either is -1 */
-                        if (c1 == -1 || (require_reverse && c2 == -1)) {
-                            e = e->next;
-                            continue;
-                        }
-                        /* AB: negative costs are legal now */
-                        c1 = abs(e->edge->cost);
-                        c2 = abs(e->reverse_edge->cost);
-                    }
-                    if (require_reverse)
-                        cost = (c1 > c2) ? c1 : c2;
-                    else
-                        cost = c1;
-                }
-                /* if edge is residual, flip cost */
-                if (e->residual == 1)
-                    cost = -cost;
-                if (e->flow < e->capacity &&
-                    e->end->distance > e->start->distance + cost) 
-                {
-                    e->end->distance = e->start->distance + cost;
-                    e->end->previous_edge = e;
-                    progress = 1;
-                }
-                e = e->next;
-            }
-            if (progress == 0)
-                break;
-        }
+    Alarm(DEBUG, "Computation took %f seconds.\r\n",
+        (stop.sec - start.sec) + (stop.usec - start.usec) / 1.0e6);
+
+    return paths;
+}
 
-        /* Step 3: Modified (using Progress variable) way to check for
-         *      negative cycles */
-        if (progress == 1)
-            Alarm(EXIT, "MultiPath_Compute: Negative Cycle Found\r\n");
+/* Same as calling MultiPath_Compute for each of the count destinations,
+ * but the first path to every destination comes from one shortest path
+ * tree of the whole graph, which is also the starting potential for the
+ * remaining passes.  ret_masks[i] (if ret_masks is not NULL) and
+ * ret_paths[i] get the results for dest_ids[i] */
+void MultiPath_Compute_Batch(int16u *dest_ids, int count, int16u k, unsigned char **ret_masks, int *ret_paths, int use_base_cost, int require_reverse)
+{
+    int d;
+    Flow_Graph *g;
+    sp_time start, stop;
 
-        /* BELLMAN-FORD END */
+    start = E_get_time();
 
-        if (Flow_Nodes_Inbound[dest_id]->distance == USHRT_MAX)
-            break;
-        
-        /* Path Augmentation and Add Edges to Bag */
-        t = Flow_Nodes_Inbound[dest_id];
-        while (t != Flow_Nodes_Outbound[My_ID]) {
-            if (t->previous_edge->residual == 1) {
-                stdhash_find(&bag_of_edges, &it, &(t->previous_edge->twin));
-                stdhash_erase(&bag_of_edges, &it);
-            }
-            else
-                stdhash_insert(&bag_of_edges, &it, &(t->previous_edge), 0);
-            t->previous_edge->flow = t->previous_edge->capacity;
-            t->previous_edge->twin->flow = 0;
-            t = t->previous_edge->start;
-        }
+    g = MultiPath_Graph(use_base_cost, require_reverse);
+    Flow_Compute_Tree(g);
 
-    } /* FORD-FULKERSON END */
-
-    /* Construct bitmask */
-    if (ret_mask != NULL) {
-        mask = new(MP_BITMASK);
-        memset(mask, 0x00, MultiPath_Bitmask_Size);
-
-        stdhash_begin(&bag_of_edges, &it);
-        /* j = 0; */ /* Added for testing */
-        /* total_cost = 0; */ /* Added for testing */
-        /*printf("Edges: ");*/
-        while(!stdhash_is_end(&bag_of_edges, &it)) {
-            e = *((Flow_Edge**)stdhash_it_key(&it));
-            if (e->edge != NULL && ret_mask != NULL) {
-                *(mask + (e->index / 8)) |= 0x80 >> (e->index % 8);
-                /* j++; */ /* Added for testing */
-                /* printf("  %d  ", e->index); *//* Added for testing */
-                /* total_cost += e->edge->cost; */ /* Added for testing */
-            }
-            stdhash_erase(&bag_of_edges, &it);
+    for (d = 0; d < count; d++) {
+        if (dest_ids[d] == My_ID || k == 0) {
+            ret_paths[d] = MultiPath_Compute(dest_ids[d], k,
+                               (ret_masks != NULL) ? &ret_masks[d] : NULL,
+                               use_base_cost, require_reverse);
+            continue;
         }
-        /* printf("\n"); */
 
-        /* Return the computed mask as ret_mask */
-        *ret_mask = mask;
+        ret_paths[d] = Flow_Compute_Tree_Paths(g, dest_ids[d], k);
+        if (ret_masks != NULL)
+            ret_masks[d] = MultiPath_Flow_Mask();
     }
 
-    if (path_index - 1 > k)
-        Alarm(EXIT, "MultiPath_Compute: paths found (%d) > k (%d) !!!\r\n",
-                path_index - 1, k);
-
-    /* Cleanup the hash table */
-    stdhash_destruct(&bag_of_edges);
-   
     stop = E_get_time();
 
-    Alarm(DEBUG, "Computation took %f seconds.\r\n",
-        (stop.sec - start.sec) + (stop.usec - start.usec) / 1.0e6);
-
-    return path_index - 1;
+    Alarm(DEBUG, "Batch computation for %d destinations took %f seconds.\r\n",
+        count, (stop.sec - start.sec) + (stop.usec - start.usec) / 1.0e6);
 }
 
 int MultiPath_Stamp_Bitmask(int16u dest_id, int16u k, unsigned char *mask)
@@ -44,6 +44,7 @@
 #include "objects.h"
 #include "node.h"
 #include "configuration.h"
+#include "flow_paths.h"
 
 #include "spu_alarm.h"
 #include "spu_memory.h"
@@ -57,38 +58,6 @@
                                            dissemination graphs with src/dst
                                            redundancy */
 
-struct Flow_Node_d;
-struct Flow_Edge_d;
-
-typedef struct Flow_Node_d {
-    /* Node *nd; */
-    struct Flow_Edge_d  **outgoing;
-    struct Flow_Edge_d  **incoming;
-    struct Flow_Node_d   *twin;
-    struct Flow_Edge_d   *previous_edge;
-    unsigned char         inbound_node; 
-    int16u                outgoing_num;
-    int16u                incoming_num;
-    int16u                distance;
-        /* True if all edges to other real nodes are incoming to this node 
-             (one outgoing edge to twin), 
-           False if all edges to other real nodes are outgoing from this 
-             node (one incoming edge from twin) */
-} Flow_Node;
-
-typedef struct Flow_Edge_d {
-    int16u                flow;
-    int16u                capacity;
-    Edge                 *edge;
-    Edge                 *reverse_edge;
-    Flow_Node            *start;
-    Flow_Node            *end;
-    int16u                index;
-    unsigned char         residual; /* True if edge is residual, False if real */
-    struct Flow_Edge_d   *twin;
-    struct Flow_Edge_d   *next;
-} Flow_Edge;
-
 #undef  ext
 #ifndef ext_multipath
 #define ext extern
@@ -104,8 +73,10 @@ ext Flow_Edge Flow_Edge_Head;
 
 void   MultiPath_Pre_Conf_Setup(void);
 void   Init_MultiPath(void);
+void   MultiPath_Reconfigure(void);
 void   MultiPath_Clear_Cache(void);
 int    MultiPath_Compute(int16u dest_id, int16u k, unsigned char **ret_mask, int use_base_cost, int require_reverse); 
+void   MultiPath_Compute_Batch(int16u *dest_ids, int count, int16u k, unsigned char **ret_masks, int *ret_paths, int use_base_cost, int require_reverse);
 int    MultiPath_Stamp_Bitmask(int16u dest_id, int16u k, unsigned char *mask);
 int    MultiPath_Neighbor_On_Path(unsigned char* mask, int16u ngbr_iter);
 int    MultiPath_Is_Superset(unsigned char* old_mask, unsigned char* new_mask);
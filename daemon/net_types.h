@@ -65,7 +65,11 @@
 #define         ROUTE_MASK              0x0f000000
 
 /* Second byte */
-/* Nothing here yet... */
+/* On hellos: the sender reads compact state packets.  On state packets:
+ * the packet is compact (delta cells and digests, see state_flood.h).
+ * Older daemons neither set nor check it, and are only sent plain state
+ * packets. */
+#define         STATE_COMPACT_TYPE      0x00010000
 
 /* Third byte */
 #define         ECN_DATA_T1             0x00000100
@@ -86,7 +90,7 @@
 #define         REL_UDP_DATA_TYPE       0x00000003
 #define         REALTIME_DATA_TYPE      0x00000004
 #define         REALTIME_NACK_TYPE      0x00000005
-#define         RESERVED_TYPE0          0x00000006
+#define         REALTIME_FEC_TYPE       0x00000006
 #define         RESERVED_TYPE1          0x00000007
 #define         RESERVED_TYPE2          0x00000008  /* SC2 */
 #define         RESERVED_TYPE3          0x00000009  /* SC2 */
@@ -109,11 +113,13 @@
 
 #define    Is_link_state(t)     (((t) & ROUTE_MASK) == LINK_STATE_TYPE)
 #define    Is_group_state(t)    (((t) & ROUTE_MASK) == GROUP_STATE_TYPE)
+#define    Is_state_compact(t)  (((t) & STATE_COMPACT_TYPE) != 0)
 
 #define    Is_udp_data(t)       (((t) & DATA_MASK) == UDP_DATA_TYPE)
 #define    Is_rel_udp_data(t)   (((t) & DATA_MASK) == REL_UDP_DATA_TYPE)
 #define    Is_realtime_data(t)  (((t) & DATA_MASK) == REALTIME_DATA_TYPE)
 #define    Is_realtime_nack(t)  (((t) & DATA_MASK) == REALTIME_NACK_TYPE)
+#define    Is_realtime_fec(t)   (((t) & DATA_MASK) == REALTIME_FEC_TYPE)
 #define    Is_link_ack(t)       (((t) & DATA_MASK) == LINK_ACK_TYPE)
 #define    Is_intru_tol_data(t) (((t) & DATA_MASK) == INTRU_TOL_DATA_TYPE)
 #define    Is_intru_tol_ack(t)  (((t) & DATA_MASK) == INTRU_TOL_ACK_TYPE)
@@ -270,6 +276,14 @@ typedef struct dummy_prio_flood_header {
     /*unsigned char   path[8];*/
 } prio_flood_header;
 
+/* Follows the root signature on priority flooding messages signed in
+ * batches (Prio_SignatureBatchUSec), and is followed by the path: depth
+ * sibling hashes from the message's leaf up to the signed root */
+typedef struct dummy_prio_batch_tail {
+    int16u          leaf;       /* index of this message in its batch */
+    int16u          depth;      /* number of hashes in the path */
+} prio_batch_tail;
+
 typedef struct dummy_fragment_header {
     int16u frag_length;       /* Length of the fragment */
     unsigned char frag_idx;   /* Fragment index of this packet in the message */
@@ -311,13 +325,17 @@ typedef	struct	dummy_hello_packet {
     int32           diff_time;
     int32           loss_rate;   /* estimated loss rate of data */
                                  /* (from 0 to LOSS_RATE_SCALE for 0% to 100%) */
+    /* Fast failure detection parameters, only sent when it is on */
+    int32u          fd_tx_interval;  /* desired interval between my probes (usec) */
+    int32u          fd_rx_interval;  /* smallest interval I accept probes at (usec) */
+    int32u          fd_detect_mult;  /* intervals of silence before I am declared dead */
 } hello_packet;
 
 typedef	struct	dummy_link_state_packet {
     Node_ID    source;
     int16u     num_edges;
     int16      src_data; /* Data about the source itself. 
-                            Not used yet */
+                            Same values as State_Packet's src_data */
 } link_state_packet;
 
 typedef	struct	dummy_edge_cell_packet {
@@ -333,7 +351,7 @@ typedef	struct	dummy_group_state_packet {
     Node_ID 	    source;
     int16u	    num_cells;
     int16           src_data; /* Data about the source itself. 
-				 Not used yet */
+				 Same values as State_Packet's src_data */
 } group_state_packet;
 
 typedef	struct	dummy_group_cell_packet {
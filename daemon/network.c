@@ -77,6 +77,7 @@
 #include "intrusion_tol_udp.h"
 #include "priority_flood.h"
 #include "reliable_flood.h"
+#include "snapshot.h"
 #include "multipath.h"
 #include "dissem_graphs.h"
 
@@ -213,13 +214,16 @@ void Init_Network(void)
   }
   Init_Session();
   Init_MultiPath();
+  Init_Snapshot();
   Init_Priority_Flooding();
   Init_Reliable_Flooding();
 
   if (Conf_IT_Link.Intrusion_Tolerance_Mode == 0) {
-    Resend_States(0, &Edge_Prot_Def);
+    Send_State_Digests(0, &Edge_Prot_Def);
+    Refresh_Own_States(0, &Edge_Prot_Def);
     /*State_Garbage_Collect(0, &Edge_Prot_Def); JLS: potential reconnection bug; fix: don't forget about edges + nodes */
-    Resend_States(0, &Groups_Prot_Def);
+    Send_State_Digests(0, &Groups_Prot_Def);
+    Refresh_Own_States(0, &Groups_Prot_Def);
     /*State_Garbage_Collect(0, &Groups_Prot_Def); JLS: need to examine groups garbage collection */
   }
 
@@ -238,6 +242,26 @@ void Init_Network(void)
   }
 }
 
+/***********************************************************/
+/* Reconfigure_Network: Applies the hosts and edges of a   */
+/* reloaded configuration file to the running daemon       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* old_ip:     host addresses before the reload, by ID     */
+/* old_edges:  edges from the file before the reload       */
+/* old_degree: number of neighbors before the reload       */
+/*                                                         */
+/***********************************************************/
+
+void Reconfigure_Network(const Network_Address *old_ip, stdskl *old_edges, int16u old_degree)
+{
+  Reconfigure_Nodes(old_ip, old_edges);
+  Reliable_Flood_Add_Neighbors(old_degree);
+  MultiPath_Reconfigure();
+  Schedule_Routes();
+}
+
 /***********************************************************/
 /* Create_Interface: Creates an interface                  */
 /*                                                         */
@@ -472,10 +496,7 @@ Network_Leg *Create_Network_Leg(Interface_ID local_interf_id,
   
   /* Rate limiting set up */
   if (Leg_Rate_Limit_kbps >= 0) {
-    leg->bucket_bytes = Leg_Bucket_Cap;
-    leg->bucket_last_filled = E_get_time();
-    stdcarr_construct(&leg->bucket_buf, sizeof(Leg_Buf_Cell), 0);
-    E_queue(Fill_Leg_Bucket, 0, leg, leg_bucket_to);
+    Leg_Sched_Init(leg);
   }
 
   for (i = 0; i != MAX_LINKS_4_EDGE; ++i) {
@@ -1192,6 +1213,7 @@ void Up_Down_Net(int dummy_int, void *dummy_p)
 
 void Graceful_Exit(int dummy_int, void *dummy_p)
 {
+  Snapshot_Write();
   Alarm(PRINT, "\n\n\nUDP\t%9lld\t%9lld\n", total_udp_pkts, total_udp_bytes);
   Alarm(PRINT, "REL_UDP\t%9lld\t%9lld\n", total_rel_udp_pkts, total_rel_udp_bytes);
   Alarm(PRINT, "ACK\t%9lld\t%9lld\n", total_link_ack_pkts, total_link_ack_bytes);
@@ -45,9 +45,14 @@
 
 #include "net_types.h"
 #include "link.h"
+#include "leg_sched.h"
 #include "node.h"
 #include "link_state.h"
 
+#ifdef SPINES_WIRELESS
+#  include "wireless.h"
+#endif
+
 #define CONNECTED_LEG_THRESHOLD 5
 #define NET_UPDATE_THRESHOLD     0.1
 #define NET_UPDATE_THRESHOLD_ABS 3
@@ -64,9 +69,8 @@
 #define LOSS_PROB_THRESH           0.02 /* 2% loss = problem */
 #define LOSS_NO_PROB_THRESH        0.005
 
-/* this is how often we will refill the leaky-bucket */
-#define LEG_BUCKET_FILL_USEC    500         /* How often to refill the leaky bucket (in microsec) */
-static const sp_time leg_bucket_to = {0, LEG_BUCKET_FILL_USEC};
+/* burst allowed by the leaky-bucket on top of one packet */
+#define LEG_BUCKET_FILL_USEC    500         /* Burst of the leaky bucket (in microsec at the leg rate) */
 
 struct Node_d;
 struct Edge_d;
@@ -88,6 +92,8 @@ typedef struct Interface_d
   int             num_discovery;                 /* if local -> # of multicast discovery channels bound to this interface */
   channel *       discovery;                     /* if local -> multicast discovery channels bound to this interface */
 
+  Interface_Sched sched;                         /* if local -> pacing of the legs leaving this interface */
+
 } Interface;
 
 typedef struct
@@ -105,6 +111,23 @@ typedef enum
 
 } Network_Leg_Status;
 
+/* Fast failure detection state of a leg (see hello.c) */
+typedef struct Leg_Liveness_d
+{
+  int16              active;                   /* both sides run fast detection on this leg */
+  int16              in_wheel;                 /* leg is in a slot of the probe wheel */
+  int32u             peer_tx_interval;         /* interval the other side wants to probe at (usec) */
+  int32u             peer_rx_interval;         /* smallest interval the other side accepts (usec) */
+  int32u             peer_detect_mult;
+  int32u             tx_interval;              /* negotiated interval of my probes (usec) */
+  int32u             detect_time;              /* silence after which the leg is dead (usec) */
+  sp_time            last_heard;               /* last packet of any kind received on the leg */
+  sp_time            last_sent;                /* last packet of any kind sent on the leg */
+  sp_time            next_probe;
+  sp_time            next_hello;               /* next full hello (rtt, loss rate) */
+  struct Network_Leg_d *wheel_next;
+} Leg_Liveness;
+
 typedef struct Network_Leg_d
 {
   Network_Leg_ID     leg_id;                   /* id of this leg: (local, remote) */
@@ -121,14 +144,15 @@ typedef struct Network_Leg_d
 
   int16              hellos_out;               /* number of outstanding hello msgs on this leg */  
   sp_time            last_recv_hello;          /* time at which we last recvd a hello from other side */
+  Leg_Liveness       live;                     /* fast failure detection */
+  char               state_compact;            /* other side reads compact state packets (STATE_COMPACT_TYPE) */
 
   int16              connect_cnter;            /* hello counter used to establish connection */
   sp_time            last_connected;           /* TS of most recent time this leg was connected */
+  char               removed;                  /* edge was removed from the configuration file by a reload */
 
   /* Rate limit variables */
-  int64              bucket_bytes;             /* Bytes currently available in the leaky bucket */
-  sp_time            bucket_last_filled;       /* Time the leaky bucket was last filled */
-  stdcarr            bucket_buf;               /* Buffer containing packets waiting to be sent (i.e. bucket was empty when they arrived) */
+  Leg_Sched          sched;                    /* Leaky bucket and the packets waiting for it */
 
 #ifdef SPINES_WIRELESS
   struct Wireless_Data_d w_data;
@@ -149,6 +173,7 @@ ext int32 Leg_Bucket_Cap;
 ext int32 Leg_Max_Buffered;
 
 void Init_Network(void);
+void Reconfigure_Network(const Network_Address *old_ip, stdskl *old_edges, int16u old_degree);
 void Init_My_Node(void);
 
 Interface *Create_Interface(Node_ID nid, Interface_ID iid, Network_Address interf_addr);
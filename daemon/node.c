@@ -68,6 +68,9 @@ static sp_time Client_Cost_Stats_Timeout = {30, 0};
 static sp_time Client_Cost_Print_Target = {0, 0};
 
 void Print_Client_Cost_Stats(int dummy, void *dummy_ptr);
+static int  In_Config_Edges(Node_ID src, Node_ID dst);
+static void Retire_Config_Edge(Node_ID src, Node_ID dst);
+static void Reconfigure_Config_Edge(Node_ID src, Node_ID dst, const Edge_Value *val);
 
 int Node_ID_cmp(const void *l, const void *r)
 {
@@ -140,6 +143,8 @@ void Init_Nodes(void)
     stdhash_construct(&All_Groups_by_Node,   sizeof(Node_ID),         sizeof(State_Chain*),      NULL, NULL, 0);
     stdhash_construct(&All_Groups_by_Name,   sizeof(Group_ID),        sizeof(State_Chain*),      NULL, NULL, 0);
     stdhash_construct(&Changed_Group_States, sizeof(Node_ID),         sizeof(Changed_State*),    NULL, NULL, 0);
+    Init_State_Log(&Changed_Edges_Log);
+    Init_State_Log(&Changed_Group_States_Log);
     stdhash_construct(&Monitor_Params,       sizeof(Network_Leg_ID),  sizeof(struct Lk_Param_d), NULL, NULL, 0);
     /* AB: added for cost accounting */
     stdskl_construct(&Client_Cost_Stats,     sizeof(Client_ID),       sizeof(int32),             Client_ID_cmp);
@@ -262,6 +267,150 @@ void Init_Nodes(void)
     }
 }
 
+/***********************************************************/
+/* void Reconfigure_Nodes(const int32 *old_ip,             */
+/*                        stdskl *old_edges)               */
+/*                                                         */
+/* Applies the hosts and edges of a reloaded configuration */
+/* file (already in temp_node_ip and Sorted_Edges) to the  */
+/* running network                                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* old_ip:    host addresses before the reload, by ID      */
+/* old_edges: edges from the file before the reload        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Reconfigure_Nodes(const int32 *old_ip, stdskl *old_edges)
+{
+    stdit        it;
+    Edge_Key     key;
+    Edge_Value  *val_ptr;
+    int16u       index;
+    int16        i;
+
+    for (i = 1; i <= MAX_NODES; i++) {
+        if (temp_node_ip[i] != 0 && Get_Node(temp_node_ip[i]) == NULL)
+            Create_Node(temp_node_ip[i]);
+    }
+
+    /* Edges that are no longer in the file are kept, like edges learned
+     * from the network, but lose their cost and index */
+    for (stdskl_begin(old_edges, &it); !stdskl_is_end(old_edges, &it); stdskl_it_next(&it)) {
+        key = *(Edge_Key*)stdskl_it_key(&it);
+        Retire_Config_Edge(old_ip[key.src_id], old_ip[key.dst_id]);
+        if (Directed_Edges == 0)
+            Retire_Config_Edge(old_ip[key.dst_id], old_ip[key.src_id]);
+    }
+
+    /* Relabel every edge, the indexes follow the order of Sorted_Edges */
+    index = 0;
+    for (stdskl_begin(&Sorted_Edges, &it); !stdskl_is_end(&Sorted_Edges, &it); stdskl_it_next(&it)) {
+        key = *(Edge_Key*)stdskl_it_key(&it);
+        val_ptr = (Edge_Value*)stdskl_it_val(&it);
+        val_ptr->index = index++;
+
+        Reconfigure_Config_Edge(temp_node_ip[key.src_id], temp_node_ip[key.dst_id], val_ptr);
+        if (Directed_Edges == 0)
+            Reconfigure_Config_Edge(temp_node_ip[key.dst_id], temp_node_ip[key.src_id], val_ptr);
+    }
+}
+
+/* Is the edge src -> dst in the (reloaded) configuration file? */
+static int In_Config_Edges(Node_ID src, Node_ID dst)
+{
+    stdit    it;
+    Edge_Key key;
+    int16u   src_id, dst_id;
+
+    stdhash_find(&Node_Lookup_Addr_to_ID, &it, &src);
+    if (stdhash_is_end(&Node_Lookup_Addr_to_ID, &it))
+        return 0;
+    src_id = *(int32*)stdhash_it_val(&it);
+
+    stdhash_find(&Node_Lookup_Addr_to_ID, &it, &dst);
+    if (stdhash_is_end(&Node_Lookup_Addr_to_ID, &it))
+        return 0;
+    dst_id = *(int32*)stdhash_it_val(&it);
+
+    if (Directed_Edges == 0 && src_id > dst_id) {
+        key.src_id = dst_id;
+        key.dst_id = src_id;
+    }
+    else {
+        key.src_id = src_id;
+        key.dst_id = dst_id;
+    }
+
+    return !stdskl_is_end(&Sorted_Edges, stdskl_find(&Sorted_Edges, &it, &key));
+}
+
+static void Retire_Config_Edge(Node_ID src, Node_ID dst)
+{
+    Edge *edge;
+
+    if ((edge = Get_Edge(src, dst)) == NULL || In_Config_Edges(src, dst))
+        return;
+
+    Alarm(PRINT, "Retire_Config_Edge: " IPF " -> " IPF " removed from the "
+            "configuration\r\n", IP(src), IP(dst));
+
+    edge->base_cost = -1;
+    edge->index     = USHRT_MAX;
+
+    if (src != My_Address || edge->leg == NULL)
+        return;
+
+    edge->leg->removed = 1;
+    if (edge->leg->status != DISCONNECTED_LEG)
+        Disconnect_Network_Leg(edge->leg);
+}
+
+static void Reconfigure_Config_Edge(Node_ID src, Node_ID dst, const Edge_Value *val)
+{
+    Edge        *edge;
+    Network_Leg *leg;
+
+    if ((edge = Get_Edge(src, dst)) == NULL) {
+        edge = Create_Edge(src, dst, -1, val->cost, val->index);
+    } else {
+        edge->base_cost = val->cost;
+        edge->index     = val->index;
+    }
+
+    if (src != My_Address)
+        return;
+
+    if ((leg = edge->leg) == NULL) {
+
+        if (Num_Local_Interfaces != 1) {
+            Alarm(PRINT, "Reconfigure_Config_Edge: ambiguous local interface for new "
+                    "neighbor " IPF ", it connects once it says hello\r\n", IP(dst));
+            return;
+        }
+
+        if (Get_Interface(dst) == NULL)
+            Create_Interface(dst, dst, dst);
+
+        leg = Create_Network_Leg(My_Interface_IDs[0], dst);
+    }
+    leg->removed = 0;
+
+    if (Conf_IT_Link.Intrusion_Tolerance_Mode == 1) {
+        leg->status = CONNECTED_LEG;
+        if (leg->links[INTRUSION_TOL_LINK] == NULL)
+            Create_Link(leg, INTRUSION_TOL_LINK);
+
+    } else if (leg->status == CONNECTED_LEG && leg->links[INTRUSION_TOL_LINK] == NULL) {
+        Create_Link(leg, INTRUSION_TOL_LINK);
+    }
+}
+
 /***********************************************************/
 /* Create_Node: Creates a new node structure               */
 /*                                                         */
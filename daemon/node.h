@@ -88,6 +88,7 @@ typedef struct Client_ID_d {
 int   Node_ID_cmp(const void *l, const void *r);
 
 void  Init_Nodes(void);
+void  Reconfigure_Nodes(const int32 *old_ip, stdskl *old_edges);
 
 Node *Create_Node(Node_ID nid);
 Node *Get_Node(Node_ID nid);
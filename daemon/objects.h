@@ -77,14 +77,13 @@
 #define MULTICAST_GROUP         27
 #define INTERFACE               28
 #define NETWORK_LEG             29
+#define LEG_BUF_CELL            30
 
 #define BUFFER_CELL             31
 #define UDP_CELL                32
 #define FRAG_PKT                33
 
-#define PRIO_FLOOD_PQ_NODE      34
-#define PRIO_FLOOD_NS_OBJ       35
-#define SEND_QUEUE_NODE         36
+/* 34 - 36 were the priority flooding queue nodes */
 #define FLOW_QUEUE_NODE         37
 #define RF_SESSION_OBJ          38
 #define DISSEM_QUEUE_NODE       39
@@ -0,0 +1,237 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <stdlib.h>
+
+#include "arch.h"
+#include "spu_alarm.h"
+#include "prio_queue.h"
+
+/* Resets the queues of a link to empty */
+void Prio_Link_Init(Prio_Link_Data *pldata)
+{
+    int i, j;
+
+    for (i = 0; i <= MAX_NODES; i++) {
+        pldata->msg_count[i] = 0;
+        pldata->in_send_queue[i] = 0;
+        pldata->sfq_next[i] = 0;
+        pldata->penalty[i] = 0;
+        pldata->max_pq[i] = 0;
+        pldata->min_pq[i] = MAX_PRIORITY + 1;
+
+        for (j = 0; j <= MAX_PRIORITY; j++) {
+            pldata->pq[i].head[j] = NULL;
+            pldata->pq[i].tail[j] = NULL;
+        }
+    }
+
+    pldata->total_msg = 0;
+
+    pldata->norm.head = 0;
+    pldata->norm.tail = 0;
+    pldata->urgent.head = 0;
+    pldata->urgent.tail = 0;
+
+    pldata->sent_messages = 0;
+}
+
+/* Appends source src_id to the send queue q of the link */
+void Prio_Queue_Source(Prio_Link_Data *pldata, Send_Fair_Queue *q,
+                       int32u src_id)
+{
+    pldata->sfq_next[src_id] = 0;
+    if (q->tail != 0)
+        pldata->sfq_next[q->tail] = src_id;
+    else
+        q->head = src_id;
+    q->tail = src_id;
+}
+
+/* Removes the source at the head of the send queue q of the link */
+int32u Prio_Dequeue_Source(Prio_Link_Data *pldata, Send_Fair_Queue *q)
+{
+    int32u src_id = q->head;
+
+    q->head = pldata->sfq_next[src_id];
+    if (q->head == 0)
+        q->tail = 0;
+    return src_id;
+}
+
+/* Picks the next source allowed to send on the link, urgent sources
+ * first, charging each source passed over its penalty. Sets *urgent
+ * to the queue the source was taken from; returns 0 if no source has
+ * anything to send */
+int32u Prio_Next_Source(Prio_Link_Data *pldata, int *urgent)
+{
+    int32u sender_id;
+
+    while (1) {
+
+        /* first, check the urgent sender fair queue */
+        if (pldata->urgent.head != 0) {
+            *urgent = 1;
+            sender_id = pldata->urgent.head;
+            pldata->penalty[sender_id]--;
+            /* make sure that this source still has something to send */
+            if (pldata->penalty[sender_id] > 0 || pldata->msg_count[sender_id] == 0) {
+                /* move to back of normal queue */
+                Prio_Dequeue_Source(pldata, &pldata->urgent);
+                Prio_Queue_Source(pldata, &pldata->norm, sender_id);
+                continue;
+            }
+        }
+        /* next, check normal_head if the urgent was empty */
+        else if (pldata->norm.head != 0) {
+            *urgent = 0;
+            sender_id = pldata->norm.head;
+            pldata->penalty[sender_id]--;
+            if (pldata->penalty[sender_id] > 0) {
+                Prio_Dequeue_Source(pldata, &pldata->norm);
+                Prio_Queue_Source(pldata, &pldata->norm, sender_id);
+                continue;
+            }
+            /* make sure that this source still has something to send */
+            else if (pldata->msg_count[sender_id] == 0) {
+                Prio_Dequeue_Source(pldata, &pldata->norm);
+                pldata->in_send_queue[sender_id] = 0;
+                continue;
+            }
+        }
+        /* else no source (toward this link) has anything to send */
+        else {
+            return 0;
+        }
+
+        return sender_id;
+    }
+}
+
+/* Moves a source that just sent to the back of the normal queue, to
+ * wait out the penalty of what it sent */
+void Prio_Requeue_Source(Prio_Link_Data *pldata, int32u src_id, int urgent,
+                         int16u penalty)
+{
+    Prio_Dequeue_Source(pldata, urgent ? &pldata->urgent : &pldata->norm);
+    pldata->penalty[src_id] = penalty;
+    Prio_Queue_Source(pldata, &pldata->norm, src_id);
+}
+
+/* Appends a message of src_id to the queue of neighbor ngbr (whose
+ * link is pldata) for the message's priority level */
+void Prio_Queue_Message(Prio_Link_Data *pldata, int ngbr, int32u src_id,
+                        Prio_Flood_Value *fbv_ptr, int32u packets)
+{
+    Prio_Flood_Value     *prev;
+    Prio_Neighbor_Status *ns = &fbv_ptr->ns[ngbr];
+
+    prev = pldata->pq[src_id].tail[fbv_ptr->priority];
+    ns->flag = NEED_MSG;
+    ns->prev = prev;
+    ns->next = NULL;
+    if (prev != NULL)
+        prev->ns[ngbr].next = fbv_ptr;
+    else
+        pldata->pq[src_id].head[fbv_ptr->priority] = fbv_ptr;
+    pldata->pq[src_id].tail[fbv_ptr->priority] = fbv_ptr;
+
+    /* possibly put this source into the send_queues */
+    if (pldata->in_send_queue[src_id] == 0) {
+        pldata->penalty[src_id] = 1;
+        Prio_Queue_Source(pldata, &pldata->urgent, src_id);
+        pldata->in_send_queue[src_id] = 1;
+    }
+
+    /* increase the msg_count for that source and total messages */
+    pldata->msg_count[src_id] += packets;
+    pldata->total_msg += packets;
+
+    /* Check if the max has now increased */
+    if (fbv_ptr->priority > pldata->max_pq[src_id])
+        pldata->max_pq[src_id] = fbv_ptr->priority;
+    /* Check if the min has now decreased */
+    if (fbv_ptr->priority < pldata->min_pq[src_id])
+        pldata->min_pq[src_id] = fbv_ptr->priority;
+}
+
+/* Unlinks a queued (NEED_MSG) message of src_id from the queue of
+ * neighbor ngbr and marks it ngbr_flag. The caller owns need_count */
+void Prio_Unqueue_Message(Prio_Link_Data *pldata, int ngbr, int32u src_id,
+                          Prio_Flood_Value *fbv_ptr, int32u packets,
+                          int32u ngbr_flag)
+{
+    int                   j;
+    Prio_Neighbor_Status *ns = &fbv_ptr->ns[ngbr];
+
+    pldata->msg_count[src_id] -= packets;
+    pldata->total_msg -= packets;
+
+    /* Unlink the message and fix pointers around it */
+    if (ns->prev != NULL)
+        ns->prev->ns[ngbr].next = ns->next;
+    else
+        pldata->pq[src_id].head[fbv_ptr->priority] = ns->next;
+    if (ns->next != NULL)
+        ns->next->ns[ngbr].prev = ns->prev;
+    else {
+        pldata->pq[src_id].tail[fbv_ptr->priority] = ns->prev;
+
+        /* have to update max/min prioirity where we have msgs */
+        if (pldata->msg_count[src_id] > 0) { /* still some msgs in PQ */
+            for (j = pldata->max_pq[src_id]; j >= 1 &&
+                    pldata->pq[src_id].head[j] == NULL; j--)
+            {
+                pldata->max_pq[src_id]--;
+            }
+            for (j = pldata->min_pq[src_id]; j <= MAX_PRIORITY &&
+                    pldata->pq[src_id].head[j] == NULL; j++)
+            {
+                pldata->min_pq[src_id]++;
+            }
+        }
+        else if (pldata->msg_count[src_id] == 0) { /* PQ is empty */
+            pldata->max_pq[src_id] = 0;
+            pldata->min_pq[src_id] = MAX_PRIORITY + 1;
+        }
+        else
+            Alarm(EXIT, "Prio_Unqueue_Message(): msg_count can't be < 0");
+    }
+
+    ns->flag = ngbr_flag;
+    ns->prev = NULL;
+    ns->next = NULL;
+}
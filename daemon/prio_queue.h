@@ -0,0 +1,124 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef PRIO_QUEUE_H
+#define PRIO_QUEUE_H
+
+#include "arch.h"
+#include "spu_events.h"
+#include "spu_scatter.h"
+#include "net_types.h"
+
+/* Per neighbor queues of the Priority-Based Flooding Belly: the messages
+ * queued toward a neighbor are linked through their Belly entries, and
+ * the sources with something queued through per source IDs, so queueing
+ * and sending allocate nothing */
+
+#define MAX_PRIORITY                10
+
+/* Message status */
+#define NEED_MSG            1
+#define RECV_MSG            2
+#define ON_LINK_MSG         3
+#define DROPPED_MSG         4
+#define EXPIRED_MSG         5
+#define NOT_IN_MASK         6
+
+/* Status of a message toward one neighbor. While the message is queued
+ * toward the neighbor (NEED_MSG), prev/next link it into that neighbor's
+ * queue for the source and priority, so queueing allocates nothing */
+typedef struct Prio_Neighbor_Status_d {
+    int32u flag;
+    struct Prio_Flood_Value_d *prev;
+    struct Prio_Flood_Value_d *next;
+} Prio_Neighbor_Status;
+
+typedef struct Prio_Flood_Value_d {
+    sp_time arrival;
+    sp_time expire;
+    sp_time origin_time;
+    int64u seq_num;
+    int32u priority;
+    int32u need_count;
+    int32u degree;
+    sys_scatter *msg_scat;
+    int32u msg_len;
+    int link_mode; /* The mode of the link from which this message was recieved */
+    /* Points just past this struct, where the Belly stores the status
+     * toward each neighbor, unless the degree outgrew that room */
+    Prio_Neighbor_Status *ns;
+} Prio_Flood_Value;
+
+/* -------Per Neighbor/Link Data Structures-------- */
+/* Queue of sources, linked through Prio_Link_Data.sfq_next by source ID.
+ * 0 (never a valid source) ends the queue */
+typedef struct Send_Fair_Queue_d {
+    int32u head;
+    int32u tail;
+} Send_Fair_Queue;
+
+/* Messages queued toward a neighbor from one source, oldest first,
+ * linked through Prio_Neighbor_Status */
+typedef struct Prio_PQ_d {
+    struct Prio_Flood_Value_d *head[MAX_PRIORITY + 1];
+    struct Prio_Flood_Value_d *tail[MAX_PRIORITY + 1];
+} Prio_PQ;
+
+typedef struct Prio_Link_Data_d {
+    int32u              total_msg;
+    int32u              msg_count[MAX_NODES + 1];
+    unsigned char       in_send_queue[MAX_NODES + 1];
+    int32u              max_pq[MAX_NODES + 1];
+    int32u              min_pq[MAX_NODES + 1];
+    Prio_PQ             pq[MAX_NODES + 1];
+    int32u              sfq_next[MAX_NODES + 1];
+    int16u              penalty[MAX_NODES + 1];
+    Send_Fair_Queue     norm;
+    Send_Fair_Queue     urgent;
+    int64u              sent_messages;
+} Prio_Link_Data;
+
+void   Prio_Link_Init(Prio_Link_Data *pldata);
+void   Prio_Queue_Source(Prio_Link_Data *pldata, Send_Fair_Queue *q, int32u src_id);
+int32u Prio_Dequeue_Source(Prio_Link_Data *pldata, Send_Fair_Queue *q);
+int32u Prio_Next_Source(Prio_Link_Data *pldata, int *urgent);
+void   Prio_Requeue_Source(Prio_Link_Data *pldata, int32u src_id, int urgent, int16u penalty);
+void   Prio_Queue_Message(Prio_Link_Data *pldata, int ngbr, int32u src_id,
+                          Prio_Flood_Value *fbv_ptr, int32u packets);
+void   Prio_Unqueue_Message(Prio_Link_Data *pldata, int ngbr, int32u src_id,
+                            Prio_Flood_Value *fbv_ptr, int32u packets, int32u ngbr_flag);
+
+#endif
@@ -48,6 +48,8 @@
 #define ext_prio_flood
 #include "priority_flood.h"
 #undef  ext_prio_flood
+#include "snapshot.h"
+#include "security.h"
 
 /* For printing 64 bit numbers */
 #define __STDC_FORMAT_MACROS
@@ -66,6 +68,31 @@ extern int16u      *Neighbor_IDs[];
 extern int64u      Injected_Messages;
 
 static const sp_time prio_print_stat_timeout = {15, 0};
+static const sp_time zero_timeout = {0, 0};
+
+/* Degree the Belly entries were sized for, and a zeroed entry of that
+ * size to insert new messages from */
+static int32u Prio_NS_Degree;
+static char   *Prio_Belly_Blank;
+
+/* Messages from local sessions waiting for their batch's root to be
+ * signed (Prio_SignatureBatchUSec). tree holds the leaves, then the
+ * levels above them once the batch is flushed */
+static struct {
+    int             count;
+    sys_scatter    *msg[PRIO_SIG_BATCH_MAX];
+    int             mode[PRIO_SIG_BATCH_MAX];
+    unsigned char  *sign_ptr[PRIO_SIG_BATCH_MAX];
+    unsigned char   tree[2 * PRIO_SIG_BATCH_MAX][SEC_MERKLE_HASH_LEN];
+} Sig_Batch;
+
+/* Recently verified batch roots of each source, replaced round robin */
+typedef struct Prio_Root_Cache_d {
+    unsigned char   root[PRIO_SIG_BATCH_ROOTS][SEC_MERKLE_HASH_LEN];
+    int             next;
+} Prio_Root_Cache;
+
+static Prio_Root_Cache Verified_Roots[MAX_NODES + 1];
 
 /* For debugging */
 /* int num_unique;
@@ -91,6 +118,14 @@ void Cleanup_prio_flood_ds(int ngbr_index, int src_id,
                             Prio_Flood_Value *fbv_ptr, int ngbr_flag);
 void Priority_Print_Statistics (int dummy1, void* dummy2);
 
+/* Releases the per-neighbor status of a message no neighbor needs anymore */
+static void Prio_Release_NS(Prio_Flood_Value *fbv_ptr)
+{
+    if (fbv_ptr->ns != (Prio_Neighbor_Status*) (fbv_ptr + 1))
+        dispose(fbv_ptr->ns);
+    fbv_ptr->ns = NULL;
+}
+
 
 void Flip_prio_flood_hdr( prio_flood_header *f_hdr )
 {
@@ -134,6 +169,7 @@ void Prio_Pre_Conf_Setup()
     Conf_Prio.Default_Expire_Sec        = PRIO_DEFAULT_EXPIRE_SEC;
     Conf_Prio.Default_Expire_USec       = PRIO_DEFAULT_EXPIRE_USEC;
     Conf_Prio.Garbage_Collection_Sec    = GARB_COLL_TO;
+    Conf_Prio.Sig_Batch_USec            = PRIO_SIG_BATCH_USEC;
 
 }
 
@@ -183,62 +219,49 @@ int Prio_Conf_hton(unsigned char *buff)
         write += sizeof(int32u);
     *(int32u*)write = htonl(Conf_Prio.Garbage_Collection_Sec);
         write += sizeof(int32u);
+    *(int32u*)write = htonl(Conf_Prio.Sig_Batch_USec);
+        write += sizeof(int32u);
     
     return sizeof(CONF_PRIO);
 }
 
 void Init_Priority_Flooding()
 {
-    int32u h, i, j;
+    int32u h, i;
     sp_time now = E_get_time();
     
     /* load in the configuration file taken from Prime code and 
      * set the default vaules for configurable variables */
     Seq_No = 1;
 
+    /* Each Belly entry has room for the status toward every neighbor
+     * right after the Prio_Flood_Value */
+    Prio_NS_Degree = Degree[My_ID];
+    Prio_Belly_Blank = (char *) Mem_alloc(sizeof(Prio_Flood_Value) +
+        sizeof(Prio_Neighbor_Status) * (Prio_NS_Degree + 1));
+    memset(Prio_Belly_Blank, 0, sizeof(Prio_Flood_Value) +
+        sizeof(Prio_Neighbor_Status) * (Prio_NS_Degree + 1));
     Belly = (stdhash *) Mem_alloc(sizeof(stdhash) * (MAX_NODES + 1));
     Node_Incarnation = (int64u *) Mem_alloc(sizeof(int64u) * (MAX_NODES + 1));
     for (i = 1; i <= MAX_NODES; i++) {
         stdhash_construct(&Belly[i], sizeof(Prio_Flood_Key),
-            sizeof(Prio_Flood_Value), NULL, NULL, STDHASH_OPTS_NO_AUTO_SHRINK );
+            sizeof(Prio_Flood_Value) + 
+                sizeof(Prio_Neighbor_Status) * (Prio_NS_Degree + 1), 
+            NULL, NULL, STDHASH_OPTS_NO_AUTO_SHRINK );
         stdhash_reserve(&Belly[i], Conf_Prio.Min_Belly_Size);
         if (i == My_ID)
-            Node_Incarnation[i] = now.sec;
+            Node_Incarnation[i] = Snapshot_Epoch(now.sec);
         else
-            Node_Incarnation[i] = 0;
+            Node_Incarnation[i] = Snapshot_Incarnation(i);
     }
 
+    /* Room for every possible neighbor: a configuration reload can add
+     * neighbors, and the queues hold pointers into this array */
     Edge_Data = (Prio_Link_Data *)
-        Mem_alloc(sizeof(Prio_Link_Data) * (Degree[My_ID] + 1));
-
-    for (h = 0; h <= Degree[My_ID]; h++) {
-        
-        for (i = 0; i <= MAX_NODES; i++) {
-            Edge_Data[h].msg_count[i] = 0;
-            Edge_Data[h].in_send_queue[i] = 0;
-            Edge_Data[h].max_pq[i] = 0;
-            Edge_Data[h].min_pq[i] = MAX_PRIORITY + 1;
-
-            for (j = 0; j <= MAX_PRIORITY; j++) {
-                Edge_Data[h].pq[i].head[j].next = NULL;
-                Edge_Data[h].pq[i].head[j].entry = NULL;
-                Edge_Data[h].pq[i].tail[j] =
-                    &Edge_Data[h].pq[i].head[j];
-            }
-        }
-
-        Edge_Data[h].total_msg = 0;
+        Mem_alloc(sizeof(Prio_Link_Data) * (MAX_NODES + 1));
 
-        Edge_Data[h].norm_head.next = NULL;
-        Edge_Data[h].norm_head.src_id = -1;
-        Edge_Data[h].norm_tail = &Edge_Data[h].norm_head;
-
-        Edge_Data[h].urgent_head.next = NULL;
-        Edge_Data[h].urgent_head.src_id = -1;
-        Edge_Data[h].urgent_tail = &Edge_Data[h].urgent_head;
-        
-        Edge_Data[h].sent_messages = 0;
-    }
+    for (h = 0; h <= MAX_NODES; h++)
+        Prio_Link_Init(&Edge_Data[h]);
 
     Bytes_Since_Checkpoint = 0;
     Time_Since_Checkpoint = now;
@@ -307,13 +330,11 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
     sp_time             now, temp_time;
     Prio_Flood_Value    fbv, *fbv_ptr;
     Prio_Link_Data      *pldata;
-    Prio_PQ_Node        *temp_pq_node;
-    Send_Fair_Queue     *temp_sfq;
     Node                *nd;
     unsigned int        sign_len;
     unsigned char       temp_ttl;
     EVP_MD_CTX          *md_ctx;
-    unsigned char       *path = NULL, *routing_mask;
+    unsigned char       *path = NULL, *routing_mask, *sign_ptr;
     unsigned char       temp_path[8];
     unsigned char       temp_path_index;
     Group_State         *gstate;
@@ -454,10 +475,12 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
                 (unsigned int)(data_len - sign_len),
                 src_id); */
         
-        crypto_ret = EVP_VerifyFinal(md_ctx, 
-                            (unsigned char*)(scat->elements[scat->num_elements-1].buf + 
-                                scat->elements[scat->num_elements-1].len - sign_len), 
-                            sign_len, Pub_Keys[src_id]);
+        sign_ptr = (unsigned char*)(scat->elements[scat->num_elements-1].buf + 
+                        scat->elements[scat->num_elements-1].len - sign_len);
+        if (Conf_Prio.Sig_Batch_USec > 0)
+            crypto_ret = Priority_Flood_Batch_Verify(md_ctx, sign_ptr, src_id);
+        else
+            crypto_ret = Sec_verify_final(md_ctx, sign_ptr, sign_len, Pub_Keys[src_id]);
         if (crypto_ret != 1) {
             Alarm(PRINT, "Priority_Flood: VerifyFinal failed\r\n");
             ret = NO_ROUTE;
@@ -524,19 +547,25 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
         fbv.msg_len = msg_size;
         fbv.link_mode = mode;
         
-        fbv.ns = new(PRIO_FLOOD_NS_OBJ);
-        if (fbv.ns == NULL) {
+        fbv.ns = NULL;
+        
+        /* Insert the message into this source's belly. The entry is
+         * larger than FBV (the neighbor status follows it), so insert a
+         * blank entry and copy FBV into it */
+        stdhash_insert(&Belly[src_id], &msg_it, &f_hdr->incarnation, Prio_Belly_Blank);
+        fbv_ptr = ((Prio_Flood_Value *)stdhash_it_val(&msg_it));
+        *fbv_ptr = fbv;
+
+        /* The status toward each neighbor lives in the Belly entry, unless
+         * neighbors were added since the Belly was sized */
+        if (Degree[My_ID] <= Prio_NS_Degree)
+            fbv_ptr->ns = (Prio_Neighbor_Status*) (fbv_ptr + 1);
+        else
+            fbv_ptr->ns = Mem_alloc(sizeof(Prio_Neighbor_Status) * (Degree[My_ID] + 1));
+        if (fbv_ptr->ns == NULL) {
             Alarm(EXIT, "Priority_Flood_Disseminate(): could not allocate mem \
                          for NS\r\n");
         }
-        
-        /* Insert the message into this source's belly */
-        stdhash_insert(&Belly[src_id], &msg_it, &f_hdr->incarnation, &fbv);
-
-        /* stdhash makes a copy of FBV, so we need to get a pointer to that 
-         * memory */
-        stdhash_find(&Belly[src_id], &msg_it, &f_hdr->incarnation);
-        fbv_ptr = ((Prio_Flood_Value *)stdhash_it_val(&msg_it));
 
         /* num_unique++;
         if (num_unique % 1000 == 0) 
@@ -584,11 +613,9 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
             if (Neighbor_Addrs[My_ID][ngbr_iter] == last_hop_ip || 
                     Neighbor_Addrs[My_ID][ngbr_iter] == hdr->source) {
                 fbv_ptr->ns[ngbr_iter].flag = RECV_MSG;
-                fbv_ptr->ns[ngbr_iter].ngbr = NULL;
                 fbv_ptr->need_count--;
                 if (fbv_ptr->need_count == 0) {
-                    dispose(fbv_ptr->ns);
-                    fbv_ptr->ns = NULL;
+                    Prio_Release_NS(fbv_ptr);
                     Cleanup_Scatter(fbv_ptr->msg_scat);
                     fbv_ptr->msg_scat = NULL;
                     fbv_ptr->msg_len = 0;
@@ -599,11 +626,9 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
              * the packet toward this neighbor */
             else if (!MultiPath_Neighbor_On_Path(routing_mask, ngbr_iter)) {
                 fbv_ptr->ns[ngbr_iter].flag = NOT_IN_MASK;
-                fbv_ptr->ns[ngbr_iter].ngbr = NULL;
                 fbv_ptr->need_count--;
                 if (fbv_ptr->need_count == 0) {
-                    dispose(fbv_ptr->ns);
-                    fbv_ptr->ns = NULL;
+                    Prio_Release_NS(fbv_ptr);
                     Cleanup_Scatter(fbv_ptr->msg_scat);
                     fbv_ptr->msg_scat = NULL;
                     fbv_ptr->msg_len = 0;
@@ -614,11 +639,9 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
              *      do not forward */
             else if (hdr->dest == My_Address)  {
                 fbv_ptr->ns[ngbr_iter].flag = DROPPED_MSG;
-                fbv_ptr->ns[ngbr_iter].ngbr = NULL;
                 fbv_ptr->need_count--;
                 if (fbv_ptr->need_count == 0) {
-                    dispose(fbv_ptr->ns);
-                    fbv_ptr->ns = NULL;
+                    Prio_Release_NS(fbv_ptr);
                     Cleanup_Scatter(fbv_ptr->msg_scat);
                     fbv_ptr->msg_scat = NULL;
                     fbv_ptr->msg_len = 0;
@@ -629,61 +652,11 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
              * this neighbor that NEEDS it. */
             else {
                 
-                if ((temp_pq_node = (Prio_PQ_Node *) new (PRIO_FLOOD_PQ_NODE))
-                        == NULL)
-                {
-                    Alarm(EXIT, "Priority_Flood_Disseminate(): cannot allocate \
-                                    Prio_PQ_Node object\r\n");
-                }
-
-                /* fill in the pq node */
-                temp_pq_node->timestamp = fbv_ptr->expire;
-                temp_pq_node->entry = fbv_ptr;
-                temp_pq_node->next = NULL;
-                temp_pq_node->prev =
-                    pldata->pq[src_id].tail[f_hdr->priority];
-
-                /* link to the node in the corresponding src's PQ and correct
-                 * prior lvl */
-                pldata->pq[src_id].tail[f_hdr->priority]->next =
-                    temp_pq_node;
-                pldata->pq[src_id].tail[f_hdr->priority] = temp_pq_node;
-
-                /* update the Ngbr status for both pointer to msg and flag */
-                fbv_ptr->ns[ngbr_iter].flag = NEED_MSG;
-                fbv_ptr->ns[ngbr_iter].ngbr = temp_pq_node;
-
-                /* possibly put this source into the send_queues */
-                if (pldata->in_send_queue[src_id] == 0) {
-                    if((temp_sfq = (Send_Fair_Queue *) new(SEND_QUEUE_NODE))
-                        == NULL)
-                    {
-                        Alarm(EXIT, "Priority_Flood_Disseminate: Cannot \
-                                     allocate send_queue objecti\r\n");
-                    }
-                    temp_sfq->next = NULL;
-                    temp_sfq->src_id = src_id;
-                    temp_sfq->penalty = 1;
-                    pldata->urgent_tail->next = temp_sfq;
-                    pldata->urgent_tail = temp_sfq;
-                    pldata->in_send_queue[src_id] = 1;
-                }
-
-                /* increase the msg_count for that source
-                 * and total messages */
+                /* append the message to this neighbor's queue for the
+                 * source and priority level */
                 packets = Calculate_Packets_In_Message(fbv_ptr->msg_scat, mode, NULL);
-                pldata->msg_count[src_id] += packets;
-                pldata->total_msg += packets;
+                Prio_Queue_Message(pldata, ngbr_iter, src_id, fbv_ptr, packets);
 
-                /* Check if the max has now increased */
-                if (f_hdr->priority > pldata->max_pq[src_id]) {
-                    pldata->max_pq[src_id] = f_hdr->priority;
-                }
-                /* Check if the min has now decreased */
-                if (f_hdr->priority < pldata->min_pq[src_id]) {
-                    pldata->min_pq[src_id] = f_hdr->priority;
-                }
-               
                 /* Find the node that corresponds to this neighbor */
                 stdhash_find(&All_Nodes, &it, &Neighbor_Addrs[My_ID][ngbr_iter]);
                 if (!stdhash_is_end(&All_Nodes, &it)) {
@@ -691,8 +664,8 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
                     
                     /* While we still have things to send to this neighbor and
                     * we can successfully send a message to the lower level */
-                    while( (pldata->norm_head.next != NULL ||
-                        pldata->urgent_head.next != NULL) &&
+                    while( (pldata->norm.head != 0 ||
+                        pldata->urgent.head != 0) &&
                            Request_Resources((IT_PRIORITY_ROUTING >> ROUTING_BITS_SHIFT), nd, mode, 
                             &Priority_Flood_Send_One));
                 }
@@ -711,13 +684,11 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
                         }
                     }
 
-                    /* get the current hog's lowest priority, oldest message */
-                    temp_pq_node = pldata->pq[hog_index].
-                                        head[pldata->min_pq[hog_index]].next;
-
-                    /* call cleanup function */
+                    /* get the current hog's lowest priority, oldest message
+                     * and call cleanup function */
                     Cleanup_prio_flood_ds(ngbr_iter, hog_index,
-                                            temp_pq_node->entry, DROPPED_MSG);
+                            pldata->pq[hog_index].head[pldata->min_pq[hog_index]], 
+                            DROPPED_MSG);
                     total_dropped++;
                     ret = BUFF_DROP;
                 }
@@ -757,6 +728,10 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
             return NO_ROUTE;
         }
     
+        /* Neighbors added after this message arrived never had it queued */
+        if (last_hop_index > fbv_ptr->degree)
+            return NO_ROUTE;
+
         switch (fbv_ptr->ns[last_hop_index].flag) {
             case RECV_MSG: case DROPPED_MSG: case EXPIRED_MSG:
                 /* We already know this neighbor doesn't need this message */
@@ -767,9 +742,8 @@ int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
             case NEED_MSG:
                 /* This message is stored in the PQ */
                 /* We can effectively get rid of it in the PQ and cleanup */
-                temp_pq_node = fbv_ptr->ns[last_hop_index].ngbr;
                 Cleanup_prio_flood_ds(last_hop_index, src_id,
-                                        temp_pq_node->entry, RECV_MSG);
+                                        fbv_ptr, RECV_MSG);
                 break;
             default:
                 printf("\tflag == %d\n", fbv_ptr->ns[last_hop_index].flag);
@@ -808,12 +782,10 @@ int Priority_Flood_Send_One( Node *next_hop, int mode )
 {
     int32u              i, sender_id, ngbr_index = 0;
     int32u              Neighbor_IP;
-    int                 ret, sent_one = 0, bytes_sent = 0;
+    int                 ret, sent_one = 0, bytes_sent = 0, urgent;
     sp_time             now;
     Prio_Flood_Value    *fbv_ptr;
     Prio_Link_Data      *pldata;
-    Prio_PQ_Node        *temp_pq_node;
-    Send_Fair_Queue     *temp_sfq;
   
     if (next_hop == NULL) {
         Alarm(PRINT, "Priority_Flood_Send_One(): next_hop was NULL - \
@@ -834,67 +806,21 @@ int Priority_Flood_Send_One( Node *next_hop, int mode )
 
     while (!sent_one) {
         
-        temp_sfq = NULL;
-
-        /* first, check the urgent sender fair queue */
-        if (pldata->urgent_head.next != NULL) {
-            temp_sfq = pldata->urgent_head.next;
-            temp_sfq->penalty--;
-            /* make sure that this source still has something to send */
-            if (temp_sfq->penalty > 0 || pldata->msg_count[temp_sfq->src_id] == 0) {
-                pldata->urgent_head.next = pldata->urgent_head.next->next;
-                if(pldata->urgent_tail == temp_sfq)
-                    pldata->urgent_tail = &pldata->urgent_head;
-                /* move to back of normal queue */
-                temp_sfq->next = NULL;
-                pldata->norm_tail->next = temp_sfq;
-                pldata->norm_tail = temp_sfq;
-                continue;
-            }
-        }
-        /* next, check normal_head if the urgent was empty */
-        else if (pldata->norm_head.next != NULL) {
-            temp_sfq = pldata->norm_head.next;
-            temp_sfq->penalty--;
-            if (temp_sfq->penalty > 0) {
-                pldata->norm_head.next = pldata->norm_head.next->next;
-                if (pldata->norm_head.next == NULL)
-                    pldata->norm_tail = &pldata->norm_head;
-                temp_sfq->next = NULL;
-                pldata->norm_tail->next = temp_sfq;
-                pldata->norm_tail = temp_sfq;
-                continue;
-            }
-            /* make sure that this source still has something to send */
-            else if (pldata->msg_count[temp_sfq->src_id] == 0) {
-                pldata->norm_head.next = pldata->norm_head.next->next;
-                if (pldata->norm_head.next == NULL)
-                    pldata->norm_tail = &pldata->norm_head;
-                pldata->in_send_queue[temp_sfq->src_id] = 0;
-                dispose(temp_sfq);
-                continue;
-            }
-        }
-        /* else no source (toward this link) has anything to send */
-        else {
+        sender_id = Prio_Next_Source(pldata, &urgent);
+        if (sender_id == 0)
             return 0;
-        }
-            
+
         /* now, we must get this sender's highest priority, oldest message */
-        sender_id = temp_sfq->src_id;
-        temp_pq_node =
-                pldata->pq[sender_id].head[pldata->max_pq[sender_id]].next;
-        assert(temp_pq_node != NULL);
+        fbv_ptr = pldata->pq[sender_id].head[pldata->max_pq[sender_id]];
+        assert(fbv_ptr != NULL);
         
         now = E_get_time();
-        fbv_ptr = temp_pq_node->entry;
         
         /* check if this msg is expired */
-        if (E_compare_time(temp_pq_node->timestamp, now) <= 0) {
-            Cleanup_prio_flood_ds(ngbr_index, sender_id, temp_pq_node->entry,
-                                    EXPIRED_MSG);
+        if (E_compare_time(fbv_ptr->expire, now) <= 0) {
+            Cleanup_prio_flood_ds(ngbr_index, sender_id, fbv_ptr, EXPIRED_MSG);
             /* Correcting the penalty because no message was sent this iteration */
-            temp_sfq->penalty = 1;
+            pldata->penalty[sender_id] = 1;
             continue;
         }
 
@@ -919,41 +845,22 @@ int Priority_Flood_Send_One( Node *next_hop, int mode )
                 Alarm(PRINT, "... Trying to SEND #%"PRIu64" TO "IPF"\n",
                     fbv_ptr->seq_num, IP(Neighbor_Addrs[My_ID][ngbr_index]));
                 /* Correcting the penalty because the message failed to send */
-                temp_sfq->penalty++;
+                pldata->penalty[sender_id]++;
                 return 0;
                 break;
             default:
                 Alarm(PRINT, "Priority_Flood_Send_One(): got an invalid  \
                                 return from Forward_Data\r\n");
                 /* Correcting the penalty because the message failed to send */
-                temp_sfq->penalty++;
+                pldata->penalty[sender_id]++;
                 return 0;
         } 
 
-        /* cleanup the send_fair_queue */
-        if (temp_sfq == pldata->urgent_head.next) {
-            pldata->urgent_head.next = pldata->urgent_head.next->next;
-            if(pldata->urgent_tail == temp_sfq)
-                pldata->urgent_tail = &pldata->urgent_head;
-        }
-        else if (temp_sfq == pldata->norm_head.next) {
-            pldata->norm_head.next = pldata->norm_head.next->next;
-            if(pldata->norm_tail == temp_sfq)
-                pldata->norm_tail = &pldata->norm_head;
-        } 
-        else { /* error */
-            Alarm(PRINT, "Priority_Flood_Send_One(): send_fair_queue \
-                            node not possible\r\n");
-        }
-
-        /* move to back of normal queue */
-        temp_sfq->penalty = Calculate_Packets_In_Message(fbv_ptr->msg_scat, mode, NULL);
-        temp_sfq->next = NULL;
-        pldata->norm_tail->next = temp_sfq;
-        pldata->norm_tail = temp_sfq;
+        /* cleanup the send_fair_queue and move to back of normal queue */
+        Prio_Requeue_Source(pldata, sender_id, urgent,
+            Calculate_Packets_In_Message(fbv_ptr->msg_scat, mode, NULL));
 
-        Cleanup_prio_flood_ds(ngbr_index, sender_id, temp_pq_node->entry,
-                                ON_LINK_MSG);
+        Cleanup_prio_flood_ds(ngbr_index, sender_id, fbv_ptr, ON_LINK_MSG);
     }
    
     /* DEBUG */
@@ -993,12 +900,11 @@ int Priority_Flood_Send_One( Node *next_hop, int mode )
 void Cleanup_prio_flood_ds(int ngbr_index, int src_id, 
                             Prio_Flood_Value *fbv_ptr, int ngbr_flag)
 {
-    int                 j, i, start = 1, end = Degree[My_ID];
+    int                 i, start = 1, end = fbv_ptr->degree;
     int16u              packets = 0;
-    Prio_Link_Data      *pldata;
-    Prio_PQ_Node        *pqnode;
+    Prio_Neighbor_Status *ns;
 
-    if (fbv_ptr->need_count == 0)
+    if (fbv_ptr->need_count == 0 || ngbr_index > (int) fbv_ptr->degree)
         return;
 
     if (ngbr_flag != EXPIRED_MSG) {
@@ -1011,59 +917,187 @@ void Cleanup_prio_flood_ds(int ngbr_index, int src_id,
     for (i = start; i <= end && fbv_ptr->need_count > 0; i++) {
 
         /* If this neighbor has already cleaned up this message, skip */
-        if ( fbv_ptr->ns[i].ngbr == NULL)
+        ns = &fbv_ptr->ns[i];
+        if (ns->flag != NEED_MSG)
             continue;
 
-        pldata = &Edge_Data[i];
-        pldata->msg_count[src_id] -= packets;
-        pldata->total_msg -= packets;
-        pqnode = fbv_ptr->ns[i].ngbr;
-
-        /* Delete the pqnode and fix pointers around it */
-        pqnode->prev->next = pqnode->next;
-        if (pqnode->next != NULL)
-            pqnode->next->prev = pqnode->prev;
-        else {
-            pldata->pq[src_id].tail[fbv_ptr->priority] = pqnode->prev;
-
-            /* have to update max/min prioirity where we have msgs */
-            if (pldata->msg_count[src_id] > 0) { /* still some msgs in PQ */
-                for (j = pldata->max_pq[src_id]; j >= 1 && 
-                        pldata->pq[src_id].head[j].next == NULL; j--)
-                {
-                    pldata->max_pq[src_id]--;
-                }
-                for (j = pldata->min_pq[src_id]; j <= MAX_PRIORITY &&
-                        pldata->pq[src_id].head[j].next == NULL; j++) 
-                {
-                    pldata->min_pq[src_id]++;
-                }
-            }
-            else if (pldata->msg_count[src_id] == 0) { /* PQ is empty */
-                pldata->max_pq[src_id] = 0;
-                pldata->min_pq[src_id] = MAX_PRIORITY + 1;
-            }
-            else
-                Alarm(EXIT, "Cleanup_flood_ds(): msg_count can't be < 0");
-        }
-        dispose(pqnode);
-
-        /* Update the NS array for with that status */
+        Prio_Unqueue_Message(&Edge_Data[i], i, src_id, fbv_ptr, packets, ngbr_flag);
         fbv_ptr->need_count--;
-        fbv_ptr->ns[i].flag = ngbr_flag;
-        fbv_ptr->ns[i].ngbr = NULL;
     }
 
     /* Is this message not needed by a single neighbor at this point? */
     if (fbv_ptr->need_count == 0) {
-        dispose(fbv_ptr->ns);
-        fbv_ptr->ns = NULL;
+        Prio_Release_NS(fbv_ptr);
         Cleanup_Scatter(fbv_ptr->msg_scat);
         fbv_ptr->msg_scat = NULL;
         fbv_ptr->msg_len = 0;
     }
 }
 
+/***********************************************************/
+/* int Priority_Flood_Batch_Add (sys_scatter *scat,        */
+/*              int mode, EVP_MD_CTX *md_ctx,              */
+/*              unsigned char *sign_ptr)                   */
+/*                                                         */
+/* Takes over a message injected by a local session in     */
+/*   place of signing it: the message joins the current    */
+/*   batch and is sent once the batch's Merkle root is     */
+/*   signed, at most Prio_SignatureBatchUSec later          */
+/*                                                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* scat:        the message, without its signature         */
+/* mode:        mode to send the message with              */
+/* md_ctx:      SHA-256 digest of the signed contents      */
+/* sign_ptr:    where the signature tail goes              */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* 1 - message taken over                                  */
+/* 0 - error, the caller still owns scat                   */
+/*                                                         */
+/***********************************************************/
+int Priority_Flood_Batch_Add(sys_scatter *scat, int mode, EVP_MD_CTX *md_ctx,
+                             unsigned char *sign_ptr)
+{
+    sp_time timeout;
+    int     i;
+
+    /* The messages already in a full batch have been restored
+     * (ttl, path stamps), so they can go now */
+    if (Sig_Batch.count == PRIO_SIG_BATCH_MAX)
+        Priority_Flood_Batch_Flush(0, NULL);
+
+    i = Sig_Batch.count;
+    if (Sec_merkle_leaf(md_ctx, Sig_Batch.tree[i]) != 1) {
+        Alarm(PRINT, "Priority_Flood_Batch_Add: hashing leaf failed\r\n");
+        return 0;
+    }
+    Sig_Batch.msg[i]      = scat;
+    Sig_Batch.mode[i]     = mode;
+    Sig_Batch.sign_ptr[i] = sign_ptr;
+    Sig_Batch.count++;
+
+    if (Sig_Batch.count == 1) {
+        timeout.sec  = Conf_Prio.Sig_Batch_USec / 1000000;
+        timeout.usec = Conf_Prio.Sig_Batch_USec % 1000000;
+        E_queue(Priority_Flood_Batch_Flush, 0, NULL, timeout);
+    } else if (Sig_Batch.count == PRIO_SIG_BATCH_MAX) {
+        E_queue(Priority_Flood_Batch_Flush, 0, NULL, zero_timeout);
+    }
+
+    return 1;
+}
+
+/***********************************************************/
+/* void Priority_Flood_Batch_Flush (int dummy1,            */
+/*                                  void *dummy2)          */
+/*                                                         */
+/* Signs the Merkle root of the current batch, writes the  */
+/*   root signature and each message's path into the       */
+/*   messages and sends them                               */
+/*                                                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* dummy1:   not used                                      */
+/* dummy2:   not used                                      */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Priority_Flood_Batch_Flush(int dummy1, void *dummy2)
+{
+    unsigned char    root[SEC_MERKLE_HASH_LEN];
+    unsigned char    sig[2048 / 8];     /* largest Signature_Len */
+    unsigned char   *tail_ptr;
+    unsigned int     sig_len = 0;
+    prio_batch_tail *tail;
+    sys_scatter     *scat;
+    int              i, ok, count = Sig_Batch.count;
+
+    E_dequeue(Priority_Flood_Batch_Flush, 0, NULL);
+    if (count == 0)
+        return;
+    Sig_Batch.count = 0;
+
+    Sec_merkle_build(Sig_Batch.tree, count, root);
+    ok = Sec_sign_root(root, sig, &sig_len, Priv_Key) == 1 && sig_len == Signature_Len;
+    if (!ok)
+        Alarm(PRINT, "Priority_Flood_Batch_Flush: signing root failed, "
+                     "dropping %d messages\r\n", count);
+
+    for (i = 0; i < count; i++) {
+        scat = Sig_Batch.msg[i];
+        if (ok) {
+            tail_ptr = Sig_Batch.sign_ptr[i];
+            memcpy(tail_ptr, sig, sig_len);
+            tail = (prio_batch_tail*)(tail_ptr + sig_len);
+            tail->leaf = i;
+            memset(tail + 1, 0, PRIO_SIG_BATCH_DEPTH * SEC_MERKLE_HASH_LEN);
+            tail->depth = Sec_merkle_path(Sig_Batch.tree, count, i, (unsigned char*)(tail + 1));
+            scat->elements[scat->num_elements-1].len += Prio_Signature_Len;
+
+            Injected_Messages++;
+            Deliver_and_Forward_Data(scat, Sig_Batch.mode[i], NULL);
+        }
+        Cleanup_Scatter(scat);
+    }
+}
+
+/***********************************************************/
+/* int Priority_Flood_Batch_Verify (EVP_MD_CTX *md_ctx,    */
+/*              unsigned char *sign_ptr, int32u src_id)    */
+/*                                                         */
+/* Verifies a message signed in a batch: the root is       */
+/*   recomputed from the message's path and only checked   */
+/*   against the signature if it is not one of src_id's    */
+/*   recently verified roots                               */
+/*                                                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* md_ctx:      SHA-256 digest of the signed contents      */
+/* sign_ptr:    the signature tail of the message          */
+/* src_id:      source of the message                      */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* 1 if the message verifies, otherwise not                */
+/*                                                         */
+/***********************************************************/
+int Priority_Flood_Batch_Verify(EVP_MD_CTX *md_ctx, unsigned char *sign_ptr, int32u src_id)
+{
+    unsigned char    leaf[SEC_MERKLE_HASH_LEN], root[SEC_MERKLE_HASH_LEN];
+    prio_batch_tail *tail = (prio_batch_tail*)(sign_ptr + Signature_Len);
+    Prio_Root_Cache *cache = &Verified_Roots[src_id];
+    int              i, ret;
+
+    if (tail->depth > PRIO_SIG_BATCH_DEPTH || tail->leaf >= (1 << tail->depth))
+        return 0;
+
+    if (Sec_merkle_leaf(md_ctx, leaf) != 1)
+        return -1;
+    Sec_merkle_root(leaf, tail->leaf, tail->depth, (unsigned char*)(tail + 1), root);
+
+    for (i = 0; i < PRIO_SIG_BATCH_ROOTS; i++)
+        if (memcmp(cache->root[i], root, SEC_MERKLE_HASH_LEN) == 0)
+            return 1;
+
+    ret = Sec_verify_root(root, sign_ptr, Signature_Len, Pub_Keys[src_id]);
+    if (ret == 1) {
+        memcpy(cache->root[cache->next], root, SEC_MERKLE_HASH_LEN);
+        cache->next = (cache->next + 1) % PRIO_SIG_BATCH_ROOTS;
+    }
+
+    return ret;
+}
+
 /**************************************************************/
 /* void Priority_Garbage_Collect (int32 dummy1, void *dummy2) */
 /*                                                            */
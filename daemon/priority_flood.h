@@ -39,6 +39,7 @@
 
 #include <openssl/engine.h>
 #include <openssl/evp.h>
+#include <openssl/sha.h>
 
 #include "arch.h"
 #include "spu_alarm.h"
@@ -64,16 +65,22 @@
 #include "multicast.h"
 #include "route.h"
 #include "multipath.h"
+#include "prio_queue.h"
 
 /* Parameters of Priority-Based Flooding */
 #define PRIO_CRYPTO                 0
-#define MAX_PRIORITY                10
 #define MAX_MESS_STORED             500
 #define MIN_BELLY_SIZE              1000000
 #define PRIO_DEFAULT_PLVL           1
 #define PRIO_DEFAULT_EXPIRE_SEC     600  /* 10 min */
 #define PRIO_DEFAULT_EXPIRE_USEC    0
 #define GARB_COLL_TO                60  /* 1 min */
+#define PRIO_SIG_BATCH_USEC         0   /* 0: sign every message */
+#define PRIO_SIG_BATCH_MAX          32  /* messages under one signed root */
+#define PRIO_SIG_BATCH_DEPTH        5   /* log2(PRIO_SIG_BATCH_MAX) */
+#define PRIO_SIG_BATCH_ROOTS        8   /* verified roots cached per source */
+#define PRIO_SIG_BATCH_TAIL_LEN     (sizeof(prio_batch_tail) + \
+                                     PRIO_SIG_BATCH_DEPTH * SHA256_DIGEST_LENGTH)
 
 typedef struct CONF_PRIO_d {
     unsigned char Crypto;
@@ -85,74 +92,15 @@ typedef struct CONF_PRIO_d {
     int32u        Default_Expire_Sec;
     int32u        Default_Expire_USec;
     int32u        Garbage_Collection_Sec;
+    int32u        Sig_Batch_USec;
 } CONF_PRIO;
 
-/* Message status */
-#define NEED_MSG            1
-#define RECV_MSG            2
-#define ON_LINK_MSG         3
-#define DROPPED_MSG         4
-#define EXPIRED_MSG         5
-#define NOT_IN_MASK         6
-
 /* ----------Per Node Data Structures---------- */
 typedef struct Prio_Flood_Key_d {
     int64u incarnation; /* Must maintain variable order here */
     int64u seq_num;
 } Prio_Flood_Key;
 
-typedef struct Prio_Neighbor_Status_d {
-    int32u flag;
-    struct Prio_PQ_Node_d *ngbr;
-} Prio_Neighbor_Status;
-
-typedef struct Prio_Flood_Value_d {
-    sp_time arrival;
-    sp_time expire;
-    sp_time origin_time;
-    int64u seq_num;
-    int32u priority;
-    int32u need_count;
-    int32u degree;
-    sys_scatter *msg_scat;
-    int32u msg_len;
-    int link_mode; /* The mode of the link from which this message was recieved */
-    Prio_Neighbor_Status *ns;
-} Prio_Flood_Value;
-
-/* -------Per Neighbor/Link Data Structures-------- */
-typedef struct Send_Fair_Queue_d {
-    int32u src_id;
-    int16u penalty;
-    struct Send_Fair_Queue_d *next;
-} Send_Fair_Queue;
-
-typedef struct Prio_PQ_Node_d {
-    sp_time timestamp;
-    struct Prio_PQ_Node_d *prev;
-    struct Prio_PQ_Node_d *next;
-    Prio_Flood_Value *entry;
-} Prio_PQ_Node;
-
-typedef struct Prio_PQ_d {
-    Prio_PQ_Node  head[MAX_PRIORITY + 1];
-    Prio_PQ_Node *tail[MAX_PRIORITY + 1];
-} Prio_PQ;
-
-typedef struct Prio_Link_Data_d {
-    int32u              total_msg;
-    int32u              msg_count[MAX_NODES + 1];
-    unsigned char       in_send_queue[MAX_NODES + 1];
-    int32u              max_pq[MAX_NODES + 1];
-    int32u              min_pq[MAX_NODES + 1];
-    Prio_PQ             pq[MAX_NODES + 1];
-    Send_Fair_Queue     norm_head;
-    Send_Fair_Queue     *norm_tail;
-    Send_Fair_Queue     urgent_head;
-    Send_Fair_Queue     *urgent_tail;
-    int64u              sent_messages;
-} Prio_Link_Data;
-
 #undef  ext
 #ifndef ext_prio_flood
 #define ext extern
@@ -189,4 +137,11 @@ int Fill_Packet_Header_Best_Effort_Flood( char* hdr );
 int Priority_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode); 
 int Priority_Flood_Send_One(Node *next_hop, int mode);
 
+/* Batch Signing Functions */
+int  Priority_Flood_Batch_Add(sys_scatter *scat, int mode, EVP_MD_CTX *md_ctx,
+                              unsigned char *sign_ptr);
+void Priority_Flood_Batch_Flush(int dummy1, void *dummy2);
+int  Priority_Flood_Batch_Verify(EVP_MD_CTX *md_ctx, unsigned char *sign_ptr, 
+                                 int32u src_id);
+
 #endif
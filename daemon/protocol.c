@@ -186,6 +186,11 @@ void Prot_process_scat(sys_scatter *scat, int total_bytes, Interface *local_inte
         }
 
         Check_Link_Loss(leg, pack_hdr->seq_no, mode);
+
+        /* Any packet tells fast failure detection the other side is up */
+        if (leg->live.active) {
+          leg->live.last_heard = E_get_time();
+        }
     }
 
     switch (mode) {
@@ -283,6 +288,14 @@ void Prot_process_scat(sys_scatter *scat, int total_bytes, Interface *local_inte
  
 	Process_RT_nack_packet(link, scat, type, mode);
 
+      } else if(Is_realtime_fec(pack_hdr->type)) {
+	Alarm(DEBUG, "\n\nprocess_realtime_fec: size: %d\n", total_bytes);
+
+	total_udp_pkts++;
+	total_udp_bytes += total_bytes;
+
+	Process_RT_FEC_packet(link, scat, type, mode);
+
       } else {
 	Alarm(PRINT, "Prot_process_scat: Unexpected msg type 0x%x for mode %d! Dropping!\r\n", pack_hdr->type, mode);
       }
@@ -69,6 +69,8 @@
 
 /* Global variables */
 
+CONF_RT_LINK Conf_RT_Link;
+
 extern Node     *This_Node;
 extern Node_ID   My_Address;
 extern stdhash   All_Nodes;
@@ -84,6 +86,58 @@ extern int       Unicast_Only;
 
 static const sp_time zero_timeout  = {     0,    0};
 
+/* Local variables */
+
+static sp_time rt_fec_flush_timeout;
+
+/* Local functions */
+
+static void RT_FEC_Add(Link *lk, char *buff, int16u len, int16u data_len);
+static void RT_FEC_Store(Realtime_Data *rt_data, rt_seq_type seq_no,
+                         char *buff, int16u len, int16u data_len);
+
+/***********************************************************/
+/* void RT_Link_Pre_Conf_Setup()                           */
+/*                                                         */
+/* Sets up the configuration file defaults for the         */
+/* Realtime Link                                           */
+/*                                                         */
+/* Return: NONE                                            */
+/*                                                         */
+/***********************************************************/
+
+void RT_Link_Pre_Conf_Setup()
+{
+    Conf_RT_Link.FEC               = RT_FEC;
+    Conf_RT_Link.FEC_Min_Block     = RT_FEC_MIN_BLOCK;
+    Conf_RT_Link.FEC_Max_Block     = RT_FEC_MAX_BLOCK_DEFAULT;
+    Conf_RT_Link.FEC_Flush_Timeout = RT_FEC_FLUSH_TIMEOUT;
+}
+
+/***********************************************************/
+/* void RT_Link_Post_Conf_Setup()                          */
+/*                                                         */
+/* Sets up timers after reading from the configuration     */
+/* file for the Realtime Link                              */
+/*                                                         */
+/* Return: NONE                                            */
+/*                                                         */
+/***********************************************************/
+
+void RT_Link_Post_Conf_Setup()
+{
+    if (Conf_RT_Link.FEC_Min_Block > Conf_RT_Link.FEC_Max_Block) {
+        Alarm(PRINT, "RT_Link_Post_Conf_Setup: RT_FECMinBlock (%u) > "
+              "RT_FECMaxBlock (%u), using %u for both\n",
+              Conf_RT_Link.FEC_Min_Block, Conf_RT_Link.FEC_Max_Block,
+              Conf_RT_Link.FEC_Max_Block);
+        Conf_RT_Link.FEC_Min_Block = Conf_RT_Link.FEC_Max_Block;
+    }
+
+    rt_fec_flush_timeout.sec  = Conf_RT_Link.FEC_Flush_Timeout / 1000000;
+    rt_fec_flush_timeout.usec = Conf_RT_Link.FEC_Flush_Timeout % 1000000;
+}
+
 /***********************************************************/
 /* Processes a Realtime UDP data packet                    */
 /*                                                         */
@@ -136,10 +190,6 @@ void Process_RT_UDP_data_packet(Link *lk, sys_scatter *scat,
     ack_len  = phdr->ack_len - Dissemination_Header_Size(routing);
     buff     = (char*) scat->elements[1].buf;
 
-    if (!Same_endian(type)) {
-      Flip_udp_hdr(hdr);
-    }
-    
     /* if (hdr->len + sizeof(udp_header) != data_len) {
       Alarm(PRINT, "Process_RT_UDP_data_packet: Packed data not available yet!\r\n");
       return;
@@ -162,6 +212,16 @@ void Process_RT_UDP_data_packet(Link *lk, sys_scatter *scat,
 	return;
     }
 
+    /* Keep the packet as it came off the wire (before any flipping or
+     * forwarding touches the buffer) in case the other side sends parity */
+    if(rt_data->fec_seen) {
+	RT_FEC_Store(rt_data, seq_no, buff, data_len + phdr->ack_len, data_len);
+    }
+
+    if (!Same_endian(type)) {
+      Flip_udp_hdr(hdr);
+    }
+
     now = E_get_time();
 
     /* Advance the receive tail if possible */
@@ -359,16 +419,28 @@ int Forward_RT_UDP_Data(Node *next_hop, sys_scatter *scat)
 	rt_data->bucket++;
     }
 
+    if(Conf_RT_Link.FEC) {
+	RT_FEC_Add(lk, rt_data->window[(rt_data->head-1)%MAX_HISTORY].buff,
+		   hdr->data_len + hdr->ack_len, hdr->data_len);
+    }
+
+    ret = 0;
     if(network_flag == 1) {
-      ret = Link_Send(lk, scat);
+      ret = Link_Send_Ref(lk, scat);
+    }
 
-      if(ret < 0) {
-        scat->elements[1].len -= lh_size;
-	    return BUFF_DROP;
-      }
+    /* Send the parity right behind the last packet of a full block,
+     * even if that packet could not be sent */
+    if(Conf_RT_Link.FEC && rt_data->fec_count >= rt_data->fec_block) {
+	E_dequeue(Send_RT_FEC, (int)lk->link_id, NULL);
+	Send_RT_FEC((int)lk->link_id, NULL);
     }
 
     scat->elements[1].len -= lh_size;
+
+    if(ret < 0) {
+	return BUFF_DROP;
+    }
     return BUFF_EMPTY;
 }
 
@@ -600,7 +672,7 @@ void Send_RT_Retransm(int linkid, void* dummy)
 	    *(rt_seq_type*)(buff+hdr.data_len) = seq_no;
     
 	    if(network_flag == 1) {
-	      ret = Link_Send(lk, &scat);
+	      ret = Link_Send_Ref(lk, &scat);
 
 	      if(ret < 0) {
 		break;
@@ -679,3 +751,409 @@ void Process_RT_nack_packet(Link *lk, sys_scatter *scat, int32u type, int mode)
 
     E_queue(Send_RT_Retransm, (int)lk->link_id, NULL, zero_timeout);
 }
+
+/***********************************************************/
+/* int RT_FEC_Block_Size(Link *lk)                         */
+/*                                                         */
+/* Picks the number of data packets covered by the next    */
+/* parity packet from the loss rate measured on the leg.   */
+/* The block is sized so that about RT_FEC_LOSS_TARGET     */
+/* packets of a block are expected to be lost, which keeps */
+/* two losses in the same block (that XOR parity cannot    */
+/* repair) rare                                            */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* lk:        the realtime link                            */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the block size                                    */
+/*                                                         */
+/***********************************************************/
+
+static int RT_FEC_Block_Size(Link *lk)
+{
+    Link         *ctrl_lk;
+    Control_Data *c_data;
+    float         loss;
+    int           block;
+
+    block = Conf_RT_Link.FEC_Max_Block;
+
+    ctrl_lk = lk->leg->links[CONTROL_LINK];
+    if (ctrl_lk == NULL || (c_data = (Control_Data*) ctrl_lk->prot_data) == NULL) {
+        return block;
+    }
+
+    loss = c_data->est_loss_rate;
+    if (loss > 0 && RT_FEC_LOSS_TARGET / loss < block) {
+        block = (int) (RT_FEC_LOSS_TARGET / loss);
+    }
+    if (block < (int) Conf_RT_Link.FEC_Min_Block) {
+        block = Conf_RT_Link.FEC_Min_Block;
+    }
+
+    return block;
+}
+
+/***********************************************************/
+/* void RT_FEC_Add(Link *lk, char *buff, int16u len,       */
+/*                 int16u data_len)                        */
+/*                                                         */
+/* XORs a data packet that is being sent into the parity   */
+/* of the current block, starting a new block if needed    */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* lk:        the realtime link                            */
+/* buff:      the packet, as it follows the packet_header  */
+/* len:       data_len + ack_len of the packet             */
+/* data_len:  data_len of the packet                       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void RT_FEC_Add(Link *lk, char *buff, int16u len, int16u data_len)
+{
+    Realtime_Data *rt_data;
+    char          *parity;
+    int            i;
+
+    rt_data = (Realtime_Data*) lk->prot_data;
+
+    /* A block covers consecutive packets: close the current one before
+     * a packet too large to cover, so the next block starts after it */
+    if (len > sizeof(packet_body) - sizeof(rt_fec_header)) {
+        Alarm(DEBUG, "RT_FEC_Add: packet too large to be covered (%u)\n", len);
+        if (rt_data->fec_count > 0) {
+            E_dequeue(Send_RT_FEC, (int)lk->link_id, NULL);
+            Send_RT_FEC((int)lk->link_id, NULL);
+        }
+        return;
+    }
+
+    if (rt_data->fec_buff == NULL) {
+        if ((rt_data->fec_buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+            Alarm(EXIT, "RT_FEC_Add: Could not allocate packet body obj\n");
+        }
+    }
+
+    if (rt_data->fec_count == 0) {
+        /* The packet was already added to the history at head-1 */
+        rt_data->fec_base     = rt_data->head - 1;
+        rt_data->fec_block    = RT_FEC_Block_Size(lk);
+        rt_data->fec_len      = 0;
+        rt_data->fec_data_len = 0;
+        memset(rt_data->fec_buff, 0, sizeof(packet_body));
+        E_queue(Send_RT_FEC, (int)lk->link_id, NULL, rt_fec_flush_timeout);
+    }
+
+    parity = rt_data->fec_buff + sizeof(rt_fec_header);
+    for (i = 0; i < len; i++) {
+        parity[i] ^= buff[i];
+    }
+
+    if (len > rt_data->fec_len) {
+        rt_data->fec_len = len;
+    }
+    rt_data->fec_data_len ^= data_len;
+    rt_data->fec_count++;
+}
+
+/***********************************************************/
+/* void Send_RT_FEC(int linkid, void* dummy)               */
+/*                                                         */
+/* Sends the parity of the current block, either because   */
+/* the block is full or because the flush timeout expired  */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* linkid:    ID of the link to send on                    */
+/* dummy:     Not used                                     */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Send_RT_FEC(int linkid, void* dummy)
+{
+    Link          *lk;
+    Realtime_Data *rt_data;
+    rt_fec_header *fhdr;
+    sys_scatter    scat;
+    packet_header  hdr;
+
+    if ((lk = Links[linkid]) == NULL || lk->link_type != REALTIME_UDP_LINK || (rt_data = (Realtime_Data*) lk->prot_data) == NULL) {
+	Alarm(EXIT, "Send_RT_FEC(): link not valid\n");
+	return;
+    }
+
+    if (rt_data->fec_count == 0) {
+        return;
+    }
+
+    fhdr           = (rt_fec_header*) rt_data->fec_buff;
+    fhdr->base_seq = rt_data->fec_base;
+    fhdr->count    = rt_data->fec_count;
+    fhdr->data_len = rt_data->fec_data_len;
+    fhdr->len      = rt_data->fec_len;
+    fhdr->padding  = 0;
+
+    scat.num_elements    = 2;
+    scat.elements[0].len = sizeof(packet_header);
+    scat.elements[0].buf = (char *)(&hdr);
+    scat.elements[1].len = sizeof(rt_fec_header) + rt_data->fec_len;
+    scat.elements[1].buf = rt_data->fec_buff;
+
+    hdr.type             = REALTIME_FEC_TYPE;
+    hdr.type             = Set_endian(hdr.type);
+
+    hdr.sender_id        = My_Address;
+    hdr.ctrl_link_id     = lk->leg->ctrl_link_id;
+    hdr.data_len         = scat.elements[1].len;
+    hdr.ack_len          = 0;
+    hdr.seq_no           = Set_Loss_SeqNo(lk->leg, REALTIME_UDP_LINK);
+
+    rt_data->fec_count = 0;
+
+    if(network_flag == 1) {
+      Link_Send(lk, &scat);
+    }
+}
+
+/***********************************************************/
+/* void RT_FEC_Store(Realtime_Data *rt_data,               */
+/*                   rt_seq_type seq_no, char *buff,       */
+/*                   int16u len, int16u data_len)          */
+/*                                                         */
+/* Keeps a copy of a received data packet so it can be     */
+/* XORed with a parity packet later                        */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* rt_data:   realtime data of the link                    */
+/* seq_no:    sequence of the packet on the link           */
+/* buff:      the packet, as it follows the packet_header  */
+/* len:       data_len + ack_len of the packet             */
+/* data_len:  data_len of the packet                       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void RT_FEC_Store(Realtime_Data *rt_data, rt_seq_type seq_no,
+                         char *buff, int16u len, int16u data_len)
+{
+    RT_FEC_Cell *cell;
+
+    if (len > sizeof(packet_body)) {
+        return;
+    }
+
+    cell = &rt_data->fec_window[seq_no % RT_FEC_RECV_WINDOW];
+    if (cell->buff == NULL) {
+        if ((cell->buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+            Alarm(EXIT, "RT_FEC_Store: Could not allocate packet body obj\n");
+        }
+    }
+
+    memcpy(cell->buff, buff, len);
+    cell->seq      = seq_no;
+    cell->len      = len;
+    cell->data_len = data_len;
+}
+
+/***********************************************************/
+/* void Process_RT_FEC_packet(Link *lk, sys_scatter *scat, */
+/*                            int32u type, int mode)       */
+/*                                                         */
+/* Processes a Realtime parity packet. If exactly one      */
+/* packet of the block it covers is missing, rebuilds that */
+/* packet from the parity and the other packets of the     */
+/* block, and processes it as if it had been received.     */
+/* Otherwise the NACKs already sent for the gap recover it */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* lk:        link the packet arrived on                   */
+/* scat:      sys_scatter containing the parity            */
+/* type:      type of the packet, containing endianess     */
+/* mode:      mode of the link                             */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Process_RT_FEC_packet(Link *lk, sys_scatter *scat, int32u type, int mode)
+{
+    packet_header  *phdr, rec_hdr;
+    rt_fec_header   fhdr;
+    Realtime_Data  *rt_data;
+    RT_FEC_Cell    *cell;
+    sys_scatter     rec_scat;
+    udp_header     *uhdr;
+    char           *parity, *rec_buff;
+    rt_seq_type     seq, missing_seq, rec_seq;
+    int16u          data_len, ack_len;
+    int             num_missing, j;
+
+    if (scat->num_elements != 2) {
+        Alarm(PRINT, "Process_RT_FEC_packet: Dropping packet because "
+            "scat->num_elements == %d instead of 2\r\n", scat->num_elements);
+        return;
+    }
+
+    phdr    = (packet_header*) scat->elements[0].buf;
+    rt_data = (Realtime_Data*) lk->prot_data;
+
+    if (phdr->data_len < sizeof(rt_fec_header)) {
+        Alarmp(SPLOG_WARNING, PRINT, "Process_RT_FEC_packet: Dropping packet because too small!\n");
+        return;
+    }
+
+    /* From now on keep copies of the data packets */
+    rt_data->fec_seen = 1;
+
+    memcpy(&fhdr, scat->elements[1].buf, sizeof(rt_fec_header));
+    if (!Same_endian(type)) {
+        fhdr.base_seq = Flip_int64(fhdr.base_seq);
+        fhdr.count    = Flip_int16(fhdr.count);
+        fhdr.data_len = Flip_int16(fhdr.data_len);
+        fhdr.len      = Flip_int16(fhdr.len);
+    }
+    parity = scat->elements[1].buf + sizeof(rt_fec_header);
+
+    if (fhdr.count == 0 || fhdr.count > RT_FEC_MAX_BLOCK ||
+        fhdr.len > phdr->data_len - sizeof(rt_fec_header)) {
+        Alarm(PRINT, "Process_RT_FEC_packet: Dropping malformed parity\n");
+        return;
+    }
+
+    /* Find the missing packet; give up unless it is the only one and we
+     * have kept all the others */
+    num_missing = 0;
+    missing_seq = 0;
+    for (seq = fhdr.base_seq; seq < fhdr.base_seq + fhdr.count; seq++) {
+        if (seq < rt_data->recv_tail) {
+            return;
+        }
+        if (seq < rt_data->recv_head &&
+            rt_data->recv_window[seq%MAX_HISTORY].flags != EMPTY_CELL) {
+            cell = &rt_data->fec_window[seq % RT_FEC_RECV_WINDOW];
+            if (cell->buff == NULL || cell->seq != seq || cell->len > fhdr.len) {
+                return;
+            }
+            continue;
+        }
+        missing_seq = seq;
+        if (++num_missing > 1) {
+            return;
+        }
+    }
+    if (num_missing == 0) {
+        return;
+    }
+
+    if ((rec_buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+        Alarm(EXIT, "Process_RT_FEC_packet: Could not allocate packet body obj\n");
+    }
+    memcpy(rec_buff, parity, fhdr.len);
+    data_len = fhdr.data_len;
+
+    for (seq = fhdr.base_seq; seq < fhdr.base_seq + fhdr.count; seq++) {
+        if (seq == missing_seq) {
+            continue;
+        }
+        cell = &rt_data->fec_window[seq % RT_FEC_RECV_WINDOW];
+        for (j = 0; j < cell->len; j++) {
+            rec_buff[j] ^= cell->buff[j];
+        }
+        data_len ^= cell->data_len;
+    }
+
+    /* Sanity check the rebuilt packet against its own sequence number */
+    if (data_len < sizeof(udp_header) ||
+        data_len + sizeof(rt_seq_type) > fhdr.len) {
+        Alarm(DEBUG, "Process_RT_FEC_packet: bad rebuilt length %u\n", data_len);
+        dec_ref_cnt(rec_buff);
+        return;
+    }
+    rec_seq = *(rt_seq_type*)(rec_buff + data_len);
+    if (!Same_endian(type)) {
+        rec_seq = Flip_int64(rec_seq);
+    }
+    if (rec_seq != missing_seq) {
+        Alarm(DEBUG, "Process_RT_FEC_packet: rebuilt seq %llu instead of %llu\n",
+              rec_seq, missing_seq);
+        dec_ref_cnt(rec_buff);
+        return;
+    }
+
+    uhdr    = (udp_header*) rec_buff;
+    ack_len = sizeof(rt_seq_type) +
+              Dissemination_Header_Size(uhdr->routing << ROUTING_BITS_SHIFT);
+    if (data_len + ack_len > fhdr.len) {
+        dec_ref_cnt(rec_buff);
+        return;
+    }
+
+    Alarm(DEBUG, "Process_RT_FEC_packet: recovered %llu\n", missing_seq);
+
+    rec_hdr          = *phdr;
+    rec_hdr.data_len = data_len;
+    rec_hdr.ack_len  = ack_len;
+
+    rec_scat.num_elements    = 2;
+    rec_scat.elements[0].len = sizeof(packet_header);
+    rec_scat.elements[0].buf = (char*) &rec_hdr;
+    rec_scat.elements[1].len = sizeof(packet_body);
+    rec_scat.elements[1].buf = rec_buff;
+
+    Process_RT_UDP_data_packet(lk, &rec_scat, type, mode);
+
+    dec_ref_cnt(rec_buff);
+}
+
+/***********************************************************/
+/* void Clean_RT_FEC(Realtime_Data *rt_data)               */
+/*                                                         */
+/* Releases the buffers used for forward error correction  */
+/* on a link that is being destroyed                       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* rt_data:   realtime data of the link                    */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Clean_RT_FEC(Realtime_Data *rt_data)
+{
+    int i;
+
+    if (rt_data->fec_buff != NULL) {
+        dec_ref_cnt(rt_data->fec_buff);
+        rt_data->fec_buff = NULL;
+    }
+    rt_data->fec_count = 0;
+
+    for (i = 0; i < RT_FEC_RECV_WINDOW; i++) {
+        if (rt_data->fec_window[i].buff != NULL) {
+            dec_ref_cnt(rt_data->fec_window[i].buff);
+            rt_data->fec_window[i].buff = NULL;
+        }
+    }
+}
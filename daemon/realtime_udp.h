@@ -43,6 +43,37 @@
 
 #define HISTORY_TIME 100000 /* 100 milliseconds */
 
+/* Parameters of Realtime Link forward error correction */
+#define RT_FEC                   0
+#define RT_FEC_MIN_BLOCK         4
+#define RT_FEC_MAX_BLOCK_DEFAULT 16
+#define RT_FEC_FLUSH_TIMEOUT     5000  /* 5 ms */
+#define RT_FEC_LOSS_TARGET       0.1   /* expected losses per parity block */
+
+typedef struct CONF_RT_LINK_d {
+    unsigned char FEC;
+    int32u        FEC_Min_Block;
+    int32u        FEC_Max_Block;
+    int32u        FEC_Flush_Timeout;
+} CONF_RT_LINK;
+
+extern CONF_RT_LINK Conf_RT_Link;
+
+/* This goes in front of the XOR parity of a block of realtime data
+ * packets. The parity covers, for each packet, the bytes following the
+ * packet_header (data_len + ack_len bytes) */
+typedef struct dummy_rt_fec_header {
+    rt_seq_type base_seq;  /* First data packet covered by this parity */
+    int16u      count;     /* Number of consecutive data packets covered */
+    int16u      data_len;  /* XOR of the data_len of the covered packets */
+    int16u      len;       /* Length of the parity that follows */
+    int16u      padding;
+} rt_fec_header;
+
+/* Configuration File Functions */
+void RT_Link_Pre_Conf_Setup();
+void RT_Link_Post_Conf_Setup();
+
 void Process_RT_UDP_data_packet(Link *lk, sys_scatter *scat,
 				int32u type, int mode);
 
@@ -56,4 +87,9 @@ void Send_RT_Retransm(int linkid, void* dummy);
 void Process_RT_nack_packet(Link *lk, sys_scatter *scat, 
 			    int32u type, int mode);
 
+void Send_RT_FEC(int linkid, void* dummy);
+void Process_RT_FEC_packet(Link *lk, sys_scatter *scat,
+			   int32u type, int mode);
+void Clean_RT_FEC(Realtime_Data *rt_data);
+
 #endif
@@ -97,7 +97,8 @@ int Reliable_Send_Msg(int16 linkid, char *buff, int16u buff_len, int32u pack_typ
     Buffer_Cell *buf_cell;
     char *p_nack;
     int16u ack_len;
-    sp_time timeout_val, sum_time, tmp_time, now;
+    int must_buffer;
+    sp_time timeout_val, sum_time, tmp_time, now, pace_delay;
 
     now = E_get_time();
 
@@ -134,9 +135,17 @@ int Reliable_Send_Msg(int16 linkid, char *buff, int16u buff_len, int32u pack_typ
     /* If there is no more room in the window, or the link is not valid yet, 
      * stick the message in the sending buffer */
 
-    if((r_data->head - r_data->tail >= r_data->window_size)||
-       (!stdcarr_empty(&r_data->msg_buff))||
-       (!(r_data->flags & CONNECTED_LINK))) {
+    must_buffer = ((r_data->head - r_data->tail >= r_data->window_size)||
+                   (!stdcarr_empty(&r_data->msg_buff))||
+                   (!(r_data->flags & CONNECTED_LINK)));
+
+    /* Same if the pacing rate does not allow another packet yet */
+    if(!must_buffer && !CC_Pace_Send(r_data, now, &pace_delay)) {
+        must_buffer = 1;
+        E_queue(Try_to_Send, (int)linkid, NULL, pace_delay);
+    }
+
+    if(must_buffer) {
 	if((buf_cell = (Buffer_Cell*) new(BUFFER_CELL))==NULL) {
 	    Alarm(EXIT, "Reliable_Send_Control_Msg(): Cannot allocate buffer cell\n");
 	}
@@ -152,10 +161,7 @@ int Reliable_Send_Msg(int16 linkid, char *buff, int16u buff_len, int32u pack_typ
 	 */
 	
 	if(stdcarr_size(&r_data->msg_buff) > MAX_BUFF_LINK) {
-	    if(Link_Sessions_Blocked_On == -1) {
-		Link_Sessions_Blocked_On = linkid;
-		Block_All_Sessions();
-	    }
+	    Block_Link_Sessions(linkid);
 	}
 
 	/* Alarm(PRINT, "buff: %d\n", stdcarr_size(&r_data->msg_buff)); */
@@ -184,6 +190,12 @@ int Reliable_Send_Msg(int16 linkid, char *buff, int16u buff_len, int32u pack_typ
 	    }
             */
 	}
+
+	/* Timed events are held back while packets keep coming in, so
+	 * do not count on Try_to_Send alone to release paced packets */
+	if(CC_Paced(r_data)) {
+	    Send_Much(linkid);
+	}
 	
 	return(0);
     }
@@ -281,7 +293,7 @@ int Reliable_Send_Msg(int16 linkid, char *buff, int16u buff_len, int32u pack_typ
 
     /* Sending the data */
     if(network_flag == 1) {
-      ret = Link_Send(lk, scat);
+      ret = Link_Send_Ref(lk, scat);
 
       Alarm(DEBUG, "Sent: data: %d; ack: %d; hdr: %d; total: %d\n",
 	    buff_len, ack_len, sizeof(packet_header), ret);
@@ -350,7 +362,7 @@ void Send_Much(int16 linkid)
     int buff_size;
     int ret;
     int32u i;
-    sp_time timeout_val, sum_time, tmp_time, now;
+    sp_time timeout_val, sum_time, tmp_time, now, pace_delay;
 
     now = E_get_time();
     /* Getting Link and protocol data from linkid */
@@ -403,6 +415,13 @@ void Send_Much(int16 linkid)
 	    break;
 	}
 
+	/* Stop if the pacing rate does not allow another packet yet,
+	 * and come back when it does */
+	if(!CC_Pace_Send(r_data, now, &pace_delay)) {
+	    E_queue(Try_to_Send, (int)linkid, NULL, pace_delay);
+	    break;
+	}
+
 	/* Take the first packet from the buffer (queue) and put it into the window */
 	stdcarr_begin(&(r_data->msg_buff), &it);
 	buf_cell = *((Buffer_Cell **)stdcarr_it_val(&it));
@@ -512,18 +531,15 @@ void Send_Much(int16 linkid)
 	scat.elements[1].buf = send_buff;
 
         /* Sending the data */
-	ret = Link_Send(Links[linkid], &scat);
+	ret = Link_Send_Ref(Links[linkid], &scat);
 
 	Alarm(DEBUG, "Sent: data: %d; ack: %d; hdr: %d; total: %d\n",
 	      data_len, ack_len, sizeof(packet_header), ret);
 	
     } 
 
-    if(Link_Sessions_Blocked_On == linkid) {
-	if(stdcarr_size(&(r_data->msg_buff)) < MAX_BUFF_LINK/4) {
-	    Resume_All_Sessions();
-	    Link_Sessions_Blocked_On = -1;
-	}
+    if(stdcarr_size(&(r_data->msg_buff)) < MAX_BUFF_LINK/4) {
+	Resume_Link_Sessions(linkid);
     }
 
 
@@ -754,17 +770,7 @@ void Reliable_timeout(int linkid, void *dummy)
     }
 
     /* Congestion control */
-    if (TCP_Fairness) {
-        r_data->ssthresh = (unsigned int)(r_data->window_size - stream_window/2);
-        if(r_data->ssthresh < (unsigned int)Minimum_Window)
-            r_data->ssthresh = Minimum_Window;
-
-        r_data->window_size = r_data->window_size - stream_window + 1;
-        if(r_data->window_size < Minimum_Window)
-            r_data->window_size = (float)Minimum_Window;
-       
-        Alarm(DEBUG, "window adjusted: %5.3f timeout; tail: %d\n", r_data->window_size, r_data->tail);
-    }
+    CC_On_Loss(r_data, CC_LOSS_TIMEOUT, stream_window, now);
 
     /* If there is already an ack to be sent on this link, cancel it, 
        as this packet will contain the ack info. */
@@ -867,7 +873,7 @@ void Reliable_timeout(int linkid, void *dummy)
 	
 	/* Sending the data */
         if(network_flag == 1) {
-	  ret = Link_Send(Links[linkid], scat);
+	  ret = Link_Send_Ref(Links[linkid], scat);
 
 	  Alarm(DEBUG, "Sent: data: %d; ack: %d; hdr: %d; total: %d\n",
 		data_len, ack_len, sizeof(packet_header), ret);
@@ -1000,22 +1006,12 @@ void Send_Nack_Retransm(int linkid, void *dummy)
 	stream_window = r_data->window_size;
     }
 
-    if (TCP_Fairness) {
-        if(r_data->cong_flag == 1) {
-            /* Congestion control */
-            r_data->ssthresh = (unsigned int)(r_data->window_size - stream_window/2);
-            if(r_data->ssthresh < (unsigned int)Minimum_Window) {
-                r_data->ssthresh = Minimum_Window;
-            }
-            r_data->window_size = r_data->window_size - stream_window/2;
-            if(r_data->window_size < Minimum_Window) {
-                r_data->window_size = (float)Minimum_Window;
-            }
-            Alarm(DEBUG, "window adjusted: %5.3f nack\n", r_data->window_size);
-        }
-        else {
-            r_data->cong_flag = 1;
-        }
+    if(r_data->cong_flag == 1) {
+        /* Congestion control */
+        CC_On_Loss(r_data, CC_LOSS_NACK, stream_window, now);
+    }
+    else {
+        r_data->cong_flag = 1;
     }
 
     /* If there is already an ack to be sent on this link, cancel it, 
@@ -1116,7 +1112,7 @@ void Send_Nack_Retransm(int linkid, void *dummy)
 
 	/* Sending the data */
         if(network_flag == 1) {
-	  ret = Link_Send(Links[linkid], scat);
+	  ret = Link_Send_Ref(Links[linkid], scat);
 
 	  Alarm(DEBUG, "^^^NACK answered: %d; len: %d; j: %d\n", 
 		nack_seq, r_data->nack_len, j);
@@ -1165,9 +1161,9 @@ int Process_Ack(int16 linkid, char *buff, int16u ack_len, int32u type)
     int32u i;
     sp_time timeout_val, now, diff;
     int32u rtt_estimate;
-    double old_window;
     int16u to_copy;
 
+    now = E_get_time();
     lk = Links[linkid];
     if(lk->r_data == NULL)
 	    Alarm(EXIT, "Process_Ack(): Reliable Data is not defined\n");
@@ -1229,13 +1225,14 @@ int Process_Ack(int16 linkid, char *buff, int16u ack_len, int32u type)
     }
 
     if(r_tail->cummulative_ack > r_data->tail) {
-	if(r_tail->cummulative_ack%10 == 0) {
+	if((r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].buff != NULL)&&
+	   (r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].resent == 0)) {
+	    diff = E_sub_time(now, r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].timestamp);
+	    rtt_estimate = diff.sec * 1000000 + diff.usec;
+	    CC_On_RTT_Sample(r_data, rtt_estimate, now);
+
 	    /* re-compute the RTT only every 10 packets */
-	    if((r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].buff != NULL)&&
-	       (r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].resent == 0)) {
-		now = E_get_time();
-		diff = E_sub_time(now, r_data->window[(r_tail->cummulative_ack-1)%MAX_WINDOW].timestamp);
-		rtt_estimate = diff.sec * 1000000 + diff.usec;
+	    if(r_tail->cummulative_ack%10 == 0) {
 		if(r_data->rtt == 0) {
 		    r_data->rtt = rtt_estimate;
 		}
@@ -1287,27 +1284,11 @@ int Process_Ack(int16 linkid, char *buff, int16u ack_len, int32u type)
 	    
 	    r_data->tail++;
 
-	    /* Congestion control */
-            if (TCP_Fairness) {
-                if(!stdcarr_empty(&(r_data->msg_buff))) {
-                    /* there are other packets waiting, so it makes sense to increase the window */
-                    old_window = r_data->window_size;
-                    if(r_data->window_size < r_data->ssthresh) {
-                        /* Slow start */
-                        r_data->window_size += 1;
-                        if(r_data->window_size > r_data->max_window) {
-                            r_data->window_size = (float)r_data->max_window;
-                        }
-                    }
-                    else {
-                        /* Congestion avoidance */
-                        r_data->window_size += 1/stream_window;
-                        if(r_data->window_size > r_data->max_window) {
-                            r_data->window_size = (float)r_data->max_window;
-                        }
-                    }
-                }
-            }
+	    /* Congestion control. Unless there are other packets waiting,
+	     * it makes no sense to increase the window */
+	    CC_On_Ack(r_data, stream_window,
+	              r_data->window[(r_data->tail-1)%MAX_WINDOW].timestamp,
+	              stdcarr_empty(&(r_data->msg_buff)) ? CC_ACK_APP_LIMITED : 0, now);
 	}		    
 	/* This was a fresh brand new ack. See if it freed some window slots
 	 * and we can send some more stuff */	
@@ -52,6 +52,8 @@
 #define ext_rel_flood
 #include "reliable_flood.h"
 #undef  ext_rel_flood
+#include "snapshot.h"
+#include "security.h"
 
 #ifndef ULLONG_MAX
 #define ULLONG_MAX 18446744073709551615ULL
@@ -135,6 +137,112 @@ void Copy_rel_flood_header( rel_flood_header *from_hdr,
     to_hdr->type        = from_hdr->type;
 }
 
+/***********************************************************/
+/* Flow buffers                                            */
+/*                                                         */
+/* A flow's buffer is allocated the first time the flow is */
+/* used, so memory grows with the flows that carry data    */
+/* rather than with (MAX_NODES + 1)^2. The status of each  */
+/* stored message toward each neighbor index is 2 bits in  */
+/* a word-aligned bitmap: bit 0 is set once sent, bit 1    */
+/* once restamped.                                         */
+/***********************************************************/
+static Flow_Buffer *RF_Flow_Buffer(int32u src_id, int32u dest_id)
+{
+    Flow_Buffer *fb;
+    int          k;
+
+    if ((fb = FB->flow[src_id][dest_id]) != NULL)
+        return fb;
+
+    fb = (Flow_Buffer*) Mem_alloc(sizeof(Flow_Buffer));
+    if (fb == NULL)
+        Alarm(EXIT, "RF_Flow_Buffer: Cannot allocate flow buffer for "
+                    "[%u,%u]\r\n", src_id, dest_id);
+    memset(fb->msg, 0, sizeof(fb->msg));
+    memset(fb->status, 0, sizeof(fb->status));
+    memset(fb->num_paths, 0, sizeof(fb->num_paths));
+    fb->sow       = 1;
+    fb->head_seq  = 1;
+    fb->src_epoch = 0;
+    for (k = 0; k <= MAX_NODES; k++)
+        fb->next_seq[k] = 1;
+
+    FB->flow[src_id][dest_id] = fb;
+    return fb;
+}
+
+static int RF_Status(Flow_Buffer *fb, int32u index, int32u ngbr)
+{
+    if (fb->msg[index] == NULL)
+        return EMPTY;
+    return NEW_UNSENT + (int) ((fb->status[index][ngbr / 32] >> 
+                                (2 * (ngbr % 32))) & 3);
+}
+
+static int RF_Status_Sent(Flow_Buffer *fb, int32u index, int32u ngbr)
+{
+    return fb->msg[index] != NULL && 
+        ((fb->status[index][ngbr / 32] >> (2 * (ngbr % 32))) & 1);
+}
+
+static void RF_Set_Status(Flow_Buffer *fb, int32u index, int32u ngbr, 
+                          int status)
+{
+    int64u code = (status == EMPTY) ? 0 : (int64u) (status - NEW_UNSENT);
+
+    fb->status[index][ngbr / 32] &= ~(((int64u) 3) << (2 * (ngbr % 32)));
+    fb->status[index][ngbr / 32] |= code << (2 * (ngbr % 32));
+}
+
+/* Returns the first neighbor index from 'from' up to our degree that
+ * was already sent the message in this slot, or -1. Scans the sent
+ * bits of a whole status word at a time */
+static int32 RF_Next_Status_Sent(Flow_Buffer *fb, int32u index, int32u from)
+{
+    int32u w = from / 32;
+    int64u bits;
+    int32u ngbr;
+
+    if (fb->msg[index] == NULL || from > Degree[My_ID])
+        return -1;
+
+    bits = fb->status[index][w] & 0x5555555555555555ULL & 
+        (~((int64u) 0) << (2 * (from % 32)));
+    while (bits == 0) {
+        if (++w >= RF_STATUS_WORDS || w * 32 > Degree[My_ID])
+            return -1;
+        bits = fb->status[index][w] & 0x5555555555555555ULL;
+    }
+
+    ngbr = w * 32 + RF_CTZ64(bits) / 2;
+    return (ngbr <= Degree[My_ID]) ? (int32) ngbr : -1;
+}
+
+/* Sets the status of this message toward every neighbor at once */
+static void RF_Set_Status_All(Flow_Buffer *fb, int32u index, int status)
+{
+    int64u code = (status == EMPTY) ? 0 : (int64u) (status - NEW_UNSENT);
+    int    w;
+
+    for (w = 0; w < RF_STATUS_WORDS; w++)
+        fb->status[index][w] = code * 0x5555555555555555ULL;
+}
+
+/* Marks the flow as having something to send toward the neighbor */
+static void RF_Queue_Flow(Rel_Flood_Link_Data *rfldata, int32u src_id,
+                          int32u dest_id, int urgent)
+{
+    int32u flow = src_id * (MAX_NODES + 1) + dest_id;
+
+    rfldata->in_flow_queue[src_id][dest_id] = 1;
+    rfldata->deficit[src_id][dest_id] = 0;
+    if (urgent)
+        RF_Ready_Set_Add(&rfldata->urgent, flow);
+    else
+        RF_Ready_Set_Add(&rfldata->ready, flow);
+}
+
 /***********************************************************/
 /* void Rel_Pre_Conf_Setup()                               */
 /*                                                         */
@@ -236,18 +344,20 @@ int Rel_Conf_hton(unsigned char *buff)
 /***********************************************************/
 void Init_Reliable_Flooding()
 {
-    int32u i, j, k, d;
+    int32u i, j, k;
     sp_time now = E_get_time();
     
+    /* Room for every possible neighbor: a configuration reload can add
+     * neighbors, and queued events hold pointers into this array */
     RF_Edge_Data = (Rel_Flood_Link_Data *)
-        Mem_alloc(sizeof(Rel_Flood_Link_Data) * (Degree[My_ID] + 1));
+        Mem_alloc(sizeof(Rel_Flood_Link_Data) * (MAX_NODES + 1));
 
     FB = (All_Flow_Buffers*) Mem_alloc(sizeof(All_Flow_Buffers));
 
     for (i = 0; i <= MAX_NODES; i++) {
         
         Flow_Seq_No[i] = 1;
-        Flow_Source_Epoch[i] = now.sec;
+        Flow_Source_Epoch[i] = (int32u) Snapshot_Epoch(now.sec);
         Handshake_Complete[i] = 0;
         E2E[i].dest = 0; /* if this is 0, there is no valid e2e there */
         E2E_Sig[i] = (unsigned char*) Mem_alloc(Rel_Signature_Len);
@@ -260,23 +370,7 @@ void Init_Reliable_Flooding()
         Sess_List[i].tail = &Sess_List[i].head;
         
         for (j = 0; j <= MAX_NODES; j++) {
-            FB->flow[i][j].sow      = 1;
-            FB->flow[i][j].next_seq = (int64u*)
-                Mem_alloc(sizeof(int64u) * (Degree[My_ID] + 1));
-            FB->flow[i][j].head_seq = 1;
-            FB->flow[i][j].src_epoch = 0;
-            for (k = 0; k < MAX_MESS_PER_FLOW; k++) {
-                FB->flow[i][j].msg[k] = NULL;
-                FB->flow[i][j].num_paths[k] = 0;
-                FB->flow[i][j].status[k] = (unsigned char*)
-                    Mem_alloc(sizeof(unsigned char) * (Degree[My_ID] + 1));
-                for (d = 0; d <= Degree[My_ID]; d++) {
-                    FB->flow[i][j].status[k][d] = EMPTY;
-                }
-            }
-            for (k = 0; k <= Degree[My_ID]; k++) {
-                FB->flow[i][j].next_seq[k] = 1;
-            }
+            FB->flow[i][j] = NULL;
             E2E[i].cell[j].aru = 0;
             E2E[i].cell[j].src_epoch = 0;
             E2E[i].cell[j].dest_epoch = 0;
@@ -290,7 +384,7 @@ void Init_Reliable_Flooding()
     
     /* This daemon automatically completes the handshake with itself */
     Handshake_Complete[My_ID] = 1;
-    FB->flow[My_ID][My_ID].src_epoch = Flow_Source_Epoch[My_ID];
+    RF_Flow_Buffer(My_ID, My_ID)->src_epoch = Flow_Source_Epoch[My_ID];
 
     E2E[My_ID].dest = My_ID;
     for (j = 0; j <= MAX_NODES; j++) {
@@ -302,17 +396,12 @@ void Init_Reliable_Flooding()
         Status_Change[My_ID].cell[Neighbor_IDs[My_ID][i]].cost = -1;
     }
 
-    for (i = 0; i <= Degree[My_ID]; i++) {
+    for (i = 0; i <= MAX_NODES; i++) {
         
-        RF_Edge_Data[i].norm_head.next = NULL;
-        RF_Edge_Data[i].norm_head.src_id = 0;
-        RF_Edge_Data[i].norm_head.dest_id = 0;
-        RF_Edge_Data[i].norm_tail = &RF_Edge_Data[i].norm_head;
-
-        RF_Edge_Data[i].urgent_head.next = NULL;
-        RF_Edge_Data[i].urgent_head.src_id = 0;
-        RF_Edge_Data[i].urgent_head.dest_id = 0;
-        RF_Edge_Data[i].urgent_tail = &RF_Edge_Data[i].urgent_head;
+        memset(&RF_Edge_Data[i].urgent, 0, sizeof(Flow_Ready_Set));
+        memset(&RF_Edge_Data[i].ready, 0, sizeof(Flow_Ready_Set));
+        RF_Edge_Data[i].urgent_cursor = 0;
+        RF_Edge_Data[i].ready_cursor = 0;
 
         RF_Edge_Data[i].hbh_unsent_head.next = NULL;
         RF_Edge_Data[i].hbh_unsent_head.src_id = 0;
@@ -344,6 +433,7 @@ void Init_Reliable_Flooding()
                 RF_Edge_Data[i].ns_matrix.flow_sow[j][k]   = 1;
                 RF_Edge_Data[i].unsent_state[j][k]         = 0;
                 RF_Edge_Data[i].in_flow_queue[j][k]        = 0;
+                RF_Edge_Data[i].deficit[j][k]              = 0;
             }
         }
     }
@@ -370,6 +460,50 @@ void Init_Reliable_Flooding()
     Alarm(DEBUG, "Created Reliable Flood Data Structures\n");
 }
 
+/***********************************************************/
+/* void Reliable_Flood_Add_Neighbors(int16u old_degree)    */
+/*                                                         */
+/* Grows the per-neighbor state of every flow after a      */
+/* configuration reload appended neighbors to our list.    */
+/* The new neighbors are owed every message still in the   */
+/* flow buffers.                                           */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* old_degree: number of neighbors before the reload       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Reliable_Flood_Add_Neighbors(int16u old_degree)
+{
+    int32u i, j, k, d;
+    Flow_Buffer *fb;
+
+    if (Degree[My_ID] <= old_degree)
+        return;
+
+    for (i = 0; i <= MAX_NODES; i++) {
+        for (j = 0; j <= MAX_NODES; j++) {
+            if ((fb = FB->flow[i][j]) == NULL)
+                continue;
+
+            for (d = old_degree + 1; d <= Degree[My_ID]; d++)
+                fb->next_seq[d] = fb->sow;
+
+            for (k = 0; k < MAX_MESS_PER_FLOW; k++) {
+                for (d = old_degree + 1; d <= Degree[My_ID]; d++)
+                    RF_Set_Status(fb, k, d, NEW_UNSENT);
+            }
+        }
+    }
+
+    for (d = old_degree + 1; d <= Degree[My_ID]; d++)
+        Status_Change[My_ID].cell[Neighbor_IDs[My_ID][d]].cost = -1;
+}
+
 void Reliable_Flood_Print_Stats(int dummy1, void *dummy2)
 {
     int i;
@@ -472,7 +606,7 @@ int Reliable_Flood_Can_Flow_Send (Session *ses, int32u dst)
         return 0;
     }
    
-    fb = &FB->flow[My_ID][dst];
+    fb = RF_Flow_Buffer(My_ID, dst);
     if (fb->head_seq < fb->sow + MAX_MESS_PER_FLOW && Flow_Source_Epoch[dst] == fb->src_epoch)
         return 1;
 
@@ -517,7 +651,7 @@ int Reliable_Flood_Block_Session (Session *ses, int32u dst)
         return 0;
     }
    
-    fb = &FB->flow[My_ID][dst];
+    fb = RF_Flow_Buffer(My_ID, dst);
     if (fb->head_seq < fb->sow + MAX_MESS_PER_FLOW && Flow_Source_Epoch[dst] == fb->src_epoch) {
         Alarm(PRINT, "Reliable_Flood_Block_Session: not blocking session, flow [%d,%d] has "
                         " space and completed handshake\r\n", My_ID, dst);
@@ -587,7 +721,7 @@ void Reliable_Flood_Resume_Sessions (int dst_id, void *dummy)
     if (dst_id < 1 || dst_id > MAX_NODES)
         return;
     
-    fb = &FB->flow[My_ID][dst_id];
+    fb = RF_Flow_Buffer(My_ID, dst_id);
     so = &Sess_List[dst_id].head;
 
     /* Start resuming sessions as long as there is room in flow */
@@ -847,8 +981,8 @@ int Reliable_Flood_Disseminate(Link *src_link, sys_scatter *scat, int mode)
         stdhash_find(&All_Nodes, &it, &Neighbor_Addrs[My_ID][i]);
         if (!stdhash_is_end(&All_Nodes, &it)) {
             nd = *((Node **)stdhash_it_val(&it));
-            while ((rfldata->norm_head.next != NULL ||
-                    rfldata->urgent_head.next != NULL) &&
+            while ((rfldata->urgent.summary != 0 ||
+                    rfldata->ready.summary != 0) &&
                    Request_Resources((IT_RELIABLE_ROUTING >>
                                       ROUTING_BITS_SHIFT), nd, mode, 
                         &Reliable_Flood_Send_One));
@@ -898,8 +1032,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
     unsigned char       *sign_start;
     Rel_Flood_Link_Data *rfldata;
     Flow_Buffer         *fb;
-    Flow_Queue          *temp_fq;
-    int64u              i, j, k, ngbr;
+    int64u              i, j, k;
     int32u              d, index;
     char                store_e2e = 0;
     sp_time             now, min_to;
@@ -959,7 +1092,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
         if (Flow_Seq_No[d] > 1) { /* If I have generated any packets to d, start over */
             now = E_get_time();
             Flow_Seq_No[d] = 1;
-            Flow_Source_Epoch[d] = now.sec;
+            Flow_Source_Epoch[d] = (int32u) Snapshot_Epoch(now.sec);
             E2E[My_ID].cell[d].dest_epoch = Flow_Source_Epoch[d];
         }
  
@@ -967,7 +1100,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
         E2E[My_ID].cell[d].src_epoch = e2e_new->cell[My_ID].dest_epoch;
         E2E[My_ID].cell[d].aru = 0;
 
-        fb = &FB->flow[d][My_ID];
+        fb = RF_Flow_Buffer(d, My_ID);
         fb->sow = 1;
         fb->head_seq = 1;
         for (i = 1; i <= Degree[My_ID]; i++)
@@ -997,7 +1130,20 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
 
     for (i = 1; i <= MAX_NODES; i++) {
 
-        fb = &FB->flow[i][d];
+        /* A flow this node never stored anything for and that the
+         * destination has not heard of either stays unallocated */
+        if (FB->flow[i][d] == NULL && e2e_new->cell[i].aru == 0 &&
+                e2e_new->cell[i].src_epoch == 0)
+        {
+            if (e2e_new->cell[i].dest_epoch > e2e_old->cell[i].dest_epoch) {
+                for (j = 1; j <= Degree[My_ID]; j++) {
+                    if (j != last_hop_index)
+                        RF_Edge_Data[j].e2e_stats[d].flow_block[i] = 1;
+                }
+            }
+            continue;
+        }
+        fb = RF_Flow_Buffer(i, d);
 
         /* The destination has changed epochs (maybe crashed and restarted). It is
          * safe for this node to clear all message memory for this flow because the
@@ -1012,8 +1158,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
                 index = k % MAX_MESS_PER_FLOW;
                 Cleanup_Scatter(fb->msg[index]);
                 fb->msg[index] = NULL;
-                for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                    fb->status[index][ngbr] = EMPTY;
+                RF_Set_Status_All(fb, index, EMPTY);
                 fb->num_paths[index] = 0;
             }
             /* Update head, tail, and next_to_send for each neighbor */
@@ -1022,8 +1167,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
             for (k = 1; k <= Degree[My_ID]; k++) {
                 fb->next_seq[k] = e2e_new->cell[i].aru + 1;
                 while (fb->next_seq[k] < fb->head_seq &&
-                       (fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == NEW_SENT ||
-                        fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[k] % MAX_MESS_PER_FLOW, k))
                 {
                     fb->next_seq[k]++;
                 }
@@ -1048,8 +1192,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
             for (k = 1; k <= Degree[My_ID]; k++) {
                 fb->next_seq[k] = e2e_new->cell[i].aru + 1;
                 while (fb->next_seq[k] < fb->head_seq &&
-                       (fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == NEW_SENT ||
-                        fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[k] % MAX_MESS_PER_FLOW, k))
                 {
                     fb->next_seq[k]++;
                 }
@@ -1074,8 +1217,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
                 if (fb->msg[index] != NULL) {
                     Cleanup_Scatter(fb->msg[index]);
                     fb->msg[index] = NULL;
-                    for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                        fb->status[index][ngbr] = EMPTY;
+                    RF_Set_Status_All(fb, index, EMPTY);
                     fb->num_paths[index] = 0;
                 }
                 e2e_cleared[i][d]++;
@@ -1090,8 +1232,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
                 if (fb->next_seq[k] < fb->sow)
                     fb->next_seq[k] = fb->sow;
                 while (fb->next_seq[k] < fb->head_seq &&
-                       (fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == NEW_SENT ||
-                        fb->status[fb->next_seq[k] % MAX_MESS_PER_FLOW][k] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[k] % MAX_MESS_PER_FLOW, k))
                 {
                     fb->next_seq[k]++;
                 }
@@ -1122,17 +1263,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
                             sizeof(rel_flood_header)), j)
                     )
             {
-                RF_Edge_Data[j].in_flow_queue[i][d] = 1;
-                temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-                if (temp_fq == NULL)
-                    Alarm(EXIT, "Reliable_Flood_Process_E2E: Can't allocate"
-                                "Flow Queue Node for in_flow_queue.\r\n");
-                temp_fq->src_id = i;
-                temp_fq->dest_id = d;
-                temp_fq->penalty = 1;
-                temp_fq->next = NULL;
-                RF_Edge_Data[j].norm_tail->next = temp_fq;
-                RF_Edge_Data[j].norm_tail = temp_fq;
+                RF_Queue_Flow(&RF_Edge_Data[j], i, d, 0);
             }
         }
     }
@@ -1168,7 +1299,7 @@ void Reliable_Flood_Process_E2E (int32u last_hop_index, sys_scatter *scat, int m
     memcpy(E2E_Sig[d], sign_start, Rel_Signature_Len);
 
     /* Potentially Resume Blocked Sessions */
-    fb = &FB->flow[My_ID][d];
+    fb = RF_Flow_Buffer(My_ID, d);
 
     if (Sess_List[d].size > 0 && fb->head_seq < fb->sow + MAX_MESS_PER_FLOW && 
             Handshake_Complete[d] == 1) 
@@ -1214,7 +1345,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
     Flow_Buffer         *fb;
     unsigned char       *routing_mask, *stored_mask; /*, *temp_mask;*/
     unsigned char       restamped_message = 0;
-    int64u              pre_loop;
+    int32               sent;
 
     hdr   = (udp_header*)(scat->elements[1].buf);
     r_hdr = (rel_flood_header*)(scat->elements[scat->num_elements-2].buf);
@@ -1222,7 +1353,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
                                       sizeof(rel_flood_header));
     index = r_hdr->seq_num % MAX_MESS_PER_FLOW;
 
-    fb = &FB->flow[src_id][dst_id];
+    fb = RF_Flow_Buffer(src_id, dst_id);
     if (Conf_Rel.E2E_Opt == 0 && E2E_Stop == 0)
         E2E_Stop = 1;
 
@@ -1285,17 +1416,16 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
         if ( !MultiPath_Is_Superset(stored_mask, routing_mask) ) {
             if (MultiPath_Is_Equal(stored_mask, routing_mask)) {
 
-                if (fb->status[index][last_hop_index] == NEW_UNSENT && Conf_Rel.HBH_Opt == 1)
-                    fb->status[index][last_hop_index] = NEW_SENT;
-                else if (fb->status[index][last_hop_index] == RESTAMPED_UNSENT && Conf_Rel.HBH_Opt == 1) {
+                if (RF_Status(fb, index, last_hop_index) == NEW_UNSENT && Conf_Rel.HBH_Opt == 1)
+                    RF_Set_Status(fb, index, last_hop_index, NEW_SENT);
+                else if (RF_Status(fb, index, last_hop_index) == RESTAMPED_UNSENT && Conf_Rel.HBH_Opt == 1) {
                     /* printf("seq %lu received from %d, set to RESTAMPED_SENT - Case 1\n", 
                             r_hdr->seq_num, Neighbor_IDs[My_ID][last_hop_index]); */
-                    fb->status[index][last_hop_index] = RESTAMPED_SENT;
+                    RF_Set_Status(fb, index, last_hop_index, RESTAMPED_SENT);
                 }
 
                 while (fb->next_seq[last_hop_index] < fb->head_seq &&
-                       (fb->status[fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW][last_hop_index] == NEW_SENT ||
-                        fb->status[fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW][last_hop_index] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW, last_hop_index))
                 {
                     fb->next_seq[last_hop_index]++;
                 }
@@ -1316,17 +1446,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
                 {
                     /* if (My_ID == 11 && last_hop_index == 1)
                         printf("NOOOO. Case A\n"); */
-                    rfldata->in_flow_queue[src_id][dst_id] = 1;
-                    temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-                    if (temp_fq == NULL)
-                        Alarm(EXIT, "Reliable_Flood_Process_Data(): Cannot allocate"
-                                    "Flow Queue Node for in_flow_queue.\r\n");
-                    temp_fq->src_id = src_id;
-                    temp_fq->dest_id = dst_id;
-                    temp_fq->penalty = 1;
-                    temp_fq->next = NULL;
-                    rfldata->urgent_tail->next = temp_fq;
-                    rfldata->urgent_tail = temp_fq;
+                    RF_Queue_Flow(rfldata, src_id, dst_id, 1);
                 }
 #endif
                 return NO_ROUTE;
@@ -1387,31 +1507,28 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
             inc_ref_cnt(scat->elements[i].buf);
         inc_ref_cnt(scat);
         fb->msg[index] = scat;
-        for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++) {
-
-            if (My_ID == 11 && ngbr == 1)
-                pre_loop = fb->next_seq[ngbr];
-
-            if      (restamped_message == 0 && Conf_Rel.HBH_Opt == 1 &&
-                       (ngbr == last_hop_index || Neighbor_IDs[My_ID][ngbr] == src_id))
-                fb->status[index][ngbr] = NEW_SENT;
-            else if (restamped_message == 0)
-                fb->status[index][ngbr] = NEW_UNSENT;
-            else if (restamped_message == 1 && Conf_Rel.HBH_Opt == 1 && 
-                        (ngbr == last_hop_index || Neighbor_IDs[My_ID][ngbr] == src_id))
-            {
-                /* printf("seq %lu received from %d, set to RESTAMPED_SENT toward %d, next_seq = %lu - Case 2\n", 
-                            r_hdr->seq_num, Neighbor_IDs[My_ID][last_hop_index], Neighbor_IDs[My_ID][ngbr],
-                            fb->next_seq[ngbr]); */
-                fb->status[index][ngbr] = RESTAMPED_SENT;
+
+        /* Unsent toward everyone, except (HBH_Opt) toward the neighbors
+         * that already have it */
+        RF_Set_Status_All(fb, index, 
+                          (restamped_message == 0) ? NEW_UNSENT : RESTAMPED_UNSENT);
+        if (Conf_Rel.HBH_Opt == 1) {
+            for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++) {
+                if (ngbr == last_hop_index || Neighbor_IDs[My_ID][ngbr] == src_id)
+                    RF_Set_Status(fb, index, ngbr, 
+                                  (restamped_message == 0) ? NEW_SENT : RESTAMPED_SENT);
             }
-            else if (restamped_message == 1)
-                fb->status[index][ngbr] = RESTAMPED_UNSENT;
-            while (fb->next_seq[ngbr] < fb->head_seq &&
-                   (fb->status[fb->next_seq[ngbr] % MAX_MESS_PER_FLOW][ngbr] == NEW_SENT ||
-                    fb->status[fb->next_seq[ngbr] % MAX_MESS_PER_FLOW][ngbr] == RESTAMPED_SENT))
+        }
+
+        /* The other slots did not change, so only a neighbor this message
+         * counts as sent to can move its next_seq */
+        for (sent = RF_Next_Status_Sent(fb, index, 1); sent != -1; 
+             sent = RF_Next_Status_Sent(fb, index, sent + 1)) 
+        {
+            while (fb->next_seq[sent] < fb->head_seq &&
+                   RF_Status_Sent(fb, fb->next_seq[sent] % MAX_MESS_PER_FLOW, sent))
             {
-                fb->next_seq[ngbr]++;
+                fb->next_seq[sent]++;
             }
         }
         if (last_hop_index == 0 && restamped_message == 0) 
@@ -1434,8 +1551,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
                 /* printf("Discarding message, location #4\n"); */
                 Cleanup_Scatter(fb->msg[fb->sow % MAX_MESS_PER_FLOW]);
                 fb->msg[fb->sow % MAX_MESS_PER_FLOW] = NULL;
-                for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                    fb->status[fb->sow % MAX_MESS_PER_FLOW][ngbr] = EMPTY;
+                RF_Set_Status_All(fb, fb->sow % MAX_MESS_PER_FLOW, EMPTY);
                 fb->num_paths[fb->sow % MAX_MESS_PER_FLOW] = 0;
                 fb->sow++;
                 hbh_cleared[src_id][dst_id]++;
@@ -1444,8 +1560,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
                 if (fb->next_seq[i] < fb->sow)
                     fb->next_seq[i] = fb->sow;
                 while (fb->next_seq[i] < fb->head_seq &&
-                       (fb->status[fb->next_seq[i] % MAX_MESS_PER_FLOW][i] == NEW_SENT ||
-                        fb->status[fb->next_seq[i] % MAX_MESS_PER_FLOW][i] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[i] % MAX_MESS_PER_FLOW, i))
                 {
                     fb->next_seq[i]++;
                 }
@@ -1455,8 +1570,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
             for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++) {
                 fb->next_seq[ngbr] = MIN(fb->next_seq[ngbr], r_hdr->seq_num);
                 while (fb->next_seq[ngbr] < fb->head_seq &&
-                       (fb->status[fb->next_seq[ngbr] % MAX_MESS_PER_FLOW][ngbr] == NEW_SENT ||
-                        fb->status[fb->next_seq[ngbr] % MAX_MESS_PER_FLOW][ngbr] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[ngbr] % MAX_MESS_PER_FLOW, ngbr))
                 {
                     fb->next_seq[ngbr]++;
                 }
@@ -1486,17 +1600,7 @@ int Reliable_Flood_Process_Data(int32u last_hop_index, int32u src_id,
                     /* dst_id != My_ID && */
                     MultiPath_Neighbor_On_Path(routing_mask,i))
         {
-            rfldata->in_flow_queue[src_id][dst_id] = 1;
-            temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-            if (temp_fq == NULL)
-                Alarm(EXIT, "Reliable_Flood_Process_Data(): Cannot allocate"
-                            "Flow Queue Node for in_flow_queue.\r\n");
-            temp_fq->src_id = src_id;
-            temp_fq->dest_id = dst_id;
-            temp_fq->penalty = 1;
-            temp_fq->next = NULL;
-            rfldata->urgent_tail->next = temp_fq;
-            rfldata->urgent_tail = temp_fq;
+            RF_Queue_Flow(rfldata, src_id, dst_id, 1);
         }
 
         /* Note that the state has changed, queue it to be sent to neighbor. */
@@ -1551,7 +1655,7 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
     rel_flood_tail      *rt;
     Rel_Flood_Link_Data *rfldata = &RF_Edge_Data[last_hop_index], *ngbr_data;
     rel_flood_hbh_ack   *ack;
-    int32u               src_id, dst_id, i, j, index, ngbr, idx;
+    int32u               src_id, dst_id, i, j, index, idx;
     int64u               min;
     Flow_Queue          *temp_fq;
     Flow_Buffer         *fb;
@@ -1579,7 +1683,7 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
             return NO_ROUTE;
         }
 
-        fb = &FB->flow[src_id][dst_id];
+        fb = RF_Flow_Buffer(src_id, dst_id);
         progress = 0;
 
         /* Make sure this hop-by-hop acknowledgement is for the current
@@ -1611,13 +1715,13 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
             idx = fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW;
             if (Conf_Rel.HBH_Opt == 1 && fb->next_seq[last_hop_index] <= ack->aru) {
                 while (fb->next_seq[last_hop_index] < fb->head_seq &&
-                        (fb->status[idx][last_hop_index] == NEW_SENT ||
-                         fb->status[idx][last_hop_index] == RESTAMPED_SENT ||
-                          (fb->status[idx][last_hop_index] == NEW_UNSENT &&
+                        (RF_Status(fb, idx, last_hop_index) == NEW_SENT ||
+                         RF_Status(fb, idx, last_hop_index) == RESTAMPED_SENT ||
+                          (RF_Status(fb, idx, last_hop_index) == NEW_UNSENT &&
                            fb->next_seq[last_hop_index] <= ack->aru) ) )
                 {
-                    if (fb->status[idx][last_hop_index] == NEW_UNSENT)
-                        fb->status[idx][last_hop_index] = NEW_SENT;
+                    if (RF_Status(fb, idx, last_hop_index) == NEW_UNSENT)
+                        RF_Set_Status(fb, idx, last_hop_index, NEW_SENT);
                     fb->next_seq[last_hop_index]++;
                     idx = fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW;
                 }
@@ -1649,8 +1753,7 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
                         /* printf("Discarding message, location #5\n"); */
                         Cleanup_Scatter(fb->msg[index]);
                         fb->msg[index] = NULL;
-                        for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                            fb->status[index][ngbr] = EMPTY;
+                        RF_Set_Status_All(fb, index, EMPTY);
                         fb->num_paths[index] = 0;
                     }
                     fb->sow++;
@@ -1669,8 +1772,7 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
                     if (fb->next_seq[j] < fb->sow)
                         fb->next_seq[j] = fb->sow;
                     while (fb->next_seq[j] < fb->head_seq &&
-                           (fb->status[fb->next_seq[j] % MAX_MESS_PER_FLOW][j] == NEW_SENT ||
-                            fb->status[fb->next_seq[j] % MAX_MESS_PER_FLOW][j] == RESTAMPED_SENT))
+                           RF_Status_Sent(fb, fb->next_seq[j] % MAX_MESS_PER_FLOW, j))
                     {
                         fb->next_seq[j]++;
                     }
@@ -1713,19 +1815,9 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
             /* if (My_ID == 11 && last_hop_index == 1)
                 printf("\tNOOOO. Case C. next_seq[1] = %lu, status = %d, head = %lu\n",
                             fb->next_seq[last_hop_index], 
-                            fb->status[fb->next_seq[last_hop_index]%MAX_MESS_PER_FLOW][last_hop_index], 
+                            RF_Status(fb, fb->next_seq[last_hop_index] % MAX_MESS_PER_FLOW, last_hop_index), 
                             fb->head_seq); */
-            rfldata->in_flow_queue[src_id][dst_id] = 1;
-            temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-            if (temp_fq == NULL)
-                Alarm(EXIT, "Reliable_Flood_Process_Data(): Cannot allocate"
-                            "Flow Queue Node for in_flow_queue.\r\n");
-            temp_fq->src_id = src_id;
-            temp_fq->dest_id = dst_id;
-            temp_fq->penalty = 1;
-            temp_fq->next = NULL;
-            rfldata->norm_tail->next = temp_fq;
-            rfldata->norm_tail = temp_fq;
+            RF_Queue_Flow(rfldata, src_id, dst_id, 0);
         }
     }
 
@@ -1755,6 +1847,7 @@ int Reliable_Flood_Process_Acks(int32u last_hop_index, sys_scatter *scat)
 void Reliable_Flood_Gen_E2E(int mode, void *dummy)
 {
     int i;
+    Flow_Buffer *fb;
     unsigned char progress = 0;
     Rel_Flood_Link_Data *rfldata;
     sp_time now;
@@ -1768,17 +1861,19 @@ void Reliable_Flood_Gen_E2E(int mode, void *dummy)
 
     if (Initial_E2E == 0) {
         for (i = 1; i <= MAX_NODES; i++) {
-            if (E2E[My_ID].cell[i].src_epoch == FB->flow[i][My_ID].src_epoch &&
-                E2E[My_ID].cell[i].aru < FB->flow[i][My_ID].head_seq - 1) 
+            if ((fb = FB->flow[i][My_ID]) == NULL)
+                continue;
+            if (E2E[My_ID].cell[i].src_epoch == fb->src_epoch &&
+                E2E[My_ID].cell[i].aru < fb->head_seq - 1) 
             {
-                E2E[My_ID].cell[i].aru = FB->flow[i][My_ID].head_seq - 1;
+                E2E[My_ID].cell[i].aru = fb->head_seq - 1;
                 progress = 1;
             }
-            else if (E2E[My_ID].cell[i].src_epoch == FB->flow[i][My_ID].src_epoch &&
-                     E2E[My_ID].cell[i].aru > FB->flow[i][My_ID].head_seq - 1)
+            else if (E2E[My_ID].cell[i].src_epoch == fb->src_epoch &&
+                     E2E[My_ID].cell[i].aru > fb->head_seq - 1)
                 Alarm(PRINT, "Reliable_Flood_Gen_E2E(): our aru (%"PRIu64") has"
                             "gone down since the last E2E (%"PRIu64")! Uh oh."
-                            "\r\n", FB->flow[i][My_ID].head_seq - 1, 
+                            "\r\n", fb->head_seq - 1, 
                             E2E[My_ID].cell[i].aru);
         }
         if (progress == 0) {
@@ -1837,7 +1932,6 @@ void Reliable_Flood_Neighbor_Transfer  (int mode, Link *lk)
     int64u                   i;
     unsigned char            progress;
     Flow_Buffer             *fb;
-    Flow_Queue              *temp_fq;
     int32u                   Neighbor_IP;
     Rel_Flood_Link_Data     *rfldata;
     sp_time                  now, min_to;
@@ -1850,8 +1944,8 @@ void Reliable_Flood_Neighbor_Transfer  (int mode, Link *lk)
     Alarm(PRINT, "*** INITIATING STATE TRANSFER TO "IPF" ***\n",
             IP(Neighbor_IP)); 
     /* Alarm(PRINT, "\tmy_sow = %"PRIu64",   my_aru = %"PRIu64",   "
-            "E2E_aru = %"PRIu64"\n", FB->flow[3][8].sow, 
-            FB->flow[3][8].head_seq - 1, E2E[8].aru[3]); */
+            "E2E_aru = %"PRIu64"\n", FB->flow[3][8]->sow, 
+            FB->flow[3][8]->head_seq - 1, E2E[8].aru[3]); */
 
     for (i = 1; i <= Degree[My_ID]; i++) {
         if (Neighbor_Addrs[My_ID][i] == Neighbor_IP) {
@@ -1923,20 +2017,20 @@ void Reliable_Flood_Neighbor_Transfer  (int mode, Link *lk)
 
         for (s = 1; s <= MAX_NODES; s++) {
             
-            fb = &FB->flow[s][d];
+            if ((fb = FB->flow[s][d]) == NULL)
+                continue;
 
             for (i = fb->sow; i < fb->head_seq; i++) {
-                if (fb->status[i % MAX_MESS_PER_FLOW][ngbr_index] == NEW_SENT)
-                    fb->status[i % MAX_MESS_PER_FLOW][ngbr_index] = NEW_UNSENT;
-                else if (fb->status[i % MAX_MESS_PER_FLOW][ngbr_index] == RESTAMPED_SENT)
-                    fb->status[i % MAX_MESS_PER_FLOW][ngbr_index] = RESTAMPED_UNSENT;
+                if (RF_Status(fb, i % MAX_MESS_PER_FLOW, ngbr_index) == NEW_SENT)
+                    RF_Set_Status(fb, i % MAX_MESS_PER_FLOW, ngbr_index, NEW_UNSENT);
+                else if (RF_Status(fb, i % MAX_MESS_PER_FLOW, ngbr_index) == RESTAMPED_SENT)
+                    RF_Set_Status(fb, i % MAX_MESS_PER_FLOW, ngbr_index, RESTAMPED_UNSENT);
             }
 
             /* fb->next_seq[ngbr_index] = MAX(fb->sow, E2E[d].cell[s].aru + 1); */
             fb->next_seq[ngbr_index] = fb->sow;
             /* while (fb->next_seq[ngbr_index] < fb->head_seq &&
-                   (fb->status[fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW][ngbr_index] == NEW_SENT ||
-                    fb->status[fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW][ngbr_index] == RESTAMPED_SENT))
+                   RF_Status_Sent(fb, fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW, ngbr_index))
             {
                 fb->next_seq[ngbr_index]++;
             } */
@@ -1949,17 +2043,7 @@ void Reliable_Flood_Neighbor_Transfer  (int mode, Link *lk)
                                 sizeof(rel_flood_header)), ngbr_index)
                ) 
             {
-                rfldata->in_flow_queue[s][d] = 1;
-                temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-                if (temp_fq == NULL)
-                    Alarm(EXIT, "Reliable_Flood_Neighbor_Transfer: Can't allocate"
-                                "Flow Queue Node for in_flow_queue.\r\n");
-                temp_fq->src_id = s;
-                temp_fq->dest_id = d;
-                temp_fq->penalty = 1;
-                temp_fq->next = NULL;
-                rfldata->urgent_tail->next = temp_fq;
-                rfldata->urgent_tail = temp_fq;
+                RF_Queue_Flow(rfldata, s, d, 1);
             }
         }
     }
@@ -2178,7 +2262,6 @@ int Reliable_Flood_Send_E2E (Node *next_hop, int ngbr_index, int mode)
     rel_flood_header    *r_hdr;
     rel_flood_tail      *rt;
     rel_flood_e2e_ack   *e2e;
-    Flow_Queue          *temp_fq;
     Flow_Buffer         *fb;
     int16u              ack_inc = 0, msg_len = 0, packets = 0, last_pkt_space = 0;
     int32u              index;
@@ -2295,7 +2378,7 @@ int Reliable_Flood_Send_E2E (Node *next_hop, int ngbr_index, int mode)
                 Alarm(PRINT, "RF_Send_E2E: SignUpdate failed on E2E Ack\r\n");
                 crypto_fail = 1;
             }
-            ret = EVP_SignFinal(md_ctx, (unsigned char*)E2E_Sig[My_ID], 
+            ret = Sec_sign_final(md_ctx, (unsigned char*)E2E_Sig[My_ID], 
                                 &sign_len, Priv_Key);
             if (ret != 1) {
                 Alarm(PRINT, "RF_Send_E2E: SignFinal failed\r\n");
@@ -2335,7 +2418,8 @@ int Reliable_Flood_Send_E2E (Node *next_hop, int ngbr_index, int mode)
      
         for (i = 1; i <= MAX_NODES; i++) {
             rfldata->e2e_stats[d].flow_block[i] = 0;
-            fb = &FB->flow[i][d];
+            if ((fb = FB->flow[i][d]) == NULL)
+                continue;
             index = fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW;
             if (rfldata->in_flow_queue[i][d] == 0 && 
                     fb->next_seq[ngbr_index] < fb->head_seq && 
@@ -2344,17 +2428,7 @@ int Reliable_Flood_Send_E2E (Node *next_hop, int ngbr_index, int mode)
                         sizeof(rel_flood_header)), ngbr_index)
                 )
             {
-                rfldata->in_flow_queue[i][d] = 1;
-                temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-                if (temp_fq == NULL)
-                    Alarm(EXIT, "Reliable_Flood_Send_E2E(): Cannot allocate"
-                                "Flow Queue Node for in_flow_queue.\r\n");
-                temp_fq->src_id = i;
-                temp_fq->dest_id = d;
-                temp_fq->penalty = 1;
-                temp_fq->next = NULL;
-                rfldata->norm_tail->next = temp_fq;
-                rfldata->norm_tail = temp_fq;
+                RF_Queue_Flow(rfldata, i, d, 0);
             }
         }
         if (ack_inc > 0) {
@@ -2417,149 +2491,89 @@ int Reliable_Flood_Send_E2E (Node *next_hop, int ngbr_index, int mode)
 /************************************************************/
 int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
 {
-    int64u              ngbr_aru, ngbr_sow;
+    int64u              ngbr_sow;
     int16u              msg_len = 0, ack_inc = 0, packets = 0, last_pkt_space = 0;
     int                 i, ret, sent_one = 0, j, min, progress = 0;
     int32u              index, ngbr;
     Rel_Flood_Link_Data *rfldata, *ngbr_data;
     rel_flood_tail      *rt;
-    Flow_Queue          *temp_fq, *progress_fq;
+    Flow_Queue          *progress_fq;
+    Flow_Ready_Set      *set;
     Flow_Buffer         *fb;
     sys_scatter         *scat;
     unsigned char       *mask;
+    int32               flow;
+    int32u              src_id, dest_id;
+    int                 urgent;
 
     assert(ngbr_index >= 1 && ngbr_index <= Degree[My_ID]);
     rfldata = &RF_Edge_Data[ngbr_index];
     
     while (!sent_one) {
         
-        temp_fq = NULL;
-
-        /* first, check the urgent flow queue */
-        if (rfldata->urgent_head.next != NULL) {
-            temp_fq = rfldata->urgent_head.next;
-            temp_fq->penalty--;
-
-            ngbr_aru = rfldata->ns_matrix.
-                        flow_aru[temp_fq->src_id][temp_fq->dest_id];
-            ngbr_sow = rfldata->ns_matrix.
-                        flow_sow[temp_fq->src_id][temp_fq->dest_id];
-            fb = &FB->flow[temp_fq->src_id][temp_fq->dest_id];
-            index = fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW;
-
-            /* if this flow hasn't finished paying its penalty or 
-             * this flow towards this neighbor is blocked
-             * or we don't have anything to send on this flow
-             * towards this neighbor, or an End-to-end ack must
-             * go first, or this node is the source and is still
-             * waiting for a handshake to complete with this
-             * destination, then move this node
-             * to the normal queue.  OR... 
-             * 
-             * the last 5 lines are for K-paths. The first part assigns a 
-             *    pointer to the packet to determine the client-given data
-             *    length. Then, we check if the next packet for the flow toward
-             *    this neighbor is marked on the packet's bitmask for this 
-             *    neighbor. If not, move to the back of the queue */
-            /* TODO: I think we need to add a condition here
-             * to check if next_seq < ngbr_sow */
-            if (temp_fq->penalty > 0 ||
-                fb->next_seq[ngbr_index] >= ngbr_sow + MAX_MESS_PER_FLOW ||
-                fb->head_seq <= fb->next_seq[ngbr_index] || 
-                rfldata->e2e_stats[temp_fq->dest_id].
-                    flow_block[temp_fq->src_id] == 1 ||
-                (My_ID == temp_fq->src_id &&
-                    Handshake_Complete[temp_fq->dest_id] == 0) ||
-                !MultiPath_Neighbor_On_Path((unsigned char*)(
-                    fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf + 
-                    sizeof(rel_flood_header)), ngbr_index)
-               )
-            {
-                rfldata->urgent_head.next = rfldata->urgent_head.next->next;
-                if(rfldata->urgent_tail == temp_fq)
-                    rfldata->urgent_tail = &rfldata->urgent_head;
-                /* move to back of normal queue */
-                temp_fq->next = NULL;
-                rfldata->norm_tail->next = temp_fq;
-                rfldata->norm_tail = temp_fq;
-                continue;
-            }
+        /* first, check the urgent flows, then the others round-robin */
+        urgent = 1;
+        set = &rfldata->urgent;
+        if ((flow = RF_Ready_Set_Next(set, rfldata->urgent_cursor)) < 0) {
+            urgent = 0;
+            set = &rfldata->ready;
+            /* else no flow has anything to send to this neighbor */
+            if ((flow = RF_Ready_Set_Next(set, rfldata->ready_cursor)) < 0)
+                return 0;
         }
-        /* next, check normal_head if the urgent was empty */
-        else if (rfldata->norm_head.next != NULL) {
-            temp_fq = rfldata->norm_head.next;
-            temp_fq->penalty--;
-            
-            ngbr_aru = rfldata->ns_matrix.
-                        flow_aru[temp_fq->src_id][temp_fq->dest_id];
-            ngbr_sow = rfldata->ns_matrix.
-                        flow_sow[temp_fq->src_id][temp_fq->dest_id];
-            fb = &FB->flow[temp_fq->src_id][temp_fq->dest_id];
-            index = fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW;
-            
-            /* if this flow hasn't finished paying its penalty or 
-             * this flow towards this neighbor is blocked
-             * or we don't have anything to send on this flow
-             * towards this neighbor, or an End-to-end ack must
-             * go first, or this node is the source and is still
-             * waiting for a handshake to complete with this
-             * destination, then delete this node. OR... 
-             * 
-             * the last 5 lines are for K-paths. The first part assigns a 
-             *    pointer to the packet to determine the client-given data
-             *    length. Then, we check if the next packet for the flow toward
-             *    this neighbor is marked on the packet's bitmask for this 
-             *    neighbor. If not, delete from normal queue */
-            /* TODO: I think we need to add a condition here
-             * to check if next_seq < ngbr_sow */
-            if (temp_fq->penalty > 0) {
-                rfldata->norm_head.next = rfldata->norm_head.next->next;
-                if (rfldata->norm_head.next == NULL)
-                    rfldata->norm_tail = &rfldata->norm_head;
-                temp_fq->next = NULL;
-                rfldata->norm_tail->next = temp_fq;
-                rfldata->norm_tail = temp_fq;
-                continue;
-
+        src_id  = flow / (MAX_NODES + 1);
+        dest_id = flow % (MAX_NODES + 1);
+
+        /* a flow that sent a message of several packets sits out that
+         * many rounds (less one) of the other flows */
+        if (rfldata->deficit[src_id][dest_id] > 0) {
+            rfldata->deficit[src_id][dest_id]--;
+            if (urgent) {
+                RF_Ready_Set_Remove(set, flow);
+                RF_Ready_Set_Add(&rfldata->ready, flow);
             }
-            else if (fb->next_seq[ngbr_index] >= ngbr_sow + MAX_MESS_PER_FLOW ||
-                fb->head_seq <= fb->next_seq[ngbr_index] || 
-                rfldata->e2e_stats[temp_fq->dest_id].
-                    flow_block[temp_fq->src_id] == 1 ||
-                (My_ID == temp_fq->src_id &&
-                    Handshake_Complete[temp_fq->dest_id] == 0) ||
-                !MultiPath_Neighbor_On_Path((unsigned char*)(
-                    fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf + 
-                    sizeof(rel_flood_header)), ngbr_index)
-               )
-            {
-                /* printf("Failed to send a packet towards neighbor %d because: ", Neighbor_IDs[My_ID][ngbr_index]);
-                if (fb->next_seq[ngbr_index] >= ngbr_sow + MAX_MESS_PER_FLOW)
-                    printf("Case 1");
-                else if (fb->head_seq <= fb->next_seq[ngbr_index])
-                    printf("Case 2: head = %lu, next_seq = %lu", fb->head_seq, fb->next_seq[ngbr_index]);
-                else if (rfldata->e2e_stats[temp_fq->dest_id].flow_block[temp_fq->src_id] == 1)
-                    printf("Case 3");
-                else if (My_ID == temp_fq->src_id && Handshake_Complete[temp_fq->dest_id] == 0)
-                    printf("Case 4");
-                else if (!MultiPath_Neighbor_On_Path((unsigned char*)(fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf + sizeof(rel_flood_header)), ngbr_index))
-                    printf("Case 5");
-                printf("\n"); */
-                rfldata->norm_head.next = rfldata->norm_head.next->next;
-                if (rfldata->norm_head.next == NULL)
-                    rfldata->norm_tail = &rfldata->norm_head;
-                rfldata->in_flow_queue[temp_fq->src_id][temp_fq->dest_id] = 0;
-                dispose(temp_fq);
-                continue;
+            else {
+                rfldata->ready_cursor = (flow + 1) % RF_FLOWS;
             }
+            continue;
         }
-        /* else no flow has anything to send to this neighbor */
-        else {
-            return 0;
+
+        ngbr_sow = rfldata->ns_matrix.flow_sow[src_id][dest_id];
+        fb = RF_Flow_Buffer(src_id, dest_id);
+        index = fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW;
+
+        /* if this flow towards this neighbor is blocked
+         * or we don't have anything to send on this flow
+         * towards this neighbor, or an End-to-end ack must
+         * go first, or this node is the source and is still
+         * waiting for a handshake to complete with this
+         * destination, then an urgent flow moves to the
+         * other flows and any other flow leaves the set until
+         * something makes it sendable again. OR... 
+         * 
+         * the last 3 lines are for K-paths. We check if the next
+         *    packet for the flow toward this neighbor is marked on
+         *    the packet's bitmask for this neighbor. */
+        /* TODO: I think we need to add a condition here
+         * to check if next_seq < ngbr_sow */
+        if (fb->next_seq[ngbr_index] >= ngbr_sow + MAX_MESS_PER_FLOW ||
+            fb->head_seq <= fb->next_seq[ngbr_index] || 
+            rfldata->e2e_stats[dest_id].flow_block[src_id] == 1 ||
+            (My_ID == src_id && Handshake_Complete[dest_id] == 0) ||
+            !MultiPath_Neighbor_On_Path((unsigned char*)(
+                fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf + 
+                sizeof(rel_flood_header)), ngbr_index)
+           )
+        {
+            RF_Ready_Set_Remove(set, flow);
+            if (urgent)
+                RF_Ready_Set_Add(&rfldata->ready, flow);
+            else
+                rfldata->in_flow_queue[src_id][dest_id] = 0;
+            continue;
         }
             
         /* Now, we send the next message for this flow */
-        fb = &FB->flow[temp_fq->src_id][temp_fq->dest_id];
         index = fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW;
         assert(fb->msg[index] != NULL);
 
@@ -2597,9 +2611,11 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
             Alarm(PRINT, "Reliable_Flood_Send_Data(): got an invalid "
                          "return from Forward_Data = %d\r\n", ret);
             /* printf("SENDING DATA #%d FOR %d-%d TO "IPF"\n",
-                       fb->next_seq[ngbr_index], temp_fq->src_id, 
-                       temp_fq->dest_id, IP(Neighbor_Addrs[My_ID][ngbr_index])); */
-            temp_fq->penalty++;
+                       fb->next_seq[ngbr_index], src_id, 
+                       dest_id, IP(Neighbor_Addrs[My_ID][ngbr_index])); */
+            /* try this flow first again next time */
+            if (!urgent)
+                rfldata->ready_cursor = flow;
             return 0;
         }
 
@@ -2612,44 +2628,34 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
                         rel_fl_hbh_ack_timeout);             
         }
 
-        /* cleanup the send_fair_queue */
-        if (temp_fq == rfldata->urgent_head.next) {
-            rfldata->urgent_head.next = rfldata->urgent_head.next->next;
-            if(rfldata->urgent_tail == temp_fq)
-                rfldata->urgent_tail = &rfldata->urgent_head;
+        /* an urgent flow joins the other flows, and the next of the
+         * other flows gets the next turn */
+        if (urgent) {
+            RF_Ready_Set_Remove(set, flow);
+            RF_Ready_Set_Add(&rfldata->ready, flow);
+            rfldata->urgent_cursor = (flow + 1) % RF_FLOWS;
         }
-        else if (temp_fq == rfldata->norm_head.next) {
-            rfldata->norm_head.next = rfldata->norm_head.next->next;
-            if(rfldata->norm_tail == temp_fq)
-                rfldata->norm_tail = &rfldata->norm_head;
-        } 
-        else { /* error */
-            Alarm(PRINT, "Reliable_Flood_Send_Data(): send_fair_queue \
-                            node not possible\r\n");
+        else {
+            rfldata->ready_cursor = (flow + 1) % RF_FLOWS;
         }
-
-        /* move to back of normal queue */
-        temp_fq->penalty = packets;
-        temp_fq->next = NULL;
-        rfldata->norm_tail->next = temp_fq;
-        rfldata->norm_tail = temp_fq;
+        rfldata->deficit[src_id][dest_id] = (packets > 0 ? packets - 1 : 0);
 
         /* Update the status of this message toward the neighbor as sent */
-        if (fb->status[index][ngbr_index] == NEW_UNSENT)
-            fb->status[index][ngbr_index] = NEW_SENT;
-        else if (fb->status[index][ngbr_index] == RESTAMPED_UNSENT) {
+        if (RF_Status(fb, index, ngbr_index) == NEW_UNSENT)
+            RF_Set_Status(fb, index, ngbr_index, NEW_SENT);
+        else if (RF_Status(fb, index, ngbr_index) == RESTAMPED_UNSENT) {
             /* printf("SENT seq %lu to %d. head = %lu, this_msg_status = %d, next_msg_status = %d\n", 
                     fb->next_seq[ngbr_index], Neighbor_IDs[My_ID][ngbr_index], fb->head_seq,
-                    fb->status[index][ngbr_index], 
-                    fb->status[(index+1)%MAX_MESS_PER_FLOW][ngbr_index]); */
+                    RF_Status(fb, index, ngbr_index), 
+                    RF_Status(fb, (index+1)%MAX_MESS_PER_FLOW, ngbr_index)); */
             /* printf("seq %lu sent to %d and set to RESTAMPED_SENT - Case 3\n", 
                         fb->next_seq[ngbr_index], Neighbor_IDs[My_ID][ngbr_index]); */
-            fb->status[index][ngbr_index] = RESTAMPED_SENT;
+            RF_Set_Status(fb, index, ngbr_index, RESTAMPED_SENT);
         }
         else {
             Alarm(PRINT, "Reliable_Flood_Send_Data(): Error - invalid status"
                             " (%d) of message %lu toward neighbor %d, head = %lu\r\n", 
-                            fb->status[index][ngbr_index], fb->next_seq[ngbr_index], 
+                            RF_Status(fb, index, ngbr_index), fb->next_seq[ngbr_index], 
                             ngbr_index, fb->head_seq);
             mask = (unsigned char*)(fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf + 
                                       sizeof(rel_flood_header));
@@ -2661,8 +2667,7 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
         }
 
         while (fb->next_seq[ngbr_index] < fb->head_seq &&
-               (fb->status[fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW][ngbr_index] == NEW_SENT ||
-                fb->status[fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW][ngbr_index] == RESTAMPED_SENT))
+               RF_Status_Sent(fb, fb->next_seq[ngbr_index] % MAX_MESS_PER_FLOW, ngbr_index))
         {
             fb->next_seq[ngbr_index]++;
         }
@@ -2674,8 +2679,8 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
              * for this flow up to */
             min = fb->head_seq - 1;
             for( j = 1; j <= Degree[My_ID]; j++) {
-                if (RF_Edge_Data[j].ns_matrix.flow_aru[temp_fq->src_id][temp_fq->dest_id] < min)
-                    min = RF_Edge_Data[j].ns_matrix.flow_aru[temp_fq->src_id][temp_fq->dest_id];
+                if (RF_Edge_Data[j].ns_matrix.flow_aru[src_id][dest_id] < min)
+                    min = RF_Edge_Data[j].ns_matrix.flow_aru[src_id][dest_id];
                 if (fb->next_seq[j] - 1 < min)
                     min = fb->next_seq[j] - 1;
             }
@@ -2691,18 +2696,17 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
                 if (fb->msg[index] != NULL) {
                     Cleanup_Scatter(fb->msg[index]);
                     fb->msg[index] = NULL;
-                    for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                        fb->status[index][ngbr] = EMPTY;
+                    RF_Set_Status_All(fb, index, EMPTY);
                     fb->num_paths[index] = 0;
                 }
                 fb->sow++;
-                hbh_cleared[temp_fq->src_id][temp_fq->dest_id]++;
+                hbh_cleared[src_id][dest_id]++;
             }
 
             /* Check if we made progress and things have become unblocked */
-            if (progress == 1 && Sess_List[temp_fq->dest_id].size > 0 &&
-                    temp_fq->src_id == My_ID)
-                E_queue(Reliable_Flood_Resume_Sessions, temp_fq->dest_id, NULL, zero_timeout);
+            if (progress == 1 && Sess_List[dest_id].size > 0 &&
+                    src_id == My_ID)
+                E_queue(Reliable_Flood_Resume_Sessions, dest_id, NULL, zero_timeout);
 
             for (j = 1; j <= Degree[My_ID]; j++) {
                 /* If our sow moved up past an out of date next_seq index,
@@ -2710,8 +2714,7 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
                 if (fb->next_seq[j] < fb->sow)
                     fb->next_seq[j] = fb->sow;
                 while (fb->next_seq[j] < fb->head_seq &&
-                       (fb->status[fb->next_seq[j] % MAX_MESS_PER_FLOW][j] == NEW_SENT ||
-                        fb->status[fb->next_seq[j] % MAX_MESS_PER_FLOW][j] == RESTAMPED_SENT))
+                       RF_Status_Sent(fb, fb->next_seq[j] % MAX_MESS_PER_FLOW, j))
                 {
                     fb->next_seq[j]++;
                 }
@@ -2724,15 +2727,15 @@ int Reliable_Flood_Send_Data( Node *next_hop, int ngbr_index, int mode )
                     ngbr_data->saa_trigger++;
 
                 if (progress == 1 &&
-                        ngbr_data->unsent_state[temp_fq->src_id][temp_fq->dest_id] == 0)
+                        ngbr_data->unsent_state[src_id][dest_id] == 0)
                 {
-                    ngbr_data->unsent_state[temp_fq->src_id][temp_fq->dest_id] = 1;
+                    ngbr_data->unsent_state[src_id][dest_id] = 1;
                     progress_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
                     if (progress_fq == NULL)
                         Alarm(EXIT, "Reliable_Flood_Send_Data(): Cannot"
                             "allocate Flow Queue Node for unsent_state.\r\n");
-                    progress_fq->src_id = temp_fq->src_id;
-                    progress_fq->dest_id = temp_fq->dest_id;
+                    progress_fq->src_id = src_id;
+                    progress_fq->dest_id = dest_id;
                     progress_fq->next = NULL;
                     ngbr_data->hbh_unsent_tail->next = progress_fq;
                     ngbr_data->hbh_unsent_tail = progress_fq;
@@ -2903,7 +2906,7 @@ int Reliable_Flood_Add_Acks (rel_flood_tail *rt, int ngbr_index, int16u remainin
         if (temp_fq->next == NULL)
             rfldata->hbh_unsent_tail = &rfldata->hbh_unsent_head;
         
-        fb = &FB->flow[temp_fq->src_id][temp_fq->dest_id];
+        fb = RF_Flow_Buffer(temp_fq->src_id, temp_fq->dest_id);
 
         temp_ack = (rel_flood_hbh_ack *)
                 ((char*)(rt) + sizeof(rel_flood_tail) + 
@@ -3019,7 +3022,7 @@ int Reliable_Flood_Verify(sys_scatter *scat, int32u src_id, unsigned char type)
         Alarm(EXIT, "Reliable_Flood_Verify: invalid r_hdr type for verifying "
                         "signatures - %d\r\n", type);
 
-    ret = EVP_VerifyFinal(md_ctx, 
+    ret = Sec_verify_final(md_ctx, 
                         (unsigned char*)(scat->elements[last_elem - 1].buf +
                             scat->elements[last_elem - 1].len - Rel_Signature_Len),
                         Rel_Signature_Len, Pub_Keys[src_id]);
@@ -3042,7 +3045,7 @@ void Reliable_Flood_Restamp( void )
     udp_header          *hdr;
     packet_header       *phdr;
     int32u              i, k;
-    int32u              index, ngbr;
+    int32u              index;
     int64u              j, resend_start;
     int                 ret, error;
     unsigned int        sign_len;
@@ -3053,7 +3056,6 @@ void Reliable_Flood_Restamp( void )
     unsigned char       *path = NULL, *sign_ptr;
     unsigned char       restamp_flow_flag;
     Rel_Flood_Link_Data *rfldata;
-    Flow_Queue          *temp_fq;
     Flow_Buffer         *fb;
     EVP_MD_CTX          *md_ctx;
     stdit               it;
@@ -3064,7 +3066,8 @@ void Reliable_Flood_Restamp( void )
     /* (1) Recompute for destinations that we have packets stored to */
     for (i = 1; i <= MAX_NODES; i++) {
         
-        fb = &FB->flow[My_ID][i];
+        if ((fb = FB->flow[My_ID][i]) == NULL)
+            continue;
         error = 0;
         restamp_flow_flag = 0;
         
@@ -3158,7 +3161,7 @@ void Reliable_Flood_Restamp( void )
                     if (error == 1)
                         goto cr_cleanup;
 
-                    ret = EVP_SignFinal(md_ctx, sign_ptr, &sign_len, Priv_Key);
+                    ret = Sec_sign_final(md_ctx, sign_ptr, &sign_len, Priv_Key);
                     if (ret != 1) {
                         Alarm(PRINT, "Reliable_Flood_Restamp: SignFinal failed\r\n");
                         error = 1;
@@ -3188,8 +3191,7 @@ void Reliable_Flood_Restamp( void )
                 }
 
                 /* mark to be resent */
-                for (ngbr = 1; ngbr <= Degree[My_ID]; ngbr++)
-                    fb->status[index][ngbr] = RESTAMPED_UNSENT;
+                RF_Set_Status_All(fb, index, RESTAMPED_UNSENT);
             }
         }
         
@@ -3206,8 +3208,7 @@ void Reliable_Flood_Restamp( void )
                 *            all neighbors are synchronized  */
                 resend_start = fb->sow;
                 while (resend_start < fb->head_seq && 
-                        (fb->status[resend_start % MAX_MESS_PER_FLOW][k] == NEW_SENT ||
-                         fb->status[resend_start % MAX_MESS_PER_FLOW][k] == RESTAMPED_SENT))
+                        RF_Status_Sent(fb, resend_start % MAX_MESS_PER_FLOW, k))
                 {
                     resend_start++;
                 }
@@ -3219,7 +3220,7 @@ void Reliable_Flood_Restamp( void )
                                     " next_seq (%lu). SOW = %lu, NGBR = %d,"
                                     " First Msg Status = %d\r\n", 
                                     resend_start, fb->next_seq[k], fb->sow, k,
-                                    fb->status[fb->sow % MAX_MESS_PER_FLOW][k]);
+                                    RF_Status(fb, fb->sow % MAX_MESS_PER_FLOW, k));
                 fb->next_seq[k] = resend_start;
 
                 /* Add to sending queue (urgent) if not already in either queue. */
@@ -3229,24 +3230,14 @@ void Reliable_Flood_Restamp( void )
                             (fb->msg[index]->elements[fb->msg[index]->num_elements-2].buf) + 
                             sizeof(rel_flood_header), k) )
                 {
-                    rfldata->in_flow_queue[My_ID][i] = 1;
-                    temp_fq = (Flow_Queue *) new (FLOW_QUEUE_NODE);
-                    if (temp_fq == NULL)
-                        Alarm(EXIT, "Reliable_Flood_Restamp(): Cannot allocate"
-                                    "Flow Queue Node for in_flow_queue.\r\n");
-                    temp_fq->src_id = My_ID;
-                    temp_fq->dest_id = i;
-                    temp_fq->penalty = 1;
-                    temp_fq->next = NULL;
-                    rfldata->urgent_tail->next = temp_fq;
-                    rfldata->urgent_tail = temp_fq;
+                    RF_Queue_Flow(rfldata, My_ID, i, 1);
 
                     /* Request Resources for the re-stamped messages */
                     stdhash_find(&All_Nodes, &it, &Neighbor_Addrs[My_ID][i]);
                     if (!stdhash_is_end(&All_Nodes, &it)) {
                         nd = *((Node **)stdhash_it_val(&it));
-                        if (rfldata->norm_head.next != NULL ||
-                             rfldata->urgent_head.next != NULL) 
+                        if (rfldata->urgent.summary != 0 ||
+                             rfldata->ready.summary != 0) 
                         {
                             Request_Resources((IT_RELIABLE_ROUTING >>
                                                ROUTING_BITS_SHIFT), nd, INTRUSION_TOL_LINK, 
@@ -3876,7 +3867,7 @@ int Send_Status_Change (Node *next_hop, int ngbr_index, int mode)
                 Alarm(PRINT, "Send_Status_Change: SignUpdate failed\r\n");
                 crypto_fail = 1;
             }
-            ret = EVP_SignFinal(md_ctx, (unsigned char*)Status_Change_Sig[My_ID], 
+            ret = Sec_sign_final(md_ctx, (unsigned char*)Status_Change_Sig[My_ID], 
                                 &sign_len, Priv_Key);
             if (ret != 1) {
                 Alarm(PRINT, "Send_Status_Change: SignFinal failed\r\n");
@@ -58,6 +58,7 @@
 #include "udp.h"
 #include "intrusion_tol_udp.h"
 #include "state_flood.h"
+#include "flow_ready_set.h"
 #include "multicast.h"
 #include "route.h"
 #include "multipath.h"
@@ -95,20 +96,23 @@ typedef struct CONF_REL_d {
 #define STATUS_CHANGE       4
 
 /* ----------Per Node Data Structures---------- */
+/* Words of 2-bit per-neighbor status in each Flow_Buffer slot */
+#define RF_STATUS_WORDS (((MAX_NODES + 1) * 2 + 63) / 64)
+
 typedef struct Flow_Buffer_d {
     /* Storage for the message */
     sys_scatter *msg[MAX_MESS_PER_FLOW];
-    /* Status of this message toward each neighbor - see Message_Sending_Status in link.h 
-     *      There are Degree + 1 of these, malloc'd at initialization */
-    unsigned char *status[MAX_MESS_PER_FLOW];
+    /* Status of this message toward each neighbor, 2 bits per neighbor
+     *      index - see Message_Sending_Status in link.h. EMPTY is not
+     *      stored: a slot with no message is EMPTY toward everyone */
+    int64u  status[MAX_MESS_PER_FLOW][RF_STATUS_WORDS];
     /* The number of K paths at the time this message was injected into the 
      *      network, if this message originated here. 0 = flooding */
     int16u  num_paths[MAX_MESS_PER_FLOW];
     /* This is the first one we haven't received acknowledgement for yet. */
     int64u  sow;
-    /* This is the first one we haven't sent yet.
-     *      There are Degree + 1 of these, malloc'd at initialization */
-    int64u  *next_seq;
+    /* This is the first one we haven't sent yet, per neighbor index */
+    int64u  next_seq[MAX_NODES + 1];
     /* This is the first one we haven't received yet (aru + 1). */
     int64u  head_seq;
     /* This is the highest source epoch seen on a data message for this flow */
@@ -116,7 +120,8 @@ typedef struct Flow_Buffer_d {
 } Flow_Buffer;
 
 typedef struct All_Flow_Buffers_d {
-    struct Flow_Buffer_d flow[MAX_NODES + 1][MAX_NODES + 1];
+    /* Allocated the first time the flow is used, NULL until then */
+    struct Flow_Buffer_d *flow[MAX_NODES + 1][MAX_NODES + 1];
 } All_Flow_Buffers;
 
 typedef rel_flood_e2e_ack End_To_End_Ack;
@@ -153,16 +158,21 @@ typedef struct Status_Change_Status_d {
 typedef struct Flow_Queue_d {
     int32u src_id;
     int32u dest_id;
-    int16u penalty;
     struct Flow_Queue_d *next;
 } Flow_Queue;
 
 typedef struct Rel_Flood_Link_Data_d {
     Rel_Fl_Neighbor_Status  ns_matrix;
-    Flow_Queue              norm_head;
-    Flow_Queue              *norm_tail;
-    Flow_Queue              urgent_head;
-    Flow_Queue              *urgent_tail;
+    /* Flows with newly arrived data, served first */
+    Flow_Ready_Set          urgent;
+    /* All other flows that may be able to send, served round-robin */
+    Flow_Ready_Set          ready;
+    int32u                  urgent_cursor;
+    int32u                  ready_cursor;
+    /* Rounds a flow sits out after sending a message of several packets
+     *      (deficit round robin with a quantum of one packet) */
+    int16u                  deficit[MAX_NODES + 1][MAX_NODES + 1];
+    /* 1 if the flow is in urgent or ready */
     unsigned char           in_flow_queue[MAX_NODES + 1]
                                                 [MAX_NODES + 1];
     
@@ -224,6 +234,7 @@ void Flip_rel_flood_hdr( rel_flood_header *r_hdr );
 void Copy_rel_flood_header( rel_flood_header *from_flood_hdr, 
         rel_flood_header *to_flood_hdr );
 void Init_Reliable_Flooding();
+void Reliable_Flood_Add_Neighbors(int16u old_degree);
 int Fill_Packet_Header_Reliable_Flood( char* hdr, int16u num_paths );
 int Reliable_Flood_Can_Flow_Send( Session *ses, int32u dst_id );
 int Reliable_Flood_Block_Session( Session *ses, int32u dst_id );
@@ -84,7 +84,6 @@ extern stdhash   Sessions_ID;
 extern stdhash   Sessions_Port;
 extern stdhash   Rel_Sessions_Port;
 extern stdhash   Sessions_Sock;
-extern int16     Link_Sessions_Blocked_On;
 
 extern int TCP_Fairness;
 
@@ -172,6 +171,7 @@ int Init_Reliable_Session(Session *ses, Node_ID address, int16u port)
 
     r_data->max_window = MAX_CG_WINDOW/2;
     r_data->ssthresh = MAX_CG_WINDOW/2;
+    CC_Init(r_data, Conf_CC.Reliable_Sessions, 2);
 
     ses->r_data = r_data;
     
@@ -1404,9 +1404,8 @@ int Process_Sess_Ack(Session *ses, char* buf, int16u ack_len,
     Reliable_Data *r_data;
     reliable_ses_tail *r_tail;
     int32u i, ack_window;
-    sp_time timeout_val, now, diff;
+    sp_time timeout_val, now, diff, sent;
     int32u rtt_estimate;
-    double old_window;
     int congestion_action = 0;
     int32 *nack;
     int16u to_copy;
@@ -1530,6 +1529,7 @@ int Process_Sess_Ack(Session *ses, char* buf, int16u ack_len,
 	    else {
 		r_data->rtt = (int)(0.2*rtt_estimate + 0.8*r_data->rtt);
 	    }
+	    CC_On_RTT_Sample(r_data, rtt_estimate, now);
 	}
 	for(i=r_data->tail; i<r_tail->cummulative_ack; i++) {
 	    if(r_data->window[i%MAX_WINDOW].buff != NULL) {
@@ -1542,48 +1542,24 @@ int Process_Sess_Ack(Session *ses, char* buf, int16u ack_len,
 	    
 	    r_data->tail++;
 
-            if (TCP_Fairness) {
-                old_window = r_data->window_size;
-                
-                /* Congestion control */
-                if(congestion_action == 0) {
-                    if(!stdcarr_empty(&(r_data->msg_buff))) { 
-                        /* there are other packets waiting, so it makes sense to increase the window */
-                        if(r_data->window_size < r_data->ssthresh) {
-                            /* Slow start */
-                            r_data->window_size += 1;
-                        }
-                        else {
-                            /* Congestion avoidance */
-                            r_data->window_size += 1/r_data->window_size;
-                        }
-                        if(r_data->window_size > r_data->max_window) {
-                            r_data->window_size = (float)r_data->max_window;
-                        }
-                    }
-                }
-                else if(congestion_action == 1) {
-                    r_data->ssthresh /= 2;
-                    if(r_data->ssthresh < 2) {
-                        r_data->ssthresh = 2;
-                    }
-                    r_data->window_size = 2;
-                    congestion_action = 3;
-                }
-                else if(congestion_action == 2) {
-                    r_data->ssthresh /= 2;
-                    if(r_data->ssthresh < 2) {
-                        r_data->ssthresh = 2;
-                    }
-                    r_data->window_size /= 2;
-                    if(r_data->window_size < 2) {
-                        r_data->window_size = 2;
-                    }
-                    congestion_action = 3;
-                }
-                
-                if(r_data->window_size != old_window)
-                    Alarm(DEBUG, "SES window adjusted: %5.3f\n", r_data->window_size);
+            /* Congestion control */
+            sent = r_data->window[(r_data->tail-1)%MAX_WINDOW].timestamp;
+            if(congestion_action == 0) {
+                /* Only if there are other packets waiting it makes sense
+                 * to increase the window */
+                CC_On_Ack(r_data, r_data->window_size, sent,
+                          stdcarr_empty(&(r_data->msg_buff)) ? CC_ACK_APP_LIMITED : 0, now);
+            }
+            else if(congestion_action == 1) {
+                CC_On_Loss(r_data, CC_ECN_SEVERE, r_data->window_size, now);
+                congestion_action = 3;
+            }
+            else if(congestion_action == 2) {
+                CC_On_Loss(r_data, CC_ECN_MODERATE, r_data->window_size, now);
+                congestion_action = 3;
+            }
+            else {
+                CC_On_Ack(r_data, r_data->window_size, sent, CC_ACK_HOLD, now);
             }
 	}		    
     }
@@ -1699,7 +1675,8 @@ int Reliable_Ses_Send(Session* ses)
     char *send_buff;
     int16u data_len, ack_len;
     int ret = 0;
-    sp_time now, timeout_val, tmp_time, sum_time;
+    int must_buffer;
+    sp_time now, timeout_val, tmp_time, sum_time, pace_delay;
     char *p_nack;
     int32u i;
 
@@ -1730,11 +1707,19 @@ int Reliable_Ses_Send(Session* ses)
     /* If there is no more room in the window, or the connection is not valid yet, 
      * stick the message in the sending buffer */
 
-    if(((next_hop == NULL) && (u_hdr->dest != My_Address)) ||
-       (r_data->head - r_data->tail >= r_data->window_size)||
-       (!stdcarr_empty(&r_data->msg_buff))||
-       (r_data->head >= r_data->adv_win)||
-       (!(r_data->flags & CONNECTED_LINK))) {
+    must_buffer = (((next_hop == NULL) && (u_hdr->dest != My_Address)) ||
+                   (r_data->head - r_data->tail >= r_data->window_size)||
+                   (!stdcarr_empty(&r_data->msg_buff))||
+                   (r_data->head >= r_data->adv_win)||
+                   (!(r_data->flags & CONNECTED_LINK)));
+
+    /* Same if the pacing rate does not allow another packet yet */
+    if(!must_buffer && !CC_Pace_Send(r_data, now, &pace_delay)) {
+        must_buffer = 1;
+        E_queue(Ses_Try_to_Send, ses->sess_id, NULL, pace_delay);
+    }
+
+    if(must_buffer) {
 	if((buf_cell = (Buffer_Cell*) new(BUFFER_CELL))==NULL) {
 	    Alarm(EXIT, "Reliable_Send_Control_Msg(): Cannot allocte buffer cell\n");
 	}
@@ -1747,10 +1732,14 @@ int Reliable_Ses_Send(Session* ses)
 	
 	if(stdcarr_size(&r_data->msg_buff) > MAX_BUFF_LINK) {
 	    ses->rel_blocked = 1;
-	    if(Link_Sessions_Blocked_On == -1) {
-		Alarm(DEBUG, "session block\n");
-		Block_Session(ses);
-	    }
+	    Alarm(DEBUG, "session block\n");
+	    Block_Session(ses);
+	}
+
+	/* Timed events are held back while packets keep coming in, so
+	 * do not count on Ses_Try_to_Send alone to release paced packets */
+	if(CC_Paced(r_data)) {
+	    Ses_Send_Much(ses);
 	}
 
         /* Amy: should we make sure the timeout is scheduled? */
@@ -1924,7 +1913,7 @@ void Ses_Send_Much(Session *ses)
     char *send_buff;
     int16u data_len, ack_len;
     int ret;
-    sp_time now, timeout_val, tmp_time, sum_time;
+    sp_time now, timeout_val, tmp_time, sum_time, pace_delay;
     char *p_nack;
     int32u i, ack_window_mask;
     stdit it;
@@ -1986,6 +1975,13 @@ void Ses_Send_Much(Session *ses)
 	    break;
 	}
 
+	/* Stop if the pacing rate does not allow another packet yet,
+	 * and come back when it does */
+	if(!CC_Pace_Send(r_data, now, &pace_delay)) {
+	    E_queue(Ses_Try_to_Send, ses->sess_id, NULL, pace_delay);
+	    break;
+	}
+
 	/* Take the first packet from the buffer (queue) and put it into the window */
 	stdcarr_begin(&(r_data->msg_buff), &it);
 	buf_cell = *((Buffer_Cell **)stdcarr_it_val(&it));
@@ -2116,10 +2112,8 @@ void Ses_Send_Much(Session *ses)
     if(ses->rel_blocked == 1) {
 	if(stdcarr_size(&(r_data->msg_buff)) < MAX_BUFF_LINK/4) {
 	    ses->rel_blocked = 0;
-	    if(Link_Sessions_Blocked_On == -1) {
-		Alarm(DEBUG, "session unblock\n");
-		Resume_Session(ses);
-	    }
+	    Alarm(DEBUG, "session unblock\n");
+	    Resume_Session(ses);
 	}
     }
 
@@ -2469,14 +2463,7 @@ void Ses_Reliable_Timeout(int sesid, void *dummy)
     Alarm(DEBUG, "SES_REL_TIMEOUT: tail: %d; head:%d\n", r_data->tail, r_data->head);
  
     /* Congestion control */
-    if (TCP_Fairness) {
-        r_data->ssthresh = (unsigned int)(r_data->window_size/2);
-        if(r_data->ssthresh < 2)
-            r_data->ssthresh = 2;
-        r_data->window_size = 2;
-
-        Alarm(DEBUG, "SES window adjusted: %5.3f timeout\n", r_data->window_size);
-    }
+    CC_On_Loss(r_data, CC_LOSS_TIMEOUT, r_data->window_size, now);
 
     /* If there is already an ack to be sent on this link, cancel it, 
        as this packet will contain the ack info. */
@@ -2703,18 +2690,7 @@ void Ses_Send_Nack_Retransm(int sesid, void *dummy)
     }
 	
     /* Congestion control */
-    if (TCP_Fairness) {
-        r_data->ssthresh = (unsigned int)(r_data->window_size/2);
-        if(r_data->ssthresh < 2) {
-            r_data->ssthresh = 2;
-        }
-        r_data->window_size = r_data->window_size/2;
-        if(r_data->window_size < 2) {
-            r_data->window_size = 2;
-        }
-
-        Alarm(DEBUG, "SES window adjusted: %5.3f\n", r_data->window_size);
-    }
+    CC_On_Loss(r_data, CC_LOSS_NACK, r_data->window_size, now);
 
 
     /* If there is already an ack to be sent on this link, cancel it, 
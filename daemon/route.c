@@ -67,6 +67,7 @@
 #include "intrusion_tol_udp.h"
 #include "priority_flood.h"
 #include "reliable_flood.h"
+#include "source_dedup.h"
 
 #include "spines.h"
 
@@ -75,6 +76,45 @@
  * particular point in time from the local node's POV.
  ********************************************************************/
 
+#define MCAST_FIB_WORDS (MAX_NEIGHBORS / 32)
+
+#if defined(__GNUC__)
+#  define MCAST_CTZ(x) __builtin_ctz(x)
+#else
+static int MCAST_CTZ(int32u x)
+{
+  int n = 0;
+
+  for (; !(x & 0x1); x >>= 1, ++n);
+
+  return n;
+}
+#endif
+
+typedef struct
+{
+  Group_ID          group;
+  Node_ID           source;
+
+} Mcast_Key;
+
+typedef struct
+{
+  int32u            gen;           /* bumped each time the group's forwarding must be rebuilt */
+
+} Mcast_Group;
+
+typedef struct
+{
+  Mcast_Group      *group;         /* group of this entry */
+  int32u            gen;           /* group->gen the entry was built for */
+  int               words;         /* number of leading words of nbrs that can be non-zero */
+  int32u            nbrs[MCAST_FIB_WORDS];  /* bit i set -> forward to Neighbor_Nodes[i] */
+  int               has_neighbors; /* neighbors is constructed and matches nbrs */
+  stdhash           neighbors;     /* (Node_ID -> Node*): nbrs as a hash, for Get_Mcast_Neighbors */
+
+} Mcast_Fib_Entry;
+
 typedef struct
 {
   int               Num_Nodes;     /* Number of nodes in this route state */
@@ -83,9 +123,10 @@ typedef struct
 
   Route            *Routes;        /* Route Routes[Num_Nodes * Num_Nodes]: routing map in matrix form */
 
-  /* forwarding table for multicast groups; maps a (group, origin) to the set of nodes to forward to */
+  /* forwarding table for multicast groups; maps a (group, origin) to the set of neighbors to forward to */
 
-  stdhash           Groups;        /* (Group_ID -> stdhash(Node_ID -> stdhash(Node_ID -> Node*))): group -> (source -> (neighbor id -> neighbor *)) */
+  stdhash           Mcast_Groups;  /* (Group_ID -> Mcast_Group*): version of each group's forwarding */
+  stdhash           Mcast_FIB;     /* (Mcast_Key -> Mcast_Fib_Entry*): (group, source) -> neighbor bitset */
 
 } Routing_Regime;
 
@@ -108,14 +149,6 @@ static const sp_time            Reroute_Timeout    = { 0, 100 };
 static long                     Route_Compute_Duration;
 static Routing_Compute_Duration Routing_Compute_Durations[NUM_ROUTING_COMPUTE_DURATIONS];
 
-#define SOURCE_HIST_SIZE 100000
-typedef struct dummy_seq_pair {
-    int32u seq;
-    int32u incarnation;
-} seq_pair;
-
-static seq_pair Source_Seq_Hist[MAX_NODES+1][SOURCE_HIST_SIZE] = {{{0,0}}};
-
 /*********************************************************************
  * Lookup a node's routing index based on its Node_ID
  *********************************************************************/
@@ -315,10 +348,11 @@ static double RR_Init(Routing_Regime *rr)
     }
   }
 
-  /* initialize Groups */
+  /* initialize the multicast forwarding table */
 
-  if (stdhash_construct(&rr->Groups, sizeof(Group_ID), sizeof(stdhash), NULL, NULL, 0) != 0) {
-    Alarm(EXIT, "RR_Init_Routes: construction of Groups failed!\n");
+  if (stdhash_construct(&rr->Mcast_Groups, sizeof(Group_ID), sizeof(Mcast_Group*), NULL, NULL, 0) != 0 ||
+      stdhash_construct(&rr->Mcast_FIB, sizeof(Mcast_Key), sizeof(Mcast_Fib_Entry*), NULL, NULL, 0) != 0) {
+    Alarm(EXIT, "RR_Init_Routes: construction of Mcast_FIB failed!\n");
   }
 
   /* compute new routing */
@@ -374,23 +408,26 @@ static double RR_Init(Routing_Regime *rr)
 
 static void RR_Fini(Routing_Regime *rr)
 {
-  stdit    outer_it;
-  stdhash *inner;
-  stdit    inner_it;
+  Mcast_Fib_Entry *entry;
+  stdit            tit;
 
-  for (stdhash_begin(&rr->Groups, &outer_it); !stdhash_is_end(&rr->Groups, &outer_it); stdhash_it_next(&outer_it)) {
+  for (stdhash_begin(&rr->Mcast_FIB, &tit); !stdhash_is_end(&rr->Mcast_FIB, &tit); stdhash_it_next(&tit)) {
 
-    inner = (stdhash*) stdhash_it_val(&outer_it);
+    entry = *(Mcast_Fib_Entry**) stdhash_it_val(&tit);
 
-    for (stdhash_begin(inner, &inner_it); !stdhash_is_end(inner, &inner_it); stdhash_it_next(&inner_it)) {
-
-      stdhash_destruct((stdhash*) stdhash_it_val(&inner_it));
+    if (entry->has_neighbors) {
+      stdhash_destruct(&entry->neighbors);
     }
 
-    stdhash_destruct(inner);
+    free(entry);
+  }
+
+  for (stdhash_begin(&rr->Mcast_Groups, &tit); !stdhash_is_end(&rr->Mcast_Groups, &tit); stdhash_it_next(&tit)) {
+    free(*(Mcast_Group**) stdhash_it_val(&tit));
   }
 
-  stdhash_destruct(&rr->Groups);
+  stdhash_destruct(&rr->Mcast_FIB);
+  stdhash_destruct(&rr->Mcast_Groups);
 
   free(rr->Routes);
   stdhash_destruct(&rr->Node_Indexes);
@@ -400,129 +437,183 @@ static void RR_Fini(Routing_Regime *rr)
 }
 
 /*********************************************************************
- * Returns a stdhash of Node's to which the local node should forward
- * a source based multicast.
+ * Returns the forwarding entry of a source based multicast: the set
+ * of neighbors to which the local node should forward it.  Entries
+ * are built on demand and rebuilt in place when their group changes.
  *********************************************************************/
 
-static stdhash *RR_Get_Mcast_Neighbors(Routing_Regime *rr,
-				       Node_ID         sender,         /* originator of send */
-				       Group_ID        mcast_address)  /* destination group */
+static Mcast_Fib_Entry *RR_Get_Mcast_Entry(Routing_Regime *rr,
+					   Node_ID         sender,         /* originator of send */
+					   Group_ID        mcast_address)  /* destination group */
 {
-  stdhash     *neighbors     = NULL;
-  Node        *best_next_hop = NULL;
-  State_Chain *s_chain_grp;
-  stdhash     *groups;
-  stdhash     *sources;
-  Group_State *g_state;
-  Node        *next_hop;
-  stdit        grp_it;
-  stdit        src_it;
-  stdit        ngb_it;
-  stdit        st_it;
-  stdhash      dmy;
+  Mcast_Fib_Entry *entry         = NULL;
+  Node            *best_next_hop = NULL;
+  Mcast_Group     *group;
+  State_Chain     *s_chain_grp;
+  Group_State     *g_state;
+  Node            *next_hop;
+  Mcast_Key        key;
+  stdit            tit;
+  int              i;
+
+  key.group  = mcast_address;
+  key.source = sender;
+
+  /* return the cached forwarding we already have for this (group, source) */
+  /* NOTE: the cached forwarding for a group is invalidated each time the group changes (see multicast.c) */
+
+  if (!stdhash_is_end(&rr->Mcast_FIB, stdhash_find(&rr->Mcast_FIB, &tit, &key))) {
+
+    entry = *(Mcast_Fib_Entry**) stdhash_it_val(&tit);
+
+    if (entry->gen == entry->group->gen) {
+      return entry;
+    }
+  }
 
   /* look up the group in the multicast group state */
 
-  if (stdhash_is_end(&All_Groups_by_Name, stdhash_find(&All_Groups_by_Name, &grp_it, &mcast_address))) {
+  if (stdhash_is_end(&All_Groups_by_Name, stdhash_find(&All_Groups_by_Name, &tit, &mcast_address))) {
     return NULL;
   }
 
-  s_chain_grp = *(State_Chain**) stdhash_it_val(&grp_it);
+  s_chain_grp = *(State_Chain**) stdhash_it_val(&tit);
 
-  /* look up the group in the routing state */
+  if (entry == NULL) {  /* build an answer on demand and store in the cache */
 
-  groups = &rr->Groups;
+    if (stdhash_is_end(&rr->Mcast_Groups, stdhash_find(&rr->Mcast_Groups, &tit, &mcast_address))) {
 
-  if (stdhash_is_end(groups, stdhash_find(groups, &grp_it, &mcast_address))) {
+      if ((group = (Mcast_Group*) malloc(sizeof(Mcast_Group))) == NULL ||
+	  stdhash_insert(&rr->Mcast_Groups, &tit, &mcast_address, &group) != 0) {
+	Alarm(EXIT, "RR_Get_Mcast_Entry(): Cannot allocate memory\n");
+      }
 
-    if (stdhash_insert(groups, &grp_it, &mcast_address, &dmy) != 0 ||
-	stdhash_construct((stdhash*) stdhash_it_val(&grp_it), sizeof(Node_ID), sizeof(stdhash), NULL, NULL, 0) != 0) {
-      Alarm(EXIT, "RR_Get_Mcast_Neighbors(): Cannot allocate memory\n");
+      group->gen = 0;
+
+    } else {
+      group = *(Mcast_Group**) stdhash_it_val(&tit);
+    }
+
+    if ((entry = (Mcast_Fib_Entry*) malloc(sizeof(Mcast_Fib_Entry))) == NULL ||
+	stdhash_insert(&rr->Mcast_FIB, &tit, &key, &entry) != 0) {
+      Alarm(EXIT, "RR_Get_Mcast_Entry(): Cannot allocate memory 2\n");
     }
+
+    entry->group         = group;
+    entry->has_neighbors = 0;
   }
 
-  /* return any cached forwarding we already have for this (group, source) */
-  /* NOTE: the cached forwarding for a group is wiped out each time the group changes (see multicast.c) */
+  entry->gen   = entry->group->gen;
+  entry->words = 0;
+  memset(entry->nbrs, 0, sizeof(entry->nbrs));
 
-  sources = (stdhash*) stdhash_it_val(&grp_it);
+  if (entry->has_neighbors) {  /* rebuilt from nbrs when asked for */
+    stdhash_destruct(&entry->neighbors);
+    entry->has_neighbors = 0;
+  }
 
-  if (!stdhash_is_end(sources, stdhash_find(sources, &src_it, &sender))) {
+  for (stdhash_begin(&s_chain_grp->states, &tit); !stdhash_is_end(&s_chain_grp->states, &tit); stdhash_it_next(&tit)) {
 
-    neighbors = (stdhash*) stdhash_it_val(&src_it);
+    g_state = *(Group_State**) stdhash_it_val(&tit);
 
-  } else {  /* build an answer on demand and store in the cache */
-    
-    if (stdhash_insert(sources, &src_it, &sender, &dmy) != 0 ||
-	stdhash_construct((stdhash*) stdhash_it_val(&src_it), sizeof(Node_ID), sizeof(Node*), NULL, NULL, 0) != 0) {
-      Alarm(EXIT, "RR_Get_Mcast_Neighbors(): Cannot allocate memory 2\n");
+    if (g_state->status & ACTIVE_GROUP) {
+
+      /* if its any acast and I'm registered, then I am the final destination -> empty neighbors */
+
+      if (Is_acast_addr(mcast_address) && g_state->node_nid == My_Address) {
+	best_next_hop = NULL;
+	break;
+      }
+      
+      if ((next_hop = RR_Get_Next_Hop(rr, sender, g_state->node_nid)) != NULL && next_hop->neighbor_id >= 0) {
+
+	if (Is_mcast_addr(mcast_address)) { 
+	  entry->nbrs[next_hop->neighbor_id / 32] |= (0x1U << next_hop->neighbor_id % 32);
+
+	} else if (Is_acast_addr(mcast_address)) {
+
+	  if (best_next_hop == NULL || next_hop->cost < best_next_hop->cost) {
+	    best_next_hop = next_hop;
+	  }
+	}
+      }
     }
+  }
 
-    neighbors = (stdhash*) stdhash_it_val(&src_it);
+  if (Is_acast_addr(mcast_address) && best_next_hop != NULL) {
+    entry->nbrs[best_next_hop->neighbor_id / 32] |= (0x1U << best_next_hop->neighbor_id % 32);
+  }
 
-    for (stdhash_begin(&s_chain_grp->states, &st_it); !stdhash_is_end(&s_chain_grp->states, &st_it); stdhash_it_next(&st_it)) {
+  for (i = 0; i < MCAST_FIB_WORDS; ++i) {
 
-      g_state = *(Group_State**) stdhash_it_val(&st_it);
+    if (entry->nbrs[i] != 0) {
+      entry->words = i + 1;
+    }
+  }
 
-      if (g_state->status & ACTIVE_GROUP) {
+  return entry;
+}
 
-	/* if its any acast and I'm registered, then I am the final destination -> empty neighbors */
+/*********************************************************************
+ * Returns a stdhash of Node's to which the local node should forward
+ * a source based multicast.
+ *********************************************************************/
 
-	if (Is_acast_addr(mcast_address) && g_state->node_nid == My_Address) {
-	  best_next_hop = NULL;
-	  break;
-	}
-      
-	if ((next_hop = RR_Get_Next_Hop(rr, sender, g_state->node_nid)) != NULL) {
+static stdhash *RR_Get_Mcast_Neighbors(Routing_Regime *rr,
+				       Node_ID         sender,         /* originator of send */
+				       Group_ID        mcast_address)  /* destination group */
+{
+  Mcast_Fib_Entry *entry;
+  Node            *next_hop;
+  int32u           bits;
+  stdit            ngb_it;
+  int              i;
 
-	  if (Is_mcast_addr(mcast_address)) { 
+  if ((entry = RR_Get_Mcast_Entry(rr, sender, mcast_address)) == NULL) {
+    return NULL;
+  }
 
-	    if (stdhash_put(neighbors, &ngb_it, &next_hop->nid, &next_hop) != 0) {
-	      Alarm(EXIT, "RR_Get_Mcast_Neighbors: Couldn't insert into neighbors!\r\n");
-	    }
+  if (!entry->has_neighbors) {
 
-	  } else if (Is_acast_addr(mcast_address)) {
+    if (stdhash_construct(&entry->neighbors, sizeof(Node_ID), sizeof(Node*), NULL, NULL, 0) != 0) {
+      Alarm(EXIT, "RR_Get_Mcast_Neighbors(): Cannot allocate memory\n");
+    }
 
-	    if (best_next_hop == NULL || next_hop->cost < best_next_hop->cost) {
-	      best_next_hop = next_hop;
-	    }
-	  }
+    entry->has_neighbors = 1;
+
+    for (i = 0; i < entry->words; ++i) {
+
+      for (bits = entry->nbrs[i]; bits != 0; bits &= bits - 1) {
+
+	if ((next_hop = Neighbor_Nodes[i * 32 + MCAST_CTZ(bits)]) != NULL &&
+	    stdhash_put(&entry->neighbors, &ngb_it, &next_hop->nid, &next_hop) != 0) {
+	  Alarm(EXIT, "RR_Get_Mcast_Neighbors: Couldn't insert into neighbors!\r\n");
 	}
       }
     }
-
-    if (Is_acast_addr(mcast_address) && best_next_hop != NULL && 
-	stdhash_insert(neighbors, &ngb_it, &best_next_hop->nid, &best_next_hop) != 0) {
-      Alarm(EXIT, "RR_Get_Mcast_Neighbors: Couldn't insert into neighbors 2!\n");
-    }
   }
 
-  return neighbors;
+  return &entry->neighbors;
 }
 
 /*********************************************************************
- * Discard any cached source based multicast forwarding tables for a group
+ * Discard any cached source based multicast forwarding tables for a
+ * group; MCAST_ALL_GROUPS -> for every group
  *********************************************************************/
 
 static void RR_Discard_Mcast_Neighbors(Routing_Regime *rr,
 				       Group_ID        mcast_address) 
 {
-  stdhash *sources;
-  stdhash *neighbors;
-  stdit    grp_it;
-  stdit    src_it;
+  stdit tit;
     
-  if (!stdhash_is_end(&rr->Groups, stdhash_find(&rr->Groups, &grp_it, &mcast_address))) {
+  if (mcast_address == MCAST_ALL_GROUPS) {
 
-    sources = (stdhash*) stdhash_it_val(&grp_it);
-
-    for (stdhash_begin(sources, &src_it); !stdhash_is_end(sources, &src_it); stdhash_it_next(&src_it)) {
-
-      neighbors = (stdhash*) stdhash_it_val(&src_it);
-      stdhash_destruct(neighbors);
+    for (stdhash_begin(&rr->Mcast_Groups, &tit); !stdhash_is_end(&rr->Mcast_Groups, &tit); stdhash_it_next(&tit)) {
+      ++(*(Mcast_Group**) stdhash_it_val(&tit))->gen;
     }
 
-    stdhash_destruct(sources);
-    stdhash_erase(&rr->Groups, &grp_it);
+  } else if (!stdhash_is_end(&rr->Mcast_Groups, stdhash_find(&rr->Mcast_Groups, &tit, &mcast_address))) {
+    ++(*(Mcast_Group**) stdhash_it_val(&tit))->gen;
   }
 }
 
@@ -756,7 +847,9 @@ stdhash *Get_Mcast_Neighbors(Node_ID  sender,         /* originator of send */
  
 void Discard_Mcast_Neighbors(Group_ID mcast_address) 
 {
-  RR_Discard_Mcast_Neighbors(Current_Routing, mcast_address);
+  if (Current_Routing != NULL) {
+    RR_Discard_Mcast_Neighbors(Current_Routing, mcast_address);
+  }
 }
 
 /*********************************************************************
@@ -766,13 +859,12 @@ void Discard_Mcast_Neighbors(Group_ID mcast_address)
 
 int Source_Based_Disseminate(Link *src_link, sys_scatter *scat, int mode)
 {
-    int32u i, last_hop_ip, src_id, seq_index;
+    int32u i, last_hop_ip, src_id;
     stdit it;
     udp_header *hdr;
     sb_header *s_hdr;
     Node *nd;
     unsigned char *routing_mask, *path;
-    seq_pair prev_seq;
 
     hdr = (udp_header *)scat->elements[1].buf;
     s_hdr = (sb_header *)scat->elements[scat->num_elements-1].buf;
@@ -787,30 +879,24 @@ int Source_Based_Disseminate(Link *src_link, sys_scatter *scat, int mode)
     src_id = *(int32u *)stdhash_it_val(&it);
 
     /* Check whether we have already seen this packet; if so, don't forward again */
-    seq_index = s_hdr->source_seq % SOURCE_HIST_SIZE;
-    prev_seq = Source_Seq_Hist[src_id][seq_index];
-    if (prev_seq.seq == s_hdr->source_seq && prev_seq.incarnation == s_hdr->source_incarnation) {
-        Alarm(DEBUG, "Source_Based_Disseminate: Duplicate Packet with source seq %u, %u...dropping\n", s_hdr->source_seq, s_hdr->source_incarnation);
-        return NO_ROUTE;
-    }
-
-     /* If the packet is so old we can't tell whether it is a duplicate or not,
-      * just throw it away.
-      * NOTE: check whether this breaks the reliable link protocol (but
-      * reliable links don't currently work with source based routing
-      * anyway...) */
-    if (prev_seq.incarnation > s_hdr->source_incarnation ||
-       (prev_seq.seq > s_hdr->source_seq && prev_seq.incarnation == s_hdr->source_incarnation)) {
-        Alarm(PRINT, "Source_Based_Disseminate: got very old packet (past "
-                     "deduplication window) from %u with source seq %u, %u; already "
-                     "had %u, %u...dropping\n", src_id, s_hdr->source_seq, s_hdr->source_incarnation,
-                     prev_seq.seq, prev_seq.incarnation);
-        return NO_ROUTE;
+    switch (Source_Dedup_Check(src_id, s_hdr->source_incarnation, s_hdr->source_seq)) {
+        case SOURCE_DEDUP_DUP:
+            Alarm(DEBUG, "Source_Based_Disseminate: Duplicate Packet with source seq %u, %u...dropping\n", s_hdr->source_seq, s_hdr->source_incarnation);
+            return NO_ROUTE;
+
+        /* If the packet is so old we can't tell whether it is a duplicate or not,
+         * just throw it away.
+         * NOTE: check whether this breaks the reliable link protocol (but
+         * reliable links don't currently work with source based routing
+         * anyway...) */
+        case SOURCE_DEDUP_OLD:
+            Alarm(PRINT, "Source_Based_Disseminate: got very old packet (past "
+                         "deduplication window) from %u with source seq %u, %u; already "
+                         "had %u, %u...dropping\n", src_id, s_hdr->source_seq, s_hdr->source_incarnation,
+                         Source_Dedup[src_id].high_seq, Source_Dedup[src_id].incarnation);
+            return NO_ROUTE;
     }
 
-    Source_Seq_Hist[src_id][seq_index].seq = s_hdr->source_seq;
-    Source_Seq_Hist[src_id][seq_index].incarnation = s_hdr->source_incarnation;
-
     if (src_link == NULL)
         last_hop_ip = My_Address;
     else
@@ -956,8 +1042,9 @@ int Deliver_and_Forward_Data(sys_scatter *scat, int mode, Link *src_lnk)
   int             routing = ((int) hdr->routing << ROUTING_BITS_SHIFT);
   Routing_Regime *rr;
   Node           *next_hop;
-  stdhash        *neighbors;
-  stdit           ngb_it;
+  Mcast_Fib_Entry *entry;
+  int32u          bits;
+  int             i;
   Group_State    *gstate;
 
   if (hdr->ttl <= 0) {
@@ -986,19 +1073,21 @@ int Deliver_and_Forward_Data(sys_scatter *scat, int mode, Link *src_lnk)
         }
     } else {                                                             /* multicast traffic */
 
-        if (hdr->ttl > 0 && (neighbors = RR_Get_Mcast_Neighbors(rr, hdr->source, hdr->dest)) != NULL) {
+        if (hdr->ttl > 0 && (entry = RR_Get_Mcast_Entry(rr, hdr->source, hdr->dest)) != NULL) {
 
-            for (stdhash_begin(neighbors, &ngb_it); !stdhash_is_end(neighbors, &ngb_it); 
-                stdhash_it_next(&ngb_it)) {
-              next_hop = *(Node**) stdhash_it_val(&ngb_it);
-	          assert(next_hop != This_Node);
+            for (i = 0; i < entry->words; ++i) {
 
-	          if (Is_Connected_Neighbor2(next_hop)) {  /* might have disconnected since that routing regime */
-	              ret = Forward_Data(next_hop, scat, mode);
-	              forwarded = 1;
-	              Alarm(DEBUG, "Deliver_and_Forward_Data: Forwarding multicast traffic to " IPF " %d!\r\n", 
-                      IP(next_hop->nid), ret);
-	          }
+              for (bits = entry->nbrs[i]; bits != 0; bits &= bits - 1) {
+                next_hop = Neighbor_Nodes[i * 32 + MCAST_CTZ(bits)];
+
+	            if (next_hop != NULL && Is_Connected_Neighbor2(next_hop)) {  /* might have disconnected since that routing regime */
+	                assert(next_hop != This_Node);
+	                ret = Forward_Data(next_hop, scat, mode);
+	                forwarded = 1;
+	                Alarm(DEBUG, "Deliver_and_Forward_Data: Forwarding multicast traffic to " IPF " %d!\r\n", 
+                        IP(next_hop->nid), ret);
+	            }
+              }
             }
         } else {
             Alarm(DEBUG, "Deliver_and_Forward_Data: Not forwarding multicast traffic!\r\n");
@@ -1097,6 +1186,10 @@ int Fill_Packet_Header( char* hdr, int routing, int16u num_paths ) {
 void     RR_Pre_Conf_Setup() 
 {
     Conf_RR.Crypto = RR_CRYPTO;
+    Conf_RR.dummy1 = 0;
+    Conf_RR.dummy2 = 0;
+    Conf_RR.dummy3 = 0;
+    Conf_RR.Source_Dedup_Window = RR_SOURCE_DEDUP_WINDOW;
 }
 
 /***********************************************************/
@@ -1110,7 +1203,9 @@ void     RR_Pre_Conf_Setup()
 /***********************************************************/
 void     RR_Post_Conf_Setup()
 {
-    
+    /* A reload keeps the window size, and the windows what they have seen */
+    if (Conf_RR.Source_Dedup_Window / 64 != Source_Dedup_Words)
+        Source_Dedup_Init(Conf_RR.Source_Dedup_Window);
 }
 
 /***********************************************************/
@@ -1128,6 +1223,14 @@ int      RR_Conf_hton(unsigned char *buff)
 
     *(unsigned char*)write = Conf_RR.Crypto;
         write += sizeof(unsigned char);
+    *(unsigned char*)write = Conf_RR.dummy1;
+        write += sizeof(unsigned char);
+    *(unsigned char*)write = Conf_RR.dummy2;
+        write += sizeof(unsigned char);
+    *(unsigned char*)write = Conf_RR.dummy3;
+        write += sizeof(unsigned char);
+    *(int32u*)write = htonl(Conf_RR.Source_Dedup_Window);
+        write += sizeof(int32u);
 
     return sizeof(CONF_RR);
 }
@@ -55,6 +55,8 @@
 #define RELIABLE_FLOOD_ROUTE 6
 #define PROBLEM_ROUTE   7
 
+#define MCAST_ALL_GROUPS 0  /* Discard_Mcast_Neighbors: discard the forwarding of every group */
+
 typedef struct Route_d 
 {
   int16   distance;              /* Number of hops on this route */
@@ -71,9 +73,14 @@ typedef struct Route_d
 } Min_Weight_Belly; */
 
 #define RR_CRYPTO 1
+#define RR_SOURCE_DEDUP_WINDOW 65536
 
 typedef struct CONF_RR_d {
     unsigned char Crypto;
+    unsigned char dummy1;
+    unsigned char dummy2;
+    unsigned char dummy3;
+    int32u        Source_Dedup_Window;  /* source seqs remembered per source, multiple of 64 */
 } CONF_RR;
 
 #undef  ext
@@ -41,6 +41,7 @@
 #include <assert.h>
 
 #include <openssl/rand.h>
+#include <openssl/rsa.h>
 
 #include "arch.h"
 #include "spu_alarm.h"
@@ -373,6 +374,262 @@ END:
     return ret;
 }
 
+/* Sec_key_matches_scheme -------------------------------------------------------------------
+   Returns 1 if key can produce / check signatures of the configured
+   Signature_Scheme, 0 otherwise.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_key_matches_scheme(EVP_PKEY *key, int scheme)
+{
+    switch (scheme) {
+    case SEC_SIG_RSA:
+        return EVP_PKEY_id(key) == EVP_PKEY_RSA;
+    case SEC_SIG_ED25519:
+        return EVP_PKEY_id(key) == EVP_PKEY_ED25519;
+    default:
+        return 0;
+    }
+}
+
+/* Sec_ed25519_ctx --------------------------------------------------------------------------
+   Returns the context used for every Ed25519 sign / verify, reset so it
+   can be initialized with a new key (re-initializing it without a reset
+   keeps the previous key).
+   ------------------------------------------------------------------------------------------ */
+
+static EVP_MD_CTX *Sec_ed25519_ctx(void)
+{
+    static EVP_MD_CTX *ctx;
+
+    if (ctx == NULL && (ctx = EVP_MD_CTX_new()) == NULL)
+        Alarmp(SPLOG_FATAL, SECURITY | EXIT, "Sec_ed25519_ctx: EVP_MD_CTX_new failed\n");
+    EVP_MD_CTX_reset(ctx);
+
+    return ctx;
+}
+
+/* Sec_sign_final ---------------------------------------------------------------------------
+   Drop-in replacement for EVP_SignFinal: finishes the SHA-256 digest built
+   up in md_ctx by EVP_SignInit / EVP_SignUpdate and signs it with key.  RSA
+   keys give the same PKCS #1 v1.5 signature EVP_SignFinal would; Ed25519
+   keys sign the 32 byte digest.  Returns 1 on success, 0 on error.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_sign_final(EVP_MD_CTX *md_ctx, unsigned char *sig, unsigned int *sig_len, EVP_PKEY *key)
+{
+    unsigned char  md[EVP_MAX_MD_SIZE];
+    unsigned int   md_len;
+    size_t         len = (size_t) EVP_PKEY_size(key);
+    EVP_PKEY_CTX  *pctx;
+    EVP_MD_CTX    *ctx;
+    int            ret = 0;
+
+    if (EVP_DigestFinal_ex(md_ctx, md, &md_len) != 1)
+        return 0;
+
+    if (EVP_PKEY_id(key) == EVP_PKEY_ED25519) {
+        ctx = Sec_ed25519_ctx();
+        if (EVP_DigestSignInit(ctx, NULL, NULL, NULL, key) == 1 &&
+            EVP_DigestSign(ctx, sig, &len, md, md_len) == 1)
+            ret = 1;
+    } else {
+        if ((pctx = EVP_PKEY_CTX_new(key, NULL)) == NULL)
+            return 0;
+        if (EVP_PKEY_sign_init(pctx) == 1 &&
+            EVP_PKEY_CTX_set_signature_md(pctx, EVP_sha256()) == 1 &&
+            EVP_PKEY_sign(pctx, sig, &len, md, md_len) == 1)
+            ret = 1;
+        EVP_PKEY_CTX_free(pctx);
+    }
+
+    if (ret == 1)
+        *sig_len = (unsigned int) len;
+
+    return ret;
+}
+
+/* Sec_verify_final -------------------------------------------------------------------------
+   Drop-in replacement for EVP_VerifyFinal, see Sec_sign_final.  Returns 1
+   if sig is a valid signature by key, 0 if it is not, negative on error.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_verify_final(EVP_MD_CTX *md_ctx, const unsigned char *sig, unsigned int sig_len, EVP_PKEY *key)
+{
+    unsigned char  md[EVP_MAX_MD_SIZE];
+    unsigned int   md_len;
+    EVP_PKEY_CTX  *pctx;
+    EVP_MD_CTX    *ctx;
+    int            ret = -1;
+
+    if (EVP_DigestFinal_ex(md_ctx, md, &md_len) != 1)
+        return -1;
+
+    if (EVP_PKEY_id(key) == EVP_PKEY_ED25519) {
+        ctx = Sec_ed25519_ctx();
+        if (EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, key) == 1)
+            ret = EVP_DigestVerify(ctx, sig, sig_len, md, md_len);
+    } else {
+        if ((pctx = EVP_PKEY_CTX_new(key, NULL)) == NULL)
+            return -1;
+        if (EVP_PKEY_verify_init(pctx) == 1 &&
+            EVP_PKEY_CTX_set_signature_md(pctx, EVP_sha256()) == 1)
+            ret = EVP_PKEY_verify(pctx, sig, sig_len, md, md_len);
+        EVP_PKEY_CTX_free(pctx);
+    }
+
+    return ret;
+}
+
+/* Sec_merkle_node --------------------------------------------------------------------------
+   Hashes two children into their parent.  Leaves and interior nodes are
+   hashed with different prefixes so one can never be passed off as the
+   other.
+   ------------------------------------------------------------------------------------------ */
+
+static void Sec_merkle_node(const unsigned char *left, const unsigned char *right, unsigned char *parent)
+{
+    unsigned char buf[1 + 2 * SEC_MERKLE_HASH_LEN];
+
+    buf[0] = 0x01;
+    memcpy(buf + 1, left, SEC_MERKLE_HASH_LEN);
+    memcpy(buf + 1 + SEC_MERKLE_HASH_LEN, right, SEC_MERKLE_HASH_LEN);
+    SHA256(buf, sizeof(buf), parent);
+}
+
+/* Sec_merkle_leaf --------------------------------------------------------------------------
+   Finishes the SHA-256 digest built up in md_ctx (as for Sec_sign_final)
+   and turns it into a Merkle leaf.  Returns 1 on success, 0 on error.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_merkle_leaf(EVP_MD_CTX *md_ctx, unsigned char *leaf)
+{
+    unsigned char buf[1 + EVP_MAX_MD_SIZE];
+    unsigned int  md_len;
+
+    buf[0] = 0x00;
+    if (EVP_DigestFinal_ex(md_ctx, buf + 1, &md_len) != 1)
+        return 0;
+    SHA256(buf, 1 + md_len, leaf);
+
+    return 1;
+}
+
+/* Sec_merkle_build -------------------------------------------------------------------------
+   tree[0 .. num_leaves - 1] holds the leaves; fills in the levels above
+   them (tree needs room for 2 * num_leaves nodes) and copies the root to
+   root.  A node without a sibling is paired with itself.  Returns the
+   depth of the tree.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_merkle_build(unsigned char (*tree)[SEC_MERKLE_HASH_LEN], int num_leaves, unsigned char *root)
+{
+    int base = 0, depth = 0, n = num_leaves, i;
+
+    while (n > 1) {
+        for (i = 0; i < n; i += 2)
+            Sec_merkle_node(tree[base + i], tree[base + (i + 1 < n ? i + 1 : i)], 
+                            tree[base + n + i / 2]);
+        base += n;
+        n = (n + 1) / 2;
+        depth++;
+    }
+    memcpy(root, tree[base], SEC_MERKLE_HASH_LEN);
+
+    return depth;
+}
+
+/* Sec_merkle_path --------------------------------------------------------------------------
+   Writes the siblings of leaf, from the bottom of a tree filled in by
+   Sec_merkle_build up to the root, into path.  Returns the depth (number
+   of hashes written).
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_merkle_path(unsigned char (*tree)[SEC_MERKLE_HASH_LEN], int num_leaves, int leaf, unsigned char *path)
+{
+    int base = 0, depth = 0, n = num_leaves, sibling;
+
+    while (n > 1) {
+        sibling = leaf ^ 1;
+        if (sibling >= n)
+            sibling = leaf;
+        memcpy(path + depth * SEC_MERKLE_HASH_LEN, tree[base + sibling], SEC_MERKLE_HASH_LEN);
+        base += n;
+        n = (n + 1) / 2;
+        leaf >>= 1;
+        depth++;
+    }
+
+    return depth;
+}
+
+/* Sec_merkle_root --------------------------------------------------------------------------
+   Recomputes the root of the tree that holds leaf at index from its path.
+   ------------------------------------------------------------------------------------------ */
+
+void Sec_merkle_root(const unsigned char *leaf, int index, int depth, const unsigned char *path, unsigned char *root)
+{
+    int i;
+
+    memcpy(root, leaf, SEC_MERKLE_HASH_LEN);
+    for (i = 0; i < depth; i++, index >>= 1) {
+        if (index & 1)
+            Sec_merkle_node(path + i * SEC_MERKLE_HASH_LEN, root, root);
+        else
+            Sec_merkle_node(root, path + i * SEC_MERKLE_HASH_LEN, root);
+    }
+}
+
+/* Sec_root_digest --------------------------------------------------------------------------
+   Starts a signature over a Merkle root.  The root is tagged so a root
+   signature cannot be mistaken for the signature of a message.
+   ------------------------------------------------------------------------------------------ */
+
+static int Sec_root_digest(EVP_MD_CTX *md_ctx, const unsigned char *root)
+{
+    static const unsigned char tag[] = "spines merkle root";
+
+    return EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL) == 1 &&
+           EVP_DigestUpdate(md_ctx, tag, sizeof(tag)) == 1 &&
+           EVP_DigestUpdate(md_ctx, root, SEC_MERKLE_HASH_LEN) == 1;
+}
+
+/* Sec_sign_root ----------------------------------------------------------------------------
+   Signs a Merkle root with key.  Returns 1 on success, 0 on error.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_sign_root(const unsigned char *root, unsigned char *sig, unsigned int *sig_len, EVP_PKEY *key)
+{
+    EVP_MD_CTX *md_ctx;
+    int         ret = 0;
+
+    if ((md_ctx = EVP_MD_CTX_new()) == NULL)
+        return 0;
+    if (Sec_root_digest(md_ctx, root))
+        ret = Sec_sign_final(md_ctx, sig, sig_len, key);
+    EVP_MD_CTX_free(md_ctx);
+
+    return ret;
+}
+
+/* Sec_verify_root --------------------------------------------------------------------------
+   Returns 1 if sig is a valid signature of the Merkle root by key, 0 if
+   it is not, negative on error.
+   ------------------------------------------------------------------------------------------ */
+
+int Sec_verify_root(const unsigned char *root, const unsigned char *sig, unsigned int sig_len, EVP_PKEY *key)
+{
+    EVP_MD_CTX *md_ctx;
+    int         ret = -1;
+
+    if ((md_ctx = EVP_MD_CTX_new()) == NULL)
+        return -1;
+    if (Sec_root_digest(md_ctx, root))
+        ret = Sec_verify_final(md_ctx, sig, sig_len, key);
+    EVP_MD_CTX_free(md_ctx);
+
+    return ret;
+}
+
 /* Sec_diff_msg -----------------------------------------------------------------------------
    Returns the number of byte differences between two scatters.
    ------------------------------------------------------------------------------------------ */
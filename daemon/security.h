@@ -39,6 +39,7 @@
 
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#include <openssl/sha.h>
 #include <spu_scatter.h>
 
 #define SECURITY_MIN_KEY_SIZE   16
@@ -50,6 +51,12 @@
 #define SECURITY_MIN_HMAC_SIZE  32
 #define SECURITY_MAX_HMAC_SIZE  32 
 
+/* Signature_Scheme values */
+#define SEC_SIG_RSA             0
+#define SEC_SIG_ED25519         1
+
+#define SEC_MERKLE_HASH_LEN     SHA256_DIGEST_LENGTH
+
 #define SECURITY_MAX_OVERHEAD_SIZE (SECURITY_MAX_BLOCK_SIZE /* padding */ + SECURITY_MAX_BLOCK_SIZE /* iv */ + SECURITY_MAX_HMAC_SIZE /* hmac */)
 
 int Sec_init(void);
@@ -66,6 +73,24 @@ int Sec_unlock_msg(const sys_scatter * const msg,
                    EVP_CIPHER_CTX * const    decrypt_ctx,
                    HMAC_CTX       * const    hmac_ctx);
 
+int Sec_key_matches_scheme(EVP_PKEY *key, int scheme);
+
+int Sec_sign_final(EVP_MD_CTX *md_ctx, unsigned char *sig, unsigned int *sig_len, EVP_PKEY *key);
+
+int Sec_verify_final(EVP_MD_CTX *md_ctx, const unsigned char *sig, unsigned int sig_len, EVP_PKEY *key);
+
+int Sec_merkle_leaf(EVP_MD_CTX *md_ctx, unsigned char *leaf);
+
+int Sec_merkle_build(unsigned char (*tree)[SEC_MERKLE_HASH_LEN], int num_leaves, unsigned char *root);
+
+int Sec_merkle_path(unsigned char (*tree)[SEC_MERKLE_HASH_LEN], int num_leaves, int leaf, unsigned char *path);
+
+void Sec_merkle_root(const unsigned char *leaf, int index, int depth, const unsigned char *path, unsigned char *root);
+
+int Sec_sign_root(const unsigned char *root, unsigned char *sig, unsigned int *sig_len, EVP_PKEY *key);
+
+int Sec_verify_root(const unsigned char *root, const unsigned char *sig, unsigned int sig_len, EVP_PKEY *key);
+
 void Sec_unit_test(void);
 
 #endif
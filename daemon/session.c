@@ -34,6 +34,10 @@
  *
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE  /* recvmmsg */
+#endif
+
 #include "arch.h"
 
 #ifndef	ARCH_PC_WIN95
@@ -59,6 +63,16 @@
 #  include <errno.h>
 #endif
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#  define SES_UDP_HAVE_MMSG
+#endif
+
+/* Local clients may send their messages as the records of an AF_UNIX
+ * SOCK_SEQPACKET socket, authenticated by SCM_CREDENTIALS */
+#if defined(__linux__) && defined(SOCK_SEQPACKET) && defined(SCM_CREDENTIALS)
+#  define SES_HAVE_SEQPACKET
+#endif
+
 #include <openssl/engine.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
@@ -93,6 +107,7 @@
 #include "multicast.h"
 #include "multipath.h"
 #include "configuration.h"
+#include "security.h"
 
 /* Global variables */
 extern int16u    Port;
@@ -101,7 +116,6 @@ extern stdhash   Sessions_ID;
 extern stdhash   Sessions_Port;
 extern stdhash   Rel_Sessions_Port;
 extern stdhash   Sessions_Sock;
-extern int16     Link_Sessions_Blocked_On;
 extern stdhash   All_Groups_by_Node;
 extern stdhash   All_Groups_by_Name;
 extern stdhash   All_Nodes;
@@ -119,13 +133,22 @@ extern int64u    Injected_Messages;
 static int32u   Session_Num;
 static const sp_time zero_timeout  = {     0,    0};
 static int last_sess_port;
-static sys_scatter Ses_UDP_Pack;
-static char *frag_buf[55];
+static Ses_UDP_Slot Ses_UDP_Slots[SES_UDP_BATCH];
+
+/* IDs of the sessions paused on each link whose window is full, and the
+ * session whose message is being sent, which is the one charged when a
+ * link fills up (see Block_Link_Sessions) */
+static stdcarr  Link_Blocked_Sessions[MAX_LINKS];
+static Session *Link_Charged_Session;
 static channel ctrl_sk_requests[MAX_CTRL_SK_REQUESTS];
 static int overwrite_ip;
 
+static void Ses_UDP_Slot_Refill(Ses_UDP_Slot *slot, int nfrags);
+
 #define FRAG_TTL         30
 
+static const sp_time frag_ttl_timeout = {FRAG_TTL + 1, 0};
+
 static int Get_Ses_Mode(int32 ses_links_used)
 {
   int ret = -1;
@@ -155,37 +178,98 @@ static int Get_Ses_Mode(int32 ses_links_used)
   return ret;
 }
 
-Frag_Packet* Delete_Frag_Element(Frag_Packet **head, Frag_Packet *frag_pkt)
+/***********************************************************/
+/* void Delete_Frag_Element(Session *ses,                  */
+/*                          Frag_Packet *frag_pkt)         */
+/*                                                         */
+/* Removes an incomplete fragmented packet from a session  */
+/* and releases the fragments it holds                     */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:       the session                                  */
+/* frag_pkt:  the packet to remove                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Delete_Frag_Element(Session *ses, Frag_Packet *frag_pkt)
 {
     int i;
-    Frag_Packet *frag_tmp;
-    
+
     if(frag_pkt == NULL) {
-        return NULL;
-    }
-    if(head == NULL) {
-        return NULL;
+        return;
     }
 
-
     for(i=0; i<frag_pkt->scat.num_elements; i++) {
         if(frag_pkt->scat.elements[i].buf != NULL) {
             dec_ref_cnt(frag_pkt->scat.elements[i].buf);
+            ses->frag_bufs--;
         }
     }
     if(frag_pkt->prev == NULL) {
-        *head = frag_pkt->next;
+        ses->frag_pkts = frag_pkt->next;
     }
     else {
         frag_pkt->prev->next = frag_pkt->next;
     }
-    if(frag_pkt->next != NULL) {
+    if(frag_pkt->next == NULL) {
+        ses->frag_tail = frag_pkt->prev;
+    }
+    else {
         frag_pkt->next->prev = frag_pkt->prev;
     }
-    
-    frag_tmp = frag_pkt->next;
+    stdhash_erase_key(&ses->frag_hash, &frag_pkt->key);
+
     dispose(frag_pkt);
-    return(frag_tmp);
+}
+
+/***********************************************************/
+/* void Session_Expire_Frags(int sesid, void *dummy)       */
+/*                                                         */
+/* Discards the incomplete fragmented packets of a session */
+/* that have not been updated for FRAG_TTL seconds. The    */
+/* list is kept in update order, so only its tail needs    */
+/* to be checked                                           */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* sesid:     ID of the session                            */
+/* dummy:     Not used                                     */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Session_Expire_Frags(int sesid, void *dummy)
+{
+    Session *ses;
+    stdit it;
+    sp_time now, timeout;
+
+    stdhash_find(&Sessions_ID, &it, &sesid);
+    if(stdhash_is_end(&Sessions_ID, &it)) {
+        return;
+    }
+    ses = *((Session **)stdhash_it_val(&it));
+
+    now = E_get_time();
+    while(ses->frag_tail != NULL &&
+          now.sec - ses->frag_tail->timestamp_sec > FRAG_TTL) {
+        Alarm(DEBUG, "Old incomplete packet. Delete it\n");
+        Delete_Frag_Element(ses, ses->frag_tail);
+    }
+
+    if(ses->frag_tail != NULL) {
+        timeout.sec  = FRAG_TTL + 1 - (now.sec - ses->frag_tail->timestamp_sec);
+        timeout.usec = 0;
+        E_queue(Session_Expire_Frags, sesid, NULL, timeout);
+    }
 }
 
 /***********************************************************/
@@ -218,11 +302,8 @@ void Init_Session(void)
     last_sess_port = 40000;
     overwrite_ip = 0;
 
-    for(i=0; i<50; i++) {
-        frag_buf[i] = new_ref_cnt(PACK_BODY_OBJ);
-        if(frag_buf[i] == NULL) {
-            Alarm(EXIT, "Init_Session: Cannot allocate memory\n");
-        }
+    for(i=0; i<SES_UDP_BATCH; i++) {
+        Ses_UDP_Slot_Refill(&Ses_UDP_Slots[i], SES_UDP_FRAGS);
     }
 
     stdhash_construct(&Sessions_ID, sizeof(int32), sizeof(Session*),
@@ -282,9 +363,42 @@ void Init_Session(void)
     if (listen(sk_local, 4) < 0)
         Alarm(EXIT, "Session_Init(): AF_UNIX Listen failure\n");
     E_attach_fd(sk_local, READ_FD, Session_Accept, SESS_DATA, NULL, HIGH_PRIORITY);
+
+#ifdef SES_HAVE_SEQPACKET
+    /* Open Socket for IPC Sequenced Packet Data. Each client message is one
+     * record, and the client's credentials come with its first record */
+    sk_local = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (sk_local < 0)
+        Alarm(EXIT, "Init_Session(): AF_UNIX SOCK_SEQPACKET socket failed\n");
+
+    val = 1;
+    if (setsockopt(sk_local, SOL_SOCKET, SO_PASSCRED, (char*)&val, sizeof(val)) < 0)
+        Alarm(EXIT, "Init_Session(): Failed to set socket option PASSCRED, errno: %d\n", errno);
+
+    memset(&unix_name, 0, sizeof(unix_name));
+    unix_name.sun_family = AF_UNIX;
+    /* Check room for NULL byte */
+    s_len = SUN_PATH_LEN - 1;
+    ret = snprintf(unix_name.sun_path, s_len, "%s%s", Unix_Domain_Prefix, 
+            SPINES_UNIX_SEQ_SUFFIX);
+    if (ret > s_len) {
+        Alarm(EXIT, "Init_Session: Unix Domain seqpacket pathname too long (%u), "
+                "max allowed = %u\n", ret, s_len);
+    }
+
+    if (bind(sk_local, (struct sockaddr *) &unix_name, sizeof(unix_name)) < 0)
+        Alarm(EXIT, "Init_Session(): AF_UNIX unable to bind to path: %s\n", 
+                        unix_name.sun_path);
+    if (listen(sk_local, 4) < 0)
+        Alarm(EXIT, "Session_Init(): AF_UNIX Listen failure\n");
+    E_attach_fd(sk_local, READ_FD, Session_Accept, SESS_SEQPACKET, NULL, HIGH_PRIORITY);
+#endif
 #endif
 
-    Link_Sessions_Blocked_On = -1;
+    for(i=0; i<MAX_LINKS; i++) {
+        stdcarr_construct(&Link_Blocked_Sessions[i], sizeof(int32u), 0);
+    }
+    Link_Charged_Session = NULL;
    
     /* If we are disabling remote connections, stop here and do not create
      *  TCP sockets to listen for incoming client connections */
@@ -397,6 +511,11 @@ void Session_Finish(void)
 
     snprintf(name, sizeof(name), "%s%s", Unix_Domain_Prefix, SPINES_UNIX_DATA_SUFFIX);
     unlink(name);
+
+#ifdef SES_HAVE_SEQPACKET
+    snprintf(name, sizeof(name), "%s%s", Unix_Domain_Prefix, SPINES_UNIX_SEQ_SUFFIX);
+    unlink(name);
+#endif
 #endif
 }
 
@@ -431,7 +550,7 @@ void Session_Accept(int sk_local, int port, void *dummy_p)
     spines_sockaddr acc_sin;
     socklen_t acc_sin_len = sizeof(acc_sin);
 
-    if (port != SESS_CTRL && port != SESS_DATA)
+    if (port != SESS_CTRL && port != SESS_DATA && port != SESS_SEQPACKET)
         return;
 
     sk = accept(sk_local, (struct sockaddr*)&acc_sin.addr, &acc_sin_len);
@@ -518,6 +637,7 @@ void Session_Accept(int sk_local, int port, void *dummy_p)
     ses->state = READY_ENDIAN;
     ses->r_data = NULL;
     ses->rel_blocked = 0;
+    ses->link_blocked = -1;
     ses->client_stat = SES_CLIENT_ON;
     ses->udp_port = -1;
     ses->recv_fd_flag = 0;
@@ -537,7 +657,21 @@ void Session_Accept(int sk_local, int port, void *dummy_p)
             Alarm(EXIT, "Session_Accept(): Cannot allocate message object\n");
     }
 
+    ses->seqpacket = (port == SESS_SEQPACKET);
+    ses->seq_buf = NULL;
+    ses->client_pid = -1;
+    ses->client_uid = -1;
+    if(ses->seqpacket) {
+        if((ses->seq_buf = (char*) new_ref_cnt(MESSAGE_OBJ))==NULL) {
+            Alarm(EXIT, "Session_Accept(): Cannot allocate message object\n");
+        }
+    }
+
     ses->frag_pkts = NULL;
+    ses->frag_tail = NULL;
+    ses->frag_bufs = 0;
+    stdhash_construct(&ses->frag_hash, sizeof(Frag_Key), sizeof(Frag_Packet*),
+                      NULL, NULL, 0);
 
     stdcarr_construct(&ses->rel_deliver_buff, sizeof(UDP_Cell*), 0);
     stdhash_construct(&ses->joined_groups, sizeof(int32), sizeof(Group_State*),
@@ -595,6 +729,447 @@ void Session_Accept(int sk_local, int port, void *dummy_p)
 
 
 
+/***********************************************************/
+/* void Session_Read_Abort(Session *ses, int reason)       */
+/*                                                         */
+/* Drops the client of a session whose input cannot be     */
+/* read any more                                           */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:    the session                                     */
+/* reason: see session.h                                   */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Session_Read_Abort(Session *ses, int reason)
+{
+    if(ses->r_data == NULL) {
+        Session_Close(ses->sess_id, reason);
+    }
+    else {
+        Disconnect_Reliable_Session(ses);
+    }
+}
+
+/***********************************************************/
+/* void Session_Read_Error(Session *ses,                   */
+/*                         int received_bytes)             */
+/*                                                         */
+/* Handles a failed read on a session socket               */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:            the session                             */
+/* received_bytes: what the read returned (0 or -1)        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Session_Read_Error(Session *ses, int received_bytes)
+{
+    Alarm(DEBUG, "\nsocket err; ret: %d; read_len: %d; partial_len: %d; STATE: %d\n",
+          received_bytes, ses->read_len, ses->partial_len, ses->state);
+
+    /* This is non-blocking socket. Not all the errors are treated as
+     * a disconnect. */
+    if(received_bytes == -1) {
+#ifndef        ARCH_PC_WIN95
+        if((errno == EWOULDBLOCK)||(errno == EAGAIN))
+#else
+#ifndef _WIN32_WCE
+        if((errno == WSAEWOULDBLOCK)||(errno == EAGAIN))
+#else
+        int sk_errno = WSAGetLastError();
+        if((sk_errno == WSAEWOULDBLOCK)||(sk_errno == EAGAIN))
+#endif /* Windows CE */
+#endif
+        {
+            Alarm(DEBUG, "EAGAIN - Session_Read()\n");
+            return;
+        }
+    }
+    Session_Read_Abort(ses, SOCK_ERR);
+}
+
+/***********************************************************/
+/* int Session_Read_Len(Session *ses, int add_size)        */
+/*                                                         */
+/* Sets up the reading of a client message whose length   */
+/* was just received in ses->total_len                     */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:      the session                                   */
+/* add_size: size of the reliable session header, if any  */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 0 on success, -1 if the client was disconnected   */
+/*                                                         */
+/***********************************************************/
+
+static int Session_Read_Len(Session *ses, int add_size)
+{
+    if(!Same_endian(ses->endianess_type)) {
+        ses->total_len = Flip_int32(ses->total_len);
+    }
+
+    /* Sanity check received length */
+    if (ses->total_len < sizeof(udp_header) || ses-> total_len > MAX_SPINES_CLIENT_MSG + sizeof(udp_header)) {
+        Alarm(PRINT, "Session_Read(): Invalid size recvd from "
+              "client: recvd %d, max = %d (client data + "
+              "udp_header)...disconnecting!\n",
+              ses->total_len, MAX_SPINES_CLIENT_MSG + sizeof(udp_header));
+
+        /* Disconnect the client */
+        Session_Read_Abort(ses, SES_DISCONNECT);
+        return(-1);
+    }
+
+
+    /* Set up to read data based on protocols used */
+    if (ses->routing_used == MIN_WEIGHT_ROUTING ||
+            ses->routing_used == SOURCE_BASED_ROUTING)
+    {
+        if(ses->total_len > MAX_SPINES_MSG + sizeof(udp_header) + add_size) {
+            ses->read_len = MAX_SPINES_MSG + sizeof(udp_header) + add_size;
+        }
+        else {
+            ses->read_len = ses->total_len;
+        }
+        ses->frag_num = (ses->total_len-sizeof(udp_header)-add_size)/MAX_SPINES_MSG;
+        if((ses->total_len-sizeof(udp_header)-add_size)%MAX_SPINES_MSG != 0) {
+            ses->frag_num++;
+        }
+        /* Allow 0-byte pkts, but still need to have 1 fragment (which
+         * will contain the udp header) */
+        if(ses->frag_num == 0) {
+            ses->frag_num++;
+        }
+        ses->frag_idx = 0;
+    }
+    else if (ses->routing_used == IT_PRIORITY_ROUTING ||
+                ses->routing_used == IT_RELIABLE_ROUTING)
+    {
+        /* Check for len < MAX_SPINES_CLIENT_MSG above makes this unnecessary */
+        /* if (ses->total_len <= 0 || ses->total_len > MAX_PACKET_SIZE * MAX_PKTS_PER_MESSAGE) { */
+        /* if (ses->total_len <= 0 || ses->total_len > (MAX_SPINES_MSG + sizeof(udp_header)) * MAX_PKTS_PER_MESSAGE) {
+            Alarm(PRINT, "Session_Read(): Invalid size recvd from "
+                  "client: recvd %d, max = %d...disconnecting!\n",
+                  ses->total_len,
+                  (MAX_SPINES_MSG + sizeof(udp_header)) * MAX_PKTS_PER_MESSAGE);
+            if(ses->r_data == NULL) {
+                Session_Close(ses->sess_id, SES_DISCONNECT);
+            }
+            else {
+                Disconnect_Reliable_Session(ses);
+            }
+        } */
+        ses->read_len = ses->total_len;
+        ses->frag_num = 1;
+        ses->frag_idx = 0;
+    }
+    else
+        Alarm(PRINT, "Session_Read: Unexpected routing_used %d\r\n",
+                    ses->routing_used);
+
+    ses->partial_len = 0;
+    ses->received_len = 0;
+    ses->seq_no++;
+    if(ses->seq_no >= 10000) {
+        ses->seq_no = 0;
+    }
+
+    ses->state = READY_DATA;
+    Alarm(DEBUG,"Finished READY_LEN, ses->read_len = %u, ses->partial_len = %u\r\n",
+                ses->read_len, ses->partial_len);
+    return(0);
+}
+
+/***********************************************************/
+/* int Session_Read_Data(Session *ses, int add_size)       */
+/*                                                         */
+/* Processes a fragment of a client message just received  */
+/* in ses->data, and sets up the reading of the next one   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:      the session                                   */
+/* add_size: size of the reliable session header, if any  */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) NO_BUFF if the session must not be used any more  */
+/*                                                         */
+/***********************************************************/
+
+static int Session_Read_Data(Session *ses, int add_size)
+{
+    udp_header *u_hdr;
+    rel_udp_pkt_add *r_add;
+    int ret;
+
+    u_hdr = (udp_header*)ses->data;
+    if(!Same_endian(ses->endianess_type)) {
+        Flip_udp_hdr(u_hdr);
+    }
+
+    if (ses->routing_used == MIN_WEIGHT_ROUTING ||
+        ses->routing_used == SOURCE_BASED_ROUTING) {
+        if(ses->frag_num > 1) {
+            if(ses->frag_idx == 0) {
+                memcpy((void*)(&ses->save_hdr), (void*)u_hdr, sizeof(udp_header));
+            }
+            u_hdr->len = ses->read_len - sizeof(udp_header);
+
+            if(ses->r_data != NULL) {
+                r_add = (rel_udp_pkt_add*)(ses->data + sizeof(udp_header));
+                r_add->type = Set_endian(0);
+                r_add->data_len = u_hdr->len - sizeof(rel_udp_pkt_add);
+                r_add->ack_len = 0;
+            }
+        }
+    }
+
+    u_hdr->seq_no = ses->seq_no;
+    u_hdr->frag_num = (int16u)ses->frag_num;
+    u_hdr->frag_idx = (int16u)ses->frag_idx;
+    u_hdr->sess_id = (int16u)(ses->sess_id & 0x0000ffff);
+
+    ses->received_len += ses->read_len;
+    if(ses->frag_idx > 0) {
+        ses->received_len -= sizeof(udp_header)+add_size;
+    }
+    ses->frag_idx++;
+
+    ret = Process_Session_Packet(ses);
+
+    if(get_ref_cnt(ses->data) > 1) {
+        dec_ref_cnt(ses->data);
+        if((ses->data = (char*) new_ref_cnt(MESSAGE_OBJ))==NULL) {
+            Alarm(EXIT, "Session_Read(): Cannot allocate packet_body\n");
+        }
+    }
+
+    if(ret == NO_BUFF){
+        return(ret);
+    }
+
+    if(ses->frag_idx == ses->frag_num) {
+        ses->read_len = sizeof(int32);
+        ses->partial_len = 0;
+        ses->state = READY_LEN;
+    }
+    else {
+        ses->read_len = ses->total_len - ses->received_len;
+        if(ses->read_len > MAX_SPINES_MSG) {
+            ses->read_len = MAX_SPINES_MSG;
+        }
+        /*
+         *Alarm(PRINT, "TOT total: %d; received: %d; read: %d\n",
+         *     ses->total_len, ses->received_len, ses->read_len);
+         */
+        memcpy((void*)(ses->data), (void*)(&ses->save_hdr), sizeof(udp_header));
+        ses->read_len += sizeof(udp_header);
+        ses->partial_len = sizeof(udp_header);
+        if(ses->r_data != NULL) {
+            ses->read_len += sizeof(rel_udp_pkt_add);
+            ses->partial_len += sizeof(rel_udp_pkt_add);
+        }
+        ses->state = READY_DATA;
+    }
+    Alarm(DEBUG,"Finished READY_DATA, ses->total_len = %u, "
+                    "ses->read_len = %u, ses->partial_len = %u\r\n",
+                    ses->total_len, ses->read_len, ses->partial_len);
+    return(ret);
+}
+
+#ifdef SES_HAVE_SEQPACKET
+
+/***********************************************************/
+/* int Session_Recv_Cred(Session *ses, sys_scatter *scat)  */
+/*                                                         */
+/* Receives the first record of a SOCK_SEQPACKET session   */
+/* together with the credentials of the client, which     */
+/* the kernel checked                                      */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:  the session                                       */
+/* scat: where to put the record                           */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) what recvmsg() returned                           */
+/*                                                         */
+/***********************************************************/
+
+static int Session_Recv_Cred(Session *ses, sys_scatter *scat)
+{
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    struct ucred cred;
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+    int ret;
+
+    iov.iov_base = scat->elements[0].buf;
+    iov.iov_len = scat->elements[0].len;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+
+    ret = recvmsg(ses->sk, &mh, 0);
+    if(ret <= 0) {
+        return(ret);
+    }
+    if(mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        errno = EMSGSIZE;
+        return(-1);
+    }
+
+    for(cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS &&
+           cmsg->cmsg_len == CMSG_LEN(sizeof(struct ucred))) {
+            memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+            ses->client_pid = (int32)cred.pid;
+            ses->client_uid = (int32)cred.uid;
+        }
+    }
+    return(ret);
+}
+
+/***********************************************************/
+/* int Session_Check_Ctrl_Peer(Session *ses)               */
+/*                                                         */
+/* Checks that the control channel a SOCK_SEQPACKET client */
+/* claims was opened by the same process                   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:  the session                                       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 0 if it was, -1 otherwise                         */
+/*                                                         */
+/***********************************************************/
+
+static int Session_Check_Ctrl_Peer(Session *ses)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if(getsockopt(ses->ctrl_sk, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+       len != sizeof(cred)) {
+        return(-1);
+    }
+    if((int32)cred.pid != ses->client_pid || (int32)cred.uid != ses->client_uid) {
+        return(-1);
+    }
+    return(0);
+}
+
+/***********************************************************/
+/* void Session_Read_Record(Session *ses, int add_size)    */
+/*                                                         */
+/* Reads a whole client message from a SOCK_SEQPACKET      */
+/* session with a single system call and processes all its */
+/* fragments                                               */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:      the session                                   */
+/* add_size: size of the reliable session header, if any  */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Session_Read_Record(Session *ses, int add_size)
+{
+    struct msghdr mh;
+    struct iovec iov[3];
+    int32 total_len;
+    int received_bytes, off, len;
+
+    /* A record is [len][udp_header][data]. The first fragment goes
+     * straight to ses->data and the rest of a fragmented message to
+     * ses->seq_buf, so that sending the first fragment cannot clobber
+     * the following ones */
+    iov[0].iov_base = (char*)&total_len;
+    iov[0].iov_len = sizeof(int32);
+    iov[1].iov_base = ses->data;
+    if (ses->routing_used == MIN_WEIGHT_ROUTING ||
+            ses->routing_used == SOURCE_BASED_ROUTING) {
+        iov[1].iov_len = MAX_SPINES_MSG + sizeof(udp_header) + add_size;
+    }
+    else {
+        iov[1].iov_len = MAX_SPINES_CLIENT_MSG + sizeof(udp_header);
+    }
+    iov[2].iov_base = ses->seq_buf;
+    iov[2].iov_len = MAX_SPINES_CLIENT_MSG + sizeof(udp_header);
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 3;
+
+    received_bytes = recvmsg(ses->sk, &mh, 0);
+    if(received_bytes <= 0) {
+        Session_Read_Error(ses, received_bytes);
+        return;
+    }
+    if(received_bytes < (int)sizeof(int32)) {
+        Alarm(PRINT, "Session_Read(): Short record (%d bytes) from client"
+              "...disconnecting!\n", received_bytes);
+        Session_Read_Abort(ses, SES_DISCONNECT);
+        return;
+    }
+
+    ses->total_len = total_len;
+    if(Session_Read_Len(ses, add_size) < 0) {
+        return;
+    }
+    if((mh.msg_flags & MSG_TRUNC) ||
+       received_bytes != (int)sizeof(int32) + ses->total_len) {
+        Alarm(PRINT, "Session_Read(): Record of %d bytes does not match its "
+              "length %d...disconnecting!\n", received_bytes, ses->total_len);
+        Session_Read_Abort(ses, SES_DISCONNECT);
+        return;
+    }
+
+    /* The record is out of the socket, so all of its fragments are
+     * processed now even if the session gets blocked on the way. The
+     * blocking takes effect with the next record */
+    off = 0;
+    while(ses->state == READY_DATA) {
+        if(Session_Read_Data(ses, add_size) == NO_BUFF) {
+            return;
+        }
+        if(ses->state != READY_DATA) {
+            break;
+        }
+        len = ses->read_len - ses->partial_len;
+        memcpy(ses->data + ses->partial_len, ses->seq_buf + off, len);
+        off += len;
+        ses->partial_len = ses->read_len;
+    }
+}
+
+#endif /* SES_HAVE_SEQPACKET */
+
 /***********************************************************/
 /* void Session_Read(int sk, int dummy, void *dummy_p)     */
 /*                                                         */
@@ -616,12 +1191,10 @@ void Session_Accept(int sk_local, int port, void *dummy_p)
 void Session_Read(int sk, int dummy, void *dummy_p)
 {
     sys_scatter scat;
-    udp_header *u_hdr;
-    rel_udp_pkt_add *r_add;
     Session *ses;
     stdit it;
     int received_bytes;
-    int ret, add_size, i;
+    int add_size, i;
 
     stdhash_find(&Sessions_Sock, &it, &sk);
     if(stdhash_is_end(&Sessions_Sock, &it)) {
@@ -630,64 +1203,40 @@ void Session_Read(int sk, int dummy, void *dummy_p)
     }
     ses = *((Session **)stdhash_it_val(&it));
 
+    if(ses->r_data != NULL) {
+        add_size = sizeof(rel_udp_pkt_add);
+    }
+    else {
+        add_size = 0;
+    }
+
+#ifdef SES_HAVE_SEQPACKET
+    if(ses->seqpacket && ses->state == READY_LEN) {
+        Session_Read_Record(ses, add_size);
+        return;
+    }
+#endif
+
     scat.num_elements = 1;
     scat.elements[0].len = ses->read_len - ses->partial_len;
     scat.elements[0].buf = (char*)(ses->data + ses->partial_len);
 
+#ifdef SES_HAVE_SEQPACKET
+    if(ses->seqpacket) {
+        received_bytes = Session_Recv_Cred(ses, &scat);
+    }
+    else
+#endif
     received_bytes = DL_recv(ses->sk, &scat);
 
     if(received_bytes <= 0) {
-
-        Alarm(DEBUG, "\nsocket err; len: %d; read_len: %d; partial_len: %d; STATE: %d\n",  
-              scat.elements[0].len, ses->read_len, ses->partial_len, ses->state);
-
-        /* This is non-blocking socket. Not all the errors are treated as
-         * a disconnect. */
-        if(received_bytes == -1) {
-#ifndef        ARCH_PC_WIN95
-            if((errno == EWOULDBLOCK)||(errno == EAGAIN))
-#else
-#ifndef _WIN32_WCE
-            if((errno == WSAEWOULDBLOCK)||(errno == EAGAIN))
-#else
-            int sk_errno = WSAGetLastError();
-            if((sk_errno == WSAEWOULDBLOCK)||(sk_errno == EAGAIN))
-#endif /* Windows CE */
-#endif
-            {
-                Alarm(DEBUG, "EAGAIN - Session_Read()\n");
-                return;
-            }
-            else {
-                if(ses->r_data == NULL) {
-                    Session_Close(ses->sess_id, SOCK_ERR);
-                }
-                else {
-                    Disconnect_Reliable_Session(ses);
-                }
-            }
-        }
-        else {
-            if(ses->r_data == NULL) {
-                Session_Close(ses->sess_id, SOCK_ERR);
-            }
-            else {
-                Disconnect_Reliable_Session(ses);
-            }
-        }
+        Session_Read_Error(ses, received_bytes);
         return;
     }
 
     if(received_bytes + ses->partial_len > ses->read_len)
         Alarm(EXIT, "Session_Read(): Too many bytes...\n");
 
-    if(ses->r_data != NULL) {
-        add_size = sizeof(rel_udp_pkt_add);
-    }
-    else {
-        add_size = 0;
-    }
-
     /*
      *Alarm(DEBUG, "* received_bytes: %d; partial_len: %d; read_len: %d; STATE: %d\n",
      *          received_bytes, ses->partial_len, ses->read_len, ses->state);
@@ -698,6 +1247,11 @@ void Session_Read(int sk, int dummy, void *dummy_p)
     }
     else {
         if(ses->state == READY_ENDIAN) {
+            if(ses->seqpacket && ses->client_pid == -1) {
+                Alarm(PRINT, "Session_Read(): No credentials from client on %d\n", ses->sk);
+                Session_Close(ses->sess_id, SOCK_ERR);
+                return;
+            }
             ses->endianess_type = *((int32*)(ses->data));
 
             ses->received_len = 0;
@@ -719,165 +1273,30 @@ void Session_Read(int sk, int dummy, void *dummy_p)
                 Session_Close(ses->sess_id, SOCK_ERR);
                 return;
             }
+#ifdef SES_HAVE_SEQPACKET
+            if (ses->seqpacket && Session_Check_Ctrl_Peer(ses) < 0) {
+                Alarm(PRINT, "Session_Read(): Control channel %d does not belong to "
+                      "client pid %d\n", ses->ctrl_sk, ses->client_pid);
+                Session_Close(ses->sess_id, SOCK_ERR);
+                return;
+            }
+#endif
             Alarm(PRINT, "linked Spines Socket Channel %d with Control Channel %d\n", ses->sk, ses->ctrl_sk);
+            if (ses->seqpacket) {
+                Alarm(PRINT, "Channel %d is a seqpacket session of pid %d, uid %d\n",
+                      ses->sk, ses->client_pid, ses->client_uid);
+            }
             ses->received_len = 0;
             ses->read_len = sizeof(int32);
             ses->partial_len = 0;
             ses->state = READY_LEN;
         }
-        else if(ses->state == READY_LEN) {
-            ses->total_len = *((int32*)(ses->data));
-            if(!Same_endian(ses->endianess_type)) {
-                ses->total_len = Flip_int32(ses->total_len);
-            }
-
-            /* Sanity check received length */
-            if (ses->total_len < sizeof(udp_header) || ses-> total_len > MAX_SPINES_CLIENT_MSG + sizeof(udp_header)) {
-                Alarm(PRINT, "Session_Read(): Invalid size recvd from "
-                      "client: recvd %d, max = %d (client data + "
-                      "udp_header)...disconnecting!\n",
-                      ses->total_len, MAX_SPINES_CLIENT_MSG + sizeof(udp_header));
-                
-                /* Disconnect the client */
-                if(ses->r_data == NULL) {
-                    Session_Close(ses->sess_id, SES_DISCONNECT);
-                }
-                else {
-                    Disconnect_Reliable_Session(ses);
-                }
-            }
-                
-
-            /* Set up to read data based on protocols used */
-            if (ses->routing_used == MIN_WEIGHT_ROUTING || 
-                    ses->routing_used == SOURCE_BASED_ROUTING) 
-            {
-                if(ses->total_len > MAX_SPINES_MSG + sizeof(udp_header) + add_size) {
-                    ses->read_len = MAX_SPINES_MSG + sizeof(udp_header) + add_size;
-                }
-                else {
-                    ses->read_len = ses->total_len;
-                }
-                ses->frag_num = (ses->total_len-sizeof(udp_header)-add_size)/MAX_SPINES_MSG;
-                if((ses->total_len-sizeof(udp_header)-add_size)%MAX_SPINES_MSG != 0) {
-                    ses->frag_num++;
-                }
-                /* Allow 0-byte pkts, but still need to have 1 fragment (which
-                 * will contain the udp header) */
-                if(ses->frag_num == 0) {
-                    ses->frag_num++;
-                }
-                ses->frag_idx = 0;
-            }
-            else if (ses->routing_used == IT_PRIORITY_ROUTING ||
-                        ses->routing_used == IT_RELIABLE_ROUTING) 
-            {
-                /* Check for len < MAX_SPINES_CLIENT_MSG above makes this unnecessary */
-                /* if (ses->total_len <= 0 || ses->total_len > MAX_PACKET_SIZE * MAX_PKTS_PER_MESSAGE) { */
-                /* if (ses->total_len <= 0 || ses->total_len > (MAX_SPINES_MSG + sizeof(udp_header)) * MAX_PKTS_PER_MESSAGE) {
-                    Alarm(PRINT, "Session_Read(): Invalid size recvd from "
-                          "client: recvd %d, max = %d...disconnecting!\n",
-                          ses->total_len,
-                          (MAX_SPINES_MSG + sizeof(udp_header)) * MAX_PKTS_PER_MESSAGE);
-                    if(ses->r_data == NULL) {
-                        Session_Close(ses->sess_id, SES_DISCONNECT);
-                    }
-                    else {
-                        Disconnect_Reliable_Session(ses);
-                    }
-                } */
-                ses->read_len = ses->total_len;
-                ses->frag_num = 1;
-                ses->frag_idx = 0;
-            }
-            else
-                Alarm(PRINT, "Session_Read: Unexpected routing_used %d\r\n",
-                            ses->routing_used);
-
-            ses->partial_len = 0;
-            ses->received_len = 0;
-            ses->seq_no++;
-            if(ses->seq_no >= 10000) {
-                ses->seq_no = 0;
-            }
-
-            ses->state = READY_DATA;
-            Alarm(DEBUG,"Finished READY_LEN, ses->read_len = %u, ses->partial_len = %u\r\n",
-                        ses->read_len, ses->partial_len);
-        }
-        else if(ses->state == READY_DATA) {
-            u_hdr = (udp_header*)ses->data;
-            if(!Same_endian(ses->endianess_type)) {
-                Flip_udp_hdr(u_hdr);
-            }
-            
-            if (ses->routing_used == MIN_WEIGHT_ROUTING ||
-                ses->routing_used == SOURCE_BASED_ROUTING) {
-                if(ses->frag_num > 1) {
-                    if(ses->frag_idx == 0) {
-                        memcpy((void*)(&ses->save_hdr), (void*)u_hdr, sizeof(udp_header));
-                    }
-                    u_hdr->len = ses->read_len - sizeof(udp_header);
-                    
-                    if(ses->r_data != NULL) {
-                        r_add = (rel_udp_pkt_add*)(ses->data + sizeof(udp_header));
-                        r_add->type = Set_endian(0);
-                        r_add->data_len = u_hdr->len - sizeof(rel_udp_pkt_add);
-                        r_add->ack_len = 0;
-                    }
-                }
-            }
-            
-            u_hdr->seq_no = ses->seq_no;
-            u_hdr->frag_num = (int16u)ses->frag_num; 
-            u_hdr->frag_idx = (int16u)ses->frag_idx; 
-            u_hdr->sess_id = (int16u)(ses->sess_id & 0x0000ffff);
-
-            ses->received_len += ses->read_len;
-            if(ses->frag_idx > 0) {
-                ses->received_len -= sizeof(udp_header)+add_size;
-            } 
-            ses->frag_idx++;
-
-            ret = Process_Session_Packet(ses);
-           
-            if(get_ref_cnt(ses->data) > 1) {
-                dec_ref_cnt(ses->data);
-                if((ses->data = (char*) new_ref_cnt(MESSAGE_OBJ))==NULL) {
-                    Alarm(EXIT, "Session_Read(): Cannot allocate packet_body\n");
-                }
-            }
-
-            if(ret == NO_BUFF){
-                return;
-            }
-
-            if(ses->frag_idx == ses->frag_num) {
-                ses->read_len = sizeof(int32);
-                ses->partial_len = 0;
-                ses->state = READY_LEN;
-            }
-            else {
-                ses->read_len = ses->total_len - ses->received_len;
-                if(ses->read_len > MAX_SPINES_MSG) {
-                    ses->read_len = MAX_SPINES_MSG;
-                }
-                /*
-                 *Alarm(PRINT, "TOT total: %d; received: %d; read: %d\n",
-                 *     ses->total_len, ses->received_len, ses->read_len);
-                 */
-                memcpy((void*)(ses->data), (void*)(&ses->save_hdr), sizeof(udp_header));
-                ses->read_len += sizeof(udp_header);
-                ses->partial_len = sizeof(udp_header);
-                if(ses->r_data != NULL) {
-                    ses->read_len += sizeof(rel_udp_pkt_add);
-                    ses->partial_len += sizeof(rel_udp_pkt_add);
-                }
-                ses->state = READY_DATA;
-            }
-            Alarm(DEBUG,"Finished READY_DATA, ses->total_len = %u, "
-                            "ses->read_len = %u, ses->partial_len = %u\r\n",
-                            ses->total_len, ses->read_len, ses->partial_len);
+        else if(ses->state == READY_LEN) {
+            ses->total_len = *((int32*)(ses->data));
+            Session_Read_Len(ses, add_size);
+        }
+        else if(ses->state == READY_DATA) {
+            Session_Read_Data(ses, add_size);
         }
     }
 }
@@ -912,8 +1331,6 @@ void Session_Close(int sesid, int reason)
     int32 dummy_port;
     Group_State *g_state;
     int cnt = 0;
-    int i;
-    Frag_Packet *frag_pkt;
 
 
     /* Get the session */
@@ -968,17 +1385,9 @@ void Session_Close(int sesid, int reason)
         dec_ref_cnt(ses->data);
         ses->data = NULL;
     }
-
-    /* Dispose all the incomplete fragmented packets */
-    while(ses->frag_pkts != NULL) {
-        frag_pkt = ses->frag_pkts;
-        ses->frag_pkts = ses->frag_pkts->next;
-        for(i=0; i<frag_pkt->scat.num_elements; i++) {
-            if(frag_pkt->scat.elements[i].buf != NULL) {
-                dec_ref_cnt(frag_pkt->scat.elements[i].buf);
-            }
-        }
-        dispose(frag_pkt);
+    if(ses->seq_buf != NULL) {
+        dec_ref_cnt(ses->seq_buf);
+        ses->seq_buf = NULL;
     }
 
     /* Remove the reliability data structures */
@@ -1043,6 +1452,13 @@ void Session_Close(int sesid, int reason)
         }
     }
 
+    /* Dispose all the incomplete fragmented packets */
+    while(ses->frag_pkts != NULL) {
+        Delete_Frag_Element(ses, ses->frag_pkts);
+    }
+    E_dequeue(Session_Expire_Frags, sesid, NULL);
+    stdhash_destruct(&ses->frag_hash);
+
     /* Dispose the session */
     dispose(ses);
 }
@@ -1664,6 +2080,18 @@ int Process_Session_Packet(Session *ses)
             read_ptr = ses->data;
             link_overhead = Link_Header_Size(Get_Ses_Mode(ses->links_used));
 
+            /* Datagrams from Session_UDP_Read already sit in a packet body,
+             * which is sent as it is instead of being copied */
+            if (Mem_Obj_Type(ses->data) == PACK_BODY_OBJ &&
+                remaining + link_overhead + sizeof(fragment_header) <= MAX_PACKET_SIZE)
+            {
+                inc_ref_cnt(ses->data);
+                ses->scat->elements[i].buf = ses->data;
+                ses->scat->elements[i].len = remaining;
+                ses->scat->num_elements++;
+                remaining = 0;
+            }
+
             while (remaining > 0) {
                 if ((ses->scat->elements[i].buf = new_ref_cnt(PACK_BODY_OBJ)) == NULL)
                     Alarm(EXIT, "Process_Session_Packet: Could not allocate packet_body\r\n");
@@ -1699,7 +2127,7 @@ int Process_Session_Packet(Session *ses)
 }
 
 /***********************************************************/
-/* int Session_Send_Message(session *ses)                  */
+/* int Session_Route_Message(session *ses)                 */
 /*                                                         */
 /* Prepares and Sends Message from Session                 */
 /*                                                         */
@@ -1713,10 +2141,10 @@ int Process_Session_Packet(Session *ses)
 /* (int) return value                                      */
 /*                                                         */
 /***********************************************************/
-int Session_Send_Message(Session *ses)
+static int Session_Route_Message(Session *ses)
 {
     udp_header *hdr;
-    int i, ret, routing, prot_sig_len = 0;
+    int i, ret, routing, prot_sig_len = 0, batched = 0;
     unsigned int sign_len;
     stdit ip_it;
     int32 src_id, dst_id;
@@ -1747,7 +2175,7 @@ int Session_Send_Message(Session *ses)
     else if (routing == SOURCE_BASED_ROUTING) {
         i = ses->scat->num_elements;
         if ((ses->scat->elements[i].buf = new_ref_cnt(PACK_BODY_OBJ)) == NULL)
-            Alarm(EXIT, "Session_Send_Message: Could not allocate packet body for s_hdr\r\n");
+            Alarm(EXIT, "Session_Route_Message: Could not allocate packet body for s_hdr\r\n");
         ses->scat->elements[i].len = sizeof(sb_header);
         ses->scat->num_elements++;
 
@@ -1762,7 +2190,7 @@ int Session_Send_Message(Session *ses)
             if (My_Source_Seq == 0) {
                 My_Source_Seq++;
                 My_Source_Incarnation++;
-                Alarm(PRINT, "Session_Send_Message: My_Source_Seq rolled over! "
+                Alarm(PRINT, "Session_Route_Message: My_Source_Seq rolled over! "
                       "Incrementing incarnation to %u\n", My_Source_Incarnation);
             }
             Alarm(DEBUG, "Sending with source seq %u, incarnation %u\n", My_Source_Seq, My_Source_Incarnation);
@@ -1773,7 +2201,7 @@ int Session_Send_Message(Session *ses)
         /* Look for the destination (target) of the message in the lookup table */
         if(Is_mcast_addr(hdr->dest) || Is_acast_addr(hdr->dest)) {
             if (ses->disjoint_paths != 0) {
-                Alarm(PRINT, "Session_Send_Message: can only do multicast with Flooding\r\n");
+                Alarm(PRINT, "Session_Route_Message: can only do multicast with Flooding\r\n");
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
                 return NO_ROUTE;
             }
@@ -1782,7 +2210,7 @@ int Session_Send_Message(Session *ses)
         else {
             stdhash_find(&Node_Lookup_Addr_to_ID, &ip_it, &hdr->dest);
             if (stdhash_is_end(&Node_Lookup_Addr_to_ID,  &ip_it)) {
-                Alarm(PRINT, "Session_Send_Message: \
+                Alarm(PRINT, "Session_Route_Message: \
                             destination not in config file\r\n");
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
                 return NO_ROUTE;
@@ -1804,7 +2232,7 @@ int Session_Send_Message(Session *ses)
         
         i = ses->scat->num_elements;
         if ((ses->scat->elements[i].buf = new_ref_cnt(PACK_BODY_OBJ)) == NULL)
-            Alarm(EXIT, "Session_Send_Message: Could not allocate packet body for f_hdr\r\n");
+            Alarm(EXIT, "Session_Route_Message: Could not allocate packet body for f_hdr\r\n");
         ses->scat->elements[i].len = 0;
         ses->scat->num_elements++;
 
@@ -1828,7 +2256,7 @@ int Session_Send_Message(Session *ses)
         /* Look for the destination (target) of the message in the lookup table */
         if(Is_mcast_addr(hdr->dest) || Is_acast_addr(hdr->dest)) {
             if (ses->disjoint_paths != 0) {
-                Alarm(PRINT, "Session_Send_Message: can only do multicast with Flooding\r\n");
+                Alarm(PRINT, "Session_Route_Message: can only do multicast with Flooding\r\n");
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
                 return NO_ROUTE;
             }
@@ -1837,7 +2265,7 @@ int Session_Send_Message(Session *ses)
         else {
             stdhash_find(&Node_Lookup_Addr_to_ID, &ip_it, &hdr->dest);
             if (stdhash_is_end(&Node_Lookup_Addr_to_ID,  &ip_it)) {
-                Alarm(PRINT, "Session_Send_Message: destination \
+                Alarm(PRINT, "Session_Route_Message: destination \
                     "IPF" not in config file\n", IP(hdr->dest));
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
                 return NO_ROUTE;
@@ -1860,7 +2288,7 @@ int Session_Send_Message(Session *ses)
         /* Look for the source (originator) of the message in the lookup table */
         stdhash_find(&Node_Lookup_Addr_to_ID, &ip_it, &My_Address);
         if (stdhash_is_end(&Node_Lookup_Addr_to_ID,  &ip_it)) {
-            Alarm(PRINT, "Session_Send_Message: source not in config file\r\n");
+            Alarm(PRINT, "Session_Route_Message: source not in config file\r\n");
             Cleanup_Scatter(ses->scat); ses->scat = NULL;
             return(NO_ROUTE);
         }
@@ -1869,7 +2297,7 @@ int Session_Send_Message(Session *ses)
         /* Look for the destination of the message in the lookup table */
         stdhash_find(&Node_Lookup_Addr_to_ID, &ip_it, &hdr->dest);
         if (stdhash_is_end(&Node_Lookup_Addr_to_ID,  &ip_it)) {
-            Alarm(PRINT, "Session_Send_Message: dest not in config file\r\n");
+            Alarm(PRINT, "Session_Route_Message: dest not in config file\r\n");
             Cleanup_Scatter(ses->scat); ses->scat = NULL;
             return(NO_ROUTE);
         }
@@ -1881,10 +2309,10 @@ int Session_Send_Message(Session *ses)
          *    (1) silently drop messages  */
         if (Reliable_Flood_Can_Flow_Send(ses, dst_id) == 0) {
             if (ses->session_semantics == RELIABLE_STREAM_SESSION) {
-                Alarm(DEBUG, "Session_Send_Message: RELIABLE_STREAM SESSION to %d\r\n", dst_id);
+                Alarm(DEBUG, "Session_Route_Message: RELIABLE_STREAM SESSION to %d\r\n", dst_id);
                 Reliable_Flood_Block_Session(ses, dst_id);
             } else { /* ses->session_semantics == RELIABLE_DGRAM_SESSION_NO_BACKPRESSURE */
-                Alarm(PRINT, "Session_Send_Message: RELIABLE_DGRAM_NO_BACKPRESSURE: dropping msg to %d\r\n", dst_id);
+                Alarm(PRINT, "Session_Route_Message: RELIABLE_DGRAM_NO_BACKPRESSURE: dropping msg to %d\r\n", dst_id);
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
             }
             return NO_ROUTE;
@@ -1893,7 +2321,7 @@ int Session_Send_Message(Session *ses)
         /* Getting here means that we can send right now */
         i = ses->scat->num_elements;
         if ((ses->scat->elements[i].buf = new_ref_cnt(PACK_BODY_OBJ)) == NULL)
-            Alarm(EXIT, "Session_Send_Message: Could not allocate packet body for r_hdr\r\n");
+            Alarm(EXIT, "Session_Route_Message: Could not allocate packet body for r_hdr\r\n");
         ses->scat->elements[i].len = 0;
         ses->scat->num_elements++;
         
@@ -1947,11 +2375,11 @@ int Session_Send_Message(Session *ses)
 
         md_ctx = EVP_MD_CTX_new();
         if (md_ctx==NULL) {
-            Alarm(EXIT, "Session_Send_Message: EVP_MD_CTX_new failed\r\n");
+            Alarm(EXIT, "Session_Route_Message: EVP_MD_CTX_new failed\r\n");
         }
         ret = EVP_SignInit(md_ctx, EVP_sha256()); 
         if (ret != 1) {
-            Alarm(PRINT, "Session_Send_Message: SignInit failed\r\n");
+            Alarm(PRINT, "Session_Route_Message: SignInit failed\r\n");
             Cleanup_Scatter(ses->scat); ses->scat = NULL;
             cr_ret = NO_ROUTE;
             goto cr_return;
@@ -1963,27 +2391,38 @@ int Session_Send_Message(Session *ses)
         for (i = 1; i < ses->scat->num_elements; i++) {
             ret = EVP_SignUpdate(md_ctx, (unsigned char*)ses->scat->elements[i].buf, ses->scat->elements[i].len);
             if (ret != 1) {
-                Alarm(PRINT, "Session_Send_Message: SignUpdate failed\r\n");
+                Alarm(PRINT, "Session_Route_Message: SignUpdate failed\r\n");
                 Cleanup_Scatter(ses->scat); ses->scat = NULL;
                 cr_ret = NO_ROUTE;
                 goto cr_return;
             }
         }
-        ret = EVP_SignFinal(md_ctx, sign_ptr, &sign_len, Priv_Key);
-        if (ret != 1) {
-            Alarm(PRINT, "Session_Send_Message: SignFinal failed\r\n");
-            Cleanup_Scatter(ses->scat); ses->scat = NULL;
-            cr_ret = NO_ROUTE;
-            goto cr_return;
-        }
-        if (sign_len != prot_sig_len) {
-            Alarm(PRINT, "Session_Send_Message: sign_len (%d) != Key_Len (%d)\r\n",
-                            sign_len, prot_sig_len);
-            Cleanup_Scatter(ses->scat); ses->scat = NULL;
-            cr_ret = NO_ROUTE;
-            goto cr_return;
+        /* In batch mode the signature is added when the batch is flushed */
+        if (routing == IT_PRIORITY_ROUTING && Conf_Prio.Sig_Batch_USec > 0) {
+            if (Priority_Flood_Batch_Add(ses->scat, Get_Ses_Mode(ses->links_used), 
+                                         md_ctx, sign_ptr) == 0) {
+                Cleanup_Scatter(ses->scat); ses->scat = NULL;
+                cr_ret = NO_ROUTE;
+                goto cr_return;
+            }
+            batched = 1;
+        } else {
+            ret = Sec_sign_final(md_ctx, sign_ptr, &sign_len, Priv_Key);
+            if (ret != 1) {
+                Alarm(PRINT, "Session_Route_Message: SignFinal failed\r\n");
+                Cleanup_Scatter(ses->scat); ses->scat = NULL;
+                cr_ret = NO_ROUTE;
+                goto cr_return;
+            }
+            if (sign_len != prot_sig_len) {
+                Alarm(PRINT, "Session_Route_Message: sign_len (%d) != Key_Len (%d)\r\n",
+                                sign_len, prot_sig_len);
+                Cleanup_Scatter(ses->scat); ses->scat = NULL;
+                cr_ret = NO_ROUTE;
+                goto cr_return;
+            }
+            ses->scat->elements[ses->scat->num_elements-1].len += prot_sig_len;
         }
-        ses->scat->elements[ses->scat->num_elements-1].len += prot_sig_len;
         hdr->ttl = temp_ttl;
         if (Path_Stamp_Debug == 1) {
             for (i = 0; i<8; i++) {
@@ -1994,13 +2433,19 @@ int Session_Send_Message(Session *ses)
         cr_return:
             EVP_MD_CTX_free(md_ctx);
             if (cr_ret != BUFF_OK) return cr_ret;
+
+        /* The batch owns the message now */
+        if (batched) {
+            ses->scat = NULL;
+            return BUFF_OK;
+        }
     }
 
     /* For Reliable, Add the Hop-By-Hop Tail */
     if (routing == IT_RELIABLE_ROUTING) {
         /* Create the scat element for the reliable_flood tail */
         if ((ses->scat->elements[ses->scat->num_elements].buf = new_ref_cnt(PACK_BODY_OBJ)) == NULL)
-            Alarm(EXIT, "Session_Send_Message: Could not allocate packet body for f_hdr\r\n");
+            Alarm(EXIT, "Session_Route_Message: Could not allocate packet body for f_hdr\r\n");
         ses->scat->elements[ses->scat->num_elements].len = sizeof(rel_flood_tail);
         rt = (rel_flood_tail*)(ses->scat->elements[ses->scat->num_elements].buf);
         rt->ack_len = 0;
@@ -2014,6 +2459,35 @@ int Session_Send_Message(Session *ses)
     return ret;
 }
 
+/***********************************************************/
+/* int Session_Send_Message(session *ses)                  */
+/*                                                         */
+/* Prepares and Sends Message from Session, charging any   */
+/* link that fills up while sending it to this session     */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ses:  pointer to the session creating this message      */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) return value                                      */
+/*                                                         */
+/***********************************************************/
+int Session_Send_Message(Session *ses)
+{
+    Session *charged;
+    int ret;
+
+    charged = Link_Charged_Session;
+    Link_Charged_Session = ses;
+    ret = Session_Route_Message(ses);
+    Link_Charged_Session = charged;
+
+    return ret;
+}
+
 /***********************************************************/
 /* int Deliver_UDP_Data(sys_scatter* scat, int32u type)    */
 /*                                                         */
@@ -2199,11 +2673,13 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
     UDP_Cell *u_cell;
     sys_scatter scat;
     int32 total_bytes;
-    int ret, found_frag_packet, cnt, i, j, stop_flag;
+    int ret, i, j, stop_flag;
     int32 sum_len, send_len;
     udp_header *u_hdr;
     udp_header *first_frag_udp_hdr = NULL;
     Frag_Packet *frag_pkt;
+    Frag_Key frag_key;
+    stdit h_it;
     sp_time now;
     int32 *pkt_no;
     sp_time *t1, send_time, diff;
@@ -2225,58 +2701,64 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
 
             now = E_get_time();
 
+            if((u_hdr->frag_num > MAX_PKTS_PER_MESSAGE)||
+               (u_hdr->frag_idx < 0)||(u_hdr->frag_idx >= u_hdr->frag_num)) {
+                Alarm(DEBUG, "Invalid fragment %d of %d. Drop it\n",
+                      u_hdr->frag_idx, u_hdr->frag_num);
+                return(BUFF_DROP);
+            }
+
             /* Search for other fragments of the same packet */
-            found_frag_packet = FALSE;
-            cnt = 0;
-            frag_pkt = ses->frag_pkts;
-            while(frag_pkt != NULL) {
-                if(now.sec - frag_pkt->timestamp_sec > FRAG_TTL) {
-                    /* This is an old incomplete packet. Discard it */
-            
-                    Alarm(DEBUG, "Old incomplete packet. Delete it\n");
+            memset(&frag_key, 0, sizeof(frag_key));
+            frag_key.sender   = u_hdr->source;
+            frag_key.sess_id  = u_hdr->sess_id;
+            frag_key.seq_no   = u_hdr->seq_no;
+            frag_key.snd_port = u_hdr->source_port;
 
-                    frag_pkt = Delete_Frag_Element(&ses->frag_pkts, frag_pkt);
-                    continue;
-                }
+            stdhash_find(&ses->frag_hash, &h_it, &frag_key);
+            if(!stdhash_is_end(&ses->frag_hash, &h_it)) {
+                /* This is a fragmented packet that we were looking for */
+                frag_pkt = *((Frag_Packet **)stdhash_it_val(&h_it));
 
-                /* This is not an expired packet */
+                Alarm(DEBUG, "Found the packet\n");
 
-                cnt++;
-                if((frag_pkt->sess_id == u_hdr->sess_id)&&
-                   (frag_pkt->sender == u_hdr->source)&&
-                   (frag_pkt->snd_port == u_hdr->source_port)&&
-                   (frag_pkt->seq_no == u_hdr->seq_no)) {
+                if((frag_pkt->scat.num_elements != u_hdr->frag_num)||
+                   (frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].buf != NULL)) {
 
-                    /* This is a fragmented packet that we were looking for */
+                    Alarm(DEBUG, "Corrupt packet. Delete it\n");
 
-                    Alarm(DEBUG, "Found the packet\n");
+                    Delete_Frag_Element(ses, frag_pkt);
+                    return(BUFF_DROP);
+                }
 
-                    if((frag_pkt->scat.num_elements != u_hdr->frag_num)||
-                       (frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].buf != NULL)) {
+                /* Insert the fragment into the packet */
 
-                        Alarm(DEBUG, "Corrupt packet. Delete it\n");
+                frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].buf = buff;
+                inc_ref_cnt(buff);
+                frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].len = u_hdr->len + sizeof(udp_header);
+                frag_pkt->recv_elements++;
+                frag_pkt->timestamp_sec = now.sec;
 
-                        Delete_Frag_Element(&ses->frag_pkts, frag_pkt);
-                        return(BUFF_DROP);
+                /* Move it to the front of the list, which is kept in
+                 * update order for expiration */
+                if(frag_pkt->prev != NULL) {
+                    frag_pkt->prev->next = frag_pkt->next;
+                    if(frag_pkt->next != NULL) {
+                        frag_pkt->next->prev = frag_pkt->prev;
                     }
-
-                    /* Insert the fragment into the packet */
-
-                    frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].buf = buff;
-                    inc_ref_cnt(buff);
-                    frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].len = u_hdr->len + sizeof(udp_header);
-                    frag_pkt->recv_elements++;
-                    frag_pkt->timestamp_sec = now.sec;
-                    found_frag_packet = TRUE;
-                    break;
+                    else {
+                        ses->frag_tail = frag_pkt->prev;
+                    }
+                    frag_pkt->prev = NULL;
+                    frag_pkt->next = ses->frag_pkts;
+                    ses->frag_pkts->prev = frag_pkt;
+                    ses->frag_pkts = frag_pkt;
                 }
-                frag_pkt = frag_pkt->next;
             }
+            else {
+                Alarm(DEBUG, "Couldn't find a fragmented packet. Total: %d; Create a new one\n",
+                      stdhash_size(&ses->frag_hash));
 
-            if(found_frag_packet == FALSE) {
-                Alarm(DEBUG, "Couldn't find a fragmented packet. Total: %d; Create a new one\n", cnt);
-
-                cnt++;
                 if((frag_pkt = new(FRAG_PKT)) == NULL) {
                     Alarm(EXIT, "Could not allocate memory\n");
                 }
@@ -2291,19 +2773,30 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
                 frag_pkt->scat.elements[(int)(u_hdr->frag_idx)].len = u_hdr->len + sizeof(udp_header);
 
                 frag_pkt->recv_elements = 1;
-                frag_pkt->sess_id = u_hdr->sess_id;
-                frag_pkt->seq_no = u_hdr->seq_no;
-                frag_pkt->snd_port = u_hdr->source_port;
-                frag_pkt->sender = u_hdr->source;
+                frag_pkt->key = frag_key;
                 frag_pkt->timestamp_sec = now.sec;
                 
-                /* Insert the fragmented packet into the linked list */
+                /* Insert the fragmented packet at the front of the list */
                 if(ses->frag_pkts != NULL) {
                     ses->frag_pkts->prev = frag_pkt;
                 }
+                else {
+                    ses->frag_tail = frag_pkt;
+                    E_queue(Session_Expire_Frags, ses->sess_id, NULL, frag_ttl_timeout);
+                }
                 frag_pkt->next = ses->frag_pkts;
                 frag_pkt->prev = NULL;
                 ses->frag_pkts = frag_pkt;
+
+                stdhash_insert(&ses->frag_hash, &h_it, &frag_key, &frag_pkt);
+            }
+            ses->frag_bufs++;
+
+            /* Bound the memory held by incomplete packets: evict the
+             * least recently updated ones */
+            while(ses->frag_bufs > MAX_FRAG_BUFS_SESS && ses->frag_tail != frag_pkt) {
+                Alarm(DEBUG, "Too many fragments buffered. Evict the oldest packet\n");
+                Delete_Frag_Element(ses, ses->frag_tail);
             }
      
             /* Deliver the packet if it is complete */
@@ -2361,7 +2854,7 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
                       IP1(u_hdr->dest), IP2(u_hdr->dest), IP3(u_hdr->dest), IP4(u_hdr->dest),
                       ses->udp_port, IP1(ses->udp_addr), IP2(ses->udp_addr), IP3(ses->udp_addr), IP4(ses->udp_addr));
 
-                    Delete_Frag_Element(&ses->frag_pkts, frag_pkt);
+                    Delete_Frag_Element(ses, frag_pkt);
                     dec_ref_cnt(udp_head_buf);
                     return(BUFF_EMPTY);
                 }
@@ -2386,7 +2879,7 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
                         
                                         Alarmp(SPLOG_ERROR, SESSION, "Session_Deliver_Data: (TCP) === Drop packet because session buffer full\n");
 
-                                        Delete_Frag_Element(&ses->frag_pkts, frag_pkt);
+                                        Delete_Frag_Element(ses, frag_pkt);
                                         return(BUFF_DROP);
                                     } 
                                     else if ((flags == 2)||(flags == 3)) {
@@ -2504,7 +2997,7 @@ int Session_Deliver_Data(Session *ses, char* buff, int16u len, int32u type, int
                             dec_ref_cnt(first_frag_udp_hdr); /* free udp_header */
                     }
                 }
-                Delete_Frag_Element(&ses->frag_pkts, frag_pkt);
+                Delete_Frag_Element(ses, frag_pkt);
             }
             if(stdcarr_empty(&ses->rel_deliver_buff)) {
                 return(BUFF_EMPTY);
@@ -2978,15 +3471,19 @@ void Ses_Send_ERR(int address, int port)
 
 
 /***********************************************************/
-/* void Session_UDP_Read(int sk, int dmy, void *dmy_p)     */
+/* void Ses_UDP_Slot_Refill(Ses_UDP_Slot *slot,            */
+/*                          int nfrags)                    */
 /*                                                         */
-/* Receive data from a DGRAM socket                        */
+/* Makes a receive slot ready for the next datagram. The   */
+/* first nfrags packet bodies are replaced if a packet     */
+/* still holds a reference to them (or were never         */
+/* allocated); the others are reused as they are           */
 /*                                                         */
 /* Arguments                                               */
 /*                                                         */
-/* sk:      socket                                         */
-/* dmy:     not used                                       */
-/* dmy_p:   not used                                       */
+/* slot:    the receive slot                               */
+/* nfrags:  number of packet bodies used by the last      */
+/*          datagram received in the slot                  */
 /*                                                         */
 /* Return Value                                            */
 /*                                                         */
@@ -2994,46 +3491,135 @@ void Ses_Send_ERR(int address, int port)
 /*                                                         */
 /***********************************************************/
 
-void Session_UDP_Read(int sk, int dmy, void * dmy_p) 
+static void Ses_UDP_Slot_Refill(Ses_UDP_Slot *slot, int nfrags)
+{
+    int i;
+
+    for(i=0; i<nfrags && i<SES_UDP_FRAGS; i++) {
+        if(slot->frag_buf[i] != NULL && get_ref_cnt(slot->frag_buf[i]) == 1) {
+            continue;
+        }
+        if(slot->frag_buf[i] != NULL) {
+            dec_ref_cnt(slot->frag_buf[i]);
+        }
+        slot->frag_buf[i] = new_ref_cnt(PACK_BODY_OBJ);
+        if(slot->frag_buf[i] == NULL) {
+            Alarm(EXIT, "Ses_UDP_Slot_Refill: Cannot allocate memory\n");
+        }
+    }
+
+    slot->elements[0].len = sizeof(int32);
+    slot->elements[0].buf = (char *)&slot->sess_id;
+    slot->elements[1].len = sizeof(int32);
+    slot->elements[1].buf = (char *)&slot->rnd_num;
+    slot->elements[2].len = MAX_SPINES_MSG+sizeof(udp_header);
+    slot->elements[2].buf = slot->frag_buf[0];
+    for(i=1; i<SES_UDP_FRAGS; i++) {
+        slot->elements[i+2].len = MAX_SPINES_MSG;
+        slot->elements[i+2].buf = slot->frag_buf[i]+sizeof(udp_header);
+    }
+}
+
+/***********************************************************/
+/* int Ses_UDP_Recv_Batch(int sk)                          */
+/*                                                         */
+/* Receives as many queued client datagrams as there are   */
+/* receive slots, without blocking                         */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* sk:      socket                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) number of slots filled (0 if nothing was queued)  */
+/*                                                         */
+/***********************************************************/
+
+static int Ses_UDP_Recv_Batch(int sk)
+{
+#ifdef SES_UDP_HAVE_MMSG
+    struct mmsghdr msgs[SES_UDP_BATCH];
+    struct sockaddr_in from[SES_UDP_BATCH];
+    int i, ret;
+
+    memset(msgs, 0, sizeof(msgs));
+    for(i=0; i<SES_UDP_BATCH; i++) {
+        msgs[i].msg_hdr.msg_name    = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        msgs[i].msg_hdr.msg_iov     = (struct iovec *)Ses_UDP_Slots[i].elements;
+        msgs[i].msg_hdr.msg_iovlen  = SES_UDP_FRAGS+2;
+    }
+
+    ret = recvmmsg(sk, msgs, SES_UDP_BATCH, MSG_DONTWAIT, NULL);
+    if(ret <= 0) {
+        if(ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            Alarm(PRINT, "Ses_UDP_Recv_Batch: recvmmsg error: %s\n", strerror(errno));
+        }
+        return(0);
+    }
+
+    for(i=0; i<ret; i++) {
+        Ses_UDP_Slots[i].received  = msgs[i].msg_len;
+        Ses_UDP_Slots[i].from_addr = ntohl(from[i].sin_addr.s_addr);
+        Ses_UDP_Slots[i].from_port = ntohs(from[i].sin_port);
+    }
+    return(ret);
+#else
+    sys_scatter scat;
+    int i;
+
+    scat.num_elements = SES_UDP_FRAGS+2;
+    for(i=0; i<SES_UDP_FRAGS+2; i++) {
+        scat.elements[i] = Ses_UDP_Slots[0].elements[i];
+    }
+    Ses_UDP_Slots[0].received = DL_recvfrom(sk, &scat, &Ses_UDP_Slots[0].from_addr,
+                                            &Ses_UDP_Slots[0].from_port);
+    return(Ses_UDP_Slots[0].received > 0 ? 1 : 0);
+#endif
+}
+
+/***********************************************************/
+/* int Ses_UDP_Process_Slot(Ses_UDP_Slot *slot)            */
+/*                                                         */
+/* Hands one client datagram to its session, one fragment  */
+/* at a time, as it would have been received via TCP       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* slot:    the receive slot holding the datagram          */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) number of packet bodies used by the datagram      */
+/*                                                         */
+/***********************************************************/
+
+static int Ses_UDP_Process_Slot(Ses_UDP_Slot *slot)
 {
     int received_bytes;
     Session *ses;
     stdit it;
-    int32 sess_id, rnd_num;
     udp_header *u_hdr;
-    char *tmp_buf;
+    udp_header save_hdr;
+    char *tmp_buf, *tcp_data;
     int i, processed_bytes, bytes_to_send;
 
-    int32 recvfrom_address;    /* address from which this packet was
-                                  received */
-    int16u recvfrom_port;      /* port from which this packet was
-                                  received */
-
-    Ses_UDP_Pack.num_elements = 52;
-    Ses_UDP_Pack.elements[0].len = sizeof(int32);
-    Ses_UDP_Pack.elements[0].buf = (char *)&sess_id;
-    Ses_UDP_Pack.elements[1].len = sizeof(int32);
-    Ses_UDP_Pack.elements[1].buf = (char *)&rnd_num;
-    Ses_UDP_Pack.elements[2].len = MAX_SPINES_MSG+sizeof(udp_header);
-    Ses_UDP_Pack.elements[2].buf = frag_buf[0]                   ;
-    for(i=1; i<50; i++) {
-            Ses_UDP_Pack.elements[i+2].len = MAX_SPINES_MSG;
-            Ses_UDP_Pack.elements[i+2].buf = frag_buf[i]+sizeof(udp_header);
+    received_bytes = slot->received - 2*sizeof(int32);
+    if(received_bytes < (int)sizeof(udp_header)) {
+        Alarm(PRINT, "Session_UDP_Read: short datagram (%d bytes)\n", slot->received);
+        return(0);
     }
 
-    received_bytes = DL_recvfrom(sk, &Ses_UDP_Pack, &recvfrom_address,
-            &recvfrom_port );
-    received_bytes -= (2*sizeof(int32));
-
     /* TODO: do/can these two Ses_Send_ERR send an error to all Multicast clients, which probably would be a bad thing? */
 
-    u_hdr = (udp_header*)frag_buf[0];
-    stdhash_find(&Sessions_ID, &it, &sess_id);
+    u_hdr = (udp_header*)slot->frag_buf[0];
+    stdhash_find(&Sessions_ID, &it, &slot->sess_id);
     if(stdhash_is_end(&Sessions_ID, &it)) {
         /* The session is gone */
         Alarm(PRINT, "The session is gone\n");
         Ses_Send_ERR(u_hdr->source, u_hdr->source_port);
-        return;
+        return(0);
     }
 
     ses = *((Session **)stdhash_it_val(&it));
@@ -3048,22 +3634,22 @@ void Session_UDP_Read(int sk, int dmy, void * dmy_p)
     if ( u_hdr->dest_port == 0 ) {
             Alarm(PRINT,"Session_UDP_Read() Initial UDP packet, source address="IPF","
             " port=%d sess_id=%d rnd_num=%d\n",
-            IP(recvfrom_address),recvfrom_port,sess_id,rnd_num);
-        ses->udp_addr = recvfrom_address;
-        ses->udp_port = recvfrom_port;
-        return;
+            IP(slot->from_addr),slot->from_port,slot->sess_id,slot->rnd_num);
+        ses->udp_addr = slot->from_addr;
+        ses->udp_port = slot->from_port;
+        return(0);
     }
 
-    if(ses->rnd_num != rnd_num) {
+    if(ses->rnd_num != slot->rnd_num) {
         /* The session is gone */
         Alarm(PRINT, "The session is gone\n");
         Ses_Send_ERR(u_hdr->source, u_hdr->source_port);
-        return;
+        return(0);
     }
 
     /* This is valid data for this session. It should be processed */
-    /* Replace the session data, with the packet received, and process it */
-    /* as it would have been received via TCP */
+    /* Hand the receive buffers to the session in place of its TCP */
+    /* message buffer and process them as if they came via TCP     */
 
     ses->seq_no++;
     if(ses->seq_no >= 10000) {
@@ -3075,10 +3661,10 @@ void Session_UDP_Read(int sk, int dmy, void * dmy_p)
     }
     ses->frag_idx = 0;
 
-    dec_ref_cnt(ses->data);
+    tcp_data = ses->data;
     processed_bytes = sizeof(udp_header);
     i = 0;
-    while(processed_bytes < received_bytes) {
+    while(processed_bytes < received_bytes && i < SES_UDP_FRAGS) {
         if(received_bytes - processed_bytes <= MAX_SPINES_MSG) {
             bytes_to_send = received_bytes - processed_bytes;
         }
@@ -3086,16 +3672,16 @@ void Session_UDP_Read(int sk, int dmy, void * dmy_p)
             bytes_to_send = MAX_SPINES_MSG;
         }
 
-        tmp_buf = frag_buf[i];
+        tmp_buf = slot->frag_buf[i];
 
         u_hdr = (udp_header*)tmp_buf;
 
         if(ses->frag_num > 1) {
             if(ses->frag_idx == 0) {
-                memcpy((void*)(&ses->save_hdr), (void*)u_hdr, sizeof(udp_header));
+                memcpy((void*)(&save_hdr), (void*)u_hdr, sizeof(udp_header));
             }
             else {
-                memcpy((void*)u_hdr, (void*)(&ses->save_hdr), sizeof(udp_header));
+                memcpy((void*)u_hdr, (void*)(&save_hdr), sizeof(udp_header));
             }
             u_hdr->len = bytes_to_send;
         }
@@ -3109,50 +3695,69 @@ void Session_UDP_Read(int sk, int dmy, void * dmy_p)
         ses->data = tmp_buf;
         ses->read_len = u_hdr->len + sizeof(udp_header);
 
-        /* Process the packet */
+        /* Process the packet. The extra reference covers Session_Close, */
+        /* which releases ses->data if the session is torn down         */
+        inc_ref_cnt(tmp_buf);
         Process_Session_Packet(ses);
 
-        /*
-         * if(get_ref_cnt(ses->data) > 1) {
-         *    Alarm(PRINT, "I'm here\n");
-         *    dec_ref_cnt(ses->data);
-         * }
-         */
+        stdhash_find(&Sessions_ID, &it, &slot->sess_id);
+        if(stdhash_is_end(&Sessions_ID, &it)) {
+            dec_ref_cnt(tcp_data);
+            return(i+1);
+        }
+        dec_ref_cnt(tmp_buf);
 
         ses->frag_idx++;
         i++;
         processed_bytes += bytes_to_send;
     }
+    ses->data = tcp_data;
 
-    /*    for(i=ses->frag_num; i<50; i++) {*/
-    for(i=0; i<ses->frag_num; i++) {
-        dec_ref_cnt(frag_buf[i]);
-        frag_buf[i] = new_ref_cnt(PACK_BODY_OBJ);
-        if(frag_buf[i] == NULL) {
-            Alarm(EXIT, "Cannot allocate memory\n");
-        }
-    }
+    return(i);
+}
 
-    if((ses->data = (char*) new_ref_cnt(MESSAGE_OBJ))==NULL) {
-        Alarm(EXIT, "Session_Read(): Cannot allocate packet_body\n");
+/***********************************************************/
+/* void Session_UDP_Read(int sk, int dmy, void *dmy_p)     */
+/*                                                         */
+/* Receive data from a DGRAM socket. Datagrams queued on   */
+/* the socket are drained in batches and passed to their   */
+/* sessions without copying the fragments                  */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* sk:      socket                                         */
+/* dmy:     not used                                       */
+/* dmy_p:   not used                                       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Session_UDP_Read(int sk, int dmy, void * dmy_p) 
+{
+    int rnd, n, i, used;
+
+    for(rnd=0; rnd<SES_UDP_ROUNDS; rnd++) {
+        n = Ses_UDP_Recv_Batch(sk);
+        for(i=0; i<n; i++) {
+            used = Ses_UDP_Process_Slot(&Ses_UDP_Slots[i]);
+            Ses_UDP_Slot_Refill(&Ses_UDP_Slots[i], used);
+        }
+        if(n < SES_UDP_BATCH) {
+            break;
+        }
     }
 }
 
 
 
 
+/* Client sockets are made non blocking once, in Session_Accept, so
+ * pausing a session only needs to stop reading from it */
 void Block_Session(struct Session_d *ses)
 {
-    int ret, ioctl_cmd;
-
-    /* set file descriptor to blocking */
-    ioctl_cmd = 0;
-#ifdef ARCH_PC_WIN95
-    ret = ioctlsocket(ses->sk, FIONBIO, (void*) &ioctl_cmd);
-#else
-    ret = ioctl(ses->sk, FIONBIO, &ioctl_cmd);
-#endif
-
     if(ses->fd_flags & READ_DESC) {
         E_detach_fd(ses->sk, READ_FD);
         ses->fd_flags = ses->fd_flags ^ READ_DESC;
@@ -3164,46 +3769,16 @@ void Block_Session(struct Session_d *ses)
      *        ses->fd_flags = ses->fd_flags ^ EXCEPT_DESC;
      *}
      */
-
-    /* set file descriptor to non blocking */
-    ioctl_cmd = 1;
-#ifdef ARCH_PC_WIN95
-    ret = ioctlsocket(ses->sk, FIONBIO, (void*) &ioctl_cmd);
-#else
-    ret = ioctl(ses->sk, FIONBIO, &ioctl_cmd);
-#endif
-
-}
-
-
-void Block_All_Sessions(void) {
-    stdit it;
-    Session *ses;
-
-    Alarm(DEBUG, "Block_All_Sessions\n");
-
-    stdhash_begin(&Sessions_ID, &it);
-    while(!stdhash_is_end(&Sessions_ID, &it)) {
-        ses = *((Session **)stdhash_it_val(&it));
-        if(ses->rel_blocked == 0) {
-            Block_Session(ses);
-        }
-        stdhash_it_next(&it);
-    }
 }
 
 
 void Resume_Session(struct Session_d *ses)
 {
-    int ret, ioctl_cmd;
-
-    /* set file descriptor to blocking */
-    ioctl_cmd = 0;
-#ifdef ARCH_PC_WIN95
-    ret = ioctlsocket(ses->sk, FIONBIO, (void*) &ioctl_cmd);
-#else
-    ret = ioctl(ses->sk, FIONBIO, &ioctl_cmd);
-#endif
+    /* Still waiting for room on a link, Resume_Link_Sessions will
+     * pick it up */
+    if(ses->link_blocked != -1) {
+        return;
+    }
 
     if(!(ses->fd_flags & READ_DESC)) {
         /* Similar to earlier, avoid client messages causing starvation 
@@ -3216,33 +3791,95 @@ void Resume_Session(struct Session_d *ses)
              E_attach_fd(ses->sk, EXCEPT_FD, Session_Read, 0, NULL, HIGH_PRIORITY );
              ses->fd_flags = ses->fd_flags | EXCEPT_DESC;
     }
+}
 
 
-    /* set file descriptor to non blocking */
-    ioctl_cmd = 1;
-#ifdef ARCH_PC_WIN95
-    ret = ioctlsocket(ses->sk, FIONBIO, (void*) &ioctl_cmd);
-#else
-    ret = ioctl(ses->sk, FIONBIO, &ioctl_cmd);
-#endif
+/***********************************************************/
+/* void Block_Link_Sessions(int16 linkid)                  */
+/*                                                         */
+/* Called when the send window or buffer of a link is full */
+/* Pauses the session whose message is being sent, if any, */
+/* until Resume_Link_Sessions is called for the same link. */
+/* Sessions sending over other links keep going.           */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* linkid:  ID of the congested link                       */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Block_Link_Sessions(int16 linkid)
+{
+    Session *ses = Link_Charged_Session;
+
+    if(linkid < 0 || linkid >= MAX_LINKS) {
+        return;
+    }
+    if(ses == NULL || ses->link_blocked != -1) {
+        return;
+    }
 
+    Alarm(DEBUG, "Block_Link_Sessions: session %u on link %d\n", ses->sess_id, linkid);
+
+    ses->link_blocked = linkid;
+    stdcarr_push_back(&Link_Blocked_Sessions[linkid], &ses->sess_id);
+    Block_Session(ses);
 }
 
 
-void Resume_All_Sessions(void) {
+/***********************************************************/
+/* void Resume_Link_Sessions(int16 linkid)                 */
+/*                                                         */
+/* Called when a link has room again. Resumes the sessions */
+/* paused on it that are not blocked for another reason.   */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* linkid:  ID of the link                                 */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+void Resume_Link_Sessions(int16 linkid)
+{
+    stdcarr *blocked;
     stdit it;
     Session *ses;
+    int32u sess_id;
 
-    Alarm(DEBUG, "Resume_All_Sessions\n");
+    if(linkid < 0 || linkid >= MAX_LINKS) {
+        return;
+    }
 
-    stdhash_begin(&Sessions_ID, &it);
-    while(!stdhash_is_end(&Sessions_ID, &it)) {
+    blocked = &Link_Blocked_Sessions[linkid];
+    while(!stdcarr_empty(blocked)) {
+        stdcarr_begin(blocked, &it);
+        sess_id = *((int32u *)stdcarr_it_val(&it));
+        stdcarr_pop_front(blocked);
+
+        /* The session may have closed while it was waiting */
+        stdhash_find(&Sessions_ID, &it, &sess_id);
+        if(stdhash_is_end(&Sessions_ID, &it)) {
+            continue;
+        }
         ses = *((Session **)stdhash_it_val(&it));
-        if(ses->rel_blocked == 0) {
-            Resume_Session(ses);
+        if(ses->link_blocked != linkid) {
+            continue;
         }
 
-        stdhash_it_next(&it);
+        Alarm(DEBUG, "Resume_Link_Sessions: session %u on link %d\n", ses->sess_id, linkid);
+
+        ses->link_blocked = -1;
+        if(ses->rel_blocked == 0 && ses->blocked == 0) {
+            Resume_Session(ses);
+        }
     }
 }
 
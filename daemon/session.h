@@ -64,6 +64,7 @@
 
 #define SESS_DATA           1
 #define SESS_CTRL           2
+#define SESS_SEQPACKET      3
 
 #define BIND_TYPE_MSG       1
 #define CONNECT_TYPE_MSG    2
@@ -119,18 +120,45 @@
 #include "stdutil/stdcarr.h"
 #include "link.h" /* For Reliable_Data */
 
-typedef struct Frag_Packet_d {
-    sys_scatter scat;
-    int16u recv_elements;
+#define MAX_FRAG_BUFS_SESS 2048 /* Fragments buffered per session before the
+                                    oldest incomplete packets are evicted */
+
+/* Identifies the packet a fragment belongs to. Padding must be zeroed
+ * since the key is hashed and compared as raw bytes */
+typedef struct Frag_Key_d {
+    Node_ID sender;
     int16u sess_id;
     int16u seq_no;
     int16u snd_port;
-    Node_ID sender;
+    int16u padding;
+} Frag_Key;
+
+typedef struct Frag_Packet_d {
+    sys_scatter scat;
+    int16u recv_elements;
+    Frag_Key key;
     int32 timestamp_sec;
-    struct Frag_Packet_d *next;
-    struct Frag_Packet_d *prev;
+    struct Frag_Packet_d *next;   /* Less recently updated packet */
+    struct Frag_Packet_d *prev;   /* More recently updated packet */
 } Frag_Packet;
 
+#define SES_UDP_BATCH   8   /* Client datagrams drained per recvmmsg call */
+#define SES_UDP_ROUNDS  8   /* recvmmsg calls per wakeup of the UDP socket */
+#define SES_UDP_FRAGS   50  /* Packet bodies a client datagram may span */
+
+/* Receive buffers for one client datagram. The packet bodies are handed
+ * to Process_Session_Packet as they are; only the ones it keeps a
+ * reference to are replaced before the next receive. */
+typedef struct Ses_UDP_Slot_d {
+    int32 sess_id;
+    int32 rnd_num;
+    char *frag_buf[SES_UDP_FRAGS];
+    scat_element elements[SES_UDP_FRAGS+2];
+    int received;
+    int32 from_addr;
+    int16u from_port;
+} Ses_UDP_Slot;
+
 typedef struct Session_d {
     int32u sess_id;
     channel sk;
@@ -159,7 +187,10 @@ typedef struct Session_d {
     char   *data;
     char   multicast_loopback;    
     stdcarr rel_deliver_buff;  /* Sending buffer to be delivered for E2E reliability*/
-    Frag_Packet *frag_pkts;
+    Frag_Packet *frag_pkts;    /* Incomplete packets, most recently updated first */
+    Frag_Packet *frag_tail;    /* Least recently updated incomplete packet */
+    stdhash frag_hash;         /* Frag_Key -> Frag_Packet* for frag_pkts */
+    int32 frag_bufs;           /* Fragments held in frag_pkts */
     int16u sent_bytes;
     struct Reliable_Data_d *r_data;
     int32  rel_otherside_addr;
@@ -168,9 +199,16 @@ typedef struct Session_d {
     int32  rel_orig_port;
     int    rel_hello_cnt;
     int    rel_blocked;
+    int16  link_blocked;       /* Link whose window this session waits on, or -1 */
     stdhash joined_groups;
     int close_reason;
 
+    /* AF_UNIX SOCK_SEQPACKET clients */
+    char   seqpacket;          /* Every client message is one record */
+    char   *seq_buf;           /* Fragments of a record after the first one */
+    int32  client_pid;         /* Credentials of the client, or -1 */
+    int32  client_uid;
+
     /* Priority Flooding Settings */
     int16u priority_lvl;
     sp_time expire;
@@ -210,8 +248,8 @@ void Ses_Send_ID(struct Session_d *ses);
 void Ses_Send_ERR(int address, int port);
 void Block_Session(struct Session_d *ses);
 void Resume_Session(struct Session_d *ses);
-void Block_All_Sessions(void);
-void Resume_All_Sessions(void);
+void Block_Link_Sessions(int16 linkid);
+void Resume_Link_Sessions(int16 linkid);
 void Try_Close_Session(int sesid, void *dummy); 
 void Session_UDP_Read(int sk, int dmy, void * dmy_p);
 
@@ -0,0 +1,303 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef ARCH_PC_WIN95
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#endif
+
+#include "arch.h"
+#include "spu_alarm.h"
+#include "spu_events.h"
+
+#include "net_types.h"
+#include "node.h"
+#include "link.h"
+#include "state_flood.h"
+#include "link_state.h"
+#include "multicast.h"
+#include "priority_flood.h"
+#include "reliable_flood.h"
+#include "snapshot.h"
+#include "spines.h"
+
+extern unsigned char Conf_Hash[];
+
+/* Local variables */
+
+static const sp_time snapshot_timeout = { SNAPSHOT_TIMEOUT, 0 };
+
+static int64u  Snap_Epoch_Floor = 0;                 /* smallest incarnation / epoch I may use */
+static int64u  Snap_Incarnation[MAX_NODES + 1];      /* saved incarnation of each source */
+
+static void    Snapshot_Load(void);
+static void    Snapshot_Periodic(int dummy_int, void *dummy_p);
+
+/***********************************************************/
+/* void Init_Snapshot(void)                                */
+/*                                                         */
+/* Loads the snapshot given with -ws, if any, and starts   */
+/* writing it periodically.  Must be called after the      */
+/* nodes and dissemination graphs are set up and before    */
+/* the flooding protocols pick their incarnations          */
+/*                                                         */
+/***********************************************************/
+
+void Init_Snapshot(void)
+{
+    memset(Snap_Incarnation, 0, sizeof(Snap_Incarnation));
+
+    if (!Use_Snapshot) {
+        return;
+    }
+
+#ifdef ARCH_PC_WIN95
+    Alarm(PRINT, "Init_Snapshot: snapshots are not supported on Windows\r\n");
+    Use_Snapshot = 0;
+#else
+    Snapshot_Load();
+    E_queue(Snapshot_Periodic, 0, NULL, snapshot_timeout);
+#endif
+}
+
+/***********************************************************/
+/* int64u Snapshot_Epoch(int64u now_sec)                   */
+/*                                                         */
+/* Returns the incarnation / epoch to start a flooding     */
+/* protocol with: the current time, but never one this     */
+/* daemon had already used before it was restarted (e.g.  */
+/* if it restarted within the same second)                 */
+/*                                                         */
+/***********************************************************/
+
+int64u Snapshot_Epoch(int64u now_sec)
+{
+    return (now_sec > Snap_Epoch_Floor ? now_sec : Snap_Epoch_Floor);
+}
+
+/***********************************************************/
+/* int64u Snapshot_Incarnation(int id)                     */
+/*                                                         */
+/* Returns the last priority flooding incarnation of a     */
+/* source saved in the snapshot, 0 if unknown              */
+/*                                                         */
+/***********************************************************/
+
+int64u Snapshot_Incarnation(int id)
+{
+    return Snap_Incarnation[id];
+}
+
+/***********************************************************/
+/* int Snapshot_Write(void)                                */
+/*                                                         */
+/* Writes the snapshot to a temporary file and renames it  */
+/* over the previous one, so a crash while writing leaves  */
+/* the previous snapshot in place                          */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 1 on success, 0 if not written                    */
+/*                                                         */
+/***********************************************************/
+
+int Snapshot_Write(void)
+{
+#ifdef ARCH_PC_WIN95
+    return 0;
+#else
+    sp_time          now = E_get_time();
+    Snapshot_Header  hdr;
+    char             tmp_name[MAXPATHLEN + 8];
+    FILE            *fp;
+    int              ret;
+    int              i;
+
+    if (!Use_Snapshot) {
+        return 0;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic          = SNAPSHOT_MAGIC;
+    hdr.version        = SNAPSHOT_VERSION;
+    hdr.endian         = ARCH_ENDIAN;
+    hdr.my_address     = My_Address;
+    memcpy(hdr.conf_hash, Conf_Hash, SHA256_DIGEST_LENGTH);
+    hdr.write_sec      = (int32) now.sec;
+    hdr.edge_rec_size  = State_Record_size(&Edge_Prot_Def);
+    hdr.group_rec_size = State_Record_size(&Groups_Prot_Def);
+
+    for (i = 1; i <= MAX_NODES; ++i) {
+        hdr.incarnation[i] = Node_Incarnation[i];
+        hdr.flow_epoch[i]  = Flow_Source_Epoch[i];
+    }
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", Snapshot_Filename);
+
+    if ((fp = fopen(tmp_name, "wb")) == NULL) {
+        Alarm(PRINT, "Snapshot_Write: cannot open %s: %s\r\n", tmp_name, strerror(errno));
+        return 0;
+    }
+
+    /* the header is written again once the counts are known */
+
+    ret = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+           (int) (hdr.num_edges  = State_Save(&Edge_Prot_Def, fp)) >= 0 &&
+           (int) (hdr.num_groups = State_Save(&Groups_Prot_Def, fp)) >= 0 &&
+           fseek(fp, 0, SEEK_SET) == 0 &&
+           fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+           fflush(fp) == 0 &&
+           fsync(fileno(fp)) == 0);
+
+    if (fclose(fp) != 0 || !ret || rename(tmp_name, Snapshot_Filename) != 0) {
+        Alarm(PRINT, "Snapshot_Write: cannot write %s: %s\r\n", Snapshot_Filename, strerror(errno));
+        unlink(tmp_name);
+        return 0;
+    }
+
+    Alarm(DEBUG, "Snapshot_Write: wrote %u edges, %u groups to %s\r\n",
+          hdr.num_edges, hdr.num_groups, Snapshot_Filename);
+
+    return 1;
+#endif
+}
+
+/***********************************************************/
+/* Writes the snapshot every SNAPSHOT_TIMEOUT              */
+/***********************************************************/
+
+static void Snapshot_Periodic(int dummy_int, void *dummy_p)
+{
+    UNUSED(dummy_int);
+    UNUSED(dummy_p);
+
+    Snapshot_Write();
+    E_queue(Snapshot_Periodic, 0, NULL, snapshot_timeout);
+}
+
+/***********************************************************/
+/* Maps the snapshot file and, if it was written by this   */
+/* node with the same configuration, applies its states    */
+/* and incarnations.  The states go through the same path  */
+/* as flooded ones, so anything newer heard from the       */
+/* neighbors afterwards simply replaces them               */
+/***********************************************************/
+
+static void Snapshot_Load(void)
+{
+#ifndef ARCH_PC_WIN95
+    sp_time                now = E_get_time();
+    const Snapshot_Header *hdr;
+    const char            *recs;
+    struct stat            st;
+    void                  *map;
+    size_t                 expected;
+    int32                  elapsed;
+    int                    fd;
+    int                    i;
+
+    if ((fd = open(Snapshot_Filename, O_RDONLY)) < 0) {
+        if (errno != ENOENT) {
+            Alarm(PRINT, "Snapshot_Load: cannot open %s: %s\r\n", Snapshot_Filename, strerror(errno));
+        }
+        return;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Snapshot_Header)) {
+        Alarm(PRINT, "Snapshot_Load: %s is too short, ignored\r\n", Snapshot_Filename);
+        close(fd);
+        return;
+    }
+
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        Alarm(PRINT, "Snapshot_Load: cannot map %s: %s\r\n", Snapshot_Filename, strerror(errno));
+        return;
+    }
+
+    hdr      = (const Snapshot_Header*) map;
+    recs     = (const char*) map + sizeof(Snapshot_Header);
+    expected = sizeof(Snapshot_Header) + (size_t) hdr->num_edges * hdr->edge_rec_size +
+               (size_t) hdr->num_groups * hdr->group_rec_size;
+
+    if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION || hdr->endian != ARCH_ENDIAN ||
+        hdr->edge_rec_size != (int32u) State_Record_size(&Edge_Prot_Def) ||
+        hdr->group_rec_size != (int32u) State_Record_size(&Groups_Prot_Def) ||
+        expected != (size_t) st.st_size) {
+        Alarm(PRINT, "Snapshot_Load: %s is not a valid snapshot, ignored\r\n", Snapshot_Filename);
+
+    } else if (hdr->my_address != My_Address ||
+               memcmp(hdr->conf_hash, Conf_Hash, SHA256_DIGEST_LENGTH) != 0) {
+        Alarm(PRINT, "Snapshot_Load: %s was written by another node or with another "
+              "configuration, ignored\r\n", Snapshot_Filename);
+
+    } else {
+        elapsed = (int32) now.sec - hdr->write_sec;
+        if (elapsed < 0) {
+            elapsed = 0;
+        }
+
+        for (i = 1; i <= MAX_NODES; ++i) {
+            Snap_Incarnation[i] = hdr->incarnation[i];
+            if (Snap_Epoch_Floor < (int64u) hdr->flow_epoch[i] + 1) {
+                Snap_Epoch_Floor = (int64u) hdr->flow_epoch[i] + 1;
+            }
+        }
+        if (Snap_Epoch_Floor < hdr->incarnation[My_ID] + 1) {
+            Snap_Epoch_Floor = hdr->incarnation[My_ID] + 1;
+        }
+
+        State_Restore(&Edge_Prot_Def, recs, hdr->num_edges, elapsed);
+        State_Restore(&Groups_Prot_Def, recs + (size_t) hdr->num_edges * hdr->edge_rec_size,
+                      hdr->num_groups, elapsed);
+
+        Alarm(PRINT, "Snapshot_Load: loaded %u edge and %u group states from %s (%d seconds old)\r\n",
+              hdr->num_edges, hdr->num_groups, Snapshot_Filename, elapsed);
+    }
+
+    munmap(map, (size_t) st.st_size);
+#endif
+}
@@ -0,0 +1,76 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <openssl/sha.h>
+
+#include "net_types.h"
+
+/* Warm-restart snapshot: the edge and group state this daemon has
+ * learned, and the flooding incarnations it has used, written to the
+ * file given with -ws on exit and every SNAPSHOT_TIMEOUT.  A daemon
+ * restarted with the same configuration file loads it at startup, so
+ * it can route as soon as its links come up instead of waiting for its
+ * neighbors to flood the whole network state to it again. */
+
+#define SNAPSHOT_MAGIC      0x53704e53
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_TIMEOUT    30          /* seconds between periodic writes */
+
+typedef struct Snapshot_Header_d {
+    int32u          magic;
+    int32u          version;
+    int32u          endian;             /* ARCH_ENDIAN of the writer */
+    Node_ID         my_address;
+    unsigned char   conf_hash[SHA256_DIGEST_LENGTH];  /* Conf_Hash of the configuration in use */
+    int32           write_sec;          /* time the snapshot was written */
+    int32u          edge_rec_size;
+    int32u          num_edges;
+    int32u          group_rec_size;
+    int32u          num_groups;
+    int64u          incarnation[MAX_NODES + 1];  /* priority flooding incarnation of each source */
+    int32u          flow_epoch[MAX_NODES + 1];   /* my reliable flooding epoch towards each destination */
+    /* followed by num_edges edge records and num_groups group records */
+} Snapshot_Header;
+
+void    Init_Snapshot(void);
+int     Snapshot_Write(void);
+int64u  Snapshot_Epoch(int64u now_sec);
+int64u  Snapshot_Incarnation(int id);
+
+#endif
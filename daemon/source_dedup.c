@@ -0,0 +1,130 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "spu_alarm.h"
+
+#define ext_source_dedup
+#include "source_dedup.h"
+#undef  ext_source_dedup
+
+/*********************************************************************
+ * Sets every source's window to window seqs (a multiple of 64) and
+ * forgets what the windows have seen
+ *********************************************************************/
+
+void Source_Dedup_Init(int32u window)
+{
+    int32u i;
+
+    for (i = 0; i <= MAX_NODES; i++) {
+        if (Source_Dedup[i].bits != NULL) {
+            if (window / 64 == Source_Dedup_Words) {
+                memset(Source_Dedup[i].bits, 0, Source_Dedup_Words * sizeof(int64u));
+            }
+            else {
+                free(Source_Dedup[i].bits);
+                Source_Dedup[i].bits = NULL;
+            }
+        }
+        Source_Dedup[i].incarnation = 0;
+        Source_Dedup[i].high_seq = 0;
+    }
+    Source_Dedup_Words = window / 64;
+}
+
+/*********************************************************************
+ * Checks a source based packet against the sliding window of its
+ * source, and records it if it is new. Returns SOURCE_DEDUP_OK for a
+ * new packet, SOURCE_DEDUP_DUP for one already seen, and
+ * SOURCE_DEDUP_OLD for one from an older incarnation or too far
+ * behind the window to tell
+ *********************************************************************/
+
+int Source_Dedup_Check(int32u src_id, int32u incarnation, int32u seq)
+{
+    Source_Dedup_Window *w = &Source_Dedup[src_id];
+    int64u s, window = (int64u) Source_Dedup_Words * 64;
+    int64u *word;
+
+    if (w->bits == NULL) {
+        w->bits = (int64u*) calloc(Source_Dedup_Words, sizeof(int64u));
+        if (w->bits == NULL)
+            Alarm(EXIT, "Source_Dedup_Check: out of memory\n");
+    }
+
+    if (incarnation < w->incarnation)
+        return SOURCE_DEDUP_OLD;
+
+    /* The source restarted or its seq wrapped: start a new window */
+    if (incarnation > w->incarnation) {
+        memset(w->bits, 0, Source_Dedup_Words * sizeof(int64u));
+        w->incarnation = incarnation;
+        w->high_seq = seq;
+    }
+    else if (seq > w->high_seq) {
+        /* Slide the window forward, forgetting the seqs it drops */
+        if (seq - w->high_seq >= window) {
+            memset(w->bits, 0, Source_Dedup_Words * sizeof(int64u));
+        }
+        else {
+            for (s = (int64u) w->high_seq + 1; s <= seq; ) {
+                word = &w->bits[(s / 64) % Source_Dedup_Words];
+                if (s % 64 == 0 && seq - s >= 63) {
+                    *word = 0;
+                    s += 64;
+                }
+                else {
+                    *word &= ~((int64u) 1 << (s % 64));
+                    s++;
+                }
+            }
+        }
+        w->high_seq = seq;
+    }
+    else if (w->high_seq - seq >= window) {
+        return SOURCE_DEDUP_OLD;
+    }
+    else if (w->bits[(seq / 64) % Source_Dedup_Words] & ((int64u) 1 << (seq % 64))) {
+        return SOURCE_DEDUP_DUP;
+    }
+
+    w->bits[(seq / 64) % Source_Dedup_Words] |= (int64u) 1 << (seq % 64);
+    return SOURCE_DEDUP_OK;
+}
@@ -0,0 +1,71 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera 
+ * 
+ * Contributor(s): 
+ * ----------------
+ *    Sahiti Bommareddy 
+ *
+ */
+
+#ifndef SOURCE_DEDUP_H
+#define SOURCE_DEDUP_H
+
+#include "arch.h"
+#include "net_types.h"
+
+/* Source based routing duplicate detection, one sliding window per
+ * source as in IPsec anti-replay: the highest source seq seen in the
+ * current incarnation plus a bitmap of the window's seqs below it,
+ * bit (seq % window) standing for seq */
+
+#define SOURCE_DEDUP_OK   0
+#define SOURCE_DEDUP_DUP  1
+#define SOURCE_DEDUP_OLD  2
+
+typedef struct Source_Dedup_Window_d {
+    int32u  incarnation;
+    int32u  high_seq;
+    int64u *bits;           /* allocated on the first packet from the source */
+} Source_Dedup_Window;
+
+#undef  ext
+#ifndef ext_source_dedup
+#define ext extern
+#else
+#define ext
+#endif
+
+ext Source_Dedup_Window Source_Dedup[MAX_NODES+1];
+ext int32u              Source_Dedup_Words;  /* window size / 64 */
+
+void Source_Dedup_Init(int32u window);
+int  Source_Dedup_Check(int32u src_id, int32u incarnation, int32u seq);
+
+#endif
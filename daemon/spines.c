@@ -50,6 +50,7 @@
 #  include <signal.h>
 #  include <sys/ioctl.h>
 #  include <unistd.h>
+#  include <fcntl.h>
 #  include <sys/time.h>
 #  include <sys/resource.h>
 #  include <netdb.h>
@@ -86,6 +87,7 @@
 #include "kernel_routing.h"
 #include "configuration.h"
 #include "security.h"
+#include "snapshot.h"
 
 #ifdef	ARCH_PC_WIN95
 WSADATA		WSAData;
@@ -151,6 +153,9 @@ int      Wireless_monitor;
 char     Log_Filename[LOG_FILE_NAME_LEN];
 int      Use_Log_File;
 
+char     Snapshot_Filename[MAXPATHLEN];
+int      Use_Snapshot;
+
 /* Configuration File Variables */
 char        Config_file[MAXPATHLEN];
 char        Config_File_Found;
@@ -168,17 +173,18 @@ stdhash  Sessions_ID;
 stdhash  Sessions_Port;
 stdhash  Rel_Sessions_Port;
 stdhash  Sessions_Sock;
-int16    Link_Sessions_Blocked_On; 
 
 /* Link State */
 
 stdhash  All_Edges;
 stdhash  Changed_Edges;
+State_Log Changed_Edges_Log;
 
 Prot_Def Edge_Prot_Def = {
     Edge_All_States, 
     Edge_All_States_by_Dest, 
     Edge_Changed_States, 
+    Edge_Changed_Log,
     Edge_State_type,
     Edge_State_header_size,
     Edge_Cell_packet_size,
@@ -196,11 +202,13 @@ Prot_Def Edge_Prot_Def = {
 stdhash  All_Groups_by_Node; 
 stdhash  All_Groups_by_Name; 
 stdhash  Changed_Group_States;
+State_Log Changed_Group_States_Log;
 
 Prot_Def Groups_Prot_Def = {
     Groups_All_States, 
     Groups_All_States_by_Name, 
     Groups_Changed_States, 
+    Groups_Changed_Log,
     Groups_State_type,
     Groups_State_header_size,
     Groups_Cell_packet_size,
@@ -277,6 +285,30 @@ void E_exit_events_wrapper(int signum)
     E_exit_events_async_safe();
 }
 
+#ifndef ARCH_PC_WIN95
+/* SIGHUP reloads the configuration file. The handler only wakes up the
+ * event loop, which does the reload between events */
+static int Reload_Pipe[2];
+
+static void Reload_Signal_Handler(int signum)
+{
+    char c = 0;
+    int  ret;
+
+    ret = write(Reload_Pipe[1], &c, 1);
+    (void) ret;
+}
+
+static void Reload_Config(int fd, int dummy, void *dummy_p)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+    Conf_Reload();
+}
+#endif
+
 void Immediate_Cleanup(int signum)
 {
     Session_Finish();
@@ -389,7 +421,7 @@ int main(int argc, char* argv[])
 #endif
 
     /* Catch SIGINT, SIGTERM, SIGHUP (and other recoverable signals) in order to cleanup things 
-     * after closing event loop */
+     * after closing event loop (SIGHUP reloads the configuration once the network is up) */
     signal(SIGINT,  E_exit_events_wrapper);
     signal(SIGTERM, E_exit_events_wrapper);
     signal(SIGHUP,  E_exit_events_wrapper);
@@ -457,6 +489,16 @@ int main(int argc, char* argv[])
 
     Init_Network();
 
+#ifndef ARCH_PC_WIN95
+    /* From now on SIGHUP reloads the configuration instead of exiting */
+    if (pipe(Reload_Pipe) != 0 ||
+            fcntl(Reload_Pipe[0], F_SETFL, O_NONBLOCK) != 0 ||
+            fcntl(Reload_Pipe[1], F_SETFL, O_NONBLOCK) != 0)
+        Alarm(EXIT, "Spines: could not create the reload pipe: %s\n", strerror(errno));
+    E_attach_fd(Reload_Pipe[0], READ_FD, Reload_Config, 0, NULL, LOW_PRIORITY);
+    signal(SIGHUP, Reload_Signal_Handler);
+#endif
+
     if(Up_Down_Interval.sec != 0)
 	E_queue(Up_Down_Net, 0, NULL, Up_Down_Interval);
 
@@ -470,6 +512,7 @@ int main(int argc, char* argv[])
 
     E_handle_events();
 
+    Snapshot_Write();
     Session_Finish();
 
     return(1);
@@ -512,12 +555,10 @@ static void Init_Memory_Objects(int x)
   Mem_init_object_abort(MULTICAST_GROUP, "Group_State", sizeof(Group_State), (int)(20*x), 1);
   Mem_init_object_abort(INTERFACE, "Interface", sizeof(Interface), 1*x, 1);
   Mem_init_object_abort(NETWORK_LEG, "Network_Leg", sizeof(Network_Leg), 5*x, 10);
+  Mem_init_object_abort(LEG_BUF_CELL, "Leg_Buf_Cell", sizeof(Leg_Buf_Cell), (int)(30*x), 1);
   Mem_init_object_abort(BUFFER_CELL, "Buffer_Cell", sizeof(Buffer_Cell), (int)(30*x), 1);
   Mem_init_object_abort(FRAG_PKT, "Frag_Packet", sizeof(Frag_Packet), (int)(30*x), 1);
   Mem_init_object_abort(UDP_CELL, "UDP_Cell", sizeof(UDP_Cell), (int)(30*x), 1);
-  Mem_init_object_abort(PRIO_FLOOD_PQ_NODE, "Priority_Flood_PQ", sizeof(Prio_PQ_Node), (int)(30*x), 20);
-  Mem_init_object_abort(PRIO_FLOOD_NS_OBJ, "Priority_Flood_NS", sizeof(Prio_Neighbor_Status) * (Degree[My_ID] + 1), (int)(30*x), 20);
-  Mem_init_object_abort(SEND_QUEUE_NODE, "Send_Fairness_Queue", sizeof(Send_Fair_Queue), (int)(3*x), 1); 
   Mem_init_object_abort(FLOW_QUEUE_NODE, "Flow_Fairness_Queue", sizeof(Flow_Queue), (int)(3*x), 1); 
   Mem_init_object_abort(RF_SESSION_OBJ, "Reliable_Flood_Session", sizeof(Session_Obj), (int)(3*x), 1); 
   Mem_init_object_abort(DISSEM_QUEUE_NODE, "Dissemination_Queue", sizeof(Dissem_Fair_Queue), (int)(3*x), 1); 
@@ -697,6 +738,7 @@ static  void    Usage(int argc, char *argv[])
     Memory_Limit = 0;
     memset((void*)Wireless_if, '\0', sizeof(Wireless_if));
     Use_Log_File = 0;
+    Use_Snapshot = 0;
     Unix_Domain_Use_Default = 1;
     Leg_Rate_Limit_kbps = 500000;
 
@@ -921,6 +963,18 @@ static  void    Usage(int argc, char *argv[])
             Log_Filename[LOG_FILE_NAME_LEN-1] = 0;
             Use_Log_File = 1;
             argc--; argv++;
+        }else if(!(strncmp(*argv, "-ws", 4))) {
+            ++argv;
+            --argc;
+            if (argc == 0) {
+                Alarm(EXIT, "-ws requires a parameter!\r\n");
+            }
+            s_len = MAXPATHLEN - 1;
+            ret = snprintf( Snapshot_Filename, s_len, "%s", *argv );
+            if (ret > s_len) {
+                Alarm(EXIT, "-ws: snapshot file name too long (%d), max allowed is %u\n", ret, s_len);
+            }
+            Use_Snapshot = 1;
         }else if(!(strncmp(*argv, "-c", 3))) {
             ++argv;
             --argc;
@@ -974,8 +1028,10 @@ static  void    Usage(int argc, char *argv[])
               "\t[-ud <path>]                   : unix domain socket path prefix, default is %s<port>\r\n"
               "\t[-pc]                          : print cost statistics\r\n"
               "\t[-rl <rate (kbps)>]            : per-leg rate limit (default 500,000 kbps, -1 for no limit)\r\n"
-              "\t[-c <file>]                    : configuration file name, default is spines.conf\r\n",
-                                                SPINES_UNIX_SOCKET_PATH);
+              "\t[-c <file>]                    : configuration file name, default is spines.conf\r\n"
+              "\t[-ws <file>]                   : warm-restart snapshot, loaded at startup and\n"
+              "\t                                 written every %d seconds and on exit\r\n",
+                                                SPINES_UNIX_SOCKET_PATH, SNAPSHOT_TIMEOUT);
             Alarm(EXIT, "Bye...\r\n");
         }
     }
@@ -102,6 +102,9 @@ extern int      Wireless_monitor;
 extern char     Log_Filename[];
 extern int      Use_Log_File;
 
+extern char     Snapshot_Filename[];
+extern int      Use_Snapshot;
+
 /* Configuration File Variables */
 extern char        Config_File_Found;
 extern char        Unix_Domain_Prefix[];
@@ -118,13 +121,13 @@ extern stdhash  Sessions_ID;
 extern stdhash  Sessions_Port;
 extern stdhash  Rel_Sessions_Port;
 extern stdhash  Sessions_Sock;
-extern int16    Link_Sessions_Blocked_On; 
 extern stdhash  Neighbors;
 
 /* Link State */
 
 extern stdhash  All_Edges;             /* <Node_ID -> State_Chain*>:   Edge source -> Edge destinations -> Edge* */
 extern stdhash  Changed_Edges;         /* <Node_ID -> Changed_State*>: Publisher -> tracking structure */
+extern State_Log Changed_Edges_Log;    /* Changed_Edges in the order they changed */
 extern Prot_Def Edge_Prot_Def;
 
 /* Multicast */
@@ -132,6 +135,7 @@ extern Prot_Def Edge_Prot_Def;
 extern stdhash  All_Groups_by_Node;    /* <Node_ID -> State_Chain*>:   Node Participant -> Groups -> Group_State */
 extern stdhash  All_Groups_by_Name;    /* <Group_ID -> State_Chain*>:  Group name -> Node Participants -> Group_State */
 extern stdhash  Changed_Group_States;  /* <Node_ID -> Changed_State*>: Publisher -> tracking structure */
+extern State_Log Changed_Group_States_Log; /* Changed_Group_States in the order they changed */
 extern Prot_Def Groups_Prot_Def;
 
 /* Params */
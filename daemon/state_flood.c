@@ -46,6 +46,7 @@
    file so they can be messed with from a central place.
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -83,8 +84,9 @@ static const sp_time zero_timeout        = {     0,    0};
 static const sp_time flood_timeout       = {     0,    0};
 static const sp_time short_timeout       = {     0,    5000};
 static const sp_time wireless_timeout    = {     0,    15000};
+static const sp_time digest_timeout      = {     5,    0};
 static const sp_time state_resend_time   = { 30000,    0};
-static const sp_time resend_call_timeout = {  3000,    0}; 
+static const sp_time resend_call_timeout = {  3000,    0};
 static const sp_time resend_fast_timeout = {     1,    0};
 static const sp_time gb_collect_remove   = { 90000,    0};
 static const sp_time gb_collect_timeout  = { 10000,    0};
@@ -106,342 +108,694 @@ void Flip_state_cell(State_Cell *s_cell)
 }
 
 /***********************************************************/
-/* Sends an entire state to a neighbor                     */
+/* Mixes the bits of a 32 bit value (murmur3 finalizer)    */
 /***********************************************************/
 
-void Net_Send_State_All(int   lk_id,   /* id of control link to neighbor */
-			void *p_data)  /* protocol definition to send */
+static int32u State_Mix(int32u h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+/***********************************************************/
+/* Returns the digest bucket of a state                    */
+/***********************************************************/
+
+static int State_Digest_Bucket(State_Data *s_data)
+{
+  return (int) (State_Mix(s_data->source_addr) % STATE_DIGEST_BUCKETS);
+}
+
+/***********************************************************/
+/* Returns the hash of a state's identity and version      */
+/***********************************************************/
+
+static int32u State_Digest_Hash(State_Data *s_data)
+{
+  int32u h = 0x811c9dc5U;
+
+  h = State_Mix(h ^ s_data->source_addr);
+  h = State_Mix(h ^ s_data->dest_addr);
+  h = State_Mix(h ^ (int32u) s_data->timestamp_sec);
+  h = State_Mix(h ^ (int32u) s_data->timestamp_usec);
+
+  return h;
+}
+
+/* Packs states into packet bodies, as compact delta cells for the
+   neighbors that read them and as plain state cells otherwise.  Cells
+   from the same source share a state packet; delta cells as long as
+   their timestamps are within an int32 of microseconds of the first
+   cell's. */
+
+typedef struct State_Packer_d
+{
+  Prot_Def         *p_def;
+  sp_time           now;
+  int               compact;  /* pack delta cells (STATE_COMPACT_TYPE) */
+  char             *buff;
+  int               bytes;
+  State_Packet     *pkt;   /* state packet being filled; NULL -> none */
+  State_Delta_Base *base;  /* timestamp the cells of pkt are relative to */
+
+} State_Packer;
+
+static void State_Pack_Start(State_Packer *pk,
+			     Prot_Def     *p_def,
+			     sp_time       now,
+			     int           compact)
+{
+  pk->p_def   = p_def;
+  pk->now     = now;
+  pk->compact = compact;
+  pk->bytes   = 0;
+  pk->pkt   = NULL;
+  pk->base  = NULL;
+
+  if ((pk->buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+    Alarm(EXIT, "State_Pack_Start(): Cannot allocte pack_body object\r\n");
+  }
+}
+
+/***********************************************************/
+/* Appends a state to a packet being packed                */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) 1 if the state was added; 0 if the packet is full */
+/***********************************************************/
+
+static int State_Pack_Cell(State_Packer *pk,
+			   State_Data   *s_data)
+{
+  Prot_Def         *p_def = pk->p_def;
+  int               extra = p_def->Cell_packet_size() - (int) sizeof(State_Cell);
+  int               cell  = (pk->compact ? (int) sizeof(State_Delta_Cell) + extra : p_def->Cell_packet_size());
+  int               base  = (pk->compact ? (int) sizeof(State_Delta_Base) : 0);
+  int               room  = (int) (sizeof(packet_body) - sizeof(reliable_tail)) - pk->bytes;
+  int64             delta = 0;
+  State_Delta_Cell *d_cell;
+  State_Cell       *s_cell;
+
+  if (pk->pkt != NULL) {
+
+    if (pk->compact && pk->pkt->source == s_data->source_addr) {
+      delta = ((int64) s_data->timestamp_sec - pk->base->timestamp_sec) * 1000000 + 
+	(s_data->timestamp_usec - pk->base->timestamp_usec);
+    }
+
+    if (pk->pkt->source != s_data->source_addr || 
+	delta > 0x7fffffffLL || delta < -0x7fffffffLL ||
+	pk->pkt->num_cells == 0xffff) {
+      pk->pkt = NULL;
+    }
+  }
+
+  if (pk->pkt == NULL) {  /* start a new state packet */
+
+    if (room < p_def->State_header_size() + base + cell) {
+      return 0;
+    }
+
+    pk->pkt             = (State_Packet*) (pk->buff + pk->bytes);
+    pk->pkt->source     = s_data->source_addr;
+    pk->pkt->num_cells  = 0;
+    pk->pkt->src_data   = (pk->compact ? STATE_DELTA_CELLS : 0);
+    pk->bytes          += sizeof(State_Packet);
+
+    pk->bytes          += p_def->Set_state_header(s_data, pk->buff + pk->bytes);
+
+    if (pk->compact) {
+      pk->base                 = (State_Delta_Base*) (pk->buff + pk->bytes);
+      pk->base->timestamp_sec  = s_data->timestamp_sec;
+      pk->base->timestamp_usec = s_data->timestamp_usec;
+      pk->bytes               += sizeof(State_Delta_Base);
+      delta                    = 0;
+    }
+
+  } else if (room < cell) {
+    return 0;
+  }
+
+  if (pk->compact) {
+    d_cell                  = (State_Delta_Cell*) (pk->buff + pk->bytes);
+    d_cell->dest            = s_data->dest_addr;
+    d_cell->timestamp_delta = (int32) delta;
+    d_cell->value           = s_data->value;
+    d_cell->age             = s_data->age + (pk->now.sec - s_data->my_timestamp_sec) / 10;
+
+    p_def->Set_state_cell(s_data, pk->buff + pk->bytes + sizeof(State_Delta_Cell));
+
+  } else {
+    s_cell                 = (State_Cell*) (pk->buff + pk->bytes);
+    s_cell->dest           = s_data->dest_addr;
+    s_cell->timestamp_sec  = s_data->timestamp_sec;
+    s_cell->timestamp_usec = s_data->timestamp_usec;
+    s_cell->value          = s_data->value;
+    s_cell->age            = s_data->age + (pk->now.sec - s_data->my_timestamp_sec) / 10;
+
+    p_def->Set_state_cell(s_data, pk->buff + pk->bytes + sizeof(State_Cell));
+  }
+
+  pk->bytes += cell;  /* cells stay aligned even if the extra fields are shorter */
+  ++pk->pkt->num_cells;
+
+  Alarm(DEBUG, "State_Pack_Cell: Packing state: " IPF " -> " IPF " | %d:%d\r\n", 
+	IP(s_data->source_addr), IP(s_data->dest_addr), s_data->timestamp_sec, s_data->timestamp_usec); 
+
+  return 1;
+}
+
+/***********************************************************/
+/* Returns the type of the state packets of a protocol     */
+/* packed by a packer                                      */
+/***********************************************************/
+
+static int32u State_Packet_Type(State_Packer *pk)
+{
+  Prot_Def *p_def = pk->p_def;
+
+  if (pk->compact) {
+    return p_def->State_type() | STATE_COMPACT_TYPE;
+  }
+
+  return p_def->State_type();
+}
+
+/***********************************************************/
+/* Sends the states in some digest buckets to a neighbor   */
+/***********************************************************/
+
+static void Net_Send_States(int16     linkid,   /* id of control link to neighbor */
+			    Prot_Def *p_def,    /* protocol definition to send */
+			    int32u    buckets)  /* bit i set -> send the states of bucket i */
 {
-  sp_time       now        = E_get_time();
-  Prot_Def     *p_def      = (Prot_Def*) p_data;
   stdhash      *states     = p_def->All_States();
-  int16         linkid     = (int16) lk_id;
-  char         *buff       = (char*) new_ref_cnt(PACK_BODY_OBJ);
-  int           pack_bytes = 0;
+  State_Packer  pk;
   State_Chain  *s_chain;
   State_Data   *s_data;
-  State_Packet *pkt;
-  State_Cell   *state_cell;
   stdit         outer_it;
   stdit         inner_it;
-  int           ret;
 
-  assert(Links[linkid] != NULL && Links[linkid]->link_type == CONTROL_LINK && Links[linkid]->leg->status == CONNECTED_LEG);
-
-  if (buff == NULL) {
-    Alarm(EXIT, "Net_Send_State_All(): Cannot allocte pack_body object\r\n");
-  }
+  State_Pack_Start(&pk, p_def, E_get_time(), Links[linkid]->leg->state_compact);
 
   for (stdhash_begin(states, &outer_it); !stdhash_is_end(states, &outer_it); stdhash_it_next(&outer_it)) {
   
     s_chain = *(State_Chain**) stdhash_it_val(&outer_it);
 
-    if (stdhash_is_end(&s_chain->states, stdhash_begin(&s_chain->states, &inner_it))) {
-      /* TODO: can this legally happen? */
-      continue;
-    }
+    for (stdhash_begin(&s_chain->states, &inner_it); !stdhash_is_end(&s_chain->states, &inner_it); stdhash_it_next(&inner_it)) {
 
-    s_data = *(State_Data**) stdhash_it_val(&inner_it);
-	    
-    /* flush the packet if it is too full for another state packet and state cell */
-    
-    if (pack_bytes > (int) (sizeof(packet_body) - sizeof(reliable_tail) -
-			    p_def->State_header_size() - p_def->Cell_packet_size())) {
-      
-      ret = Reliable_Send_Msg(linkid, buff, (int16u) pack_bytes, p_def->State_type());
-      dec_ref_cnt(buff);
-      
-      if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
-	Alarm(EXIT, "Net_Send_State_All(): Cannot allocte pack_body object\r\n");
+      s_data = *(State_Data**) stdhash_it_val(&inner_it);
+
+      if (!(buckets & (0x1U << State_Digest_Bucket(s_data)))) {
+	break;  /* all the states of a source are in the same bucket */
       }
-      
-      pack_bytes = 0;
-    }
 
-    /* set up a state packet and first state cell to send */
+      if (!State_Pack_Cell(&pk, s_data)) {  /* flush the full packet and start another */
 
-    pkt                        = (State_Packet*) (buff + pack_bytes);
-    pkt->source                = s_data->source_addr;
-    pkt->num_cells             = 1;
-    pack_bytes                += sizeof(State_Packet);
-    
-    pack_bytes                += p_def->Set_state_header(s_data, buff + pack_bytes);
-    
-    state_cell                 = (State_Cell*) (buff + pack_bytes);
-    state_cell->dest           = s_data->dest_addr;
-    state_cell->timestamp_sec  = s_data->timestamp_sec;
-    state_cell->timestamp_usec = s_data->timestamp_usec;
-    state_cell->age            = s_data->age + (now.sec - s_data->my_timestamp_sec) / 10;
-    state_cell->value          = s_data->value; 
-    pack_bytes                += sizeof(State_Cell);
+	Reliable_Send_Msg(linkid, pk.buff, (int16u) pk.bytes, State_Packet_Type(&pk));
+	dec_ref_cnt(pk.buff);
 
-    pack_bytes                += p_def->Set_state_cell(s_data, buff + pack_bytes);
-	   
-    /* add any other state cells from this source */
+	State_Pack_Start(&pk, p_def, pk.now, pk.compact);
+	State_Pack_Cell(&pk, s_data);
+      }
+    }
+  }
 
-    for (stdhash_it_next(&inner_it); !stdhash_is_end(&s_chain->states, &inner_it); stdhash_it_next(&inner_it)) {
+  if (pk.bytes != 0) {
+    Reliable_Send_Msg(linkid, pk.buff, (int16u) pk.bytes, State_Packet_Type(&pk));
+  }
 
-      s_data = *(State_Data**) stdhash_it_val(&inner_it);
+  dec_ref_cnt(pk.buff);
+}
 
-      /* flush the packet if it is too full for another state cell */
+/***********************************************************/
+/* Sends an entire state to a neighbor                     */
+/***********************************************************/
 
-      if (pack_bytes > (int) (sizeof(packet_body) - sizeof(reliable_tail) - p_def->Cell_packet_size())) {
-	
-	ret = Reliable_Send_Msg(linkid, buff, (int16u) pack_bytes, p_def->State_type());    
-	dec_ref_cnt(buff);
-	
-	if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
-	  Alarm(EXIT, "Net_Send_State_all(): Cannot allocte pack_body object\n");
-	}
+void Net_Send_State_All(int   lk_id,   /* id of control link to neighbor */
+			void *p_data)  /* protocol definition to send */
+{
+  Prot_Def     *p_def      = (Prot_Def*) p_data;
+  State_Log    *log        = p_def->Changed_Log();
+  int16         linkid     = (int16) lk_id;
+  Node         *nbr;
 
-	pkt            = (State_Packet*) buff;
-	pkt->source    = s_data->source_addr;
-	pkt->num_cells = 0;		    
-	pack_bytes     = sizeof(State_Packet);
-	
-	pack_bytes += p_def->Set_state_header(s_data, buff+pack_bytes);
-      }
+  assert(Links[linkid] != NULL && Links[linkid]->link_type == CONTROL_LINK && Links[linkid]->leg->status == CONNECTED_LEG);
 
-      ++pkt->num_cells;
+  Net_Send_States(linkid, p_def, 0xffffffffU);
 
-      state_cell                 = (State_Cell*) (buff + pack_bytes);
-      state_cell->dest           = s_data->dest_addr;
-      state_cell->timestamp_sec  = s_data->timestamp_sec;
-      state_cell->timestamp_usec = s_data->timestamp_usec;
-      state_cell->age            = s_data->age + (now.sec - s_data->my_timestamp_sec) / 10;
-      state_cell->value          = s_data->value; 
-      pack_bytes                += sizeof(State_Cell);
+  /* he now knows every change in the log */
 
-      pack_bytes                += p_def->Set_state_cell(s_data, buff + pack_bytes);  	    
-    }
-  }
+  nbr = Links[linkid]->leg->edge->dst;
 
-  if (pack_bytes != 0) {
-    ret = Reliable_Send_Msg(linkid, buff, (int16u) pack_bytes, p_def->State_type());
+  if (nbr->neighbor_id >= 0) {
+    log->cursor[nbr->neighbor_id] = log->last_seq;
   }
+}
 
-  dec_ref_cnt(buff);
+/***********************************************************/
+/* Returns true if a neighbor is connected and has not     */
+/* been sent all the changes in a log yet                  */
+/***********************************************************/
+
+static int State_Log_Behind(State_Log *log,  
+			    int16      neighbor_id)
+{
+  Node *nbr = Neighbor_Nodes[neighbor_id];
+
+  return (nbr != NULL && Is_Connected_Neighbor2(nbr) && log->cursor[neighbor_id] != log->last_seq);
 }
 
 /***********************************************************/
-/* Sends the new state updates to all the neighbors        */
+/* Packs the changes after a cursor position               */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* pk:          packer to pack into                        */
+/* log:         change log                                 */
+/* from:        cursor position to start after             */
+/* last:        last change to consider; NULL -> until the */
+/*              packet is full                             */
+/* neighbor_id: skip the changes this neighbor already     */
+/*              knows; -1 -> pack everything               */
+/* known:       if not NULL, OR'ed with the masks of the   */
+/*              packed changes                             */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (Changed_State*) the last change covered by the packet; */
+/* NULL if there was no change after the cursor            */
 /***********************************************************/
 
-void Send_State_Updates(int   dummy_int, 
-			void *p_data)     /* protocol definition to send */
+static Changed_State *State_Log_Pack(State_Packer  *pk,
+				     State_Log     *log,
+				     int32u         from,
+				     Changed_State *last,
+				     int16          neighbor_id,
+				     int32u        *known)
 {
-  Prot_Def *p_def = (Prot_Def*) p_data;
-  int       flag  = 0;
-  int16     i;
-  
-  for (i = 0; i < Num_Neighbors; ++i) {
+  Changed_State *covered = NULL;
+  Changed_State *cg_state;
+  int            i;
+
+  for (cg_state = log->head; cg_state != NULL && (int32) (cg_state->seq - from) <= 0; cg_state = cg_state->next);
+
+  for (; cg_state != NULL; cg_state = cg_state->next) {
 
-    if (Neighbor_Nodes[i] != NULL && 
-	Is_Connected_Neighbor2(Neighbor_Nodes[i]) &&
-	Net_Send_State_Updates(p_def, i) < 0) { 
+    if (neighbor_id < 0 || !(cg_state->mask[neighbor_id / 32] & (0x1 << neighbor_id % 32))) {
 
-      flag = 1;  /* changes only partially queued / sent; call again */
+      if (!State_Pack_Cell(pk, (State_Data*) cg_state->state)) {
+	break;
+      }
+
+      if (known != NULL) {
+	for (i = 0; i < MAX_LINKS/(MAX_LINKS_4_EDGE*32); ++i) {
+	  known[i] |= cg_state->mask[i];
+	}
+      }
+    }
+
+    covered = cg_state;
+
+    if (cg_state == last) {
+      break;
     }
   }
 
-  if (flag == 1) {
-    E_queue(Send_State_Updates, 0, p_data, zero_timeout);
+  return covered;
+}
+
+/***********************************************************/
+/* Removes a change from a log without disposing of it     */
+/***********************************************************/
+
+static void State_Log_Unlink(State_Log     *log,       /* change log */
+			     Changed_State *cg_state)  /* change to remove */
+{
+  if (cg_state->prev != NULL) {
+    cg_state->prev->next = cg_state->next;
 
   } else {
-    Empty_Changed_States(p_def->Changed_States());
+    log->head = cg_state->next;
+  }
+
+  if (cg_state->next != NULL) {
+    cg_state->next->prev = cg_state->prev;
+
+  } else {
+    log->tail = cg_state->prev;
   }
 }
 
 /***********************************************************/
-/* Sends a portion of new state updates to a neighbor      */
-/* Returns 1 if everything sent, else -1                   */
+/* Drops the changes every connected neighbor was sent     */
 /***********************************************************/
 
-int Net_Send_State_Updates(Prot_Def *p_def,        /* protocol definition to send */
-			   int16     neighbor_id)  /* index of neighbor in Neighbor_Nodes to send to */
+static void State_Log_Trim(Prot_Def *p_def)
 {
-  sp_time        now        = E_get_time();
-  stdhash       *changes    = p_def->Changed_States();
-  Node          *nbr        = Neighbor_Nodes[neighbor_id];
-  int32u         node_index = neighbor_id / 32;             /* see state_flood.h for explanation */
-  int32u         node_mask  = (0x1 << (neighbor_id % 32));  /* see state_flood.h for explanation */
-  char          *buff       = (char*) new_ref_cnt(PACK_BODY_OBJ);
-  int            pack_bytes = 0;
-  int            pkt_cnt    = 0;
-  int16          linkid;
-  stdhash        done_srcs;            /* tracks processed update sources */
+  State_Log     *log     = p_def->Changed_Log();
+  stdhash       *changes = p_def->Changed_States();
+  int32u         oldest  = log->last_seq;
   Changed_State *cg_state;
   State_Data    *s_data;
-  State_Packet  *pkt;
-  State_Cell    *state_cell;
-  stdit          outer_it;
-  stdit          inner_it;
-  stdit          tmp_it;
-  int            ret;
-
-  assert(nbr != NULL && Is_Connected_Neighbor2(nbr) && nbr->edge->leg != NULL && nbr->edge->leg->status == CONNECTED_LEG);
-  UNUSED(nbr);
+  stdit          tit;
+  int16          i;
 
-  linkid = Neighbor_Nodes[neighbor_id]->edge->leg->links[CONTROL_LINK]->link_id;
+  for (i = 0; i < Num_Neighbors; ++i) {
 
-  if (buff == NULL || stdhash_construct(&done_srcs, sizeof(Node_ID), 0, NULL, NULL, 0) != 0) {
-    Alarm(EXIT, "Net_Send_State_Update: Couldn't allocate!\r\n");
+    if (Neighbor_Nodes[i] != NULL && Is_Connected_Neighbor2(Neighbor_Nodes[i]) &&
+	(int32) (log->cursor[i] - oldest) < 0) {
+      oldest = log->cursor[i];
+    }
   }
 
-  for (stdhash_begin(changes, &outer_it); !stdhash_is_end(changes, &outer_it); stdhash_it_next(&outer_it)) {
+  while ((cg_state = log->head) != NULL && (int32) (cg_state->seq - oldest) <= 0) {
 
-    cg_state = *(Changed_State**) stdhash_it_val(&outer_it);
-    s_data   = (State_Data*) cg_state->state;
+    s_data = (State_Data*) cg_state->state;
+    State_Log_Unlink(log, cg_state);
 
-    if (stdhash_contains(&done_srcs, &s_data->source_addr)) {
-      continue;  /* already processed this source */
+    for (stdhash_find(changes, &tit, &s_data->source_addr); !stdhash_is_end(changes, &tit); stdhash_keyed_next(changes, &tit)) {
+
+      if (*(Changed_State**) stdhash_it_val(&tit) == cg_state) {
+	stdhash_erase(changes, &tit);
+	break;
+      }
     }
 
-    /* NOTE: we have to do a find here to ensure we get all entries
-       from this source when we do our stdhash_keyed_next iteration;
-       'outer_it' is probably in the middle of a keyed iteration.
-    */
+    dispose(cg_state);
+  }
+}
 
-    stdhash_find(changes, &inner_it, &s_data->source_addr);  /* can't fail */
-    cg_state = *(Changed_State**) stdhash_it_val(&inner_it);
+/***********************************************************/
+/* Sends the new state updates to all the neighbors        */
+/*                                                         */
+/* Neighbors whose cursors are at the same point in the    */
+/* log, and that read the same packet format, are sent the */
+/* same packet, which is packed only once.  A neighbor     */
+/* that already knows one of the packed changes gets its   */
+/* own packet without it instead.                          */
+/***********************************************************/
 
-    /* find the first state change from this source we need to send to this node */
+void Send_State_Updates(int   dummy_int, 
+			void *p_data)     /* protocol definition to send */
+{
+  Prot_Def      *p_def = (Prot_Def*) p_data;
+  State_Log     *log   = p_def->Changed_Log();
+  sp_time        now   = E_get_time();
+  char           grouped[MAX_LINKS / MAX_LINKS_4_EDGE];
+  int32u         known[MAX_LINKS/(MAX_LINKS_4_EDGE*32)];
+  State_Packer   shared;
+  State_Packer   own;
+  Changed_State *last;
+  Changed_State *covered;
+  int32u         from;
+  char           compact;
+  int            flag  = 0;
+  int            round;
+  int16          i;
+  int16          j;
+  
+  /* limit the # of packets we send to any given neighbor so we don't starve the rest of the daemon */
 
-    if (cg_state->mask[node_index] & node_mask) {  /* set bit -> doesn't need this one; find the first one he does */
-      
-      for (stdhash_keyed_next(changes, &inner_it); !stdhash_is_end(changes, &inner_it); stdhash_keyed_next(changes, &inner_it)) {
+  for (round = 0; round < 5; ++round) {
 
-	cg_state = *(Changed_State**) stdhash_it_val(&inner_it);
+    memset(grouped, 0, sizeof(grouped));
 
-	if (!(cg_state->mask[node_index] & node_mask)) {  
-	  break;  /* he needs this one */
-	}
+    for (i = 0; i < Num_Neighbors; ++i) {
+
+      if (grouped[i] || !State_Log_Behind(log, i)) {
+	continue;
       }
 
-      if (stdhash_is_end(changes, &inner_it)) {  /* no updates from this source were needed */
+      from    = log->cursor[i];
+      compact = Neighbor_Nodes[i]->edge->leg->state_compact;
+
+      memset(known, 0, sizeof(known));
+      State_Pack_Start(&shared, p_def, now, compact);
 
-	if (stdhash_insert(&done_srcs, &tmp_it, &s_data->source_addr, NULL) != 0) {
-	  Alarm(EXIT, "Net_Send_State_Update: Couldn't insert into done_srcs!\r\n");
+      last = State_Log_Pack(&shared, log, from, NULL, -1, known);
+
+      for (j = i; j < Num_Neighbors; ++j) {
+
+	if (grouped[j] || !State_Log_Behind(log, j) || log->cursor[j] != from ||
+	    Neighbor_Nodes[j]->edge->leg->state_compact != compact) {
+	  continue;
 	}
 
-	continue;
+	grouped[j] = 1;
+
+	if (last == NULL) {  /* nothing left after his cursor */
+	  log->cursor[j] = log->last_seq;
+	  continue;
+	}
+
+	assert(Neighbor_Nodes[j]->edge->leg != NULL && Neighbor_Nodes[j]->edge->leg->status == CONNECTED_LEG);
+
+	if (!(known[j / 32] & (0x1 << j % 32))) {  /* he needs every packed change */
+	  Reliable_Send_Msg(Neighbor_Nodes[j]->edge->leg->links[CONTROL_LINK]->link_id, shared.buff, 
+			    (int16u) shared.bytes, State_Packet_Type(&shared));
+	  log->cursor[j] = last->seq;
+	  continue;
+	}
+
+	State_Pack_Start(&own, p_def, now, compact);
+
+	covered = State_Log_Pack(&own, log, from, last, j, NULL);
+
+	if (own.bytes != 0) {
+	  Reliable_Send_Msg(Neighbor_Nodes[j]->edge->leg->links[CONTROL_LINK]->link_id, own.buff, 
+			    (int16u) own.bytes, State_Packet_Type(&own));
+	}
+
+	dec_ref_cnt(own.buff);
+	log->cursor[j] = covered->seq;
       }
+
+      dec_ref_cnt(shared.buff);
     }
+  }
 
-    s_data = (State_Data*) cg_state->state;
+  State_Log_Trim(p_def);
 
-    /* flush the packet if it is too full for another state packet and state cell */
+  for (i = 0; i < Num_Neighbors; ++i) {
 
-    if (pack_bytes > (int) (sizeof(packet_body) - sizeof(reliable_tail) -
-			    p_def->State_header_size() - p_def->Cell_packet_size())) {
-	        
-      ret = Reliable_Send_Msg(linkid, buff, (int16u) pack_bytes, p_def->State_type());
-      dec_ref_cnt(buff);
-		
-      if (++pkt_cnt > 5) {  /* limit the # of packets we send to any given neighbor so we don't starve the rest of the daemon */
-	stdhash_destruct(&done_srcs);
-	return -1;
-      }
+    if (State_Log_Behind(log, i)) {
+      flag = 1;  /* changes only partially sent; call again */
+    }
+  }
 
-      if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
-	Alarm(EXIT, "Net_Send_State_updates(): Cannot allocte pack_body object\r\n");
-      }
+  if (flag == 1) {
+    E_queue(Send_State_Updates, 0, p_data, zero_timeout);
+  }
+}
+
+/***********************************************************/
+/* Computes the digest of all the states of a protocol     */
+/***********************************************************/
+
+static void State_Compute_Digest(Prot_Def     *p_def,   /* protocol definition to digest */
+				 State_Digest *digest)  /* digest to fill in */
+{
+  stdhash     *states = p_def->All_States();
+  State_Chain *s_chain;
+  State_Data  *s_data;
+  stdit        outer_it;
+  stdit        inner_it;
 
-      pack_bytes = 0;
+  memset(digest, 0, sizeof(*digest));
+
+  for (stdhash_begin(states, &outer_it); !stdhash_is_end(states, &outer_it); stdhash_it_next(&outer_it)) {
+
+    s_chain = *(State_Chain**) stdhash_it_val(&outer_it);
+
+    for (stdhash_begin(&s_chain->states, &inner_it); !stdhash_is_end(&s_chain->states, &inner_it); stdhash_it_next(&inner_it)) {
+      s_data = *(State_Data**) stdhash_it_val(&inner_it);
+      digest->bucket[State_Digest_Bucket(s_data)] += State_Digest_Hash(s_data);
     }
+  }
+}
 
-    /* set up a state packet and first state cell to send */
+/***********************************************************/
+/* Starts a state packet with no cells that carries        */
+/* anti-entropy information                                */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) offset of the payload in the packet body          */
+/***********************************************************/
 
-    pkt                        = (State_Packet*) (buff + pack_bytes);
-    pkt->source                = s_data->source_addr;
-    pkt->num_cells             = 1;
-    pack_bytes                += sizeof(State_Packet);
+static int State_Digest_Header(Prot_Def *p_def,     /* protocol definition */
+			       char     *buff,      /* packet body */
+			       int16     src_data)  /* STATE_DIGEST or STATE_DIGEST_REQUEST */
+{
+  State_Packet *pkt = (State_Packet*) buff;
 
-    pack_bytes                += p_def->Set_state_header(s_data, buff + pack_bytes);
+  memset(buff, 0, p_def->State_header_size());
 
-    state_cell                 = (State_Cell*) (buff + pack_bytes);
-    state_cell->dest           = s_data->dest_addr;
-    state_cell->timestamp_sec  = s_data->timestamp_sec;
-    state_cell->timestamp_usec = s_data->timestamp_usec;
-    state_cell->age            = s_data->age + (now.sec - s_data->my_timestamp_sec) / 10;
-    state_cell->value          = s_data->value;
-    pack_bytes                += sizeof(State_Cell);
+  pkt->source    = My_Address;
+  pkt->num_cells = 0;
+  pkt->src_data  = src_data;
 
-    pack_bytes                += p_def->Set_state_cell(s_data, buff + pack_bytes);
+  return p_def->State_header_size();
+}
 
-    /* record that we are about to reliably send this state change to this neighbor */
+/***********************************************************/
+/* Sends a digest of the states of a protocol to all the   */
+/* neighbors                                               */
+/*                                                         */
+/* A neighbor that missed some update asks for just the    */
+/* buckets that differ, so states need not be re-flooded   */
+/* to repair losses (see Refresh_Own_States).              */
+/***********************************************************/
 
-    cg_state->mask[node_index] |= node_mask;
+void Send_State_Digests(int   dummy_int, 
+			void *p_data)     /* protocol definition to digest */
+{
+  Prot_Def     *p_def      = (Prot_Def*) p_data;
+  char         *buff       = NULL;
+  int           pack_bytes = 0;
+  Node         *nbr;
+  int16         i;
 
-    Alarm(DEBUG, "Upd: Packing state: " IPF " -> " IPF " | %d:%d\r\n", 
-	  IP(pkt->source), IP(state_cell->dest), state_cell->timestamp_sec, state_cell->timestamp_usec); 
-	   
-    /* add any other state cells from this source */
+  for (i = 0; i < Num_Neighbors; ++i) {
 
-    for (stdhash_keyed_next(changes, &inner_it); !stdhash_is_end(changes, &inner_it); stdhash_keyed_next(changes, &inner_it)) {
+    if ((nbr = Neighbor_Nodes[i]) == NULL || !Is_Connected_Neighbor2(nbr) ||
+	!nbr->edge->leg->state_compact) {  /* older daemons don't read digests */
+      continue;
+    }
 
-      cg_state = *(Changed_State**) stdhash_it_val(&inner_it);
-      s_data   = (State_Data*) cg_state->state;
+    if (buff == NULL) {  /* one digest packet for all the neighbors */
 
-      if (cg_state->mask[node_index] & node_mask) {
-	continue;  /* not needed */
+      if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+	Alarm(EXIT, "Send_State_Digests(): Cannot allocte pack_body object\r\n");
       }
 
-      /* flush the packet if it is too full for another state cell */
+      pack_bytes  = State_Digest_Header(p_def, buff, STATE_DIGEST);
+      State_Compute_Digest(p_def, (State_Digest*) (buff + pack_bytes));
+      pack_bytes += sizeof(State_Digest);
+    }
 
-      if (pack_bytes > (int) (sizeof(packet_body) - sizeof(reliable_tail) - p_def->Cell_packet_size())) {
-		  
-	ret = Reliable_Send_Msg(linkid, buff, (int16u)pack_bytes, p_def->State_type());
-	dec_ref_cnt(buff);
+    Reliable_Send_Msg(nbr->edge->leg->links[CONTROL_LINK]->link_id, buff, (int16u) pack_bytes, p_def->State_type() | STATE_COMPACT_TYPE);
+  }
 
-	if (++pkt_cnt > 5) {  /* limit the # of packets we send to any given neighbor so we don't starve the rest of the daemon */
-	  stdhash_destruct(&done_srcs);
-	  return -1;
-	}
+  if (buff != NULL) {
+    dec_ref_cnt(buff);
+  }
 
-	if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
-	  Alarm(EXIT, "Net_Send_State_Updates(): Cannot allocte pack_body object\n");
+  E_queue(Send_State_Digests, 0, p_data, digest_timeout);
+}
+
+/***********************************************************/
+/* Refreshes the states this node owns every               */
+/* state_resend_time, so that they never age into garbage  */
+/* collection on this or any other node                    */
+/*                                                         */
+/* Only my own states are re-stamped and flooded, through  */
+/* the change log; lost updates are left to the digests.   */
+/***********************************************************/
+
+void Refresh_Own_States(int   dummy_int, 
+			void *p_data)     /* protocol definition to refresh */
+{
+  sp_time      now    = E_get_time();
+  Prot_Def    *p_def  = (Prot_Def*) p_data;
+  stdhash     *states = p_def->All_States();
+  int          cnt    = 0;
+  State_Data  *s_data;
+  State_Chain *s_chain;
+  sp_time      state_time;
+  sp_time      diff;
+  stdit        tit;
+
+  if (!stdhash_is_end(states, stdhash_find(states, &tit, &My_Address))) {
+
+    s_chain = *(State_Chain**) stdhash_it_val(&tit);
+
+    for (stdhash_begin(&s_chain->states, &tit); !stdhash_is_end(&s_chain->states, &tit); stdhash_it_next(&tit)) {
+
+      s_data = *(State_Data**) stdhash_it_val(&tit);
+	    
+      state_time.sec  = s_data->my_timestamp_sec;
+      state_time.usec = s_data->my_timestamp_usec;
+      diff            = E_sub_time(now, state_time);
+	    
+      assert(diff.sec >= 0 && diff.usec >= 0);
+
+      if (E_compare_time(diff, state_resend_time) >= 0 &&              /* its time to refresh */
+	  p_def->Is_state_relevant((void*)s_data)) {
+
+	if(++s_data->timestamp_usec >= 1000000) {
+	  ++s_data->timestamp_sec;
+	  s_data->timestamp_usec = 0;
 	}
 
-	pkt            = (State_Packet*)buff;
-	pkt->source    = s_data->source_addr;
-	pkt->num_cells = 0;		    
-	pack_bytes     = sizeof(State_Packet);
-	pack_bytes    += p_def->Set_state_header(s_data, buff + pack_bytes);
+	Add_to_changed_states(p_def, My_Address, s_data);              /* updates my_timestamp_* */
+	
+	if (++cnt > 500) {
+	  E_queue(Refresh_Own_States, 0, p_data, resend_fast_timeout);
+	  return;
+	}
       }
+    }
+  }
+
+  E_queue(Refresh_Own_States, 0, p_data, resend_call_timeout);
+}
 
-      ++pkt->num_cells;
+/***********************************************************/
+/* Compares a neighbor's digest with ours and asks for the */
+/* buckets that differ                                     */
+/***********************************************************/
 
-      state_cell                 = (State_Cell*) (buff + pack_bytes);
-      state_cell->dest           = s_data->dest_addr;
-      state_cell->timestamp_sec  = s_data->timestamp_sec;
-      state_cell->timestamp_usec = s_data->timestamp_usec;
-      state_cell->age            = s_data->age + (now.sec - s_data->my_timestamp_sec) / 10;
-      state_cell->value          = s_data->value; 
-      pack_bytes                += sizeof(State_Cell);
+static void Process_State_Digest(Link     *lk,      /* link on which the digest came in */
+				 Prot_Def *p_def,   /* protocol definition of the digest */
+				 char     *pos,     /* pointer to the digest */
+				 int32u    type)    /* first four bytes of the message */
+{
+  State_Digest         *theirs = (State_Digest*) pos;
+  State_Digest          mine;
+  State_Digest_Request *req;
+  int32u                buckets = 0;
+  char                 *buff;
+  int                   pack_bytes;
+  int                   i;
 
-      pack_bytes                += p_def->Set_state_cell(s_data, buff+pack_bytes);  
+  State_Compute_Digest(p_def, &mine);
 
-      /* record that we are about to send this change to this neighbor */
+  for (i = 0; i < STATE_DIGEST_BUCKETS; ++i) {
 
-      cg_state->mask[node_index] |= node_mask;
+    if (!Same_endian(type)) {
+      theirs->bucket[i] = Flip_int32(theirs->bucket[i]);
     }
 
-    /* record this source, so we don't consider it again */
-
-    if (stdhash_insert(&done_srcs, &tmp_it, &s_data->source_addr, NULL) != 0) {
-      Alarm(EXIT, "Net_Send_State_Updates: Couldn't insert into done_srcs!\r\n");
+    if (theirs->bucket[i] != mine.bucket[i]) {
+      buckets |= (0x1U << i);
     }
   }
 
-  if (pack_bytes != 0) {
-    ret = Reliable_Send_Msg(linkid, buff, (int16u) pack_bytes, p_def->State_type());
+  if (buckets == 0) {
+    return;
+  }
+
+  Alarm(DEBUG, "Process_State_Digest: asking " IPF " for buckets 0x%08x\r\n", IP(lk->leg->edge->dst_id), buckets);
+
+  if ((buff = (char*) new_ref_cnt(PACK_BODY_OBJ)) == NULL) {
+    Alarm(EXIT, "Process_State_Digest(): Cannot allocte pack_body object\r\n");
   }
 
+  pack_bytes    = State_Digest_Header(p_def, buff, STATE_DIGEST_REQUEST);
+  req           = (State_Digest_Request*) (buff + pack_bytes);
+  req->buckets  = buckets;
+  pack_bytes   += sizeof(State_Digest_Request);
+
+  Reliable_Send_Msg(lk->link_id, buff, (int16u) pack_bytes, p_def->State_type() | STATE_COMPACT_TYPE);
   dec_ref_cnt(buff);
-  stdhash_destruct(&done_srcs);
-    
-  return 1;
 }
 
 /***********************************************************/
@@ -460,10 +814,16 @@ void Process_state_packet(Link  *lk,        /* link on which packet came in */
   Reliable_Data *r_data             = lk->r_data;
   int            my_endianess_type  = (!Same_endian(type) ? Flip_int32(type) : type);
   Prot_Def      *p_def              = Get_Prot_Def(my_endianess_type);
+  int            compact            = Is_state_compact(my_endianess_type);  /* else src_data means nothing */
   int            processed_bytes    = 0;
   int            changed_route_flag = 0;
   State_Packet  *pkt;
   State_Cell    *state_cell;
+  State_Delta_Base *delta_base;
+  State_Delta_Cell *d_cell;
+  State_Digest_Request *digest_req;
+  int64          stamp;
+  int32          full_cell[sizeof(packet_body) / sizeof(int32)];  /* delta cell expanded to a full cell */
   State_Data    *s_data;
   reliable_tail *r_tail;
   Changed_State *cg_state;
@@ -531,12 +891,78 @@ void Process_state_packet(Link  *lk,        /* link on which packet came in */
     p_def->Process_state_header(buf + processed_bytes, type);
     processed_bytes += p_def->State_header_size();
 
+    if (compact && pkt->num_cells == 0 && pkt->src_data == STATE_DIGEST) {
+      Process_State_Digest(lk, p_def, buf + processed_bytes, type);
+      processed_bytes += sizeof(State_Digest);
+      continue;
+    }
+
+    if (compact && pkt->num_cells == 0 && pkt->src_data == STATE_DIGEST_REQUEST) {
+
+      digest_req = (State_Digest_Request*) (buf + processed_bytes);
+
+      if (!Same_endian(type)) {
+	digest_req->buckets = Flip_int32(digest_req->buckets);
+      }
+
+      Net_Send_States(lk->link_id, p_def, digest_req->buckets);
+      processed_bytes += sizeof(State_Digest_Request);
+      continue;
+    }
+
+    delta_base = NULL;
+
+    if (compact && pkt->src_data == STATE_DELTA_CELLS) {
+
+      delta_base       = (State_Delta_Base*) (buf + processed_bytes);
+      processed_bytes += sizeof(State_Delta_Base);
+
+      if (!Same_endian(type)) {
+	delta_base->timestamp_sec  = Flip_int32(delta_base->timestamp_sec);
+	delta_base->timestamp_usec = Flip_int32(delta_base->timestamp_usec);
+      }
+    }
+
     for (i = 0; i < pkt->num_cells; ++i) {
 
-      state_cell = (State_Cell*) (buf + processed_bytes);
+      if (delta_base != NULL) {  /* expand the delta cell into a full cell */
+
+	d_cell = (State_Delta_Cell*) (buf + processed_bytes);
+
+	if (!Same_endian(type)) {
+	  d_cell->dest            = Flip_int32(d_cell->dest);
+	  d_cell->timestamp_delta = Flip_int32(d_cell->timestamp_delta);
+	  d_cell->value           = Flip_int16(d_cell->value);
+	  d_cell->age             = Flip_int16(d_cell->age);
+	}
+
+	stamp                      = (int64) delta_base->timestamp_usec + d_cell->timestamp_delta;
+	state_cell                 = (State_Cell*) full_cell;
+	state_cell->dest           = d_cell->dest;
+	state_cell->timestamp_sec  = delta_base->timestamp_sec + (int32) (stamp / 1000000);
+	state_cell->timestamp_usec = (int32) (stamp % 1000000);
+	state_cell->value          = d_cell->value;
+	state_cell->age            = d_cell->age;
+
+	if (state_cell->timestamp_usec < 0) {
+	  state_cell->timestamp_usec += 1000000;
+	  --state_cell->timestamp_sec;
+	}
+
+	memcpy((char*) full_cell + sizeof(State_Cell), buf + processed_bytes + sizeof(State_Delta_Cell), 
+	       p_def->Cell_packet_size() - sizeof(State_Cell));
+
+	processed_bytes += sizeof(State_Delta_Cell) + p_def->Cell_packet_size() - sizeof(State_Cell);
+
+      } else {
+
+	state_cell = (State_Cell*) (buf + processed_bytes);
 	    
-      if (!Same_endian(type)) {
-	Flip_state_cell(state_cell);
+	if (!Same_endian(type)) {
+	  Flip_state_cell(state_cell);
+	}
+
+	processed_bytes += p_def->Cell_packet_size();
       }
 
       if ((s_data = Find_State(p_def->All_States(), pkt->source, state_cell->dest)) == NULL ||
@@ -545,7 +971,7 @@ void Process_state_packet(Link  *lk,        /* link on which packet came in */
 
 	/* newer update */
 
-	if ((s_data = p_def->Process_state_cell(pkt->source, sender, buf + processed_bytes, type)) != NULL) {  /* NULL -> don't propagate this flood */
+	if ((s_data = p_def->Process_state_cell(pkt->source, sender, (char*) state_cell, type)) != NULL) {  /* NULL -> don't propagate this flood */
 	  Add_to_changed_states(p_def, sender, s_data);
 	  changed_route_flag = 1;
 	}
@@ -564,8 +990,6 @@ void Process_state_packet(Link  *lk,        /* link on which packet came in */
 	}
 
       } /* else already have newer knowledge about this state; swallow it */
-
-      processed_bytes += p_def->Cell_packet_size();
     }
   }
 
@@ -575,56 +999,114 @@ void Process_state_packet(Link  *lk,        /* link on which packet came in */
 }
 
 /***********************************************************/
-/* Resends the valid states to all the neighbors for       */
-/* garbage collection purposes                             */
+/* Returns the size of a saved state record: the source of */
+/* the state followed by a full state cell                 */
 /***********************************************************/
 
-void Resend_States(int dummy_int, 
-		   void *p_data)  /* protocol definition to resend */
+int State_Record_size(Prot_Def *p_def)  /* protocol definition */
 {
-  sp_time      now    = E_get_time();
-  Prot_Def    *p_def  = (Prot_Def*) p_data;
-  stdhash     *states = p_def->All_States();
-  int          cnt    = 0;
-  State_Data  *s_data;
+  return (int) sizeof(Node_ID) + p_def->Cell_packet_size();
+}
+
+/***********************************************************/
+/* Writes all the states of a protocol to a file, as       */
+/* State_Record_size() byte records                        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) number of states written, -1 on a write error     */
+/***********************************************************/
+
+int State_Save(Prot_Def *p_def,  /* protocol definition to save */
+	       FILE     *fp)     /* file to append the records to */
+{
+  sp_time      now     = E_get_time();
+  stdhash     *states  = p_def->All_States();
+  int          rec     = State_Record_size(p_def);
+  char         buf[sizeof(Node_ID) + sizeof(packet_body)];
+  State_Cell  *cell    = (State_Cell*) (buf + sizeof(Node_ID));
   State_Chain *s_chain;
-  sp_time      state_time;
-  sp_time      diff;
-  stdit        tit;
+  State_Data  *s_data;
+  stdit        outer_it;
+  stdit        inner_it;
+  int          count   = 0;
 
-  if (!stdhash_is_end(states, stdhash_find(states, &tit, &My_Address))) {
+  memset(buf, 0, rec);
 
-    s_chain = *(State_Chain**) stdhash_it_val(&tit);
+  for (stdhash_begin(states, &outer_it); !stdhash_is_end(states, &outer_it); stdhash_it_next(&outer_it)) {
 
-    for (stdhash_begin(&s_chain->states, &tit); !stdhash_is_end(&s_chain->states, &tit); stdhash_it_next(&tit)) {
+    s_chain = *(State_Chain**) stdhash_it_val(&outer_it);
 
-      s_data = *(State_Data**) stdhash_it_val(&tit);
-	    
-      state_time.sec  = s_data->my_timestamp_sec;
-      state_time.usec = s_data->my_timestamp_usec;
-      diff            = E_sub_time(now, state_time);
-	    
-      assert(diff.sec >= 0 && diff.usec >= 0);
+    for (stdhash_begin(&s_chain->states, &inner_it); !stdhash_is_end(&s_chain->states, &inner_it); stdhash_it_next(&inner_it)) {
 
-      if (E_compare_time(diff, state_resend_time) >= 0 &&              /* its time to refresh */
-	  p_def->Is_state_relevant((void*)s_data)) {
+      s_data = *(State_Data**) stdhash_it_val(&inner_it);
 
-	if(++s_data->timestamp_usec >= 1000000) {
-	  ++s_data->timestamp_sec;
-	  s_data->timestamp_usec = 0;
-	}
+      memcpy(buf, &s_data->source_addr, sizeof(Node_ID));
+      cell->dest           = s_data->dest_addr;
+      cell->timestamp_sec  = s_data->timestamp_sec;
+      cell->timestamp_usec = s_data->timestamp_usec;
+      cell->value          = s_data->value;
+      cell->age            = s_data->age + (now.sec - s_data->my_timestamp_sec) / 10;
+      p_def->Set_state_cell(s_data, (char*) cell + sizeof(State_Cell));
 
-	Add_to_changed_states(p_def, My_Address, s_data);              /* updates my_timestamp_* */
-	
-	if (++cnt > 500) {
-	  E_queue(Resend_States, 0, p_data, resend_fast_timeout);
-	  return;
-	}
+      if (fwrite(buf, rec, 1, fp) != 1) {
+	return -1;
       }
+
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+/***********************************************************/
+/* Applies states written by State_Save as if a neighbor   */
+/* had flooded them: a saved state only replaces a newer   */
+/* one, and my own states are left for me to publish anew  */
+/***********************************************************/
+
+void State_Restore(Prot_Def   *p_def,    /* protocol definition to restore */
+		   const char *recs,     /* records written by State_Save */
+		   int32u      count,    /* number of records */
+		   int32       elapsed)  /* seconds since they were saved */
+{
+  int          rec                = State_Record_size(p_def);
+  char         buf[sizeof(Node_ID) + sizeof(packet_body)];
+  State_Cell  *cell               = (State_Cell*) (buf + sizeof(Node_ID));
+  int          changed_route_flag = 0;
+  Node_ID      source;
+  State_Data  *s_data;
+  int32u       i;
+
+  for (i = 0; i < count; ++i, recs += rec) {
+
+    /* the records may not be aligned and the cell can be modified while processed */
+
+    memcpy(buf, recs, rec);
+    memcpy(&source, buf, sizeof(Node_ID));
+
+    if (source == My_Address) {
+      continue;
+    }
+
+    if ((s_data = Find_State(p_def->All_States(), source, cell->dest)) != NULL &&
+	(s_data->timestamp_sec > cell->timestamp_sec ||
+	 (s_data->timestamp_sec == cell->timestamp_sec && s_data->timestamp_usec >= cell->timestamp_usec))) {
+      continue;
+    }
+
+    cell->age += elapsed / 10;
+
+    if ((s_data = p_def->Process_state_cell(source, My_Address, (char*) cell, Set_endian(0))) != NULL) {
+      Add_to_changed_states(p_def, My_Address, s_data);
+      changed_route_flag = 1;
     }
   }
 
-  E_queue(Resend_States, 0, p_data, resend_call_timeout);
+  if (changed_route_flag && p_def->Is_route_change()) {
+    Schedule_Routes();
+  }
 }
 
 /***********************************************************/
@@ -643,6 +1125,7 @@ void State_Garbage_Collect(int   dummy_int,
   sp_time      state_time;
   sp_time      diff;
   State_Chain *s_chain_dst;
+  Changed_State *cg_state;
   stdit        outer_it;
   stdit        inner_it;
   stdit        dst_it;
@@ -699,6 +1182,20 @@ void State_Garbage_Collect(int   dummy_int,
 	  }
 	}
 
+	/* forget any change of it that is still to be sent */
+
+	if ((cg_state = Find_Changed_State(p_def->Changed_States(), s_data->source_addr, s_data->dest_addr)) != NULL) {
+
+	  State_Log_Unlink(p_def->Changed_Log(), cg_state);
+
+	  for (stdhash_find(p_def->Changed_States(), &src_it, &s_data->source_addr); 
+	       *(Changed_State**) stdhash_it_val(&src_it) != cg_state; 
+	       stdhash_keyed_next(p_def->Changed_States(), &src_it));
+
+	  stdhash_erase(p_def->Changed_States(), &src_it);
+	  dispose(cg_state);
+	}
+
 	p_def->Destroy_State_Data(s_data);
 	dispose(s_data);
 
@@ -754,6 +1251,7 @@ void Add_to_changed_states(Prot_Def   *p_def,   /* protocol definition to use */
 			   State_Data *s_data)  /* updated state */
 {
   sp_time        now = E_get_time();
+  State_Log     *log = p_def->Changed_Log();
   Node          *nd;
   Changed_State *cg_state;
   stdit          tit;
@@ -765,7 +1263,7 @@ void Add_to_changed_states(Prot_Def   *p_def,   /* protocol definition to use */
   s_data->my_timestamp_sec  = (int32) now.sec;
   s_data->my_timestamp_usec = (int32) now.usec;	
     
-  if (stdhash_empty(p_def->Changed_States())) {
+  if (!E_in_queue(Send_State_Updates, 0, p_def)) {
 
     if (Wireless) {
       E_queue(Send_State_Updates, 0, p_def, wireless_timeout);
@@ -803,8 +1301,26 @@ void Add_to_changed_states(Prot_Def   *p_def,   /* protocol definition to use */
     if (stdhash_insert(p_def->Changed_States(), &tit, &s_data->source_addr, &cg_state) != 0) {
       Alarm(EXIT, "Add_to_changed_states: Couldn't insert into changed states!\r\n");
     }
+
+  } else {  /* unlink the older version of this change from the log */
+    State_Log_Unlink(log, cg_state);
   }
 
+  /* append the change to the log */
+
+  cg_state->seq  = ++log->last_seq;
+  cg_state->prev = log->tail;
+  cg_state->next = NULL;
+
+  if (log->tail != NULL) {
+    log->tail->next = cg_state;
+
+  } else {
+    log->head = cg_state;
+  }
+
+  log->tail = cg_state;
+
   memset(cg_state->mask, 0, sizeof(cg_state->mask));  /* all neighbors need to know: 0 in mask -> neighbor still needs it */
 
   if (sender != My_Address) {  /* I'm not in the mask of a changed state */
@@ -840,20 +1356,12 @@ Changed_State *Find_Changed_State(stdhash  *h,       /* changed states hash to s
 }
 
 /***********************************************************/
-/* Empties the buffer of changed states                    */
+/* Initializes an empty change log                         */
 /***********************************************************/
 
-void Empty_Changed_States(stdhash *h)  /* changed states hash */
+void Init_State_Log(State_Log *log)  /* change log */
 {
-  Changed_State *cg_state;
-  stdit          tit;
-
-  for (stdhash_begin(h, &tit); !stdhash_is_end(h, &tit); stdhash_it_next(&tit)) {
-    cg_state = *(Changed_State**) stdhash_it_val(&tit);
-    dispose(cg_state);
-  } 
-
-  stdhash_clear(h);
+  memset(log, 0, sizeof(*log));
 }
 
 /***********************************************************/
@@ -37,6 +37,8 @@
 #ifndef STATE_FLOOD_H
 #define STATE_FLOOD_H
 
+#include <stdio.h>
+
 #include "link.h"
 
 typedef struct Prot_Def_d 
@@ -44,6 +46,7 @@ typedef struct Prot_Def_d
   stdhash *(*All_States)(void); 
   stdhash *(*All_States_by_Dest)(void); 
   stdhash *(*Changed_States)(void); 
+  struct State_Log_d *(*Changed_Log)(void);
   int      (*State_type)(void);
   int      (*State_header_size)(void);
   int      (*Cell_packet_size)(void);
@@ -69,18 +72,36 @@ typedef struct Prot_Def_d
    The 32's come from the fact that we are using 32b ints for the
    array.  
 
-   A set bit indicates we've sent the changed state to that
-   neighbor, whereas an unset bit means we still need to send it to
-   them.
+   A set bit indicates the neighbor already knows this version of the
+   state (e.g. - it told us about it), whereas an unset bit means we
+   need to send it to them when their cursor reaches it.
 */
 
 typedef struct Changed_State_d 
 {
   void  *state;
   int32u mask[MAX_LINKS/(MAX_LINKS_4_EDGE*32)];
+  int32u seq;                          /* position in the change log */
+  struct Changed_State_d *prev;        /* next older change in the log */
+  struct Changed_State_d *next;        /* next newer change in the log */
 
 } Changed_State;
 
+/* Log of the changed states of a protocol, oldest first.  A state
+   that changes again is moved to the end with a new sequence number,
+   so each state is in the log at most once.  Each neighbor has a
+   cursor: the sequence number of the last change sent to it.  Changes
+   every connected neighbor's cursor has passed are dropped. */
+
+typedef struct State_Log_d
+{
+  Changed_State *head;                 /* oldest change */
+  Changed_State *tail;                 /* newest change */
+  int32u         last_seq;             /* sequence number of the newest change */
+  int32u         cursor[MAX_LINKS/MAX_LINKS_4_EDGE];
+
+} State_Log;
+
 /* This is the beginning of any state type (e.g. - Edge and Group_State) */
 
 typedef struct State_Data_d 
@@ -109,8 +130,11 @@ typedef struct  State_Packet_d
 {
   Node_ID source;
   int16u  num_cells;
-  int16   src_data;  /* Data about the source source itself. 
-			Not used yet */
+  int16   src_data;  /* Data about the source itself: on packets of
+			STATE_COMPACT_TYPE, STATE_DELTA_CELLS, STATE_DIGEST
+			or STATE_DIGEST_REQUEST (see below).  Any other
+			value, or any packet of an older daemon, means
+			plain State_Cells */
 } State_Packet;
 
 /* This is the begining of any state cell */
@@ -125,12 +149,61 @@ typedef struct  State_Cell_d
 
 } State_Cell;
 
+/* Compact state packets (STATE_COMPACT_TYPE) are only sent to the
+   neighbors whose hellos carry STATE_COMPACT_TYPE; older daemons get
+   plain State_Cells and no digests.
+
+   State packets whose src_data is STATE_DELTA_CELLS carry a
+   State_Delta_Base after the header, and State_Delta_Cells instead of
+   State_Cells.  The protocol's additional cell fields follow each
+   cell as usual. */
+
+#define STATE_DELTA_CELLS 0x0de1
+
+typedef struct State_Delta_Base_d
+{
+  int32   timestamp_sec;               /* timestamp the cells are relative to */
+  int32   timestamp_usec;
+
+} State_Delta_Base;
+
+typedef struct State_Delta_Cell_d
+{
+  Node_ID dest;
+  int32   timestamp_delta;             /* microseconds after the base timestamp */
+  int16   value;
+  int16   age;
+
+} State_Delta_Cell;
+
+/* Anti-entropy: every few seconds each node sends its neighbors a
+   digest of all its states of a protocol, hashed into buckets by
+   source.  A neighbor whose own bucket hashes differ asks for the
+   states in those buckets, which are then sent as state cells.  Both
+   are state packets with no cells, marked through src_data and
+   followed by a State_Digest or a State_Digest_Request. */
+
+#define STATE_DIGEST          0x0d16
+#define STATE_DIGEST_REQUEST  0x0d17
+#define STATE_DIGEST_BUCKETS  32
+
+typedef struct State_Digest_d
+{
+  int32u  bucket[STATE_DIGEST_BUCKETS];  /* sum of the hashes of the states in each bucket */
+
+} State_Digest;
+
+typedef struct State_Digest_Request_d
+{
+  int32u  buckets;                       /* bit i set -> send the states of bucket i */
+
+} State_Digest_Request;
+
 void           Process_state_packet(Link *lk, char *buf, 
 				    int16u data_len, int16u ack_len, 
 				    int32u type, int mode);
 
 void           Net_Send_State_All(int lk_id, void *p_data); 
-int            Net_Send_State_Updates(Prot_Def *p_def, int16 node_id);
 void           Send_State_Updates(int dummy_int, void *p_data /* protocol definition to send */);     
 
 Prot_Def      *Get_Prot_Def(int32u type);
@@ -144,9 +217,15 @@ State_Data    *Find_State(stdhash *hash_struct, Node_ID source,
 Changed_State *Find_Changed_State(stdhash *hash_struct, 
 				  Node_ID source, Node_ID dest);
 
-void           Empty_Changed_States(stdhash *states);
-void           Resend_States(int sync_up, void* p_data);
+void           Init_State_Log(State_Log *log);
+void           Send_State_Digests(int dummy_int, void* p_data);
+void           Refresh_Own_States(int dummy_int, void* p_data);
 void           State_Garbage_Collect(int dummy_int, void* p_data);
 
+int            State_Record_size(Prot_Def *p_def);
+int            State_Save(Prot_Def *p_def, FILE *fp);
+void           State_Restore(Prot_Def *p_def, const char *recs, 
+			     int32u count, int32 elapsed);
+
 #endif
 
@@ -238,7 +238,7 @@ int Forward_UDP_Data(Node *next_hop, sys_scatter *scat)
   hdr->seq_no           = Set_Loss_SeqNo(lk->leg, UDP_LINK);
 
   if(network_flag == 1) {
-    ret = Link_Send(lk, scat);
+    ret = Link_Send_Ref(lk, scat);
 
     if (ret < 0) {
       return BUFF_DROP;
@@ -50,7 +50,7 @@
 #ifdef HAVE_FEATURES_H
 #  include <features.h>    /* for the glibc version number */
 #  if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
-#    ifdef HAVE_NETPACKET_PACKET_H
+#    if defined(HAVE_NETPACKET_PACKET_H) && !defined(HAVE_LINUX_IF_PACKET_H)
 #      include <netpacket/packet.h>
 #    endif
 #    ifdef HAVE_NET_ETHERNET_H
@@ -62,7 +62,7 @@
 #    include <linux/if_ether.h>    /* The L2 protocols */
 #  endif
 #else
-#  ifdef HAVE_NETPACKET_PACKET_H
+#  if defined(HAVE_NETPACKET_PACKET_H) && !defined(HAVE_LINUX_IF_PACKET_H)
 #    include <netpacket/packet.h>
 #  endif
 #  ifdef HAVE_NET_ETHERNET_H
@@ -78,6 +78,17 @@
 #  include <dlfcn.h>
 #endif
 
+#if defined(HAVE_LINUX_IF_PACKET_H) && defined(HAVE_LINUX_FILTER_H)
+#  include <linux/if_packet.h>
+#  include <linux/filter.h>
+#  include <sys/ioctl.h>
+#  include <sys/mman.h>
+#  include <net/if.h>
+#  ifdef TPACKET3_HDRLEN
+#    define WIRELESS_RING
+#  endif
+#endif
+
 #include "stdutil/stdhash.h"
 
 #include "objects.h"
@@ -97,12 +108,28 @@ int     (*_pcap_get_selectable_fd) (pcap_t*);
 int     (*_pcap_next_ex) (pcap_t*,struct pcap_pkthdr**,u_char **);
 char*   (*_pcap_geterr) (pcap_t*);
 
+#ifdef WIRELESS_RING
+static struct {
+    int                  sk;
+    unsigned char       *map;
+    struct tpacket_req3  req;
+    unsigned int         block;    /* Next block the kernel hands to us */
+    int                  prism;    /* Frames start with a prism header */
+} Ring = { -1, NULL };
+
+static int Wireless_Ring_Init(char *dev);
+#endif
+
+static void Wireless_process_frame(u_char *packet, bpf_u_int32 caplen, int prism);
+
 
 /***********************************************************/
 /* void Wireless_Init(void)                                */
 /*                                                         */
 /* Initializes raw sniffer socket used to process 802.11   */
-/* frames.  Will link to libpcap shared library.           */
+/* frames.  Uses an AF_PACKET receive ring when the kernel */
+/* supports it, and links to libpcap shared library        */
+/* otherwise.                                              */
 /*                                                         */
 /* Arguments                                               */
 /*                                                         */
@@ -131,6 +158,15 @@ void Wireless_Init()
         return;
     }
 
+#ifdef WIRELESS_RING
+    wireless_sk = Wireless_Ring_Init(Wireless_if);
+    if (wireless_sk >= 0) {
+        E_attach_fd(wireless_sk, READ_FD, Wireless_process_ring, 0, 
+                NULL, LOW_PRIORITY);
+        return;
+    }
+#endif
+
     handle = dlopen("./libpcap.so", RTLD_NOW);
     if (!handle) {
         handle = dlopen("/lib/libpcap.so", RTLD_NOW);
@@ -161,12 +197,8 @@ void Wireless_Init()
     }
 
     memset(bpf, 0, sizeof(bpf));
-    /* Unfortunately, there is a bug in Linux 2.4 bpf on 802.11 raw frames, 
-       so use packet size for now, although port-based bpf is the right way. 
-       When running on Linux 2.6 or above, you can change this line. */
-    /* I am only interested in hello packets, which are 248 bytes */
-    //sprintf(bpf, "len<300 and udp port %d", Port);
-    sprintf(bpf, "len<260 and len>240");
+    /* Only packets to our control port are of interest */
+    sprintf(bpf, "udp dst port %d", Port);
     wireless_sk = init_p80211(Wireless_if, 1, &pcap_handler, bpf);
     E_attach_fd(wireless_sk, READ_FD, Wireless_process_pkt, 0, 
             (void*)pcap_handler, LOW_PRIORITY);
@@ -193,42 +225,141 @@ void Wireless_Init()
 
 void Wireless_process_pkt(int sk, int dummy_i, void *pcap_handler)
 {
-    int ret, dst, temp;
+    int ret;
     const u_char *packet;
+    struct pcap_pkthdr *pcap_h;
+
+    ret = _pcap_next_ex((pcap_t*)pcap_handler, &pcap_h, (u_char **) &packet);
+    if (ret < 0) { 
+        Alarm(EXIT, "pcap_next_ex: error\n");
+    } else if(ret == 0) {
+        /* Timeout Elapsed */
+        return;
+    }
+
+    Wireless_process_frame((u_char *)packet, pcap_h->caplen, 1);
+}
+
+
+#ifdef WIRELESS_RING
+/***********************************************************/
+/* void Wireless_process_ring()                            */
+/*                                                         */
+/* Called by the event system when the kernel has handed   */
+/* one or more blocks of the AF_PACKET ring to us.  Every  */
+/* frame in those blocks is processed in place, and the    */
+/* blocks are then given back to the kernel                */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* sk:      ring socket                                    */
+/* dummy_i: not used                                       */
+/* dummy_p: not used                                       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+void Wireless_process_ring(int sk, int dummy_i, void *dummy_p)
+{
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *frame;
+    unsigned int i, n;
+
+    /* At most one pass over the ring, so that a flood of frames cannot
+     * keep us from the rest of the event loop */
+    for (n = 0; n < Ring.req.tp_block_nr; n++) {
+        block = (struct tpacket_block_desc *)
+                    (Ring.map + Ring.block * Ring.req.tp_block_size);
+        if ((block->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+            break;
+        __sync_synchronize();
+
+        frame = (struct tpacket3_hdr *)
+                    ((char *)block + block->hdr.bh1.offset_to_first_pkt);
+        for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+            Wireless_process_frame((u_char *)frame + frame->tp_mac,
+                                   frame->tp_snaplen, Ring.prism);
+            frame = (struct tpacket3_hdr *)((char *)frame + frame->tp_next_offset);
+        }
+
+        __sync_synchronize();
+        block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+        Ring.block = (Ring.block + 1) % Ring.req.tp_block_nr;
+    }
+}
+#endif
+
+
+/***********************************************************/
+/* void Wireless_process_frame()                           */
+/*                                                         */
+/* Records RSSI and ReTransmission info from one captured  */
+/* frame carrying a spines packet                          */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* packet:  the frame, starting at the link header         */
+/* caplen:  bytes of the frame that were captured          */
+/* prism:   1 if the frame is prism + 802.11 + LLC/SNAP,   */
+/*          0 if it is Ethernet (wired test setups)        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Wireless_process_frame(u_char *packet, bpf_u_int32 caplen, int prism)
+{
+    int dst, temp, link_len;
     u_int16_t eth_type;
     Node *nd;
     stdit it;
 
-    struct pcap_pkthdr *pcap_h;
-    wlan_header *wlan_h;
-    ieee_802_11_header *i802_h;
+    wlan_header *wlan_h = NULL;
+    ieee_802_11_header *i802_h = NULL;
     llc_header *llc_h;
     my_ip_header *ip_h;
     my_udp_header *udp_h;
     packet_header *spines_h;
 
-    ret = _pcap_next_ex((pcap_t*)pcap_handler, &pcap_h, (u_char **) &packet);
-    if (ret < 0) { 
-        Alarm(EXIT, "pcap_next_ex: error\n");
-    } else if(ret == 0) {
-        /* Timeout Elapsed */
-        return;
+    /* The link header length comes from the card on the prism path, so
+     * check it against the captured length before reading past it */
+    if (prism) {
+        if (caplen < sizeof(wlan_header) + sizeof(ieee_802_11_header) + sizeof(llc_header)) {
+            return;
+        }
+        wlan_h   = (wlan_header *)packet;
+        if (wlan_h->msglen < sizeof(wlan_header) ||
+            wlan_h->msglen > caplen - sizeof(ieee_802_11_header) - sizeof(llc_header)) {
+            return;
+        }
+        link_len = wlan_h->msglen + sizeof(ieee_802_11_header) + sizeof(llc_header);
+    } else {
+        link_len = 14;
     }
-    if (pcap_h->caplen < 200) {
-        /* Alarm(PRINT, "Wireless_process_pkt(): check bpf filtering \n"); */
+
+    if (caplen < link_len + sizeof(my_ip_header) + sizeof(my_udp_header) + 
+                 sizeof(packet_header)) {
         return;
     }
 
-    wlan_h   = (wlan_header *)packet;
-    i802_h   = (ieee_802_11_header *)((char*)wlan_h + wlan_h->msglen);
-    llc_h    = (llc_header*)((char*)i802_h + sizeof(ieee_802_11_header));
-    eth_type = ntohs(llc_h->unknown1);
+    if (prism) {
+        i802_h   = (ieee_802_11_header *)((char*)wlan_h + wlan_h->msglen);
+        llc_h    = (llc_header*)((char*)i802_h + sizeof(ieee_802_11_header));
+        eth_type = ntohs(llc_h->unknown1);
+    } else {
+        eth_type = ntohs(*(u_int16_t *)(packet + 12));
+    }
 
     if (eth_type == ETHERTYPE_IP) {
         /* IP Filtering */
-        ip_h  = (my_ip_header*)((char *)llc_h + sizeof(llc_header));
+        ip_h  = (my_ip_header*)(packet + link_len);
         dst = ntohl(ip_h->ip_dst.s_addr);
-        if (ip_h->ip_len < (sizeof(my_ip_header)+sizeof(my_udp_header)+sizeof(packet_header)) || 
+        if (ntohs(ip_h->ip_len) < (sizeof(my_ip_header)+sizeof(my_udp_header)+sizeof(packet_header)) || 
             ip_h->ip_p != IPPROTO_UDP || (dst != My_Address && dst != Discovery_Address[0])) {
             return;
         }
@@ -250,6 +381,11 @@ void Wireless_process_pkt(int sk, int dummy_i, void *pcap_handler)
             if(!stdhash_is_end(&All_Nodes, &it)) {
                 nd = *((Node **)stdhash_it_val(&it));
 
+                /* Wired frames carry no radio information */
+                if (wlan_h == NULL) {
+                    return;
+                }
+
                 /* The RSSI depends on the chip monitoring on the monitoring wireless node
                    Here, we try to be compatible with both db (broadcom) and 0-60 (atheros) values, 
                    mapped to percent.  However, some cards (like Cisco) may differ */
@@ -298,7 +434,7 @@ void Wireless_process_pkt(int sk, int dummy_i, void *pcap_handler)
     }
 }
 
-inline int init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter)
+int init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter)
 {
     struct bpf_program fp;
     int pcap_socket;
@@ -313,7 +449,7 @@ inline int init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter)
     }
 
     /* open device for reading. Need only up to 250 bytes */
-    *descr = _pcap_open_live(dev,250,promisc,0,errbuf);
+    *descr = _pcap_open_live(dev,WIRELESS_SNAPLEN,promisc,0,errbuf);
     if(*descr == NULL) { 
         printf("pcap_open_live(): %s\n", errbuf); 
         exit(1); 
@@ -349,6 +485,151 @@ inline int init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter)
     return(pcap_socket);
 }
 
+#ifdef WIRELESS_RING
+/***********************************************************/
+/* int Wireless_Ring_Init(char *dev)                       */
+/*                                                         */
+/* Opens an AF_PACKET socket on dev with a TPACKET_V3      */
+/* receive ring and a classic BPF filter that keeps only   */
+/* incoming UDP packets to our control port                */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* dev:     interface to capture on                        */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the ring socket, or -1 if the ring cannot be used */
+/*       on dev, in which case libpcap should be           */
+/*                                                         */
+/***********************************************************/
+
+static int Wireless_Ring_Init(char *dev)
+{
+    struct tpacket_req3 *req = &Ring.req;
+    struct packet_mreq   mreq;
+    struct sockaddr_ll   sll;
+    struct sock_fprog    prog;
+    struct ifreq         ifr;
+    int                  sk, version = TPACKET_V3, link_len;
+
+    sk = socket(AF_PACKET, SOCK_RAW, 0);
+    if (sk < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+    if (ioctl(sk, SIOCGIFHWADDR, &ifr) < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: %s: %s\n", dev, strerror(errno));
+        close(sk);
+        return -1;
+    }
+
+    /* Length of the link headers in front of the IP header */
+    switch (ifr.ifr_hwaddr.sa_family) {
+    case ARPHRD_IEEE80211_PRISM:
+        Ring.prism = 1;
+        link_len = sizeof(wlan_header) + sizeof(ieee_802_11_header) + sizeof(llc_header);
+        break;
+    case ARPHRD_ETHER:
+    case ARPHRD_LOOPBACK:
+        Ring.prism = 0;
+        link_len = 14;
+        break;
+    default:
+        Alarm(PRINT, "Wireless_Ring_Init: %s has unsupported link type %d\n",
+              dev, ifr.ifr_hwaddr.sa_family);
+        close(sk);
+        return -1;
+    }
+
+    {
+        /* Incoming, unfragmented IPv4 UDP to our control port, cut to
+         * WIRELESS_SNAPLEN bytes.  The EtherType is the last field of
+         * both the Ethernet and the LLC/SNAP header */
+        struct sock_filter filter[] = {
+            BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   PACKET_OUTGOING, 10, 0),
+            BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, link_len - 2),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETHERTYPE_IP, 0, 8),
+            BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, link_len + 9),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 6),
+            BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, link_len + 6),
+            BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,  0x1fff, 4, 0),
+            BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, link_len),
+            BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, link_len + 2),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   Port, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K,             WIRELESS_SNAPLEN),
+            BPF_STMT(BPF_RET | BPF_K,             0),
+        };
+
+        prog.len = sizeof(filter) / sizeof(filter[0]);
+        prog.filter = filter;
+        if (setsockopt(sk, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+            Alarm(PRINT, "Wireless_Ring_Init: SO_ATTACH_FILTER: %s\n", strerror(errno));
+            close(sk);
+            return -1;
+        }
+    }
+
+    if (setsockopt(sk, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: TPACKET_V3: %s\n", strerror(errno));
+        close(sk);
+        return -1;
+    }
+
+    memset(req, 0, sizeof(*req));
+    req->tp_block_size = WIRELESS_RING_BLOCK_SIZE;
+    req->tp_block_nr = WIRELESS_RING_BLOCKS;
+    req->tp_frame_size = WIRELESS_RING_FRAME_SIZE;
+    req->tp_frame_nr = WIRELESS_RING_BLOCK_SIZE / WIRELESS_RING_FRAME_SIZE * WIRELESS_RING_BLOCKS;
+    req->tp_retire_blk_tov = WIRELESS_RING_TIMEOUT_MS;
+    if (setsockopt(sk, SOL_PACKET, PACKET_RX_RING, req, sizeof(*req)) < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: PACKET_RX_RING: %s\n", strerror(errno));
+        close(sk);
+        return -1;
+    }
+
+    Ring.map = mmap(NULL, req->tp_block_size * req->tp_block_nr, 
+                    PROT_READ | PROT_WRITE, MAP_SHARED, sk, 0);
+    if (Ring.map == MAP_FAILED) {
+        Alarm(PRINT, "Wireless_Ring_Init: mmap: %s\n", strerror(errno));
+        Ring.map = NULL;
+        close(sk);
+        return -1;
+    }
+    Ring.block = 0;
+
+    /* Only start receiving once the filter and the ring are in place */
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = if_nametoindex(dev);
+    if (sll.sll_ifindex == 0 || bind(sk, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: bind to %s: %s\n", dev, strerror(errno));
+        munmap(Ring.map, req->tp_block_size * req->tp_block_nr);
+        Ring.map = NULL;
+        close(sk);
+        return -1;
+    }
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = sll.sll_ifindex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(sk, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        Alarm(PRINT, "Wireless_Ring_Init: promiscuous mode on %s: %s\n", 
+              dev, strerror(errno));
+    }
+
+    Ring.sk = sk;
+    printf("\nRAW SOCKET CAPTURE : DEVICE=%s (TPACKET_V3 ring)\n", dev);
+
+    return sk;
+}
+#endif
+
 
 void Wireless_Print_Status(FILE *fp) 
 {
@@ -358,10 +639,25 @@ void Wireless_Print_Status(FILE *fp)
         stdit it;
         char line[256];
         int connected, loss_rate;
+#ifdef WIRELESS_RING
+        struct tpacket_stats_v3 stats;
+        socklen_t len = sizeof(stats);
+#endif
 
         sprintf(line, "\n\nWireless Neighbors Status: ["IPF"]\n", IP(My_Address)); 
     	Alarm(PRINT, "%s", line); 
     	if (fp != NULL) fprintf(fp, "%s", line); 
+
+#ifdef WIRELESS_RING
+        /* The kernel resets these counters on every read */
+        if (Ring.sk >= 0 && 
+            getsockopt(Ring.sk, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+            sprintf(line, "Capture ring: %u frames, %u dropped, %u blocks full\n", 
+                    stats.tp_packets, stats.tp_drops, stats.tp_freeze_q_cnt);
+            Alarm(PRINT, "%s", line); 
+            if (fp != NULL) fprintf(fp, "%s", line); 
+        }
+#endif
         stdhash_begin(&All_Nodes, &it); 
         while(!stdhash_is_end(&All_Nodes, &it)) {
             nd = *((Node **)stdhash_it_val(&it));
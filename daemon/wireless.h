@@ -38,6 +38,15 @@
 #define Wireless_H
 
 
+#define WIRELESS_SNAPLEN          250     /* Bytes kept of each captured frame */
+
+/* AF_PACKET receive ring (TPACKET_V3): the kernel fills whole blocks and
+ * wakes us up once per block, or when a partly filled block times out */
+#define WIRELESS_RING_BLOCK_SIZE  (1 << 16)
+#define WIRELESS_RING_BLOCKS      8
+#define WIRELESS_RING_FRAME_SIZE  2048
+#define WIRELESS_RING_TIMEOUT_MS  20
+
 typedef struct Wireless_Data_d {
     int16 rssi; 
     int16 retry;
@@ -138,7 +147,8 @@ struct bpf_program {
 
 void Wireless_Init();
 void Wireless_process_pkt(int sk, int dummy_i, void *pcap_handler);
-inline int init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter);
+void Wireless_process_ring(int sk, int dummy_i, void *dummy_p);
+int  init_p80211(char *dev, int promisc, pcap_t** descr, char *my_filter);
 void Wireless_Print_Status(FILE *fp);
 
 
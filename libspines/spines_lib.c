@@ -34,10 +34,16 @@
  *
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE  /* sendmmsg / recvmmsg */
+#endif
+
 #ifndef	ARCH_PC_WIN95
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
 
 #ifndef NDEBUG  /* NOTE: turn this off if you want asserts for debugging */
 #  define NDEBUG
@@ -50,8 +56,20 @@
 #include <sys/time.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
 #include <pthread.h>
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#  define LIB_HAVE_MMSG
+#endif
+#if defined(__linux__) && defined(SOCK_SEQPACKET) && defined(SCM_CREDENTIALS)
+#  define LIB_HAVE_SEQPACKET
+#endif
+#ifndef IOV_MAX
+#  define IOV_MAX 1024
+#endif
+
 #else
 
 #include <winsock2.h>
@@ -119,19 +137,73 @@ typedef struct Lib_Client_d {
     int ip_ttl;              /* ttl to stamp all unicast "DATA" UDP packets */ 
     int mcast_ttl;           /* ttl to stamp all multicast "DATA" UDP packets */
     int routing;
+    int seqpacket;           /* data socket is an AF_UNIX SOCK_SEQPACKET */
+    int recv_err;            /* error that cut a received batch short,
+                                returned by the next receive */
 } Lib_Client;
 
+/* The socket -> client table is indexed by the socket descriptor, so that
+ * spines_get_client() is O(1) and needs no lock. It is split in pages that
+ * are allocated the first time a descriptor in their range is used and are
+ * never freed. Entries (client + 1, 0 meaning no client) are only written
+ * with data_mutex held, by spines_socket() and spines_close(), after the
+ * client itself is filled in. Everything else in Lib_Client is either
+ * immutable once the socket is returned to the application or a single int
+ * changed by the thread that owns the socket (ttl, connect address, bound
+ * port), so the send and receive paths never take data_mutex. */
+#define CLIENT_PAGE_BITS 8
+#define CLIENT_PAGE_SIZE (1 << CLIENT_PAGE_BITS)
+#define CLIENT_PAGES     1024
+#define MAX_CLIENT_SK    (CLIENT_PAGES * CLIENT_PAGE_SIZE)
+
+#if defined(__GNUC__)
+#  define CLIENT_TABLE_BARRIER() __sync_synchronize()
+#else
+#  define CLIENT_TABLE_BARRIER()
+#endif
+
 /* Local variables */ 
 static spines_sockaddr Spines_Addr;
 static int             Local_Address = 0;
-static int             Max_Client = 0;
 static int             Control_sk[MAX_CTRL_SOCKETS];
 
 static Lib_Client      all_clients[MAX_APP_CLIENTS];
+static int * volatile  client_table[CLIENT_PAGES];
 static int             init_flag  = 0;
 
 static stdmutex	       data_mutex = { 0 };
 
+/* Returns the table entry of socket sk, allocating its page if needed.
+ * Must be called with data_mutex held. */
+static volatile int *Client_Table_Entry(int sk)
+{
+    int *page;
+
+    if(sk < 0 || sk >= MAX_CLIENT_SK)
+        return(NULL);
+
+    page = client_table[sk >> CLIENT_PAGE_BITS];
+    if(page == NULL) {
+        page = (int*) calloc(CLIENT_PAGE_SIZE, sizeof(int));
+        if(page == NULL)
+            return(NULL);
+        CLIENT_TABLE_BARRIER();
+        client_table[sk >> CLIENT_PAGE_BITS] = page;
+    }
+    return(&page[sk & (CLIENT_PAGE_SIZE - 1)]);
+}
+
+/* Maps socket sk to client (-1 to remove it). The entry must exist. 
+ * Must be called with data_mutex held. */
+static void Client_Table_Set(int sk, int client)
+{
+    volatile int *entry;
+
+    entry = Client_Table_Entry(sk);
+    CLIENT_TABLE_BARRIER();
+    *entry = client + 1;
+}
+
 static void	Flip_udp_hdr( udp_header *udp_hdr )
 {
     udp_hdr->source	  = Flip_int32( udp_hdr->source );
@@ -373,6 +445,50 @@ int Send_Initial_UDP_Packet_To_Server(int s, struct sockaddr *saddr, int my_addr
     return(len);
 }
 
+#ifdef LIB_HAVE_SEQPACKET
+/* Sends the first record of a SOCK_SEQPACKET connection to the daemon along
+ * with the credentials of this process, which the kernel checks. Returns
+ * the number of bytes sent, or 0 on error */
+static int Lib_Send_Cred(int sk, char *buf, int len)
+{
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    struct ucred cred;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct ucred))];
+    } control;
+    int ret;
+
+    cred.pid = getpid();
+    cred.uid = geteuid();
+    cred.gid = getegid();
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    memset(&mh, 0, sizeof(mh));
+    memset(&control, 0, sizeof(control));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_CREDENTIALS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+    memcpy(CMSG_DATA(cmsg), &cred, sizeof(cred));
+
+    do {
+        ret = sendmsg(sk, &mh, 0);
+    } while(ret < 0 && errno == EINTR);
+    if(ret != len)
+        return(0);
+    return(ret);
+}
+#endif
+
 /***********************************************************/
 /* int spines_socket(int domain, int type,                 */
 /*                   int protocol,                         */
@@ -407,7 +523,7 @@ int  spines_socket(int domain, int type, int protocol,
     int val, ret, sk, u_sk, ctrl_sk, s_ctrl_sk, client;
     int32 *flag_var, *route_var, *sess_var, *rnd_var, *port_var, *addr_var;
     int udp_port, rnd_num, sess_id;
-    int link_prot, route_prot, connect_flag, session_prot;
+    int link_prot, route_prot, connect_flag, session_prot, seq_flag, sk_type;
     int tot_bytes, recv_bytes;
     int v_local_port, v_addr;
     int32 endianess_type;
@@ -433,6 +549,7 @@ int  spines_socket(int domain, int type, int protocol,
     route_prot   = protocol & RESERVED_ROUTING_BITS;
     connect_flag = protocol & UDP_CONNECT;
     session_prot = protocol & RESERVED_SESSION_BITS;
+    seq_flag     = protocol & SEQPACKET_CONNECT;
 
     /* Check for valid client-specified protocol options */
     if (type != SOCK_DGRAM && connect_flag == UDP_CONNECT) {
@@ -511,6 +628,19 @@ int  spines_socket(int domain, int type, int protocol,
         return(-1);
     }
 #endif
+#ifdef LIB_HAVE_SEQPACKET
+    if (seq_flag == SEQPACKET_CONNECT && (sp_addr.family != AF_UNIX || type != SOCK_DGRAM)) {
+        Alarm(PRINT, "spines_socket(): SEQPACKET_CONNECT needs a SOCK_DGRAM socket over AF_UNIX\r\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
+#else
+    if (seq_flag == SEQPACKET_CONNECT) {
+        Alarm(PRINT, "spines_socket(): SEQPACKET_CONNECT unsupported on this platform\r\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
+#endif
 
     /* Setup sockaddr pointers to appropriate structs for connection */
     Alarm(DEBUG, "spines_socket(): sp_addr.family %d, AF_UNIX: %d, AF_INET %d, AF_INET6 %d\n", sp_addr.family, AF_UNIX, AF_INET, AF_INET6); // AB DEBUG
@@ -535,7 +665,8 @@ int  spines_socket(int domain, int type, int protocol,
             memcpy(&unix_addr, &unix_ctrl_addr, sizeof(unix_addr));
             /* Check room for NULL byte */
             s_len = sizeof(unix_addr.sun_path) - 1;
-            ret = snprintf(unix_addr.sun_path, s_len, "%s%s", unix_ctrl_addr.sun_path, SPINES_UNIX_DATA_SUFFIX);
+            ret = snprintf(unix_addr.sun_path, s_len, "%s%s", unix_ctrl_addr.sun_path, 
+                    seq_flag == SEQPACKET_CONNECT ? SPINES_UNIX_SEQ_SUFFIX : SPINES_UNIX_DATA_SUFFIX);
             if (ret > s_len) {
                 Alarm(PRINT, "spines_socket(): Data suffix did not fit! total len = %d, max allowed is %u\n",
                                 ret, s_len);
@@ -565,8 +696,13 @@ int  spines_socket(int domain, int type, int protocol,
             return(-1);
     }
 
+    sk_type = SOCK_STREAM;
+#ifdef LIB_HAVE_SEQPACKET
+    if (seq_flag == SEQPACKET_CONNECT)
+        sk_type = SOCK_SEQPACKET;
+#endif
     ctrl_sk = socket(sp_addr.family, SOCK_STREAM, 0);
-    sk = socket(sp_addr.family, SOCK_STREAM, 0);
+    sk = socket(sp_addr.family, sk_type, 0);
     if (sk < 0 || ctrl_sk < 0) {
         Alarm(PRINT, "spines_socket: unable to create socket %d %d %d '%s'\n", 
                 sk, ctrl_sk, errno, strerror(errno));
@@ -677,9 +813,15 @@ int  spines_socket(int domain, int type, int protocol,
 
     *msg_type = LINKS_TYPE_MSG;
 
-    /* (1) Send the endianess */
+    /* (1) Send the endianess. Over SOCK_SEQPACKET it carries the
+       credentials the daemon authenticates the client with */
     endianess_type = Set_endian(0);
     tot_bytes = 0;
+#ifdef LIB_HAVE_SEQPACKET
+    if (seq_flag == SEQPACKET_CONNECT)
+        tot_bytes = Lib_Send_Cred(sk, (char*)&endianess_type, sizeof(int32));
+    else
+#endif
     while (tot_bytes < sizeof(int32)) {
         if ((ret = send(sk, ((char*)(&endianess_type))+tot_bytes, sizeof(int32)-tot_bytes, 0)) <= 0)
             break;
@@ -753,7 +895,12 @@ int  spines_socket(int domain, int type, int protocol,
 	            break;
         }
 
-        if(client == MAX_APP_CLIENTS) {
+        /* Make sure the table has room for every socket of this client
+         * before publishing it, so that Client_Table_Set cannot fail */
+        if(client == MAX_APP_CLIENTS || Client_Table_Entry(sk) == NULL ||
+           (type == SOCK_DGRAM && connect_flag == UDP_CONNECT && 
+            Client_Table_Entry(u_sk) == NULL)) 
+        {
 	        Alarm(PRINT, "spines_socket(): Too many open sockets\n");
 	        stdmutex_drop(&data_mutex);
 	        close(sk);
@@ -763,20 +910,24 @@ int  spines_socket(int domain, int type, int protocol,
 	        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
 	        return(-1);
         }
-      
-        if(client == Max_Client)
-	        Max_Client++;
 
         all_clients[client].type = 0;
         all_clients[client].connect_flag = 0;
         all_clients[client].endianess_type = endianess_type;
         all_clients[client].tcp_sk = sk;
         all_clients[client].udp_sk = sk;
+        all_clients[client].seqpacket = (seq_flag == SEQPACKET_CONNECT);
+        all_clients[client].recv_err = 0;
+        Client_Table_Set(sk, client);
     } stdmutex_drop(&data_mutex);
 
     /* Get the session ID, virtual local port, and virtual addr */
     ret = spines_recvfrom(sk, buf, sizeof(buf), 1, NULL, NULL);
     if(ret <= 0) {
+        stdmutex_grab(&data_mutex); {
+            Client_Table_Set(sk, -1);
+            all_clients[client].udp_sk = -1;
+        } stdmutex_drop(&data_mutex);
 	    close(sk);
 	    close(ctrl_sk);
 	    if(type == SOCK_DGRAM && connect_flag == UDP_CONNECT)
@@ -804,7 +955,7 @@ int  spines_socket(int domain, int type, int protocol,
         all_clients[client].sess_id            = sess_id;
 
         memcpy(&all_clients[client].addr_storage, &sp_addr, sizeof(sp_addr));
-        all_clients[client].srv_addr = (struct sockaddr*)(&all_clients[client].addr_storage);
+        all_clients[client].srv_addr = (struct sockaddr*)(&all_clients[client].addr_storage.addr);
 
         all_clients[client].protocol           = protocol;
         all_clients[client].connect_addr       = -1;
@@ -815,6 +966,12 @@ int  spines_socket(int domain, int type, int protocol,
         all_clients[client].mcast_ttl          = SPINES_TTL_MAX;
         all_clients[client].routing            = ((protocol & RESERVED_ROUTING_BITS) >> ROUTING_BITS_SHIFT);
         all_clients[client].session_semantics  = session_prot;
+
+        /* UDP clients are looked up by their UDP socket */
+        if(type == SOCK_DGRAM && connect_flag == UDP_CONNECT) {
+            Client_Table_Set(sk, -1);
+            Client_Table_Set(u_sk, client);
+        }
     } stdmutex_drop(&data_mutex);
 
     if (type == SOCK_DGRAM && connect_flag == UDP_CONNECT && sp_addr.family == AF_INET) {
@@ -867,10 +1024,8 @@ void spines_close(int s)
         type = all_clients[client].type;
         tcp_sk = all_clients[client].tcp_sk;
         connect_flag = all_clients[client].connect_flag;
+        Client_Table_Set(s, -1);
         all_clients[client].udp_sk = -1;
-        if(client == Max_Client-1) {
-	        Max_Client--;
-        }
 
     } stdmutex_drop(&data_mutex);
 
@@ -910,18 +1065,13 @@ void spines_shutdown(int s)
 {
     int client, type, tcp_sk, connect_flag;
 
-    stdmutex_grab(&data_mutex); {
-
-        client = spines_get_client(s);
-        if(client == -1) {
-	        stdmutex_drop(&data_mutex);
-	        return;
-        }
-        type = all_clients[client].type;
-        tcp_sk = all_clients[client].tcp_sk;
-        connect_flag = all_clients[client].connect_flag;
-
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(s);
+    if(client == -1) {
+        return;
+    }
+    type = all_clients[client].type;
+    tcp_sk = all_clients[client].tcp_sk;
+    connect_flag = all_clients[client].connect_flag;
 
 #ifdef ARCH_PC_WIN95
     shutdown(s, SD_BOTH);
@@ -942,6 +1092,798 @@ void spines_shutdown(int s)
 }
 
 
+/* Message transport between a client and its daemon. The send and receive
+ * paths hand the application's iovecs straight to writev / sendmmsg /
+ * recvmmsg next to a small per-message header, so no message is copied and a
+ * whole batch costs one system call */
+
+#define LIB_UDP_MODE     1  /* UDP_CONNECT datagrams to the session UDP port    */
+#define LIB_TCP_MODE     2  /* datagrams framed on the TCP / unix domain socket */
+#define LIB_STREAM_MODE  3  /* SOCK_STREAM (reliable session) byte stream       */
+#define LIB_SEQ_MODE     4  /* one datagram per SOCK_SEQPACKET unix record      */
+
+#define LIB_BATCH_MSGS   64   /* max messages given to one system call */
+#define LIB_BATCH_IOV    256  /* max iovec elements given to one system call */
+#define LIB_HDR_SPACE    (2*sizeof(int32) + sizeof(udp_header) + sizeof(rel_udp_pkt_add))
+#define LIB_TCP_HDR_LEN  (sizeof(int32) + sizeof(udp_header))
+
+static int Lib_Client_Mode(int client, int force_tcp)
+{
+    if(all_clients[client].seqpacket)
+        return(LIB_SEQ_MODE);
+    if(force_tcp == 1)
+        return(LIB_TCP_MODE);
+    if(all_clients[client].type == SOCK_STREAM)
+        return(LIB_STREAM_MODE);
+    if(all_clients[client].connect_flag == UDP_CONNECT)
+        return(LIB_UDP_MODE);
+    return(LIB_TCP_MODE);
+}
+
+/* Returns the total length of the buffers of msg, or -1 if the iovec array
+ * is invalid or too long to be sent in one system call together with its
+ * header */
+static int Lib_Msg_Len(const spines_msg *msg)
+{
+    int i, len;
+
+    if((int)msg->msg_iovlen < 0 || (int)msg->msg_iovlen > LIB_BATCH_IOV - 3 ||
+       (msg->msg_iovlen > 0 && msg->msg_iov == NULL))
+        return(-1);
+
+    for(i = 0, len = 0; i < (int)msg->msg_iovlen; i++) {
+        if((int)msg->msg_iov[i].iov_len < 0 ||
+           len + (int)msg->msg_iov[i].iov_len < len)
+            return(-1);
+        len += (int)msg->msg_iov[i].iov_len;
+    }
+    return(len);
+}
+
+/* Writes all of iov to sk, restarting after partial writes. The iovec
+ * array is consumed. Returns 0 on success, -1 on error */
+static int Lib_Writev(int sk, spines_iovec *iov, int iovcnt)
+{
+    int ret;
+
+#ifndef ARCH_PC_WIN95
+    while(iovcnt > 0) {
+        ret = writev(sk, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return(-1);
+        while(iovcnt > 0 && (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+#else
+    size_t done;
+
+    for(; iovcnt > 0; iov++, iovcnt--) {
+        for(done = 0; done < iov->iov_len; done += ret) {
+            ret = send(sk, (char*)iov->iov_base + done, iov->iov_len - done, 0);
+            if(ret <= 0)
+                return(-1);
+        }
+    }
+#endif
+    return(0);
+}
+
+/* Fills all of iov from sk. The iovec array is consumed. Returns 0 on
+ * success, -1 on error or if the connection was closed */
+static int Lib_Readv(int sk, spines_iovec *iov, int iovcnt)
+{
+    int ret;
+
+#ifndef ARCH_PC_WIN95
+    while(iovcnt > 0) {
+        ret = readv(sk, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return(-1);
+        while(iovcnt > 0 && (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+#else
+    size_t done;
+
+    for(; iovcnt > 0; iov++, iovcnt--) {
+        for(done = 0; done < iov->iov_len; done += ret) {
+            ret = recv(sk, (char*)iov->iov_base + done, iov->iov_len - done, 0);
+            if(ret <= 0)
+                return(-1);
+        }
+    }
+#endif
+    return(0);
+}
+
+/* Builds in buf the header that precedes a len byte message in the given
+ * transport. Returns the header length, or -1 if the destination is invalid */
+static int Lib_Fill_Send_Hdr(int client, int mode, const spines_msg *msg,
+                             int len, char *buf)
+{
+    udp_header *hdr;
+    rel_udp_pkt_add *r_add;
+    int address, port;
+
+    memset(buf, 0, LIB_HDR_SPACE);
+
+    if(mode == LIB_STREAM_MODE) {
+        *(int32*)buf = len + sizeof(udp_header) + sizeof(rel_udp_pkt_add);
+        hdr = (udp_header*)(buf+sizeof(int32));
+        r_add = (rel_udp_pkt_add*)(buf+sizeof(int32)+sizeof(udp_header));
+
+        hdr->len = len + sizeof(rel_udp_pkt_add);
+        hdr->ttl = all_clients[client].ip_ttl;
+        hdr->routing = all_clients[client].routing;
+        r_add->type = Set_endian(0);
+        r_add->data_len = len;
+        r_add->ack_len = 0;
+        return(sizeof(int32)+sizeof(udp_header)+sizeof(rel_udp_pkt_add));
+    }
+
+    if(msg->msg_name != NULL) {
+        if(msg->msg_namelen < sizeof(struct sockaddr_in)) {
+            Alarm(PRINT, "spines_sendto(): invalid address\n");
+            return(-1);
+        }
+        address = ntohl(((struct sockaddr_in*)msg->msg_name)->sin_addr.s_addr);
+        port = ntohs(((struct sockaddr_in*)msg->msg_name)->sin_port);
+    } else {
+        if(all_clients[client].connect_port == -1) {
+            Alarm(PRINT, "DGRAM socket not connected\n");
+            return(-1);
+        }
+        address = all_clients[client].connect_addr;
+        port = all_clients[client].connect_port;
+    }
+    if(port == 0) {
+        Alarm(PRINT, "spines_sendto(): cannot send to port 0\n");
+        return(-1);
+    }
+
+    if(mode == LIB_UDP_MODE) {
+        *(int*)buf = all_clients[client].sess_id;
+        *(int*)(buf+sizeof(int)) = all_clients[client].rnd_num;
+        hdr = (udp_header*)(buf+2*sizeof(int));
+        hdr->source = all_clients[client].my_addr;
+        hdr->source_port = all_clients[client].my_port;
+    } else {
+        *(int32*)buf = len + sizeof(udp_header);
+        hdr = (udp_header*)(buf+sizeof(int32));
+    }
+    hdr->dest = (int32)address;
+    hdr->dest_port = port;
+    hdr->len = len;
+
+    /* set the TTL of the packet */
+    if(!Is_mcast_addr(hdr->dest) && !Is_acast_addr(hdr->dest)) {
+        /* This is unicast */
+        hdr->ttl = all_clients[client].ip_ttl;
+    } else {
+        /* This is a multicast */
+        hdr->ttl = all_clients[client].mcast_ttl;
+    }
+    hdr->routing = all_clients[client].routing;
+
+    if(mode == LIB_UDP_MODE)
+        return(2*sizeof(int)+sizeof(udp_header));
+    return(sizeof(int32)+sizeof(udp_header));
+}
+
+/* Sends n datagrams to the daemon's session UDP port. Message i is made of
+ * the iov_cnt[i] elements of iov starting at iov_start[i]. Returns the
+ * number of datagrams sent, or -1 if none could be sent */
+static int Lib_Send_Datagrams(int s, int client, spines_iovec *iov,
+                              int *iov_start, int *iov_cnt, int n)
+{
+    struct sockaddr_in *inet_ptr;
+    int i, ret, total;
+#ifdef LIB_HAVE_MMSG
+    struct mmsghdr mmh[LIB_BATCH_MSGS];
+    struct sockaddr_in daemon_addr;
+#else
+    sys_scatter scat;
+    int j;
+#endif
+
+    inet_ptr = (struct sockaddr_in *)all_clients[client].srv_addr;
+    if(inet_ptr->sin_family != AF_INET) {
+        Alarm(PRINT, "spines_sendto(): cannot send UDP DGRAM using non AF_INET sockaddr\n");
+        return(-1);
+    }
+
+#ifdef LIB_HAVE_MMSG
+    memset(&daemon_addr, 0, sizeof(daemon_addr));
+    daemon_addr.sin_family = AF_INET;
+    daemon_addr.sin_addr = inet_ptr->sin_addr;
+    daemon_addr.sin_port = htons(ntohs(inet_ptr->sin_port)+SESS_UDP_PORT);
+
+    memset(mmh, 0, n * sizeof(struct mmsghdr));
+    for(i = 0; i < n; i++) {
+        mmh[i].msg_hdr.msg_name = &daemon_addr;
+        mmh[i].msg_hdr.msg_namelen = sizeof(daemon_addr);
+        mmh[i].msg_hdr.msg_iov = &iov[iov_start[i]];
+        mmh[i].msg_hdr.msg_iovlen = iov_cnt[i];
+    }
+
+    for(total = 0; total < n; total += ret) {
+        ret = sendmmsg(s, &mmh[total], n - total, 0);
+        if(ret < 0 && errno == EINTR) {
+            ret = 0;
+            continue;
+        }
+        if(ret <= 0)
+            break;
+    }
+#else
+    for(total = 0; total < n; total++) {
+        scat.num_elements = iov_cnt[total];
+        for(i = 0, j = iov_start[total]; i < iov_cnt[total]; i++, j++) {
+            scat.elements[i].buf = iov[j].iov_base;
+            scat.elements[i].len = iov[j].iov_len;
+        }
+        ret = DL_send(s, ntohl(inet_ptr->sin_addr.s_addr),
+                      ntohs(inet_ptr->sin_port)+SESS_UDP_PORT, &scat);
+        if(ret <= 0)
+            break;
+    }
+#endif
+    if(total == 0) {
+        Alarm(PRINT, "spines_sendto(): error sending to the daemon\n");
+        return(-1);
+    }
+    return(total);
+}
+
+#ifdef LIB_HAVE_SEQPACKET
+/* Sends n datagrams as records of the SOCK_SEQPACKET socket sk, laid out as
+ * in Lib_Send_Datagrams. The kernel keeps the boundary of every record, so
+ * the whole batch goes in one system call. Returns the number of datagrams
+ * sent, or -1 if none could be sent */
+static int Lib_Send_Records(int sk, spines_iovec *iov, int *iov_start,
+                            int *iov_cnt, int n)
+{
+    int ret, total;
+#ifdef LIB_HAVE_MMSG
+    struct mmsghdr mmh[LIB_BATCH_MSGS];
+    int i;
+
+    memset(mmh, 0, n * sizeof(struct mmsghdr));
+    for(i = 0; i < n; i++) {
+        mmh[i].msg_hdr.msg_iov = &iov[iov_start[i]];
+        mmh[i].msg_hdr.msg_iovlen = iov_cnt[i];
+    }
+
+    for(total = 0; total < n; total += ret) {
+        ret = sendmmsg(sk, &mmh[total], n - total, 0);
+        if(ret < 0 && errno == EINTR) {
+            ret = 0;
+            continue;
+        }
+        if(ret <= 0)
+            break;
+    }
+#else
+    struct msghdr mh;
+
+    memset(&mh, 0, sizeof(mh));
+    for(total = 0; total < n; total++) {
+        mh.msg_iov = &iov[iov_start[total]];
+        mh.msg_iovlen = iov_cnt[total];
+        do {
+            ret = sendmsg(sk, &mh, 0);
+        } while(ret < 0 && errno == EINTR);
+        if(ret <= 0)
+            break;
+    }
+#endif
+    if(total == 0) {
+        Alarm(PRINT, "spines_sendto(): error sending to the daemon\n");
+        return(-1);
+    }
+    return(total);
+}
+#endif
+
+/* Sends up to vlen messages on Spines socket s, gathering as many of them
+ * as possible into each system call. msg_len of every message sent is set
+ * to its length. Returns the number of messages sent, or -1 if none */
+static int Lib_Send_Batch(int s, spines_mmsghdr *msgvec, unsigned int vlen,
+                          int force_tcp)
+{
+    spines_iovec iov[LIB_BATCH_IOV];
+    char hdrs[LIB_BATCH_MSGS][LIB_HDR_SPACE];
+    int iov_start[LIB_BATCH_MSGS], iov_cnt[LIB_BATCH_MSGS];
+    int lens[LIB_BATCH_MSGS];
+    const spines_msg *msg;
+    int client, mode, sk, i, n, niov, len, hlen, ret, err;
+    unsigned int sent;
+
+    client = spines_get_client(s);
+    if(client == -1) {
+        Alarm(PRINT, "spines_send(): unknown spines socket\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
+    mode = Lib_Client_Mode(client, force_tcp);
+    sk = (mode == LIB_UDP_MODE) ? s : all_clients[client].tcp_sk;
+
+    err = 0;
+    sent = 0;
+    while(sent < vlen && !err) {
+
+        /* Gather as many messages as fit in one system call */
+        for(n = 0, niov = 0; sent + n < vlen && n < LIB_BATCH_MSGS; n++) {
+            msg = &msgvec[sent + n].msg_hdr;
+            len = Lib_Msg_Len(msg);
+            if(len < 0 || len > MAX_SPINES_CLIENT_MSG) {
+                Alarm(PRINT, "spines_send(): invalid message or msg size limit"
+                             " exceeded (max %d)...dropping\n", MAX_SPINES_CLIENT_MSG);
+                err = SP_ERROR_INPUT_ERR;
+                break;
+            }
+            if(niov + 1 + (int)msg->msg_iovlen > LIB_BATCH_IOV)
+                break;
+
+            hlen = Lib_Fill_Send_Hdr(client, mode, msg, len, hdrs[n]);
+            if(hlen < 0) {
+                err = SP_ERROR_INPUT_ERR;
+                break;
+            }
+            iov_start[n] = niov;
+            iov[niov].iov_base = hdrs[n];
+            iov[niov].iov_len = hlen;
+            niov++;
+            for(i = 0; i < (int)msg->msg_iovlen; i++)
+                iov[niov++] = msg->msg_iov[i];
+            iov_cnt[n] = niov - iov_start[n];
+            lens[n] = len;
+        }
+        if(n == 0)
+            break;
+
+        if(mode == LIB_UDP_MODE || mode == LIB_SEQ_MODE) {
+#ifdef LIB_HAVE_SEQPACKET
+            if(mode == LIB_SEQ_MODE)
+                ret = Lib_Send_Records(sk, iov, iov_start, iov_cnt, n);
+            else
+#endif
+            ret = Lib_Send_Datagrams(sk, client, iov, iov_start, iov_cnt, n);
+            if(ret < n)
+                err = SP_ERROR_DAEMON_COMM_ERR;
+            if(ret > 0)
+                n = ret;
+            else
+                n = 0;
+        } else if(Lib_Writev(sk, iov, niov) < 0) {
+            /* The stream to the daemon is no longer in sync */
+            Alarm(PRINT, "spines_send(): error sending to the daemon\n");
+            err = SP_ERROR_DAEMON_COMM_ERR;
+            n = 0;
+        }
+
+        for(i = 0; i < n; i++)
+            msgvec[sent + i].msg_len = lens[i];
+        sent += n;
+    }
+
+    /* SESSION_SEMANTICS - possibly block on recv feedbackfor session_flag here */
+    if(sent == 0 && err != 0) {
+        spines_set_errno(err);
+        return(-1);
+    }
+    return((int)sent);
+}
+
+/* Sends a single contiguous message through Lib_Send_Batch. Returns the
+ * number of bytes sent, or -1 */
+static int Lib_Send_One(int s, const void *buf, size_t len,
+                        const struct sockaddr *to, socklen_t tolen, int force_tcp)
+{
+    spines_iovec iov;
+    spines_mmsghdr mm;
+
+    memset(&mm, 0, sizeof(mm));
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+    mm.msg_hdr.msg_name = (void*)to;
+    mm.msg_hdr.msg_namelen = tolen;
+    mm.msg_hdr.msg_iov = &iov;
+    mm.msg_hdr.msg_iovlen = 1;
+
+    if(Lib_Send_Batch(s, &mm, 1, force_tcp) != 1)
+        return(-1);
+    return((int)mm.msg_len);
+}
+
+/* Returns 1 if the sender address of a message fits in msg */
+static int Lib_From_Fits(spines_msg *msg)
+{
+    return(msg->msg_name == NULL || msg->msg_namelen >= sizeof(struct sockaddr_in));
+}
+
+/* Fills the sender address of a received message */
+static int Lib_Set_From(spines_msg *msg, udp_header *hdr)
+{
+    if(msg->msg_name == NULL)
+        return(0);
+
+    if(!Lib_From_Fits(msg)) {
+        Alarm(PRINT, "spines_recvfrom(): fromlen too small\n");
+        return(-1);
+    }
+    memset(msg->msg_name, 0, sizeof(struct sockaddr_in));
+    ((struct sockaddr_in*)msg->msg_name)->sin_family = AF_INET;
+    ((struct sockaddr_in*)msg->msg_name)->sin_port = htons((short)hdr->source_port);
+    ((struct sockaddr_in*)msg->msg_name)->sin_addr.s_addr = htonl(hdr->source);
+    msg->msg_namelen = sizeof(struct sockaddr_in);
+    return(0);
+}
+
+/* Receives up to vlen datagrams from the daemon's UDP session socket with a
+ * single system call. Only the first one is waited for. The batch stops
+ * before a message whose buffers cannot take a datagram, so that none is
+ * received for nothing. A malformed datagram is dropped and cuts the batch
+ * short: the datagrams before it are returned, and the error by the next
+ * call */
+static int Lib_Recv_Datagrams(int s, int client, spines_mmsghdr *msgvec,
+                              unsigned int vlen)
+{
+    spines_iovec iov[LIB_BATCH_IOV];
+    int32 msg_len[LIB_BATCH_MSGS];
+    udp_header hdrs[LIB_BATCH_MSGS];
+    int iov_start[LIB_BATCH_MSGS], iov_cnt[LIB_BATCH_MSGS];
+    spines_msg *msg;
+    int i, n, niov, ret, bytes;
+#ifdef LIB_HAVE_MMSG
+    struct mmsghdr mmh[LIB_BATCH_MSGS];
+#else
+    sys_scatter scat;
+    int j;
+#endif
+
+    for(n = 0, niov = 0; n < (int)vlen && n < LIB_BATCH_MSGS; n++) {
+        msg = &msgvec[n].msg_hdr;
+        if(Lib_Msg_Len(msg) < 0 || !Lib_From_Fits(msg)) {
+            if(n == 0) {
+                if(!Lib_From_Fits(msg))
+                    Alarm(PRINT, "spines_recvfrom(): fromlen too small\n");
+                spines_set_errno(SP_ERROR_INPUT_ERR);
+                return(-1);
+            }
+            break;
+        }
+        if(niov + 2 + (int)msg->msg_iovlen > LIB_BATCH_IOV)
+            break;
+        iov_start[n] = niov;
+        iov[niov].iov_base = &msg_len[n];
+        iov[niov++].iov_len = sizeof(int32);
+        iov[niov].iov_base = &hdrs[n];
+        iov[niov++].iov_len = sizeof(udp_header);
+        for(i = 0; i < (int)msg->msg_iovlen; i++)
+            iov[niov++] = msg->msg_iov[i];
+        iov_cnt[n] = niov - iov_start[n];
+    }
+
+#ifdef LIB_HAVE_MMSG
+    memset(mmh, 0, n * sizeof(struct mmsghdr));
+    for(i = 0; i < n; i++) {
+        mmh[i].msg_hdr.msg_iov = &iov[iov_start[i]];
+        mmh[i].msg_hdr.msg_iovlen = iov_cnt[i];
+    }
+    do {
+        ret = recvmmsg(s, mmh, n, MSG_WAITFORONE, NULL);
+    } while(ret < 0 && errno == EINTR);
+    if(ret <= 0) {
+        /* errno set by OS level call */
+        return(-1);
+    }
+    n = ret;
+#else
+    scat.num_elements = iov_cnt[0];
+    for(i = 0, j = iov_start[0]; i < iov_cnt[0]; i++, j++) {
+        scat.elements[i].buf = iov[j].iov_base;
+        scat.elements[i].len = iov[j].iov_len;
+    }
+    ret = DL_recv(s, &scat);
+    if(ret <= 0) {
+        /* errno set by OS level call */
+        return(-1);
+    }
+    n = 1;
+#endif
+
+    for(i = 0; i < n; i++) {
+        msg = &msgvec[i].msg_hdr;
+#ifdef LIB_HAVE_MMSG
+        bytes = (int)mmh[i].msg_len;
+        msg->msg_flags = mmh[i].msg_hdr.msg_flags;
+#else
+        bytes = ret;
+        msg->msg_flags = 0;
+#endif
+        bytes -= sizeof(int32) + sizeof(udp_header);
+
+        if(!Same_endian(all_clients[client].endianess_type)) {
+            msg_len[i] = Flip_int32(msg_len[i]);
+            Flip_udp_hdr(&hdrs[i]);
+        }
+        if(bytes < 0 || hdrs[i].dest == -1) {
+            Alarm(PRINT, "spines_recvfrom(): unspecified recipient destination field\n");
+            break;
+        }
+        if(Lib_Set_From(msg, &hdrs[i]) < 0)
+            break;
+        msgvec[i].msg_len = bytes;
+    }
+
+    if(i == 0) {
+        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
+        return(-1);
+    }
+    if(i < n)
+        all_clients[client].recv_err = SP_ERROR_DAEMON_COMM_ERR;
+    return(i);
+}
+
+/* Receives one datagram framed on the TCP / unix domain socket s directly
+ * into the buffers of msg. Returns the length of the message, or -1 */
+static int Lib_Recv_Framed(int s, int client, spines_msg *msg)
+{
+    spines_iovec iov[LIB_BATCH_IOV];
+    char pkt[LIB_TCP_HDR_LEN];
+    int32 *pkt_len;
+    udp_header *hdr;
+    int i, niov, data_len, left;
+
+    pkt_len = (int32*)pkt;
+    hdr = (udp_header*)(pkt+sizeof(int32));
+
+    iov[0].iov_base = pkt;
+    iov[0].iov_len = LIB_TCP_HDR_LEN;
+    if(Lib_Readv(s, iov, 1) < 0) {
+        Alarm(PRINT, "spines_recvfrom(): network recv error\n");
+        return(-1);
+    }
+
+    if(!Same_endian(all_clients[client].endianess_type)) {
+        *pkt_len = Flip_int32(*pkt_len);
+        Flip_udp_hdr(hdr);
+    }
+
+    data_len = *pkt_len - (int)sizeof(udp_header);
+    if(data_len < 0 || data_len > Lib_Msg_Len(msg)) {
+        Alarm(PRINT, "spines_recvfrom(): message too big: %d :: %d\n",
+              *pkt_len, Lib_Msg_Len(msg));
+        return(-1);
+    }
+
+    /* Scatter the body over as much of the application buffers as needed */
+    for(i = 0, niov = 0, left = data_len; left > 0; i++) {
+        iov[niov] = msg->msg_iov[i];
+        if(iov[niov].iov_len > (size_t)left)
+            iov[niov].iov_len = left;
+        left -= iov[niov].iov_len;
+        if(iov[niov].iov_len > 0)
+            niov++;
+    }
+    if(Lib_Readv(s, iov, niov) < 0) {
+        Alarm(PRINT, "spines_recvfrom(): network recv error\n");
+        return(-1);
+    }
+
+    if(Lib_Set_From(msg, hdr) < 0)
+        return(-1);
+    msg->msg_flags = 0;
+    return(data_len);
+}
+
+#ifdef LIB_HAVE_SEQPACKET
+/* Receives one datagram from the SOCK_SEQPACKET socket s directly into the
+ * buffers of msg. A datagram normally is a single record. The daemon may
+ * only split the body of a fragmented one over several records, which are
+ * then read in turn. flags is passed to the first recvmsg(). Returns the
+ * length of the message, or -1 (errno EAGAIN if MSG_DONTWAIT found none) */
+static int Lib_Recv_Record(int s, int client, spines_msg *msg, int flags,
+                           int32u *dest)
+{
+    spines_iovec iov[LIB_BATCH_IOV];
+    struct msghdr mh;
+    char pkt[LIB_TCP_HDR_LEN];
+    int32 *pkt_len;
+    udp_header *hdr;
+    int i, niov, data_len, got, skip, ret;
+
+    pkt_len = (int32*)pkt;
+    hdr = (udp_header*)(pkt+sizeof(int32));
+
+    iov[0].iov_base = pkt;
+    iov[0].iov_len = LIB_TCP_HDR_LEN;
+    for(i = 0; i < (int)msg->msg_iovlen; i++)
+        iov[i+1] = msg->msg_iov[i];
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = msg->msg_iovlen + 1;
+    do {
+        ret = recvmsg(s, &mh, flags);
+    } while(ret < 0 && errno == EINTR);
+    if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return(-1);
+    if(ret < (int)LIB_TCP_HDR_LEN) {
+        Alarm(PRINT, "spines_recvfrom(): network recv error\n");
+        return(-1);
+    }
+
+    if(!Same_endian(all_clients[client].endianess_type)) {
+        *pkt_len = Flip_int32(*pkt_len);
+        Flip_udp_hdr(hdr);
+    }
+
+    data_len = *pkt_len - (int)sizeof(udp_header);
+    got = ret - (int)LIB_TCP_HDR_LEN;
+    if(data_len < 0 || data_len > Lib_Msg_Len(msg) || got > data_len ||
+       (mh.msg_flags & MSG_TRUNC)) {
+        Alarm(PRINT, "spines_recvfrom(): message too big: %d :: %d\n",
+              *pkt_len, Lib_Msg_Len(msg));
+        return(-1);
+    }
+
+    /* Read the rest of a message split over several records */
+    if(got < data_len) {
+        for(i = 0, niov = 0, skip = got; i < (int)msg->msg_iovlen; i++) {
+            iov[niov] = msg->msg_iov[i];
+            if(iov[niov].iov_len <= (size_t)skip) {
+                skip -= iov[niov].iov_len;
+                continue;
+            }
+            iov[niov].iov_base = (char*)iov[niov].iov_base + skip;
+            iov[niov].iov_len -= skip;
+            skip = 0;
+            if(iov[niov].iov_len > (size_t)(data_len - got))
+                iov[niov].iov_len = data_len - got;
+            got += iov[niov].iov_len;
+            niov++;
+            if(got == data_len)
+                break;
+        }
+        if(Lib_Readv(s, iov, niov) < 0) {
+            Alarm(PRINT, "spines_recvfrom(): network recv error\n");
+            return(-1);
+        }
+    }
+
+    if(Lib_Set_From(msg, hdr) < 0)
+        return(-1);
+    if(dest != NULL)
+        *dest = htonl(hdr->dest);
+    msg->msg_flags = 0;
+    return(data_len);
+}
+#endif
+
+/* Returns 1 if another message can be read from the stream socket s without
+ * blocking on the daemon, 0 otherwise. A framed message is only ready once
+ * its whole body arrived, not just its header */
+static int Lib_Stream_Ready(int s, int client, int mode)
+{
+#ifndef ARCH_PC_WIN95
+    int32 pkt_len;
+    int avail;
+    char c;
+
+    if(mode != LIB_TCP_MODE)
+        return(recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1);
+
+    if(ioctl(s, FIONREAD, &avail) < 0 || avail < (int)LIB_TCP_HDR_LEN)
+        return(0);
+    if(recv(s, &pkt_len, sizeof(int32), MSG_PEEK | MSG_DONTWAIT) != sizeof(int32))
+        return(0);
+    if(!Same_endian(all_clients[client].endianess_type))
+        pkt_len = Flip_int32(pkt_len);
+    return(avail - (int)sizeof(int32) >= pkt_len);
+#else
+    return(0);
+#endif
+}
+
+/* Receives up to vlen messages on Spines socket s. Only the first one is
+ * waited for. Returns the number of messages received (0 if a stream
+ * socket was closed), or -1 */
+static int Lib_Recv_Batch(int s, spines_mmsghdr *msgvec, unsigned int vlen)
+{
+    spines_msg *msg;
+    int client, mode, ret;
+    unsigned int i;
+
+    client = spines_get_client(s);
+    if(client == -1) {
+        Alarm(PRINT, "spines_recv(): unknown spines socket\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
+    if(vlen == 0)
+        return(0);
+
+    /* Report the error that ended the previous batch early */
+    if(all_clients[client].recv_err != 0) {
+        spines_set_errno(all_clients[client].recv_err);
+        all_clients[client].recv_err = 0;
+        return(-1);
+    }
+
+    mode = Lib_Client_Mode(client, 0);
+    if(mode == LIB_UDP_MODE)
+        return(Lib_Recv_Datagrams(s, client, msgvec, vlen));
+
+    for(i = 0; i < vlen; i++) {
+        if(i > 0 && mode != LIB_SEQ_MODE && !Lib_Stream_Ready(s, client, mode))
+            break;
+
+        /* A message that cannot take the next datagram ends the batch
+         * before it is read */
+        msg = &msgvec[i].msg_hdr;
+        if(Lib_Msg_Len(msg) < 0 || (mode != LIB_STREAM_MODE && !Lib_From_Fits(msg))) {
+            if(i > 0)
+                break;
+            if(Lib_Msg_Len(msg) >= 0)
+                Alarm(PRINT, "spines_recvfrom(): fromlen too small\n");
+            ret = -1;
+            spines_set_errno(SP_ERROR_INPUT_ERR);
+#ifdef LIB_HAVE_SEQPACKET
+        } else if(mode == LIB_SEQ_MODE) {
+            /* Records need no peeking: the next one is just not waited for */
+            ret = Lib_Recv_Record(s, client, msg, i > 0 ? MSG_DONTWAIT : 0, NULL);
+            if(ret < 0 && i > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if(ret < 0)
+                spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
+#endif
+        } else if(mode == LIB_TCP_MODE) {
+            ret = Lib_Recv_Framed(s, client, msg);
+            if(ret < 0)
+                spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
+        } else {
+#ifndef ARCH_PC_WIN95
+            ret = readv(s, msg->msg_iov, msg->msg_iovlen);
+#else
+            ret = recv(s, msg->msg_iov[0].iov_base, msg->msg_iov[0].iov_len, 0);
+#endif
+            if(ret == 0)
+                break;
+            msg->msg_namelen = 0;
+            msg->msg_flags = 0;
+        }
+        if(ret < 0) {
+            if(i == 0)
+                return(-1);
+            all_clients[client].recv_err = errno;
+            break;
+        }
+        msgvec[i].msg_len = ret;
+    }
+    return((int)i);
+}
+
+
 /***********************************************************/
 /* int spines_sendto(int s, const void *msg, size_t len,   */
 /*                   int flags, const struct sockaddr *to, */
@@ -980,152 +1922,19 @@ int spines_sendto_internal(int s, const void *msg, size_t len,
 			   int flags, const struct sockaddr *to, 
 			   socklen_t tolen, int force_tcp)
 {
-    udp_header u_hdr;
-    sys_scatter scat;
-    int port, address, ret;
-    int sess_id, rnd_num;
-    char pkt[MAX_PACKET_SIZE];
-    unsigned char l_ip_ttl, l_mcast_ttl, routing;
-    int32 *total_len;
-    udp_header *hdr;
-    int client, type, tcp_sk, my_addr, my_port, srv_addr, srv_port, connect_flag;
-    int tot_bytes;
-    struct sockaddr_in *inet_ptr;
-
     if (len > MAX_SPINES_CLIENT_MSG) {
         Alarm(PRINT, "spines_sendto(): msg size limit exceeded (recvd %d,"
                      " max %d)...dropping\n", len, MAX_SPINES_CLIENT_MSG);
-        return(-1);
-    }
-
-    address = ntohl(((struct sockaddr_in*)to)->sin_addr.s_addr);
-    port = ntohs(((struct sockaddr_in*)to)->sin_port);
-    ret = 0;
-
-    if(port == 0) {
-	    Alarm(PRINT, "spines_sendto(): cannot send to port 0\n");
-	    spines_set_errno(SP_ERROR_INPUT_ERR);
-	    return(-1);
-    }
-
-    stdmutex_grab(&data_mutex); {
-
-      client = spines_get_client(s);
-      if(client == -1) {
-        stdmutex_drop(&data_mutex);
-	    return(-1);
-      }
-
-      type         = all_clients[client].type;
-      tcp_sk       = all_clients[client].tcp_sk;
-      sess_id      = all_clients[client].sess_id;
-      rnd_num      = all_clients[client].rnd_num;
-      my_addr      = all_clients[client].my_addr;
-      my_port      = all_clients[client].my_port;
-      connect_flag = all_clients[client].connect_flag;
-      l_ip_ttl     = all_clients[client].ip_ttl;
-      l_mcast_ttl  = all_clients[client].mcast_ttl;
-      routing      = all_clients[client].routing;
-         
-      inet_ptr     = (struct sockaddr_in *)all_clients[client].srv_addr;
-    }stdmutex_drop(&data_mutex);
-
-    if((type == SOCK_STREAM)&&(force_tcp != 1)) {
-        return(spines_send(tcp_sk, msg, len, flags));
-    }
-
-    if((force_tcp == 1)||(connect_flag != UDP_CONNECT)) {
-
-	    /*Force TCP*/
-	    total_len = (int32*)(pkt);
-	    hdr = (udp_header*)(pkt+sizeof(int32));
-	
-	    hdr->source    = 0;
-	    hdr->dest      = (int32)address;
-	    hdr->dest_port = port;
-	    hdr->len       = len;
-
-        /* set the TTL of the packet */
-        if(!Is_mcast_addr(hdr->dest) && !Is_acast_addr(hdr->dest)) { 
-            /* This is unicast */
-            hdr->ttl = l_ip_ttl;
-        } else  { 
-            /* This is a multicast */
-            hdr->ttl = l_mcast_ttl;
-        }
-
-	    hdr->routing = routing;
-
-	    *total_len = len + sizeof(udp_header);
-	    ret = send(tcp_sk, pkt, 
-		    sizeof(int32)+sizeof(udp_header), 0); 
-	    if(ret != sizeof(int32)+sizeof(udp_header)) {
-	        Alarm(PRINT, "spines_sendto(): error sending header: %d\n", ret);
-	        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
-	        return(-1);
-	    }
-	    
-	    tot_bytes = 0;
-	    while(tot_bytes < len) {
-	        if ((ret = send(tcp_sk, (char*)msg + tot_bytes, len - tot_bytes, 0)) <= 0) {
-		        break;
-	        }
-	        tot_bytes += ret;
-	    }
-	    if(tot_bytes != len) {
-	        Alarm(PRINT, "spines_sendto(): error sending: %d\n", ret);	
-	        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
-	        return(-1);
-	    }
-
-        /* SESSION_SEMANTICS - possibly block on recv feedbackfor session_flag here */
-	    return(len);
+        return(-1);
     }
-    else {
-	    /* Use UDP communication */
-	    u_hdr.source      = my_addr;
-	    u_hdr.source_port = my_port;    
-	    u_hdr.dest        = (int32)address;
-	    u_hdr.dest_port   = port;
-	    u_hdr.len         = len;
-
-        if (inet_ptr->sin_family != AF_INET) {
-            Alarm(PRINT, "spines_sendto(): cannot send UDP DGRAM using non AF_INET sockaddr\n");
-            return(-1);
-        }
-        srv_addr     = ntohl(inet_ptr->sin_addr.s_addr);
-        srv_port     = ntohs(inet_ptr->sin_port);
-
-        /* set the TTL of the packet */
-        if(!Is_mcast_addr(u_hdr.dest) && !Is_acast_addr(u_hdr.dest)) { 
-            /* This is unicast */
-            u_hdr.ttl = l_ip_ttl;
-        } else { 
-            /* This is a multicast */
-            u_hdr.ttl = l_mcast_ttl;
-        }
 
-	    u_hdr.routing = routing;
-
-	    scat.num_elements = 4;
-	    scat.elements[0].len = sizeof(int);
-	    scat.elements[0].buf = (char*)&sess_id;
-	    scat.elements[1].len = sizeof(int);
-	    scat.elements[1].buf = (char*)&rnd_num;
-	    scat.elements[2].len = sizeof(udp_header);
-	    scat.elements[2].buf = (char*)&u_hdr;
-	    scat.elements[3].len = len;
-	    scat.elements[3].buf = (char*)msg;
-	    ret = DL_send(s, srv_addr, srv_port+SESS_UDP_PORT, &scat);
-	    if(ret != 2*sizeof(int32)+sizeof(udp_header)+len) {
-	        Alarm(PRINT, "spines_sendto(): error sending: %d != %d\n", 
-                    ret, 2*sizeof(int32)+sizeof(udp_header)+len);	
-	        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
-	        return(-1);
-	    }
-        /* SESSION_SEMANTICS - possibly block on recv feedbackfor session_flag here */
-	    return(len);
+    if(to == NULL) {
+	    Alarm(PRINT, "spines_sendto(): no destination address\n");
+	    spines_set_errno(SP_ERROR_INPUT_ERR);
+	    return(-1);
     }
+
+    return(Lib_Send_One(s, msg, len, to, tolen, force_tcp));
 }
 
 
@@ -1188,19 +1997,41 @@ int  spines_recvfrom_internal(int s, void *buf, size_t len, int flags,
     int total_bytes, r_add_size;
     int client, type = 0, connect_flag = 0;
     int32 endianess_type;
+#ifdef LIB_HAVE_SEQPACKET
+    spines_iovec iov;
+    spines_msg msg;
+#endif
 
     endianess_type = Set_endian(0);
 
-    stdmutex_grab(&data_mutex); {
-
-      client = spines_get_client(s);
-      if(client != -1) {
-        type = all_clients[client].type;
-        connect_flag = all_clients[client].connect_flag;
-        endianess_type = all_clients[client].endianess_type;
+    client = spines_get_client(s);
+    if(client != -1) {
+      type = all_clients[client].type;
+      connect_flag = all_clients[client].connect_flag;
+      endianess_type = all_clients[client].endianess_type;
+    }
+
+#ifdef LIB_HAVE_SEQPACKET
+    if(client != -1 && all_clients[client].seqpacket) {
+      /* One record holds the whole message */
+      iov.iov_base = buf;
+      iov.iov_len = len;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = from;
+      msg.msg_namelen = (from != NULL) ? *fromlen : 0;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+
+      received_bytes = Lib_Recv_Record(s, client, &msg, 0, dest);
+      if(received_bytes < 0) {
+        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
+        return(-1);
       }
-    
-    } stdmutex_drop(&data_mutex);
+      if(from != NULL)
+        *fromlen = msg.msg_namelen;
+      return(received_bytes);
+    }
+#endif
 
     if((connect_flag == UDP_CONNECT)&&(force_tcp != 1)) {
       /* Use UDP communication */
@@ -1372,20 +2203,15 @@ int spines_bind(int sockfd, struct sockaddr *my_addr,
     int tot_bytes;
 
 
-    stdmutex_grab(&data_mutex); {
-
-      client = spines_get_client(sockfd);
-      if(client == -1) {
-	    stdmutex_drop(&data_mutex);
-	    spines_set_errno(SP_ERROR_INPUT_ERR);
-	    Alarm(PRINT, "spines_bind(): spines socket not valid \n");
-	    return(-1);
-      }
-      my_type = all_clients[client].type;
-      tcp_sk = all_clients[client].tcp_sk;
-      connect_flag = all_clients[client].connect_flag;
-
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(sockfd);
+    if(client == -1) {
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        Alarm(PRINT, "spines_bind(): spines socket not valid \n");
+        return(-1);
+    }
+    my_type = all_clients[client].type;
+    tcp_sk = all_clients[client].tcp_sk;
+    connect_flag = all_clients[client].connect_flag;
 
     if(addrlen < sizeof(struct sockaddr_in)) {
 	    Alarm(PRINT, "spines_bind(): invalid address\n");
@@ -1448,9 +2274,7 @@ int spines_bind(int sockfd, struct sockaddr *my_addr,
     }
 
     /* on successs update the stored virtual local port */
-    stdmutex_grab(&data_mutex); {
-      all_clients[client].virtual_local_port = port;
-    } stdmutex_drop(&data_mutex);
+    all_clients[client].virtual_local_port = port;
 
     return(0);
 }
@@ -1509,21 +2333,16 @@ int  spines_setsockopt(int s, int  level,  int  optname,
 	return(-1);
     }
 
-    stdmutex_grab(&data_mutex); {
-
-      client = spines_get_client(s);
-      if(client == -1) {
-	stdmutex_drop(&data_mutex);
-	spines_set_errno(SP_ERROR_INPUT_ERR);
-	Alarm(PRINT, "spines_bind(): spines socket not valid \n");
-	return(-1);
-      }
-
-      tcp_sk  = all_clients[client].tcp_sk;
-      udp_sk  = all_clients[client].udp_sk;
-      my_type = all_clients[client].type;
+    client = spines_get_client(s);
+    if(client == -1) {
+      spines_set_errno(SP_ERROR_INPUT_ERR);
+      Alarm(PRINT, "spines_bind(): spines socket not valid \n");
+      return(-1);
+    }
 
-    } stdmutex_drop(&data_mutex);
+    tcp_sk  = all_clients[client].tcp_sk;
+    udp_sk  = all_clients[client].udp_sk;
+    my_type = all_clients[client].type;
 
     /* if the sock opt is to set the ttl, then just record it locally, no comms needed */
     if((optname == SPINES_IP_TTL) || (optname == SPINES_IP_MULTICAST_TTL)) {
@@ -1533,15 +2352,12 @@ int  spines_setsockopt(int s, int  level,  int  optname,
         return (-1);
       }
       
-      stdmutex_grab(&data_mutex); {
-        if(optname == SPINES_IP_TTL) {
-          all_clients[client].ip_ttl = *((unsigned char*) optval);
-	  
-        } else if(optname == SPINES_IP_MULTICAST_TTL) {
-          all_clients[client].mcast_ttl = *((unsigned char*) optval);
-        }
+      if(optname == SPINES_IP_TTL) {
+        all_clients[client].ip_ttl = *((unsigned char*) optval);
 
-      } stdmutex_drop(&data_mutex);
+      } else if(optname == SPINES_IP_MULTICAST_TTL) {
+        all_clients[client].mcast_ttl = *((unsigned char*) optval);
+      }
       
       return(0);
     }
@@ -1773,23 +2589,19 @@ int  spines_connect(int sockfd, const struct sockaddr *serv_addr,
     address = ntohl(((struct sockaddr_in*)serv_addr)->sin_addr.s_addr);
     port = ntohs(((struct sockaddr_in*)serv_addr)->sin_port);
 
-    stdmutex_grab(&data_mutex); {
-      client = spines_get_client(sockfd);
-      if(client == -1) {
-	    stdmutex_drop(&data_mutex);
-	    Alarm(PRINT, "spines_connect(): unknown spines socket\r\n");
-	    spines_set_errno(SP_ERROR_INPUT_ERR);
-	    return(-1);
-      }
+    client = spines_get_client(sockfd);
+    if(client == -1) {
+        Alarm(PRINT, "spines_connect(): unknown spines socket\r\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
 
-      my_type = all_clients[client].type;
-      if(my_type == SOCK_DGRAM) {
-	    all_clients[client].connect_addr = address;
-	    all_clients[client].connect_port = port;
-	    stdmutex_drop(&data_mutex);
-	    return(0);
-      }
-    } stdmutex_drop(&data_mutex);
+    my_type = all_clients[client].type;
+    if(my_type == SOCK_DGRAM) {
+        all_clients[client].connect_addr = address;
+        all_clients[client].connect_port = port;
+        return(0);
+    }
 
     total_len = (int32*)(pkt);
     u_hdr = (udp_header*)(pkt+sizeof(int32));
@@ -1859,96 +2671,14 @@ int  spines_connect(int sockfd, const struct sockaddr *serv_addr,
 
 int  spines_send(int s, const void *msg, size_t len, int flags)
 {
-    udp_header *u_hdr;
-    char pkt[MAX_PACKET_SIZE];
-    rel_udp_pkt_add *r_add;
-    int32 *total_len;
-    struct sockaddr_in host;
-    int ret;
-    int client, type, connect_addr, connect_port;
-    unsigned char l_ip_ttl, l_mcast_ttl, routing;
-
     if (len > MAX_SPINES_CLIENT_MSG) {
         Alarm(PRINT, "spines_send(): msg size limit exceeded (recvd %d,"
                      " max %d)...dropping\n", len, MAX_SPINES_CLIENT_MSG);
         return(-1);
     }
 
-    stdmutex_grab(&data_mutex); {
-
-        client = spines_get_client(s);
-        if(client == -1) {
-	        stdmutex_drop(&data_mutex);
-	        Alarm(PRINT, "spines_send(): unknown spines socket\r\n");
-	        spines_set_errno(SP_ERROR_INPUT_ERR);
-	        return(-1);
-        }
-        type         = all_clients[client].type;
-        connect_addr = all_clients[client].connect_addr;
-        connect_port = all_clients[client].connect_port;    
-        l_ip_ttl     = all_clients[client].ip_ttl;
-        l_mcast_ttl  = all_clients[client].mcast_ttl;
-        routing      = all_clients[client].routing;
-
-    } stdmutex_drop(&data_mutex);
-
-    if(type == SOCK_DGRAM) {
-	    if(connect_port == -1) {
-	        Alarm(PRINT, "DGRAM socket not connected\n");
-	        spines_set_errno(SP_ERROR_INPUT_ERR);
-	        return(-1);
-	    }
-	    host.sin_family = AF_INET;
-	    host.sin_addr.s_addr = htonl(connect_addr);
-	    host.sin_port   = htons(connect_port);
-	    return(spines_sendto(s, msg, len, flags, 
-			     (struct sockaddr*)&host, sizeof(struct sockaddr)));
-    }
-
-    /* Check for maximum length */
-    /*   */    
-    /*   */
-
-    total_len = (int32*)(pkt);
-    u_hdr = (udp_header*)(pkt+sizeof(int32));
-    r_add = (rel_udp_pkt_add*)(pkt+sizeof(int32)+sizeof(udp_header));
-
-    *total_len = len + sizeof(udp_header) + sizeof(rel_udp_pkt_add);
-     
-    u_hdr->source = 0;
-    u_hdr->dest   = 0;
-    u_hdr->dest_port   = 0;
-    u_hdr->len    = len + sizeof(rel_udp_pkt_add);
-
-    /* set the TTL of the packet */
-    if(!Is_mcast_addr(u_hdr->dest) && !Is_acast_addr(u_hdr->dest)) { /* This is unicast */
-        u_hdr->ttl = l_ip_ttl;
-    } else { /* This is a multicast */
-        u_hdr->ttl = l_mcast_ttl;
-    }
-
-    u_hdr->routing = routing;
-
-    r_add->type = Set_endian(0);
-    r_add->data_len = len;
-    r_add->ack_len = 0;
-
-    ret = send(s, pkt, sizeof(udp_header)+sizeof(rel_udp_pkt_add)+sizeof(int32), 0);
-    if(ret != sizeof(udp_header)+sizeof(rel_udp_pkt_add)+sizeof(int32)) {
-        Alarm(PRINT, "spines_send(): send did not send full data amount\n");
-        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
-	    return(-1);
-    }
-    
-    ret = send(s, msg, len, 0);
-    if(ret != len) {
-        Alarm(PRINT, "spines_send(): send did not send full data amount\n");
-        spines_set_errno(SP_ERROR_DAEMON_COMM_ERR);
-	    return(-1);
-    }
-    
-    /* SESSION_SEMANTICS - possibly block on recv feedbackfor session_flag here */
-    return(ret);
+    /* DGRAM sockets go to their connected address */
+    return(Lib_Send_One(s, msg, len, NULL, 0, 0));
 }
 
 
@@ -1981,18 +2711,13 @@ int  spines_recv(int s, void *buf, size_t len, int flags)
 
     Alarm(DEBUG, "Using spines_recv\n");
 
-    stdmutex_grab(&data_mutex); {
-
-      client = spines_get_client(s);
-      if(client == -1) {
-	stdmutex_drop(&data_mutex);
-	Alarm(PRINT, "spines_recv(): unknown spines socket\n");
-	spines_set_errno(SP_ERROR_INPUT_ERR);
-	return(-1);
-      }
-      type = all_clients[client].type;
-
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(s);
+    if(client == -1) {
+      Alarm(PRINT, "spines_recv(): unknown spines socket\n");
+      spines_set_errno(SP_ERROR_INPUT_ERR);
+      return(-1);
+    }
+    type = all_clients[client].type;
 
     if(type == SOCK_DGRAM) {
       return(spines_recvfrom(s, buf, len, flags, NULL, NULL));
@@ -2033,16 +2758,13 @@ int spines_listen(int s, int backlog)
     int ret;
     int client, my_type;
 
-    stdmutex_grab(&data_mutex); {
-      client = spines_get_client(s);
-      if(client == -1) {
-	stdmutex_drop(&data_mutex);
-	Alarm(PRINT, "spines_listen(): unknown spines socket\n");
-	spines_set_errno(SP_ERROR_INPUT_ERR);
-	return(-1);
-      }
-      my_type = all_clients[client].type;
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(s);
+    if(client == -1) {
+      Alarm(PRINT, "spines_listen(): unknown spines socket\n");
+      spines_set_errno(SP_ERROR_INPUT_ERR);
+      return(-1);
+    }
+    my_type = all_clients[client].type;
 
     if(my_type == SOCK_DGRAM) {
 	Alarm(PRINT, "DATAGRAM socket. spines_listen() not supported\n");
@@ -2121,20 +2843,15 @@ int  spines_accept(int s, struct sockaddr *addr, socklen_t *addrlen)
     socklen_t lenaddr;
 
 
-    stdmutex_grab(&data_mutex); {
-
-        client = spines_get_client(s);
-        if(client == -1) {
-	        stdmutex_drop(&data_mutex);
-	        Alarm(PRINT, "spines_accept(): unknown spines socket\n");
-	        spines_set_errno(SP_ERROR_INPUT_ERR);
-	        return(-1);
-        }
-        my_type = all_clients[client].type;
-        protocol = all_clients[client].protocol;
-        old_addr = all_clients[client].srv_addr;
-
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(s);
+    if(client == -1) {
+        Alarm(PRINT, "spines_accept(): unknown spines socket\n");
+        spines_set_errno(SP_ERROR_INPUT_ERR);
+        return(-1);
+    }
+    my_type = all_clients[client].type;
+    protocol = all_clients[client].protocol;
+    old_addr = all_clients[client].srv_addr;
 
     if(my_type == SOCK_DGRAM) {
         Alarm(PRINT, "DATAGRAM socket. spines_accept() not supported\n");
@@ -2365,13 +3082,16 @@ int spines_setdissemination(int sk, int paths, int overwrite_ip)
 
 
 int spines_get_client(int sk) {
-  int i;
-  for(i=0; i<Max_Client; i++) {
-    if(all_clients[i].udp_sk == sk) {
-      return(i);
-    }
-  }
-  return(-1);
+  volatile int *page;
+
+  if(sk < 0 || sk >= MAX_CLIENT_SK)
+    return(-1);
+
+  page = client_table[sk >> CLIENT_PAGE_BITS];
+  if(page == NULL)
+    return(-1);
+
+  return(page[sk & (CLIENT_PAGE_SIZE - 1)] - 1);
 }
 
 
@@ -2393,18 +3113,15 @@ int spines_flood_send(int sockfd, int address, int port, int rate, int size, int
     return -1;
 #endif
 
-    stdmutex_grab(&data_mutex); {
-      client = spines_get_client(sockfd);
-      if(client == -1) {
-	stdmutex_drop(&data_mutex);
-	Alarm(PRINT, "spines_connect(): unknown spines socket\r\n");
-	spines_set_errno(SP_ERROR_INPUT_ERR);
-	return(-1);
-      }
-      my_type = all_clients[client].type;
-      tcp_sk = all_clients[client].tcp_sk;
-      connect_flag = all_clients[client].connect_flag;
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(sockfd);
+    if(client == -1) {
+      Alarm(PRINT, "spines_connect(): unknown spines socket\r\n");
+      spines_set_errno(SP_ERROR_INPUT_ERR);
+      return(-1);
+    }
+    my_type = all_clients[client].type;
+    tcp_sk = all_clients[client].tcp_sk;
+    connect_flag = all_clients[client].connect_flag;
 
     sk = sockfd;
 
@@ -2462,18 +3179,15 @@ int spines_flood_recv(int sockfd, char *filename, int namelen)
     return -1;
 #endif
 
-    stdmutex_grab(&data_mutex); {
-      client = spines_get_client(sockfd);
-      if(client == -1) {
-	stdmutex_drop(&data_mutex);
-	Alarm(PRINT, "spines_send(): unknown spines socket\r\n");
-	spines_set_errno(SP_ERROR_INPUT_ERR);
-	return(-1);
-      }
-      my_type = all_clients[client].type;
-      tcp_sk = all_clients[client].tcp_sk;
-      connect_flag = all_clients[client].connect_flag;
-    } stdmutex_drop(&data_mutex);
+    client = spines_get_client(sockfd);
+    if(client == -1) {
+      Alarm(PRINT, "spines_send(): unknown spines socket\r\n");
+      spines_set_errno(SP_ERROR_INPUT_ERR);
+      return(-1);
+    }
+    my_type = all_clients[client].type;
+    tcp_sk = all_clients[client].tcp_sk;
+    connect_flag = all_clients[client].connect_flag;
 
     sk = sockfd;
 
@@ -2541,15 +3255,12 @@ int spines_getsockname(int sk, struct sockaddr *name, socklen_t *nlen)
       return(-1);
     }
 
-    stdmutex_grab(&data_mutex); {
-      client = spines_get_client(sk);
-      if(client != -1) {
-        ((struct sockaddr_in*)name)->sin_port = htons((short)all_clients[client].virtual_local_port);
-        ((struct sockaddr_in*)name)->sin_addr.s_addr = htonl(all_clients[client].virtual_addr);
-        *nlen = sizeof(struct sockaddr_in);
-      }
-      
-    } stdmutex_drop(&data_mutex);   
+    client = spines_get_client(sk);
+    if(client != -1) {
+      ((struct sockaddr_in*)name)->sin_port = htons((short)all_clients[client].virtual_local_port);
+      ((struct sockaddr_in*)name)->sin_addr.s_addr = htonl(all_clients[client].virtual_addr);
+      *nlen = sizeof(struct sockaddr_in);
+    }
 
     if(client == -1) {
       Alarm(PRINT, "spines_getsockname(): unknown socket\n");
@@ -2567,129 +3278,129 @@ int spines_getsockname(int sk, struct sockaddr *name, socklen_t *nlen)
   
 }
 
-#define MAX_MSG_LEN ((0x1 << 20) - 1)
+/***********************************************************/
+/* int spines_sendmsg(int s, const spines_msg *msg,        */
+/*                    int flags)                           */
+/*                                                         */
+/* Sends a message gathered from several buffers           */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* s:       the Spines socket                              */
+/* msg:     the buffers of the message (msg_iov) and its   */
+/*          destination (msg_name, or NULL for connected   */
+/*          and stream sockets)                            */
+/* flags:   not used yet                                   */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the number of bytes sent (or -1 if an error)      */
+/*                                                         */
+/***********************************************************/
 
-int  spines_sendmsg( int s, const spines_msg *msg, int flags )
+int  spines_sendmsg(int s, const spines_msg *msg, int flags)
 {
-        int  ret;
-        int  buf_len;
-        int  i;
-        char buf[ MAX_MSG_LEN ];
-
-        if ( ( int ) msg->msg_iovlen < 0 )
-        {
-                Alarm( DEBUG, "spines_sendmsg(): illegal msg_iovlen\n" );
-                spines_set_errno( SP_ERROR_INPUT_ERR );
-                assert( 0 );
-                return -1;
-        }
-
-        for ( i = 0, buf_len = 0; i < (int) msg->msg_iovlen; ++i )
-        {
-                if ( ( int ) msg->msg_iov[ i ].iov_len < 0 )
-                {
-                        Alarm( DEBUG, "spines_sendmsg(): illegal iov_len\n" );
-                        spines_set_errno( SP_ERROR_INPUT_ERR );
-                        assert( 0 );
-                        return -1;
-                }
-
-                if ( buf_len + ( int ) msg->msg_iov[ i ].iov_len > MAX_MSG_LEN )
-                {
-                        Alarm( DEBUG, "spines_sendmsg(): msg too big!\n" );
-                        spines_set_errno( SP_ERROR_INPUT_ERR );
-                        assert( 0 );
-                        return -1;
-                }
-
-                memcpy( buf + buf_len, msg->msg_iov[ i ].iov_base, msg->msg_iov[ i ].iov_len );
-                buf_len += ( int ) msg->msg_iov[ i ].iov_len;
-        }
+    spines_mmsghdr mm;
 
-        if ( msg->msg_name == NULL )
-        {
-                ret = spines_send( s, buf, buf_len, flags );
-        }
-        else
-        {
-                ret = spines_sendto( s, buf, buf_len, flags, msg->msg_name, msg->msg_namelen );
-        }
+    mm.msg_hdr = *msg;
+    mm.msg_len = 0;
+    if(Lib_Send_Batch(s, &mm, 1, 0) != 1)
+        return(-1);
 
-        /* SESSION_SEMANTICS - possibly block on recv feedbackfor session_flag here */
-        return ret;
+    return((int)mm.msg_len);
 }
 
+/***********************************************************/
+/* int spines_recvmsg(int s, spines_msg *msg, int flags)   */
+/*                                                         */
+/* Receives a message scattered into several buffers       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* s:       the Spines socket                              */
+/* msg:     the buffers to receive into (msg_iov) and an   */
+/*          optional buffer for the sender (msg_name)      */
+/* flags:   not used yet                                   */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the number of bytes received                      */
+/*       -1 if an error                                    */
+/*                                                         */
+/***********************************************************/
+
 int  spines_recvmsg(int s, spines_msg *msg, int flags)
 {
-        int  ret;
-        int  buf_len;
-        int  adv_bytes;
-        int  i;
-        char buf[ MAX_MSG_LEN ];
+    spines_mmsghdr mm;
+    int ret;
 
-        if ( ( int ) msg->msg_iovlen < 0 )
-        {
-                Alarm( DEBUG, "spines_recvmsg(): illegal msg_iovlen\n" );
-                spines_set_errno( SP_ERROR_INPUT_ERR );
-                assert( 0 );
-                return -1;
-        }
+    mm.msg_hdr = *msg;
+    mm.msg_len = 0;
+    ret = Lib_Recv_Batch(s, &mm, 1);
+    if(ret <= 0)
+        return(ret);
 
-        for ( i = 0, buf_len = 0; i < (int) msg->msg_iovlen; ++i )
-        {
-                if ( ( int ) msg->msg_iov[ i ].iov_len < 0 )
-                {
-                        Alarm( DEBUG, "spines_recvmsg(): illegal iov_len\n" );
-                        spines_set_errno( SP_ERROR_INPUT_ERR );
-                        assert( 0 );
-                        return -1;
-                }
-
-                if ( buf_len + ( int ) msg->msg_iov[ i ].iov_len > MAX_MSG_LEN )
-                {
-                        Alarm( DEBUG, "spines_recvmsg(): msg too big!\n" );
-                        spines_set_errno( SP_ERROR_INPUT_ERR );
-                        assert( 0 );
-                        return -1;
-                }
-
-                buf_len += ( int ) msg->msg_iov[ i ].iov_len;
-        }
+    msg->msg_namelen = mm.msg_hdr.msg_namelen;
+    msg->msg_flags = mm.msg_hdr.msg_flags;
+    return((int)mm.msg_len);
+}
 
-        if ( msg->msg_name == NULL )
-        {
-                ret = spines_recv( s, buf, buf_len, flags );
-        }
-        else
-        {
-                ret = spines_recvfrom( s, buf, buf_len, flags, msg->msg_name, &msg->msg_namelen );
-        }
+/***********************************************************/
+/* int spines_sendmmsg(int s, spines_mmsghdr *msgvec,      */
+/*                     unsigned int vlen, int flags)       */
+/*                                                         */
+/* Sends several messages, batching as many of them as     */
+/* possible into each system call (sendmmsg for UDP        */
+/* clients, writev on the TCP / unix domain socket)        */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* s:       the Spines socket                              */
+/* msgvec:  the messages, as for spines_sendmsg. msg_len   */
+/*          is set to the bytes sent for each message      */
+/* vlen:    number of messages in msgvec                   */
+/* flags:   not used yet                                   */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the number of messages sent (or -1 if an error    */
+/*       happened before any was sent)                     */
+/*                                                         */
+/***********************************************************/
 
-        if ( ret > 0 )
-        {
-                assert( ret <= buf_len );
-
-                for ( i = 0, adv_bytes = 0; i < (int) msg->msg_iovlen && adv_bytes < ret; ++i )
-                {
-                        int cpy_bytes = ( int ) msg->msg_iov[ i ].iov_len;
-
-                        if ( adv_bytes + cpy_bytes >= ret )
-                        {
-                                cpy_bytes = ret - adv_bytes;
-                        }
-
-                        memcpy( msg->msg_iov[ i ].iov_base, buf + adv_bytes, cpy_bytes );
-                        adv_bytes += cpy_bytes;
-                }
-
-                if ( adv_bytes != ret )
-                {
-                        Alarm( DEBUG, "spines_recvmsg(): bug!\n" );
-                        spines_set_errno( SP_ERROR_INPUT_ERR );
-                        assert( 0 );
-                        return -1;
-                }
-        }
+int  spines_sendmmsg(int s, spines_mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    return(Lib_Send_Batch(s, msgvec, vlen, 0));
+}
+
+/***********************************************************/
+/* int spines_recvmmsg(int s, spines_mmsghdr *msgvec,      */
+/*                     unsigned int vlen, int flags)       */
+/*                                                         */
+/* Receives several messages. Blocks until the first one   */
+/* is available, then returns it together with the ones   */
+/* already waiting (at most vlen)                          */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* s:       the Spines socket                              */
+/* msgvec:  the messages, as for spines_recvmsg. msg_len   */
+/*          is set to the bytes received for each message  */
+/* vlen:    number of messages in msgvec                   */
+/* flags:   not used yet                                   */
+/*                                                         */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* (int) the number of messages received, 0 if a stream    */
+/*       socket was closed, -1 if an error                 */
+/*                                                         */
+/***********************************************************/
 
-        return ret;
+int  spines_recvmmsg(int s, spines_mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    return(Lib_Recv_Batch(s, msgvec, vlen));
 }
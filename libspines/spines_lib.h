@@ -67,6 +67,15 @@ typedef struct
 } spines_msg;
 #endif
 
+/* One message of spines_sendmmsg / spines_recvmmsg. msg_len is set to the
+ * number of bytes sent or received for the message */
+typedef struct
+{
+             spines_msg      msg_hdr;
+             unsigned int    msg_len;
+
+} spines_mmsghdr;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -89,6 +98,7 @@ extern "C" {
 #define     RESERVED_LINKS_BITS     0x0000000f
 
 #define     UDP_CONNECT             0x00000010
+#define     SEQPACKET_CONNECT       0x00010000 /* AF_UNIX SOCK_SEQPACKET to the daemon */
 
 #define     MIN_WEIGHT_ROUTING      0x00000000
 #define     IT_PRIORITY_ROUTING     0x00000100
@@ -129,6 +139,7 @@ extern "C" {
 #define     DEFAULT_SPINES_PORT     8100
 #define     SPINES_UNIX_SOCKET_PATH "/tmp/spines"
 #define     SPINES_UNIX_DATA_SUFFIX "data"
+#define     SPINES_UNIX_SEQ_SUFFIX  "seq"
 
 #define     SP_ERROR_VERSION_MISMATCH   7845
 #define     SP_ERROR_LIB_ALREADY_INITED 7846
@@ -194,6 +205,8 @@ int  spines_getsockname(int sk, struct sockaddr *name, socklen_t *nlen);
 
 int  spines_sendmsg(int s, const spines_msg *msg, int flags);
 int  spines_recvmsg(int s, spines_msg *msg, int flags);
+int  spines_sendmmsg(int s, spines_mmsghdr *msgvec, unsigned int vlen, int flags);
+int  spines_recvmmsg(int s, spines_mmsghdr *msgvec, unsigned int vlen, int flags);
 
 /* Enhanced recvfrom function that returns the destination address -- this
  * corresponds to the multicast group to which the packet was sent This is a
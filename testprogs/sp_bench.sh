@@ -0,0 +1,412 @@
+#!/bin/bash
+#
+# sp_bench.sh - single-host Spines overlay benchmark
+#
+# Starts N spines daemons on loopback addresses (127.0.1.1 .. 127.0.1.N),
+# each with its own unix domain socket path, connected in a generated
+# topology. Optionally impairs every overlay edge through the -m monitor
+# (setlink), then runs sp_bflooder between node 1 and node N for every
+# requested link protocol, dissemination protocol and route weight.
+#
+# Each run appends one JSON object per line to <outdir>/results.jsonl with
+# packets/sec, goodput, latency percentiles and daemon CPU usage. Results
+# can be saved as a baseline (-S) and later runs compared against it (-B);
+# the script exits with status 2 if any run regressed by more than the
+# tolerance.
+#
+# With -C it also runs the congested link scenario on its own 3 node
+# star (1-2, 1-3) of reliable links: node 1 sends to node 3 at the given
+# rate while a second session on node 1 floods node 2 at ten times that
+# rate, and node 2 is stopped 80% of the time so that its link stays full
+# without being declared dead. The session to node 3 should not be held
+# back by the full link; its run is recorded as suite "congested_link".
+#
+# On Linux the whole 127.0.0.0/8 block is routed to lo. On other systems
+# the 127.0.1.x aliases have to be added by hand first
+# (e.g. "ifconfig lo0 alias 127.0.1.2 up").
+#
+
+usage() {
+    cat <<EOF
+Usage: sp_bench.sh [options]
+  -n <nodes>          : number of daemons, default 4
+  -t <topology>       : line, ring, mesh or random, default line
+  -g <degree>         : average degree of the random topology, default 3
+  -s <seed>           : seed for the random topology, default 1
+  -P "<prots>"        : link protocols to test (0 UDP, 1 Reliable, 2 Realtime,
+                        8 Intrusion-Tolerant), default "0 1 2 8"
+  -D "<dissems>"      : dissemination protocols for non-IT links
+                        (0 Min Weight, 3 Source Based), default "0 3".
+                        IT links always run with 1 (Priority) and 2 (Reliable)
+  -w "<weights>"      : route weights passed to spines -w, default "distance"
+  -L "<bw lat loss burst>" : impairment set with setlink on every edge in
+                        both directions (kbps, ms, %, %), default none
+  -b <bytes>          : message size, default 1000
+  -c <count>          : messages per run, default 10000
+  -R <kbps>           : sending rate, default 10000
+  -p <port>           : spines base port, default 8100
+  -T <seconds>        : settle time after start/impairment, default 5
+  -d <dir>            : top of the spines build tree, default ..
+  -o <dir>            : output directory, default ./sp_bench_out
+  -S <file>           : save the results of this run as baseline <file>
+  -B <file>           : compare against baseline <file>
+  -e <percent>        : allowed regression against the baseline, default 10
+  -C                  : also run the congested link scenario
+EOF
+    exit 1
+}
+
+NODES=4
+TOPO=line
+DEGREE=3
+SEED=1
+PROTS="0 1 2 8"
+DISSEMS="0 3"
+WEIGHTS="distance"
+IMPAIR=""
+SIZE=1000
+COUNT=10000
+RATE=10000
+PORT=8100
+SETTLE=5
+TOP_DIR=$(cd "$(dirname "$0")/.." && pwd)
+OUT_DIR=./sp_bench_out
+SAVE_BASELINE=""
+BASELINE=""
+TOLERANCE=10
+CONGESTED=0
+
+while getopts "n:t:g:s:P:D:w:L:b:c:R:p:T:d:o:S:B:e:Ch" opt; do
+    case $opt in
+    n) NODES=$OPTARG ;;
+    t) TOPO=$OPTARG ;;
+    g) DEGREE=$OPTARG ;;
+    s) SEED=$OPTARG ;;
+    P) PROTS=$OPTARG ;;
+    D) DISSEMS=$OPTARG ;;
+    w) WEIGHTS=$OPTARG ;;
+    L) IMPAIR=$OPTARG ;;
+    b) SIZE=$OPTARG ;;
+    c) COUNT=$OPTARG ;;
+    R) RATE=$OPTARG ;;
+    p) PORT=$OPTARG ;;
+    T) SETTLE=$OPTARG ;;
+    d) TOP_DIR=$OPTARG ;;
+    o) OUT_DIR=$OPTARG ;;
+    S) SAVE_BASELINE=$OPTARG ;;
+    B) BASELINE=$OPTARG ;;
+    e) TOLERANCE=$OPTARG ;;
+    C) CONGESTED=1 ;;
+    *) usage ;;
+    esac
+done
+
+SPINES=$TOP_DIR/daemon/spines
+FLOODER=$TOP_DIR/testprogs/sp_bflooder
+SETLINK=$TOP_DIR/controlprogs/setlink
+
+for prog in "$SPINES" "$FLOODER" "$SETLINK"; do
+    if [ ! -x "$prog" ]; then
+        echo "sp_bench.sh: $prog not found, build the tree first (or use -d)" >&2
+        exit 1
+    fi
+done
+
+if [ "$NODES" -lt 2 ] || [ "$NODES" -gt 250 ]; then
+    echo "sp_bench.sh: number of nodes must be between 2 and 250" >&2
+    exit 1
+fi
+
+mkdir -p "$OUT_DIR" || exit 1
+OUT_DIR=$(cd "$OUT_DIR" && pwd)
+RESULTS=$OUT_DIR/results.jsonl
+EDGES=$OUT_DIR/edges
+: > "$RESULTS"
+
+CLK_TCK=$(getconf CLK_TCK)
+PIDS=()
+
+node_ip() {
+    echo "127.0.1.$1"
+}
+
+# Writes "a b" lines, one per undirected edge, to $EDGES
+gen_edges() {
+    awk -v n="$NODES" -v topo="$TOPO" -v deg="$DEGREE" -v seed="$SEED" '
+    function add(a, b) {
+        if (a == b) return 0
+        if (a > b) { t = a; a = b; b = t }
+        if ((a, b) in e) return 0
+        e[a, b] = 1; print a, b; return 1
+    }
+    BEGIN {
+        if (topo == "line" || topo == "ring") {
+            for (i = 1; i < n; i++) add(i, i + 1)
+            if (topo == "ring" && n > 2) add(n, 1)
+        } else if (topo == "mesh") {
+            for (i = 1; i <= n; i++)
+                for (j = i + 1; j <= n; j++) add(i, j)
+        } else if (topo == "random") {
+            srand(seed)
+            # random spanning tree keeps the overlay connected
+            for (i = 2; i <= n; i++) { add(i, 1 + int(rand() * (i - 1))); m++ }
+            want = int(n * deg / 2)
+            if (want > n * (n - 1) / 2) want = n * (n - 1) / 2
+            while (m < want)
+                m += add(1 + int(rand() * n), 1 + int(rand() * n))
+        } else {
+            print "unknown topology " topo > "/dev/stderr"; exit 1
+        }
+    }' > "$EDGES"
+}
+
+# $1: config file, $2: 1 for intrusion tolerance mode
+gen_conf() {
+    {
+        echo "Remote_Connections = False"
+        echo "Directed_Edges = True"
+        echo "Path_Stamp_Debug = False"
+        echo "Crypto = False"
+        if [ "$2" = 1 ]; then
+            echo "IT_IntrusionToleranceMode = Yes"
+        else
+            echo "IT_IntrusionToleranceMode = No"
+        fi
+        echo "Hosts {"
+        for ((i = 1; i <= NODES; i++)); do
+            echo "    $i $(node_ip $i)"
+        done
+        echo "}"
+        echo "Edges {"
+        while read -r a b; do
+            echo "    $a $b 10"
+            echo "    $b $a 10"
+        done < "$EDGES"
+        echo "}"
+    } > "$1"
+}
+
+# User+system CPU ticks of every running daemon, in PIDS order
+cpu_ticks() {
+    local pid
+    for pid in "${PIDS[@]}"; do
+        awk '{ print $14 + $15 }' /proc/"$pid"/stat 2>/dev/null || echo 0
+    done
+}
+
+stop_daemons() {
+    local pid
+    for pid in "${PIDS[@]}"; do
+        kill -CONT "$pid" 2>/dev/null
+        kill "$pid" 2>/dev/null
+    done
+    for pid in "${PIDS[@]}"; do
+        wait "$pid" 2>/dev/null
+    done
+    PIDS=()
+}
+
+trap 'stop_daemons; exit 1' INT TERM
+
+# $1: config file, $2: route weight
+start_daemons() {
+    local i
+    for ((i = 1; i <= NODES; i++)); do
+        rm -f "$OUT_DIR/sp$i" "$OUT_DIR/sp${i}data"
+        "$SPINES" -l "$(node_ip $i)" -p "$PORT" -c "$1" -ud "$OUT_DIR/sp$i" \
+                  -m -w "$2" -lf "$OUT_DIR/spines$i.log" > /dev/null 2>&1 &
+        PIDS+=($!)
+    done
+    sleep "$SETTLE"
+
+    if [ -n "$IMPAIR" ]; then
+        set -- $IMPAIR
+        while read -r a b; do
+            "$SETLINK" "$1" "$2" "$3" "$4" "$(node_ip $a)" "$(node_ip $b)" "$OUT_DIR/sp$b" > /dev/null
+            "$SETLINK" "$1" "$2" "$3" "$4" "$(node_ip $b)" "$(node_ip $a)" "$OUT_DIR/sp$a" > /dev/null
+        done < "$EDGES"
+        sleep "$SETTLE"
+    fi
+}
+
+# $1: suite name, $2: weight, $3: link protocol, $4: dissemination
+run_flood() {
+    local rport=$((8400 + RUN)) rlog slog bench wall0 wall1 status
+    local cpu0 cpu1 i d tot_ticks=0 max_ticks=0 wall_us cpu_total cpu_max limit
+
+    rlog=$OUT_DIR/run$RUN.recv
+    slog=$OUT_DIR/run$RUN.send
+    RUN=$((RUN + 1))
+
+    # generous upper bound on the run time: twice the nominal duration + 30s
+    limit=$((COUNT * SIZE * 8 / RATE / 1000 * 2 + 30))
+
+    cpu0=($(cpu_ticks))
+    wall0=$(date +%s%N)
+    timeout "$limit" "$FLOODER" -ud "$OUT_DIR/sp$NODES" -r "$rport" -n "$COUNT" \
+            -b "$SIZE" -P "$3" -D "$4" -q > "$rlog" 2>&1 &
+    local rpid=$!
+    sleep 1
+    timeout "$limit" "$FLOODER" -ud "$OUT_DIR/sp1" -s -a "$(node_ip $NODES)" -d "$rport" \
+            -n "$COUNT" -b "$SIZE" -R "$RATE" -P "$3" -D "$4" -x > "$slog" 2>&1
+    wait $rpid
+    status=$?
+    wall1=$(date +%s%N)
+    cpu1=($(cpu_ticks))
+
+    wall_us=$(((wall1 - wall0) / 1000))
+    for ((i = 0; i < ${#cpu1[@]}; i++)); do
+        d=$((cpu1[i] - cpu0[i]))
+        tot_ticks=$((tot_ticks + d))
+        [ $d -gt $max_ticks ] && max_ticks=$d
+    done
+    cpu_total=$(awk -v t="$tot_ticks" -v hz="$CLK_TCK" -v w="$wall_us" 'BEGIN { printf "%.1f", t / hz * 1e8 / w }')
+    cpu_max=$(awk -v t="$max_ticks" -v hz="$CLK_TCK" -v w="$wall_us" 'BEGIN { printf "%.1f", t / hz * 1e8 / w }')
+
+    bench=$(grep '^BENCH ' "$rlog")
+    if [ $status -ne 0 ] || [ -z "$bench" ]; then
+        bench="BENCH recv=0 pps=0 kbps=0 lat_p50_us=-1 lat_p90_us=-1 lat_p99_us=-1 lat_p999_us=-1 lat_max_us=-1"
+        status=timeout
+    else
+        status=ok
+    fi
+
+    echo "$bench" | awk -v suite="$1" -v topo="$TOPO" -v n="$NODES" -v w="$2" \
+        -v P="$3" -v D="$4" -v size="$SIZE" -v count="$COUNT" -v rate="$RATE" \
+        -v impair="$IMPAIR" -v ct="$cpu_total" -v cm="$cpu_max" -v st="$status" '
+    {
+        for (i = 2; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] }
+        printf "{\"key\":\"%s/%s/%d/%s/P%s/D%s/%d/%d\",\"suite\":\"%s\",\"topology\":\"%s\",\"nodes\":%d,", \
+               suite, topo, n, w, P, D, size, rate, suite, topo, n
+        printf "\"weight\":\"%s\",\"link\":%s,\"dissem\":%s,\"size\":%d,\"count\":%d,\"rate_kbps\":%d,", \
+               w, P, D, size, count, rate
+        printf "\"impair\":\"%s\",\"status\":\"%s\",\"recv\":%d,\"pps\":%s,\"goodput_kbps\":%s,", \
+               impair, st, v["recv"], v["pps"], v["kbps"]
+        printf "\"lat_p50_us\":%s,\"lat_p90_us\":%s,\"lat_p99_us\":%s,\"lat_p999_us\":%s,\"lat_max_us\":%s,", \
+               v["lat_p50_us"], v["lat_p90_us"], v["lat_p99_us"], v["lat_p999_us"], v["lat_max_us"]
+        printf "\"cpu_pct_total\":%s,\"cpu_pct_max_daemon\":%s}\n", ct, cm
+    }' | tee -a "$RESULTS"
+}
+
+# Runs the congested link scenario (see the top of this file) with the
+# given route weight. Takes over NODES, TOPO and EDGES while it runs.
+# $1: weight
+run_congested() {
+    local nodes=$NODES topo=$TOPO edges=$EDGES rport=$((8400 + RUN)) limit hog
+    local rpid spid stopper
+
+    NODES=3
+    TOPO=star
+    EDGES=$OUT_DIR/edges_congested
+    printf "1 2\n1 3\n" > "$EDGES"
+    gen_conf "$OUT_DIR/spines_congested.conf" 0
+    start_daemons "$OUT_DIR/spines_congested.conf" "$1"
+
+    hog=$((RATE * 10))
+    limit=$((COUNT * SIZE * 8 / RATE / 1000 * 2 + 30))
+    RUN=$((RUN + 1))
+
+    timeout "$limit" "$FLOODER" -ud "$OUT_DIR/sp2" -r "$rport" -n $((COUNT * 20)) \
+            -b "$SIZE" -P 1 -D 0 -q > "$OUT_DIR/congested.recv" 2>&1 &
+    rpid=$!
+    sleep 1
+    timeout "$limit" "$FLOODER" -ud "$OUT_DIR/sp1" -s -a "$(node_ip 2)" -d "$rport" \
+            -n $((COUNT * 20)) -b "$SIZE" -R "$hog" -P 1 -D 0 -x > "$OUT_DIR/congested.send" 2>&1 &
+    spid=$!
+    sleep 2
+
+    # keep node 2 stopped 80% of the time while the measured run goes on
+    (
+        while kill -0 "${PIDS[1]}" 2>/dev/null; do
+            kill -STOP "${PIDS[1]}"; sleep 0.4
+            kill -CONT "${PIDS[1]}"; sleep 0.1
+        done
+    ) &
+    stopper=$!
+
+    run_flood congested_link "$1" 1 0
+
+    kill "$stopper" 2>/dev/null
+    wait "$stopper" 2>/dev/null
+    kill -CONT "${PIDS[1]}" 2>/dev/null
+    kill "$spid" "$rpid" 2>/dev/null
+    wait "$spid" "$rpid" 2>/dev/null
+    stop_daemons
+
+    NODES=$nodes
+    TOPO=$topo
+    EDGES=$edges
+}
+
+# Compares goodput and p99 latency of every run against the baseline
+compare_baseline() {
+    awk -v tol="$TOLERANCE" '
+    function val(line, k,    m) {
+        if (match(line, "\"" k "\":\"?[^,}\"]*")) {
+            m = substr(line, RSTART, RLENGTH); sub(/^[^:]*:"?/, "", m); return m
+        }
+        return ""
+    }
+    FNR == NR { base_kbps[val($0, "key")] = val($0, "goodput_kbps"); base_p99[val($0, "key")] = val($0, "lat_p99_us"); next }
+    {
+        k = val($0, "key")
+        if (!(k in base_kbps)) { print "NEW        " k; next }
+        kbps = val($0, "goodput_kbps"); p99 = val($0, "lat_p99_us")
+        bad = 0
+        if (kbps < base_kbps[k] * (1 - tol / 100.0)) bad = 1
+        if (base_p99[k] >= 0 && (p99 < 0 || p99 > base_p99[k] * (1 + tol / 100.0))) bad = 1
+        printf "%s %s goodput %s -> %s kbps, p99 %s -> %s us\n", bad ? "REGRESSION" : "ok        ", \
+               k, base_kbps[k], kbps, base_p99[k], p99
+        regressions += bad
+    }
+    END { exit regressions > 0 ? 2 : 0 }' "$BASELINE" "$RESULTS"
+}
+
+gen_edges || exit 1
+echo "sp_bench.sh: $NODES nodes, $TOPO topology, $(wc -l < "$EDGES") edges, results in $RESULTS"
+
+RUN=0
+for weight in $WEIGHTS; do
+    normal_prots=""
+    it_prot=""
+    for p in $PROTS; do
+        if [ "$p" = 8 ]; then it_prot=8; else normal_prots="$normal_prots $p"; fi
+    done
+
+    if [ -n "$normal_prots" ]; then
+        gen_conf "$OUT_DIR/spines.conf" 0
+        start_daemons "$OUT_DIR/spines.conf" "$weight"
+        for p in $normal_prots; do
+            for d in $DISSEMS; do
+                # source based routing only runs over UDP and realtime links
+                [ "$d" = 3 ] && [ "$p" = 1 ] && continue
+                run_flood overlay "$weight" "$p" "$d"
+            done
+        done
+        stop_daemons
+    fi
+
+    if [ -n "$it_prot" ]; then
+        gen_conf "$OUT_DIR/spines_it.conf" 1
+        start_daemons "$OUT_DIR/spines_it.conf" "$weight"
+        for d in 1 2; do
+            run_flood intrusion_tolerant "$weight" 8 "$d"
+        done
+        stop_daemons
+    fi
+
+    if [ "$CONGESTED" = 1 ]; then
+        run_congested "$weight"
+    fi
+done
+
+if [ -n "$SAVE_BASELINE" ]; then
+    cp "$RESULTS" "$SAVE_BASELINE" && echo "sp_bench.sh: saved baseline $SAVE_BASELINE"
+fi
+
+if [ -n "$BASELINE" ]; then
+    compare_baseline
+    exit $?
+fi
+
+exit 0
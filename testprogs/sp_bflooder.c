@@ -82,6 +82,8 @@ static int  no_rotate_priority;
 static int16u KPaths;
 
 static void Usage(int argc, char *argv[]);
+static int  Compare_Latency(const void *l1, const void *l2);
+static long long int Latency_Percentile(long long int *lat, int count, double pct);
 
 #define SP_MAX_PKT_SIZE  100000
 #define MAX_PRIORITY 10
@@ -207,6 +209,8 @@ int main( int argc, char *argv[] )
   long long int running_latency;
   int        last_seq, bytes_checkpoint, seq_checkpoint = 0;
   double     running_std_dev; /*now_loss;*/
+  long long int *latency_hist = NULL;
+  int        lat_count;
   
 #ifdef	ARCH_PC_WIN95    
   ret = WSAStartup( MAKEWORD(1,1), &WSAData );
@@ -518,6 +522,16 @@ int main( int argc, char *argv[] )
     /* calloc guarantees that count is 0 and all pointers are null. */
     root = calloc(1, sizeof(trie_node));
 
+    /* One latency sample per expected packet, sorted at the end to
+     * compute percentiles */
+    if(report_latency_stats == 1) {
+      latency_hist = (long long int*) malloc(Num_pkts * sizeof(long long int));
+      if(latency_hist == NULL) {
+        printf("sp_bflooder: could not allocate latency history for %d packets\n", Num_pkts);
+        exit(1);
+      }
+    }
+
     if(verbose_mode == 1) {
       printf("\r\n - VERBOSE REPORTING - \r\nMsg size, Num Msgs being Sent, Msg Sequence Num, Oneway Latency\r\n");
       if(fileflag == 1) {
@@ -633,6 +647,9 @@ int main( int argc, char *argv[] )
 	  printf("ERROR: One Way calculated latency is negative (%lld), and probably indicated the clocks are not synchronized\r\n", oneway_time);
 	}
       }*/
+      if(report_latency_stats == 1 && recv_count < Num_pkts) {
+        latency_hist[recv_count] = oneway_time;
+      }
       recv_count++;
       
       /*if(report_latency_stats == 1) {
@@ -799,6 +816,43 @@ int main( int argc, char *argv[] )
       fprintf(f1, "%s", results_str);
     }
 
+    if(report_latency_stats == 1) {
+      lat_count = (recv_count < Num_pkts) ? recv_count : Num_pkts;
+      qsort(latency_hist, lat_count, sizeof(long long int), Compare_Latency);
+      for(i = 0; i < lat_count; i++) {
+        running_latency += latency_hist[i];
+      }
+      min_latency = latency_hist[0];
+      max_latency = latency_hist[lat_count - 1];
+
+      sprintf(results_str,
+	      "- Latency (ms) (Avg Min Max):\t%.3f \t %.3f \t %.3f\r\n"
+	      "- Latency (ms) (p50 p90 p99 p99.9):\t%.3f \t %.3f \t %.3f \t %.3f\r\n\r\n",
+	      running_latency / 1000.0 / lat_count, min_latency / 1000, max_latency / 1000,
+	      Latency_Percentile(latency_hist, lat_count, 50.0) / 1000.0,
+	      Latency_Percentile(latency_hist, lat_count, 90.0) / 1000.0,
+	      Latency_Percentile(latency_hist, lat_count, 99.0) / 1000.0,
+	      Latency_Percentile(latency_hist, lat_count, 99.9) / 1000.0);
+      printf("%s", results_str);
+
+      /* Single key=value line for scripts (see sp_bench.sh) */
+      printf("BENCH recv=%d total=%d size=%d duration_us=%lld pps=%.1f kbps=%.3f "
+             "lat_avg_us=%lld lat_min_us=%lld lat_p50_us=%lld lat_p90_us=%lld "
+             "lat_p99_us=%lld lat_p999_us=%lld lat_max_us=%lld\n",
+             recv_count, Num_pkts, Num_bytes, duration_now,
+             recv_count * 1000000.0 / duration_now, rate_now,
+             running_latency / lat_count, (long long int)min_latency,
+             Latency_Percentile(latency_hist, lat_count, 50.0),
+             Latency_Percentile(latency_hist, lat_count, 90.0),
+             Latency_Percentile(latency_hist, lat_count, 99.0),
+             Latency_Percentile(latency_hist, lat_count, 99.9),
+             (long long int)max_latency);
+      if(fileflag == 1) {
+        fprintf(f1, "%s", results_str);
+      }
+      free(latency_hist);
+    }
+
     printf("Printing path statistics:\n");
     trie_print(root, temp_path, 0);
 
@@ -826,6 +880,26 @@ int main( int argc, char *argv[] )
   return(0);
 }
 
+static int Compare_Latency(const void *l1, const void *l2)
+{
+  long long int a = *(const long long int*)l1;
+  long long int b = *(const long long int*)l2;
+
+  return (a > b) - (a < b);
+}
+
+/* Nearest-rank percentile over an already sorted array */
+static long long int Latency_Percentile(long long int *lat, int count, double pct)
+{
+  int idx;
+
+  idx = (int)ceil(pct / 100.0 * count) - 1;
+  if (idx < 0) idx = 0;
+  if (idx >= count) idx = count - 1;
+
+  return lat[idx];
+}
+
 static  void    Usage(int argc, char *argv[])
 {
   int i1, i2, i3, i4, tmp;
@@ -893,6 +967,8 @@ static  void    Usage(int argc, char *argv[])
     } else if( !strncmp( *argv, "-n", 2 ) ){
       sscanf(argv[1], "%d", (int*)&Num_pkts );
       argc--; argv++;
+    } else if( !strncmp( *argv, "-seq", 5 ) ){
+      Protocol |= SEQPACKET_CONNECT;
     } else if( !strncmp( *argv, "-s", 2 ) ){
       Send_Flag = 1;
     } else if( !strncmp( *argv, "-v", 2 ) ){
@@ -928,6 +1004,7 @@ static  void    Usage(int argc, char *argv[])
 	      "\t[-o <address>    ] : address where spines runs, default localhost\n"
 	      "\t[-p <port number>] : port where spines runs, default is 8100\n"
           "\t[-ud <path>      ] : unix domain socket path to connect to, default is /tmp/spines<port>\n"
+          "\t[-seq            ] : reach the daemon over its unix domain SOCK_SEQPACKET socket\n"
 	      "\t[-d <port number>] : to send packets on, default is 8400\n"
 	      "\t[-r <port number>] : to receive packets on, default is 8400\n"
 	      "\t[-a <address>    ] : address to send packets to\n"
@@ -944,7 +1021,7 @@ static  void    Usage(int argc, char *argv[])
                                     "\t                     \tdefault is MAX_INT (for flooding)\n"
 	      "\t[-v              ] : print verbose\n"
 	      "\t[-x              ] : turn off rotating priority messages\n"
-	      "\t[-q              ] : report latency stats (required tight clock sync)\n"
+	      "\t[-q              ] : report latency percentiles (requires tight clock sync)\n"
 	      "\t[-s              ] : sender flooder\n");
       exit( 0 );
     }
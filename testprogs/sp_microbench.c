@@ -0,0 +1,2185 @@
+/*
+ * Spines.
+ *
+ * The contents of this file are subject to the Spines Open-Source
+ * License, Version 1.0 (the ``License''); you may not use
+ * this file except in compliance with the License.  You may obtain a
+ * copy of the License at:
+ *
+ * http://www.spines.org/LICENSE.txt
+ *
+ * or in the file ``LICENSE.txt'' found in this distribution.
+ *
+ * Software distributed under the License is distributed on an AS IS basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Creators of Spines are:
+ *  Yair Amir, Claudiu Danilov, John Schultz, Daniel Obenshain,
+ *  Thomas Tantillo, and Amy Babay.
+ *
+ * Copyright (c) 2003-2025 The Johns Hopkins University.
+ * All rights reserved.
+ *
+ * Major Contributor(s):
+ * --------------------
+ *    John Lane
+ *    Raluca Musaloiu-Elefteri
+ *    Nilo Rivera
+ *
+ * Contributor(s):
+ * ----------------
+ *    Sahiti Bommareddy
+ *
+ */
+
+/* sp_microbench: microbenchmarks for the data structures on the daemon's
+ * hot path (stdutil containers, libspread-util memory pools, the
+ * E_queue/E_dequeue timer queue, the reliable flooding flow
+ * scheduler, the priority flooding queues and source based duplicate
+ * detection).
+ *
+ * Each benchmark reports ns/op, last level cache misses/op (from
+ * perf_event_open, null if the counter is not available) and the number
+ * of malloc/calloc/realloc/free calls made while it ran.  Allocation
+ * calls are counted by linking with -Wl,--wrap=malloc,... (see
+ * testprogs/Makefile.in), which also catches the calls made from inside
+ * the static stdutil and libspread-util libraries.  new() calls on the
+ * libspread-util memory pools are counted separately (pool_allocs), since
+ * a pool only mallocs when it runs dry.
+ *
+ * Results are printed as one JSON document so that runs before and after
+ * a container or allocator change can be compared objectively. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/sha.h>
+
+#include "spu_alarm.h"
+#include "spu_events.h"
+#include "spu_memory.h"
+#include "spu_objects.h"
+
+#include "stdutil/stdhash.h"
+#include "stdutil/stdskl.h"
+#include "stdutil/stdcarr.h"
+#include "stdutil/stddll.h"
+
+#include "security.h"
+#include "intrusion_tol_udp.h"
+#include "flow_ready_set.h"
+#include "prio_queue.h"
+#include "source_dedup.h"
+#include "flow_paths.h"
+
+/* Defined by intrusion_tol_udp.c in the daemon; security.o reads only
+ * its Encrypt flag, which the signatures benchmarked here never use */
+CONF_IT_LINK Conf_IT_Link;
+
+/* Same layout as the daemon's Prio_Flood_Key (daemon/priority_flood.h) */
+typedef struct dummy_prio_flood_key {
+    stduint64 incarnation;
+    stduint64 seq_num;
+} Bench_Prio_Key;
+
+/* Same layout as the daemon's Flow_Queue (daemon/reliable_flood.h) before
+ * the reliable flooding scheduler moved to ready sets */
+typedef struct dummy_bench_flow_node {
+    int   src_id;
+    int   dest_id;
+    int   penalty;
+    struct dummy_bench_flow_node *next;
+} Bench_Flow_Node;
+
+/* Flow scheduler shape: every (src,dest) flow of the daemon's ready sets
+ * (daemon/flow_ready_set.h) across 8 neighbors */
+#define BENCH_FLOWS         RF_FLOWS
+#define BENCH_NGBRS         8
+
+/* Priority flooding queues: messages from 16 sources at 10 priority
+ * levels, each forwarded to 7 of 8 neighbors */
+#define BENCH_PRIO_NGBRS    8
+#define BENCH_PRIO_SRCS     16
+#define BENCH_PRIO_LEVELS   10
+#define BENCH_PRIO_SLOTS    4096
+
+/* Same layout as the daemon's Prio_Neighbor_Status, Prio_PQ_Node and
+ * Send_Fair_Queue (daemon/priority_flood.h) before the queues moved into
+ * the Belly entries */
+typedef struct dummy_bench_old_ns {
+    stdint32 flag;
+    struct dummy_bench_pq_node *ngbr;
+} Bench_Old_NS;
+
+typedef struct dummy_bench_pq_node {
+    struct timeval timestamp;
+    struct dummy_bench_pq_node *prev;
+    struct dummy_bench_pq_node *next;
+    struct dummy_bench_prio_msg *entry;
+} Bench_PQ_Node;
+
+typedef struct dummy_bench_sfq_node {
+    stdint32 src_id;
+    short    penalty;
+    struct dummy_bench_sfq_node *next;
+} Bench_SFQ_Node;
+
+/* A Belly entry: the daemon's Prio_Flood_Value followed by the status
+ * toward each neighbor, plus the former NS array; only one layout is
+ * used per benchmark */
+typedef struct dummy_bench_prio_msg {
+    Prio_Flood_Value     value;
+    Prio_Neighbor_Status ns[BENCH_PRIO_NGBRS + 1];
+    int                  src_id;
+    Bench_Old_NS        *old_ns;
+} Bench_Prio_Msg;
+
+/* Source based routing duplicate detection: 50 sources, each packet
+ * seen about twice and reordered by up to 64 positions */
+#define BENCH_DEDUP_SRCS    50
+#define BENCH_DEDUP_HIST    100000
+#define BENCH_DEDUP_WINDOW  65536
+
+#if BENCH_DEDUP_SRCS > MAX_NODES
+#error "BENCH_DEDUP_SRCS must fit the daemon's Source_Dedup windows"
+#endif
+
+typedef struct dummy_bench_dedup_pkt {
+    int32u src;
+    int32u incarnation;
+    int32u seq;
+} Bench_Dedup_Pkt;
+
+/* Same layout as the daemon's seq_pair (daemon/route.c) before source
+ * based duplicate detection moved to sliding windows */
+typedef struct dummy_bench_seq_pair {
+    int32u seq;
+    int32u incarnation;
+} Bench_Seq_Pair;
+
+/* Memory pool object types, chosen above anything used by libspread-util
+ * or the daemon so the pools do not collide */
+#define BENCH_OBJ_SMALL     150
+#define BENCH_OBJ_PACKET    151
+#define BENCH_OBJ_REF_CNT   152
+#define BENCH_OBJ_FLOW      153
+#define BENCH_OBJ_PRIO_NS   154
+#define BENCH_OBJ_PRIO_PQ   155
+#define BENCH_OBJ_PRIO_SFQ  156
+
+#define BENCH_SMALL_SIZE    64
+#define BENCH_PACKET_SIZE   1472
+
+#define MAX_NAME_LEN        64
+
+typedef struct dummy_bench_result {
+    char   name[MAX_NAME_LEN];
+    long   ops;
+    double ns_per_op;
+    long long cache_misses;
+    long   allocs;
+    long   frees;
+    long   pool_allocs;
+} Bench_Result;
+
+static int   Num_Elems   = 10000;
+static int   Num_Ops     = 1000000;
+static int   Num_Timers  = 4000;
+static int   Timer_Ops   = 20000;
+static int   Seed        = 1;
+static char  Filter[MAX_NAME_LEN];
+static char  Out_File[80];
+
+static Bench_Result *Results;
+static int   Num_Results;
+static int   Max_Results;
+
+/* Allocation counters, bumped by the __wrap_* functions below */
+static long  Alloc_Count;
+static long  Free_Count;
+static long  Pool_Alloc_Count;
+
+/* Benchmark currently being measured */
+static struct timespec Bench_Start_Time;
+static long  Bench_Start_Allocs;
+static long  Bench_Start_Frees;
+static long  Bench_Start_Pool_Allocs;
+static int   Perf_Fd = -1;
+static char  Bench_Name[MAX_NAME_LEN];
+
+static stduint64 Rand_State;
+
+/* Sink for values read during find/iterate so they are not optimized away */
+static volatile long Sink;
+
+static void   Usage(int argc, char *argv[]);
+static void   Print_Results(void);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void  __real_free(void *ptr);
+void *__real_new(int32u obj_type);
+
+/* new() on a libspread-util pool; only counts calls made from here, not
+ * those inside the library itself (e.g. from new_ref_cnt) */
+void *__wrap_new(int32u obj_type)
+{
+    Pool_Alloc_Count++;
+    return __real_new(obj_type);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    Alloc_Count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    Alloc_Count++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    Alloc_Count++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL)
+        Free_Count++;
+    __real_free(ptr);
+}
+
+/* xorshift64*, so runs are reproducible for a given seed */
+static stduint64 Rand64(void)
+{
+    Rand_State ^= Rand_State >> 12;
+    Rand_State ^= Rand_State << 25;
+    Rand_State ^= Rand_State >> 27;
+    return Rand_State * 2685821657736338717ULL;
+}
+
+static int Rand_Below(int n)
+{
+    return (int) (Rand64() % (stduint64) n);
+}
+
+static void Perf_Init(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    Perf_Fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (Perf_Fd < 0)
+        fprintf(stderr, "sp_microbench: cache miss counter not available, "
+                        "reporting null\n");
+#endif
+}
+
+/***********************************************************/
+/* void Bench_Begin(const char *name)                      */
+/*                                                         */
+/* Starts measuring a benchmark. Setup work belongs before */
+/* this call, teardown after the matching Bench_End.       */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* name: benchmark name, reported in the JSON output       */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* 1 if the benchmark should run, 0 if it is filtered out  */
+/*                                                         */
+/***********************************************************/
+
+static int Bench_Begin(const char *name)
+{
+    if (Filter[0] != '\0' && strstr(name, Filter) == NULL)
+        return 0;
+
+    strncpy(Bench_Name, name, sizeof(Bench_Name) - 1);
+    Bench_Name[sizeof(Bench_Name) - 1] = '\0';
+
+#ifdef __linux__
+    if (Perf_Fd >= 0) {
+        ioctl(Perf_Fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(Perf_Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    Bench_Start_Allocs = Alloc_Count;
+    Bench_Start_Frees  = Free_Count;
+    Bench_Start_Pool_Allocs = Pool_Alloc_Count;
+    clock_gettime(CLOCK_MONOTONIC, &Bench_Start_Time);
+    return 1;
+}
+
+/***********************************************************/
+/* void Bench_End(long ops)                                */
+/*                                                         */
+/* Stops measuring the current benchmark and records its   */
+/* result                                                  */
+/*                                                         */
+/* Arguments                                               */
+/*                                                         */
+/* ops: number of operations performed since Bench_Begin   */
+/*                                                         */
+/* Return Value                                            */
+/*                                                         */
+/* NONE                                                    */
+/*                                                         */
+/***********************************************************/
+
+static void Bench_End(long ops)
+{
+    struct timespec now;
+    long long       misses = -1;
+    Bench_Result   *res;
+    double          elapsed_ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    /* Read the counters before anything here allocates */
+    res = &Results[Num_Results];
+#ifdef __linux__
+    if (Perf_Fd >= 0) {
+        ioctl(Perf_Fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(Perf_Fd, &misses, sizeof(misses)) != sizeof(misses))
+            misses = -1;
+    }
+#endif
+    res->allocs = Alloc_Count - Bench_Start_Allocs;
+    res->frees  = Free_Count - Bench_Start_Frees;
+    res->pool_allocs = Pool_Alloc_Count - Bench_Start_Pool_Allocs;
+
+    elapsed_ns = (double) (now.tv_sec - Bench_Start_Time.tv_sec) * 1e9 +
+                 (double) (now.tv_nsec - Bench_Start_Time.tv_nsec);
+
+    strcpy(res->name, Bench_Name);
+    res->ops          = ops;
+    res->ns_per_op    = (ops > 0) ? elapsed_ns / ops : 0;
+    res->cache_misses = misses;
+
+    Num_Results++;
+    if (Num_Results == Max_Results)
+        Alarm(EXIT, "sp_microbench: too many results\n");
+}
+
+/* Node_ID keys look like the daemon's: IPv4 addresses in host order */
+static int32 Node_Key(int i)
+{
+    return (int32) ((10 << 24) | (i & 0xffffff));
+}
+
+/* Session ports: unique values in the non privileged port range, in a
+ * shuffled order like ports handed out by the kernel */
+static void Make_Ports(int32 *ports, int n)
+{
+    int   i, j;
+    int32 tmp;
+
+    for (i = 0; i < n; i++)
+        ports[i] = 1024 + (i * 7919) % (65536 - 1024);
+    for (i = n - 1; i > 0; i--) {
+        j = Rand_Below(i + 1);
+        tmp = ports[i]; ports[i] = ports[j]; ports[j] = tmp;
+    }
+}
+
+/***********************************************************/
+/* Hash table benchmarks, shared by all int32 key shapes    */
+/***********************************************************/
+
+static void Bench_Hash_Int32(const char *shape, const int32 *keys, int n)
+{
+    stdhash  h;
+    stdit    it;
+    void    *val = NULL;
+    int32    key;
+    int      i, pass, passes;
+    long     found;
+    char     name[MAX_NAME_LEN];
+
+    stdhash_construct(&h, sizeof(int32), sizeof(void*), NULL, NULL, 0);
+
+    snprintf(name, sizeof(name), "stdhash_%s_insert", shape);
+    if (Bench_Begin(name)) {
+        for (i = 0; i < n; i++)
+            stdhash_insert(&h, &it, &keys[i], &val);
+        Bench_End(n);
+    } else {
+        for (i = 0; i < n; i++)
+            stdhash_insert(&h, &it, &keys[i], &val);
+    }
+
+    snprintf(name, sizeof(name), "stdhash_%s_find_hit", shape);
+    if (Bench_Begin(name)) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++)
+            found += !stdhash_is_end(&h, stdhash_find(&h, &it, &keys[Rand_Below(n)]));
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    snprintf(name, sizeof(name), "stdhash_%s_find_miss", shape);
+    if (Bench_Begin(name)) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++) {
+            key = keys[Rand_Below(n)] ^ 0x40000000;
+            found += !stdhash_is_end(&h, stdhash_find(&h, &it, &key));
+        }
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    snprintf(name, sizeof(name), "stdhash_%s_iterate", shape);
+    passes = Num_Ops / n + 1;
+    if (Bench_Begin(name)) {
+        found = 0;
+        for (pass = 0; pass < passes; pass++)
+            for (stdhash_begin(&h, &it); !stdhash_is_end(&h, &it); stdhash_it_next(&it))
+                found += *(const int32*) stdhash_it_key(&it);
+        Sink = found;
+        Bench_End((long) passes * n);
+    }
+
+    /* Steady state: half finds, a quarter erases of a random present key
+     * and a quarter re-inserts, so the table size stays around n */
+    snprintf(name, sizeof(name), "stdhash_%s_mix", shape);
+    if (Bench_Begin(name)) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++) {
+            key = keys[Rand_Below(n)];
+            switch (i & 3) {
+            case 0:
+            case 1:
+                found += !stdhash_is_end(&h, stdhash_find(&h, &it, &key));
+                break;
+            case 2:
+                stdhash_erase_key(&h, &key);
+                break;
+            case 3:
+                stdhash_put(&h, &it, &key, &val);
+                break;
+            }
+        }
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    /* Put back whatever the mix erased so erase sees a full table */
+    for (i = 0; i < n; i++)
+        stdhash_put(&h, &it, &keys[i], &val);
+
+    snprintf(name, sizeof(name), "stdhash_%s_erase", shape);
+    if (Bench_Begin(name)) {
+        for (i = 0; i < n; i++)
+            stdhash_erase_key(&h, &keys[i]);
+        Bench_End(n);
+    }
+
+    stdhash_destruct(&h);
+}
+
+/* Prio_Flood_Key keys follow the Belly pattern in priority_flood.c: a
+ * few sources each inserting increasing sequence numbers while the oldest
+ * messages get garbage collected, i.e. a sliding window per source */
+static void Bench_Hash_Prio_Key(int n)
+{
+    stdhash         h;
+    stdit           it;
+    Bench_Prio_Key  key;
+    void           *val = NULL;
+    stduint64          head, tail, window;
+    int             i, pass, passes;
+    long            found;
+
+    stdhash_construct(&h, sizeof(Bench_Prio_Key), sizeof(void*), NULL, NULL,
+                      STDHASH_OPTS_NO_AUTO_SHRINK);
+    key.incarnation = (stduint64) time(NULL);
+
+    if (Bench_Begin("stdhash_prio_key_insert")) {
+        for (i = 0; i < n; i++) {
+            key.seq_num = i + 1;
+            stdhash_insert(&h, &it, &key, &val);
+        }
+        Bench_End(n);
+    } else {
+        for (i = 0; i < n; i++) {
+            key.seq_num = i + 1;
+            stdhash_insert(&h, &it, &key, &val);
+        }
+    }
+    tail = 1;
+    head = n;
+
+    if (Bench_Begin("stdhash_prio_key_find_hit")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++) {
+            key.seq_num = tail + Rand_Below(n);
+            found += !stdhash_is_end(&h, stdhash_find(&h, &it, &key));
+        }
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    if (Bench_Begin("stdhash_prio_key_find_miss")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++) {
+            key.seq_num = head + 1 + Rand_Below(n);
+            found += !stdhash_is_end(&h, stdhash_find(&h, &it, &key));
+        }
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    passes = Num_Ops / n + 1;
+    if (Bench_Begin("stdhash_prio_key_iterate")) {
+        found = 0;
+        for (pass = 0; pass < passes; pass++)
+            for (stdhash_begin(&h, &it); !stdhash_is_end(&h, &it); stdhash_it_next(&it))
+                found += (long) ((const Bench_Prio_Key*) stdhash_it_key(&it))->seq_num;
+        Sink = found;
+        Bench_End((long) passes * n);
+    }
+
+    /* Sliding window: every op inserts the next sequence number, finds a
+     * recent one (duplicate check) and erases the oldest */
+    window = n;
+    if (Bench_Begin("stdhash_prio_key_window")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++) {
+            key.seq_num = ++head;
+            stdhash_insert(&h, &it, &key, &val);
+            key.seq_num = head - Rand_Below((int) window);
+            found += !stdhash_is_end(&h, stdhash_find(&h, &it, &key));
+            key.seq_num = tail++;
+            stdhash_erase_key(&h, &key);
+        }
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    if (Bench_Begin("stdhash_prio_key_erase")) {
+        for (; tail <= head; tail++) {
+            key.seq_num = tail;
+            stdhash_erase_key(&h, &key);
+        }
+        Bench_End(n);
+    }
+
+    stdhash_destruct(&h);
+}
+
+static int Node_Cmp(const void *l, const void *r)
+{
+    int32 a = *(const int32*) l;
+    int32 b = *(const int32*) r;
+
+    return (a < b) ? -1 : (a > b);
+}
+
+static void Bench_Skl_Node_ID(const int32 *keys, int n)
+{
+    stdskl  l;
+    stdit   it;
+    void   *val = NULL;
+    int     i, pass, passes;
+    long    found;
+
+    stdskl_construct(&l, sizeof(int32), sizeof(void*), Node_Cmp);
+
+    if (Bench_Begin("stdskl_node_id_insert")) {
+        for (i = 0; i < n; i++)
+            stdskl_insert(&l, &it, &keys[i], &val, STDFALSE);
+        Bench_End(n);
+    } else {
+        for (i = 0; i < n; i++)
+            stdskl_insert(&l, &it, &keys[i], &val, STDFALSE);
+    }
+
+    if (Bench_Begin("stdskl_node_id_find_hit")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++)
+            found += !stdskl_is_end(&l, stdskl_find(&l, &it, &keys[Rand_Below(n)]));
+        Sink = found;
+        Bench_End(Num_Ops);
+    }
+
+    passes = Num_Ops / n + 1;
+    if (Bench_Begin("stdskl_node_id_iterate")) {
+        found = 0;
+        for (pass = 0; pass < passes; pass++)
+            for (stdskl_begin(&l, &it); !stdskl_is_end(&l, &it); stdskl_it_next(&it))
+                found += *(const int32*) stdskl_it_key(&it);
+        Sink = found;
+        Bench_End((long) passes * n);
+    }
+
+    if (Bench_Begin("stdskl_node_id_erase")) {
+        for (i = 0; i < n; i++)
+            stdskl_erase_key(&l, &keys[i]);
+        Bench_End(n);
+    }
+
+    stdskl_destruct(&l);
+}
+
+/* Queues of packet pointers, like the per-link and per-session send
+ * queues: push at the back, pop at the front, with occasional scans */
+static void Bench_Queues(int n)
+{
+    stdcarr  carr;
+    stddll   dll;
+    stdit    it;
+    void    *val;
+    int      i, pass, passes;
+    long     found;
+
+    stdcarr_construct(&carr, sizeof(void*), 0);
+    stddll_construct(&dll, sizeof(void*));
+
+    if (Bench_Begin("stdcarr_push_pop")) {
+        for (i = 0; i < n; i++) {
+            val = (void*) (long) i;
+            stdcarr_push_back(&carr, &val);
+        }
+        for (i = 0; i < Num_Ops; i++) {
+            stdcarr_pop_front(&carr);
+            val = (void*) (long) i;
+            stdcarr_push_back(&carr, &val);
+        }
+        Bench_End(n + Num_Ops);
+    }
+
+    passes = Num_Ops / n + 1;
+    if (Bench_Begin("stdcarr_iterate")) {
+        found = 0;
+        for (pass = 0; pass < passes; pass++)
+            for (stdcarr_begin(&carr, &it); !stdcarr_is_end(&carr, &it); stdcarr_it_next(&it))
+                found += (long) *(void**) stdcarr_it_val(&it);
+        Sink = found;
+        Bench_End((long) passes * (long) stdcarr_size(&carr));
+    }
+
+    if (Bench_Begin("stddll_push_pop")) {
+        for (i = 0; i < n; i++) {
+            val = (void*) (long) i;
+            stddll_push_back(&dll, &val);
+        }
+        for (i = 0; i < Num_Ops; i++) {
+            stddll_pop_front(&dll);
+            val = (void*) (long) i;
+            stddll_push_back(&dll, &val);
+        }
+        Bench_End(n + Num_Ops);
+    }
+
+    if (Bench_Begin("stddll_iterate")) {
+        found = 0;
+        for (pass = 0; pass < passes; pass++)
+            for (stddll_begin(&dll, &it); !stddll_is_end(&dll, &it); stddll_it_next(&it))
+                found += (long) *(void**) stddll_it_val(&it);
+        Sink = found;
+        Bench_End((long) passes * (long) stddll_size(&dll));
+    }
+
+    /* Remove from the middle and re-append, as when a queued packet is
+     * acknowledged out of order */
+    if (Bench_Begin("stddll_erase_middle")) {
+        for (i = 0; i < Num_Ops / 100; i++) {
+            stddll_begin(&dll, &it);
+            stdit_advance(&it, stddll_size(&dll) / 2);
+            stddll_erase(&dll, &it);
+            val = (void*) (long) i;
+            stddll_push_back(&dll, &val);
+        }
+        Bench_End(Num_Ops / 100);
+    }
+
+    stdcarr_destruct(&carr);
+    stddll_destruct(&dll);
+}
+
+/* libspread-util pools: new/dispose as in the packet paths, both a tight
+ * LIFO pair and a working set larger than the pool watermark */
+static void Bench_Memory(int n)
+{
+    void   **objs;
+    void    *obj;
+    int      i, j;
+
+    objs = (void**) malloc(n * sizeof(void*));
+    if (objs == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    if (Bench_Begin("mem_new_dispose_small")) {
+        for (i = 0; i < Num_Ops; i++) {
+            obj = new(BENCH_OBJ_SMALL);
+            ((char*) obj)[0] = (char) i;
+            dispose(obj);
+        }
+        Bench_End(Num_Ops);
+    }
+
+    if (Bench_Begin("mem_new_dispose_packet")) {
+        for (i = 0; i < Num_Ops; i++) {
+            obj = new(BENCH_OBJ_PACKET);
+            ((char*) obj)[0] = (char) i;
+            dispose(obj);
+        }
+        Bench_End(Num_Ops);
+    }
+
+    /* n packets outstanding (a full send window), replaced in random
+     * order */
+    for (i = 0; i < n; i++)
+        objs[i] = new(BENCH_OBJ_PACKET);
+    if (Bench_Begin("mem_packet_working_set")) {
+        for (i = 0; i < Num_Ops; i++) {
+            j = Rand_Below(n);
+            dispose(objs[j]);
+            objs[j] = new(BENCH_OBJ_PACKET);
+        }
+        Bench_End(Num_Ops);
+    }
+
+    /* Burst: allocate n then free n, as when a queue fills and drains */
+    if (Bench_Begin("mem_packet_burst")) {
+        for (i = 0; i < n; i++)
+            dispose(objs[i]);
+        for (i = 0; i < n; i++)
+            objs[i] = new(BENCH_OBJ_PACKET);
+        Bench_End(2 * n);
+    }
+    for (i = 0; i < n; i++)
+        dispose(objs[i]);
+
+    /* A packet handed to several neighbors: one new_ref_cnt, a few
+     * inc_ref_cnt and the matching dec_ref_cnt */
+    if (Bench_Begin("mem_ref_cnt_share")) {
+        for (i = 0; i < Num_Ops; i++) {
+            obj = new_ref_cnt(BENCH_OBJ_REF_CNT);
+            inc_ref_cnt(obj);
+            inc_ref_cnt(obj);
+            dec_ref_cnt(obj);
+            dec_ref_cnt(obj);
+            dec_ref_cnt(obj);
+        }
+        Bench_End(Num_Ops);
+    }
+
+    free(objs);
+}
+
+/* Flow scheduling state shared by both schedulers: whether the next
+ * message of a flow toward a neighbor is blocked (window, E2E, bitmask)
+ * and whether the flow is queued for that neighbor */
+static char Flow_Blocked[BENCH_NGBRS][BENCH_FLOWS];
+static char Flow_Queued[BENCH_NGBRS][BENCH_FLOWS];
+
+/* Messages of 1 to 3 packets, as a flow's penalty/deficit */
+static int Flow_Packets(int f)
+{
+    return 1 + f % 3;
+}
+
+/* Next flow event: a random flow on a random neighbor gets something to
+ * send, a quarter of the time still blocked */
+static void Flow_Event(int *n, int *f)
+{
+    *n = Rand_Below(BENCH_NGBRS);
+    *f = Rand_Below(BENCH_FLOWS);
+    Flow_Blocked[*n][*f] = (Rand_Below(4) == 0);
+}
+
+/* Reliable flooding flow scheduler: each op is one flow event followed
+ * by one send opportunity on a random neighbor. "list" is the former
+ * per-neighbor Flow_Queue rotation (a node allocated per enqueue, blocked
+ * flows dropped when reached, penalized flows rotated to the back), "ready"
+ * the per-neighbor two-level bitmap with a deficit per flow. Both start
+ * with every flow queued on every neighbor */
+static void Bench_Flow_Sched(void)
+{
+    Bench_Flow_Node  head[BENCH_NGBRS], *tail[BENCH_NGBRS], *fq;
+    Flow_Ready_Set  *ready;
+    unsigned short (*deficit)[BENCH_FLOWS];
+    int              cursor[BENCH_NGBRS];
+    int              i, n, f, sent;
+    long             sends;
+
+    ready = (Flow_Ready_Set*) calloc(BENCH_NGBRS, sizeof(Flow_Ready_Set));
+    deficit = calloc(BENCH_NGBRS, sizeof(*deficit));
+    if (ready == NULL || deficit == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    Rand_State = 0x9E3779B97F4A7C15ULL ^ (stduint64) Seed;
+    memset(Flow_Blocked, 0, sizeof(Flow_Blocked));
+    memset(Flow_Queued, 1, sizeof(Flow_Queued));
+    for (n = 0; n < BENCH_NGBRS; n++) {
+        tail[n] = &head[n];
+        for (f = 0; f < BENCH_FLOWS; f++) {
+            fq = (Bench_Flow_Node*) new(BENCH_OBJ_FLOW);
+            fq->src_id = f / (MAX_NODES + 1);
+            fq->dest_id = f % (MAX_NODES + 1);
+            fq->penalty = 0;
+            fq->next = NULL;
+            tail[n]->next = fq;
+            tail[n] = fq;
+        }
+    }
+    sends = 0;
+    if (Bench_Begin("flow_sched_list")) {
+        for (i = 0; i < Num_Ops; i++) {
+            Flow_Event(&n, &f);
+            if (!Flow_Queued[n][f]) {
+                Flow_Queued[n][f] = 1;
+                fq = (Bench_Flow_Node*) new(BENCH_OBJ_FLOW);
+                fq->src_id = f / (MAX_NODES + 1);
+                fq->dest_id = f % (MAX_NODES + 1);
+                fq->penalty = 0;
+                fq->next = NULL;
+                tail[n]->next = fq;
+                tail[n] = fq;
+            }
+
+            n = Rand_Below(BENCH_NGBRS);
+            sent = 0;
+            while (!sent && (fq = head[n].next) != NULL) {
+                f = fq->src_id * (MAX_NODES + 1) + fq->dest_id;
+                fq->penalty--;
+                head[n].next = fq->next;
+                if (tail[n] == fq)
+                    tail[n] = &head[n];
+                if (fq->penalty <= 0 && Flow_Blocked[n][f]) {
+                    Flow_Queued[n][f] = 0;
+                    dispose(fq);
+                    continue;
+                }
+                if (fq->penalty <= 0) {
+                    fq->penalty = Flow_Packets(f);
+                    sent = 1;
+                }
+                fq->next = NULL;
+                tail[n]->next = fq;
+                tail[n] = fq;
+            }
+            sends += sent;
+        }
+        Bench_End(Num_Ops);
+    }
+    for (n = 0; n < BENCH_NGBRS; n++) {
+        while ((fq = head[n].next) != NULL) {
+            head[n].next = fq->next;
+            dispose(fq);
+        }
+    }
+    Sink += sends;
+
+    Rand_State = 0x9E3779B97F4A7C15ULL ^ (stduint64) Seed;
+    memset(Flow_Blocked, 0, sizeof(Flow_Blocked));
+    memset(Flow_Queued, 1, sizeof(Flow_Queued));
+    for (n = 0; n < BENCH_NGBRS; n++) {
+        cursor[n] = 0;
+        for (f = 0; f < BENCH_FLOWS; f++)
+            RF_Ready_Set_Add(&ready[n], f);
+    }
+    sends = 0;
+    if (Bench_Begin("flow_sched_ready")) {
+        for (i = 0; i < Num_Ops; i++) {
+            Flow_Event(&n, &f);
+            if (!Flow_Queued[n][f]) {
+                Flow_Queued[n][f] = 1;
+                deficit[n][f] = 0;
+                RF_Ready_Set_Add(&ready[n], f);
+            }
+
+            n = Rand_Below(BENCH_NGBRS);
+            sent = 0;
+            while (!sent && (f = RF_Ready_Set_Next(&ready[n], cursor[n])) >= 0) {
+                if (deficit[n][f] > 0) {
+                    deficit[n][f]--;
+                    cursor[n] = (f + 1) % BENCH_FLOWS;
+                    continue;
+                }
+                if (Flow_Blocked[n][f]) {
+                    Flow_Queued[n][f] = 0;
+                    RF_Ready_Set_Remove(&ready[n], f);
+                    continue;
+                }
+                deficit[n][f] = Flow_Packets(f) - 1;
+                cursor[n] = (f + 1) % BENCH_FLOWS;
+                sent = 1;
+            }
+            sends += sent;
+        }
+        Bench_End(Num_Ops);
+    }
+    Sink += sends;
+
+    free(ready);
+    free(deficit);
+}
+
+/* Belly entries come from a free list of slots so that neither
+ * benchmark pays for the hash table */
+static Bench_Prio_Msg *Prio_Slots;
+static int            *Prio_Free;
+static int             Num_Prio_Free;
+
+static Bench_Prio_Msg *Prio_Msg_Get(void)
+{
+    if (Num_Prio_Free == 0)
+        Alarm(EXIT, "sp_microbench: out of priority message slots\n");
+    return &Prio_Slots[Prio_Free[--Num_Prio_Free]];
+}
+
+static void Prio_Msg_Put(Bench_Prio_Msg *msg)
+{
+    Prio_Free[Num_Prio_Free++] = (int) (msg - Prio_Slots);
+}
+
+static void Prio_Slots_Reset(void)
+{
+    int i;
+
+    for (i = 0; i < BENCH_PRIO_SLOTS; i++)
+        Prio_Free[i] = BENCH_PRIO_SLOTS - 1 - i;
+    Num_Prio_Free = BENCH_PRIO_SLOTS;
+}
+
+/* Per neighbor queues of the former layout: a PQ node per queued
+ * message, a send queue node per source with something queued */
+typedef struct dummy_bench_old_link {
+    Bench_PQ_Node   head[BENCH_PRIO_SRCS + 1][BENCH_PRIO_LEVELS + 1];
+    Bench_PQ_Node  *tail[BENCH_PRIO_SRCS + 1][BENCH_PRIO_LEVELS + 1];
+    int             count[BENCH_PRIO_SRCS + 1];
+    Bench_SFQ_Node  sfq_head;
+    Bench_SFQ_Node *sfq_tail;
+} Bench_Old_Link;
+
+static void Old_Prio_Arrive(Bench_Old_Link *links, int src, int prio)
+{
+    Bench_Prio_Msg *msg = Prio_Msg_Get();
+    Bench_PQ_Node  *pq;
+    Bench_SFQ_Node *sfq;
+    Bench_Old_Link *l;
+    int             n;
+
+    msg->src_id = src;
+    msg->value.priority = prio;
+    msg->value.need_count = BENCH_PRIO_NGBRS - 1;
+    msg->old_ns = (Bench_Old_NS*) new(BENCH_OBJ_PRIO_NS);
+    msg->old_ns[1].flag = 0;
+    msg->old_ns[1].ngbr = NULL;
+
+    /* arrived from neighbor 1, queued toward the others */
+    for (n = 2; n <= BENCH_PRIO_NGBRS; n++) {
+        l = &links[n];
+        pq = (Bench_PQ_Node*) new(BENCH_OBJ_PRIO_PQ);
+        pq->entry = msg;
+        pq->next = NULL;
+        pq->prev = l->tail[src][prio];
+        l->tail[src][prio]->next = pq;
+        l->tail[src][prio] = pq;
+        msg->old_ns[n].flag = 1;
+        msg->old_ns[n].ngbr = pq;
+        if (l->count[src]++ == 0) {
+            sfq = (Bench_SFQ_Node*) new(BENCH_OBJ_PRIO_SFQ);
+            sfq->src_id = src;
+            sfq->penalty = 1;
+            sfq->next = NULL;
+            l->sfq_tail->next = sfq;
+            l->sfq_tail = sfq;
+        }
+    }
+}
+
+static void Old_Prio_Send(Bench_Old_Link *links, int n)
+{
+    Bench_Old_Link *l = &links[n];
+    Bench_SFQ_Node *sfq = l->sfq_head.next;
+    Bench_PQ_Node  *pq;
+    Bench_Prio_Msg *msg;
+    int             src, prio;
+
+    if (sfq == NULL)
+        return;
+    src = sfq->src_id;
+    for (prio = BENCH_PRIO_LEVELS; l->head[src][prio].next == NULL; prio--)
+        ;
+    pq = l->head[src][prio].next;
+    msg = pq->entry;
+
+    pq->prev->next = pq->next;
+    if (pq->next != NULL)
+        pq->next->prev = pq->prev;
+    else
+        l->tail[src][prio] = pq->prev;
+    dispose(pq);
+    msg->old_ns[n].ngbr = NULL;
+    if (--msg->value.need_count == 0) {
+        dispose(msg->old_ns);
+        Prio_Msg_Put(msg);
+    }
+
+    l->sfq_head.next = sfq->next;
+    if (l->sfq_tail == sfq)
+        l->sfq_tail = &l->sfq_head;
+    if (--l->count[src] == 0) {
+        dispose(sfq);
+    }
+    else {
+        sfq->next = NULL;
+        l->sfq_tail->next = sfq;
+        l->sfq_tail = sfq;
+    }
+}
+
+/* Queues the message the way Priority_Flood_Disseminate does */
+static void New_Prio_Arrive(Prio_Link_Data *links, int src, int prio)
+{
+    Bench_Prio_Msg *msg = Prio_Msg_Get();
+    int             n;
+
+    msg->value.priority = prio;
+    msg->value.need_count = BENCH_PRIO_NGBRS - 1;
+    msg->value.ns = msg->ns;
+    msg->ns[1].flag = RECV_MSG;
+
+    for (n = 2; n <= BENCH_PRIO_NGBRS; n++)
+        Prio_Queue_Message(&links[n], n, src, &msg->value, 1);
+}
+
+/* Sends one message the way Priority_Flood_Send_One does */
+static void New_Prio_Send(Prio_Link_Data *links, int n)
+{
+    Prio_Link_Data   *l = &links[n];
+    Prio_Flood_Value *fbv_ptr;
+    int32u            src;
+    int               urgent;
+
+    if ((src = Prio_Next_Source(l, &urgent)) == 0)
+        return;
+    fbv_ptr = l->pq[src].head[l->max_pq[src]];
+
+    Prio_Requeue_Source(l, src, urgent, 1);
+    Prio_Unqueue_Message(l, n, src, fbv_ptr, 1, ON_LINK_MSG);
+    if (--fbv_ptr->need_count == 0)
+        Prio_Msg_Put((Bench_Prio_Msg*) fbv_ptr);
+}
+
+/* Priority flooding store and forward: each op is one message arriving
+ * from neighbor 1 and one send toward each of the other 7 neighbors, with
+ * a backlog of 500 messages (Prio_MaxMessStored) queued on every link.
+ * "list" is the former layout (an NS array, a PQ node per neighbor and
+ * send queue nodes from the memory pools), "intrusive" runs the daemon's
+ * own queues (daemon/prio_queue.c), linked through the Belly entries */
+static void Bench_Prio_Queues(void)
+{
+    Bench_Old_Link *old_links;
+    Prio_Link_Data *links;
+    int             i, n, s, p;
+
+    Prio_Slots = (Bench_Prio_Msg*) calloc(BENCH_PRIO_SLOTS, sizeof(Bench_Prio_Msg));
+    Prio_Free = (int*) malloc(BENCH_PRIO_SLOTS * sizeof(int));
+    old_links = (Bench_Old_Link*) calloc(BENCH_PRIO_NGBRS + 1, sizeof(Bench_Old_Link));
+    links = (Prio_Link_Data*) malloc((BENCH_PRIO_NGBRS + 1) * sizeof(Prio_Link_Data));
+    if (Prio_Slots == NULL || Prio_Free == NULL || old_links == NULL || links == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    Rand_State = 0x9E3779B97F4A7C15ULL ^ (stduint64) Seed;
+    Prio_Slots_Reset();
+    for (n = 0; n <= BENCH_PRIO_NGBRS; n++) {
+        for (s = 0; s <= BENCH_PRIO_SRCS; s++) {
+            for (p = 0; p <= BENCH_PRIO_LEVELS; p++)
+                old_links[n].tail[s][p] = &old_links[n].head[s][p];
+        }
+        old_links[n].sfq_tail = &old_links[n].sfq_head;
+    }
+    for (i = 0; i < 500; i++)
+        Old_Prio_Arrive(old_links, 1 + Rand_Below(BENCH_PRIO_SRCS),
+                        1 + Rand_Below(BENCH_PRIO_LEVELS));
+    if (Bench_Begin("prio_queue_list")) {
+        for (i = 0; i < Num_Ops; i++) {
+            Old_Prio_Arrive(old_links, 1 + Rand_Below(BENCH_PRIO_SRCS),
+                            1 + Rand_Below(BENCH_PRIO_LEVELS));
+            for (n = 2; n <= BENCH_PRIO_NGBRS; n++)
+                Old_Prio_Send(old_links, n);
+        }
+        Bench_End(Num_Ops);
+    }
+    for (i = 0; i < 500; i++) {
+        for (n = 2; n <= BENCH_PRIO_NGBRS; n++)
+            Old_Prio_Send(old_links, n);
+    }
+
+    Rand_State = 0x9E3779B97F4A7C15ULL ^ (stduint64) Seed;
+    Prio_Slots_Reset();
+    for (n = 0; n <= BENCH_PRIO_NGBRS; n++)
+        Prio_Link_Init(&links[n]);
+    for (i = 0; i < 500; i++)
+        New_Prio_Arrive(links, 1 + Rand_Below(BENCH_PRIO_SRCS),
+                        1 + Rand_Below(BENCH_PRIO_LEVELS));
+    if (Bench_Begin("prio_queue_intrusive")) {
+        for (i = 0; i < Num_Ops; i++) {
+            New_Prio_Arrive(links, 1 + Rand_Below(BENCH_PRIO_SRCS),
+                            1 + Rand_Below(BENCH_PRIO_LEVELS));
+            for (n = 2; n <= BENCH_PRIO_NGBRS; n++)
+                New_Prio_Send(links, n);
+        }
+        Bench_End(Num_Ops);
+    }
+
+    free(Prio_Slots);
+    free(Prio_Free);
+    free(old_links);
+    free(links);
+}
+
+/* Same logic as the former check in Source_Based_Disseminate */
+static int Dedup_Hist_Check(Bench_Seq_Pair (*hist)[BENCH_DEDUP_HIST],
+                            const Bench_Dedup_Pkt *p)
+{
+    Bench_Seq_Pair *prev = &hist[p->src][p->seq % BENCH_DEDUP_HIST];
+
+    if (prev->seq == p->seq && prev->incarnation == p->incarnation)
+        return SOURCE_DEDUP_DUP;
+    if (prev->incarnation > p->incarnation ||
+        (prev->seq > p->seq && prev->incarnation == p->incarnation))
+        return SOURCE_DEDUP_OLD;
+    prev->seq = p->seq;
+    prev->incarnation = p->incarnation;
+    return SOURCE_DEDUP_OK;
+}
+
+/* Fills pkts with traffic from BENCH_DEDUP_SRCS sources whose seqs start
+ * at first_seq: each new packet is followed by copies arriving over
+ * other paths, 1 in 256 packets is a stale copy from more than a window
+ * back, and everything is reordered by up to 64 positions.  A source
+ * whose seq wraps moves to the next incarnation, as in
+ * Session_Route_Message */
+static void Dedup_Trace(Bench_Dedup_Pkt *pkts, int n, int32u first_seq)
+{
+    int32u    next_seq[BENCH_DEDUP_SRCS + 1], inc[BENCH_DEDUP_SRCS + 1];
+    Bench_Dedup_Pkt tmp;
+    int       i, j, src;
+
+    for (src = 1; src <= BENCH_DEDUP_SRCS; src++) {
+        next_seq[src] = first_seq;
+        inc[src] = 1000;
+    }
+
+    for (i = 0; i < n; i++) {
+        src = 1 + Rand_Below(BENCH_DEDUP_SRCS);
+        pkts[i].src = src;
+        pkts[i].incarnation = inc[src];
+        if (next_seq[src] - first_seq > 64 && Rand_Below(2) == 0) {
+            pkts[i].seq = next_seq[src] - 1 - Rand_Below(64);
+        }
+        else if (next_seq[src] - first_seq > BENCH_DEDUP_WINDOW + 1024 &&
+                 Rand_Below(256) == 0) {
+            pkts[i].seq = next_seq[src] - BENCH_DEDUP_WINDOW - Rand_Below(1024);
+        }
+        else {
+            pkts[i].seq = next_seq[src]++;
+            if (next_seq[src] == 0) {
+                next_seq[src] = 1;
+                inc[src]++;
+            }
+        }
+        /* Copies from before a wrap keep their old incarnation */
+        if (pkts[i].seq >= next_seq[src] && next_seq[src] < 1024)
+            pkts[i].incarnation--;
+    }
+
+    for (i = 0; i < n; i++) {
+        j = i + Rand_Below(64);
+        if (j >= n)
+            j = n - 1;
+        tmp = pkts[i];
+        pkts[i] = pkts[j];
+        pkts[j] = tmp;
+    }
+}
+
+/* Checks the sliding windows against an exact record of every packet
+ * seen, under reordering, stale copies and seq wraparound; exits on any
+ * disagreement */
+static void Dedup_Verify(void)
+{
+    int32u          max_inc[BENCH_DEDUP_SRCS + 1], max_seq[BENCH_DEDUP_SRCS + 1];
+    Bench_Dedup_Pkt *pkts;
+    stdhash         seen;
+    stdit           it;
+    stduint64       key;
+    int             n = 400000, i, src, expect, got, counts[3] = {0, 0, 0};
+
+    pkts = (Bench_Dedup_Pkt*) malloc(n * sizeof(Bench_Dedup_Pkt));
+    if (pkts == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+    /* Every source wraps about a third of the way through */
+    Dedup_Trace(pkts, n, 0xFFFFFFFF - 1500);
+
+    stdhash_construct(&seen, sizeof(stduint64), 0, NULL, NULL, 0);
+    Source_Dedup_Init(BENCH_DEDUP_WINDOW);
+    for (src = 0; src <= BENCH_DEDUP_SRCS; src++) {
+        max_inc[src] = 0;
+        max_seq[src] = 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        src = pkts[i].src;
+        key = ((stduint64) src << 48) ^ ((stduint64) pkts[i].incarnation << 32) ^ pkts[i].seq;
+        if (pkts[i].incarnation < max_inc[src]) {
+            expect = SOURCE_DEDUP_OLD;
+        }
+        else if (pkts[i].incarnation > max_inc[src]) {
+            max_inc[src] = pkts[i].incarnation;
+            max_seq[src] = pkts[i].seq;
+            expect = SOURCE_DEDUP_OK;
+        }
+        else if ((stduint64) pkts[i].seq + BENCH_DEDUP_WINDOW <= max_seq[src]) {
+            expect = SOURCE_DEDUP_OLD;
+        }
+        else if (!stdhash_is_end(&seen, stdhash_find(&seen, &it, &key))) {
+            expect = SOURCE_DEDUP_DUP;
+        }
+        else {
+            expect = SOURCE_DEDUP_OK;
+        }
+        if (expect == SOURCE_DEDUP_OK) {
+            stdhash_insert(&seen, &it, &key, NULL);
+            if (pkts[i].seq > max_seq[src])
+                max_seq[src] = pkts[i].seq;
+        }
+
+        got = Source_Dedup_Check(src, pkts[i].incarnation, pkts[i].seq);
+        if (got != expect)
+            Alarm(EXIT, "sp_microbench: source dedup window wrong at packet %d "
+                  "(src %u, incarnation %u, seq %u): got %d, expected %d\n",
+                  i, src, pkts[i].incarnation, pkts[i].seq, got, expect);
+        counts[got]++;
+    }
+    Alarm(PRINT, "sp_microbench: source dedup window verified on %d packets "
+          "(%d new, %d duplicate, %d old)\n", n, counts[SOURCE_DEDUP_OK],
+          counts[SOURCE_DEDUP_DUP], counts[SOURCE_DEDUP_OLD]);
+
+    stdhash_destruct(&seen);
+    free(pkts);
+}
+
+/* Source based routing duplicate detection on every forwarded packet:
+ * "hist" is the former table of (seq, incarnation) pairs indexed by
+ * seq % 100000 (40 MB for MAX_NODES = 50), "window" the daemon's
+ * per-source sliding window bitmaps (daemon/source_dedup.c, 8 KB each) */
+static void Bench_Source_Dedup(void)
+{
+    Bench_Seq_Pair     (*hist)[BENCH_DEDUP_HIST];
+    Bench_Dedup_Pkt   *pkts;
+    int                i, found;
+
+    /* Skip the 40 MB table and the verification if filtered out */
+    if (Filter[0] != '\0' && strstr("source_dedup_hist", Filter) == NULL &&
+        strstr("source_dedup_window", Filter) == NULL)
+        return;
+    Dedup_Verify();
+
+    hist = (Bench_Seq_Pair (*)[BENCH_DEDUP_HIST])
+               calloc(BENCH_DEDUP_SRCS + 1, sizeof(*hist));
+    pkts = (Bench_Dedup_Pkt*) malloc(Num_Ops * sizeof(Bench_Dedup_Pkt));
+    if (hist == NULL || pkts == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+    Source_Dedup_Init(BENCH_DEDUP_WINDOW);
+    Dedup_Trace(pkts, Num_Ops, 1);
+
+    if (Bench_Begin("source_dedup_hist")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++)
+            found += Dedup_Hist_Check(hist, &pkts[i]) == SOURCE_DEDUP_OK;
+        Bench_End(Num_Ops);
+        Sink += found;
+    }
+
+    if (Bench_Begin("source_dedup_window")) {
+        found = 0;
+        for (i = 0; i < Num_Ops; i++)
+            found += Source_Dedup_Check(pkts[i].src, pkts[i].incarnation,
+                                        pkts[i].seq) == SOURCE_DEDUP_OK;
+        Bench_End(Num_Ops);
+        Sink += found;
+    }
+
+    free(hist);
+    free(pkts);
+}
+
+/* Signed flooding packets: the daemon hashes the packet with SHA-256
+ * (EVP_SignInit / EVP_SignUpdate over the scatter) and Sec_sign_final /
+ * Sec_verify_final sign that digest with RSA or Ed25519.  A forwarding
+ * node verifies every packet, so *_verify is the per-hop cost */
+#define BENCH_SIG_PKT_SIZE  1400
+
+static EVP_PKEY *Sig_Keygen(int type)
+{
+    EVP_PKEY_CTX *pctx;
+    EVP_PKEY     *key = NULL;
+
+    if ((pctx = EVP_PKEY_CTX_new_id(type, NULL)) == NULL ||
+        EVP_PKEY_keygen_init(pctx) != 1 ||
+        (type == EVP_PKEY_RSA && EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 1024) != 1) ||
+        EVP_PKEY_keygen(pctx, &key) != 1)
+        Alarm(EXIT, "sp_microbench: key generation failed\n");
+    EVP_PKEY_CTX_free(pctx);
+    return key;
+}
+
+static int Sig_Sign_Pkt(EVP_MD_CTX *md_ctx, const unsigned char *pkt, unsigned char *sig,
+                        unsigned int *sig_len, EVP_PKEY *key)
+{
+    return EVP_SignInit(md_ctx, EVP_sha256()) == 1 &&
+           EVP_SignUpdate(md_ctx, pkt, BENCH_SIG_PKT_SIZE) == 1 &&
+           Sec_sign_final(md_ctx, sig, sig_len, key) == 1;
+}
+
+static int Sig_Verify_Pkt(EVP_MD_CTX *md_ctx, const unsigned char *pkt, const unsigned char *sig,
+                          unsigned int sig_len, EVP_PKEY *key)
+{
+    return EVP_VerifyInit(md_ctx, EVP_sha256()) == 1 &&
+           EVP_VerifyUpdate(md_ctx, pkt, BENCH_SIG_PKT_SIZE) == 1 &&
+           Sec_verify_final(md_ctx, sig, sig_len, key) == 1;
+}
+
+/* RSA signatures must stay byte for byte what EVP_SignFinal produced (and
+ * verify with EVP_VerifyFinal), so nodes that have not been updated keep
+ * accepting them; both schemes must reject a corrupted packet */
+static void Sig_Verify_Schemes(EVP_PKEY *rsa, EVP_PKEY *ed, EVP_PKEY *ed2, const unsigned char *pkt,
+                               EVP_MD_CTX *md_ctx)
+{
+    unsigned char  sig[512], ref[512], bad[BENCH_SIG_PKT_SIZE];
+    unsigned int   sig_len, ref_len;
+
+    if (!Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, rsa) ||
+        EVP_SignInit(md_ctx, EVP_sha256()) != 1 ||
+        EVP_SignUpdate(md_ctx, pkt, BENCH_SIG_PKT_SIZE) != 1 ||
+        EVP_SignFinal(md_ctx, ref, &ref_len, rsa) != 1 ||
+        sig_len != ref_len || memcmp(sig, ref, sig_len) != 0)
+        Alarm(EXIT, "Sig_Verify_Schemes: RSA signature differs from EVP_SignFinal\n");
+    if (EVP_VerifyInit(md_ctx, EVP_sha256()) != 1 ||
+        EVP_VerifyUpdate(md_ctx, pkt, BENCH_SIG_PKT_SIZE) != 1 ||
+        EVP_VerifyFinal(md_ctx, sig, sig_len, rsa) != 1 ||
+        !Sig_Verify_Pkt(md_ctx, pkt, sig, sig_len, rsa))
+        Alarm(EXIT, "Sig_Verify_Schemes: RSA signature does not verify\n");
+
+    memcpy(bad, pkt, BENCH_SIG_PKT_SIZE);
+    bad[BENCH_SIG_PKT_SIZE / 2] ^= 1;
+    if (Sig_Verify_Pkt(md_ctx, bad, sig, sig_len, rsa))
+        Alarm(EXIT, "Sig_Verify_Schemes: RSA accepted a corrupted packet\n");
+
+    if (!Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, ed) || sig_len != 64 ||
+        !Sig_Verify_Pkt(md_ctx, pkt, sig, sig_len, ed))
+        Alarm(EXIT, "Sig_Verify_Schemes: Ed25519 signature does not verify\n");
+    if (Sig_Verify_Pkt(md_ctx, bad, sig, sig_len, ed))
+        Alarm(EXIT, "Sig_Verify_Schemes: Ed25519 accepted a corrupted packet\n");
+
+    /* A node signs with its own key and verifies with everyone else's on
+     * the same context */
+    if (!Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, ed2) ||
+        !Sig_Verify_Pkt(md_ctx, pkt, sig, sig_len, ed2) ||
+        Sig_Verify_Pkt(md_ctx, pkt, sig, sig_len, ed))
+        Alarm(EXIT, "Sig_Verify_Schemes: Ed25519 context kept a previous key\n");
+}
+
+/* Batch signing (Prio_SignatureBatchUSec): a source signs only the
+ * Merkle root of up to BENCH_SIG_BATCH messages, a forwarder checks each
+ * message's path and verifies each root once */
+#define BENCH_SIG_BATCH     32
+#define BENCH_SIG_DEPTH     5
+
+/* Hashes a packet into a Merkle leaf the way Priority_Flood_Batch_Add
+ * does */
+static void Merkle_Leaf(EVP_MD_CTX *md_ctx, const unsigned char *pkt, unsigned char *leaf)
+{
+    if (EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(md_ctx, pkt, BENCH_SIG_PKT_SIZE) != 1 ||
+        Sec_merkle_leaf(md_ctx, leaf) != 1)
+        Alarm(EXIT, "Merkle_Leaf: hashing failed\n");
+}
+
+/* Reference interior node, written out from the tree's definition: the
+ * SHA-256 of 0x01, the left child and the right child */
+static void Merkle_Ref_Node(const unsigned char *left, const unsigned char *right, unsigned char *parent)
+{
+    unsigned char buf[1 + 2 * SEC_MERKLE_HASH_LEN];
+
+    buf[0] = 0x01;
+    memcpy(buf + 1, left, SEC_MERKLE_HASH_LEN);
+    memcpy(buf + 1 + SEC_MERKLE_HASH_LEN, right, SEC_MERKLE_HASH_LEN);
+    SHA256(buf, sizeof(buf), parent);
+}
+
+/* Checks the daemon's Sec_merkle_* (daemon/security.c): leaves are the
+ * SHA-256 of 0x00 and the packet digest, an odd node out is paired with
+ * itself (checked by hand for 3 and 5 leaves), every path is
+ * ceil(log2(n)) siblings deep starting with the leaf's own sibling, and
+ * every leaf of every batch size recomputes the root from its path while
+ * a changed leaf, path hash or index does not */
+static void Merkle_Verify(EVP_MD_CTX *md_ctx, unsigned char *pkt)
+{
+    unsigned char tree[2 * BENCH_SIG_BATCH][SEC_MERKLE_HASH_LEN];
+    unsigned char path[BENCH_SIG_DEPTH * SEC_MERKLE_HASH_LEN];
+    unsigned char root[SEC_MERKLE_HASH_LEN], check[SEC_MERKLE_HASH_LEN];
+    unsigned char ref[4][SEC_MERKLE_HASH_LEN], buf[1 + SHA256_DIGEST_LENGTH];
+    int           n, i, depth, sibling;
+
+    for (i = 0; i < 5; i++) {
+        pkt[0] = (unsigned char) i;
+        Merkle_Leaf(md_ctx, pkt, tree[i]);
+    }
+
+    buf[0] = 0x00;
+    SHA256(pkt, BENCH_SIG_PKT_SIZE, buf + 1);
+    SHA256(buf, sizeof(buf), check);
+    if (memcmp(check, tree[4], SEC_MERKLE_HASH_LEN) != 0)
+        Alarm(EXIT, "Merkle_Verify: Sec_merkle_leaf is not SHA-256(0x00 | digest)\n");
+
+    /* 3 leaves: H(H(l0, l1), H(l2, l2)) */
+    Merkle_Ref_Node(tree[0], tree[1], ref[0]);
+    Merkle_Ref_Node(tree[2], tree[2], ref[1]);
+    Merkle_Ref_Node(ref[0], ref[1], ref[2]);
+    if (Sec_merkle_build(tree, 3, root) != 2 || memcmp(root, ref[2], SEC_MERKLE_HASH_LEN) != 0)
+        Alarm(EXIT, "Merkle_Verify: wrong root for 3 leaves\n");
+
+    /* 5 leaves: H(H(H(l0, l1), H(l2, l3)), H(H(l4, l4), H(l4, l4))) */
+    Merkle_Ref_Node(tree[2], tree[3], ref[1]);
+    Merkle_Ref_Node(ref[0], ref[1], ref[2]);
+    Merkle_Ref_Node(tree[4], tree[4], ref[3]);
+    Merkle_Ref_Node(ref[3], ref[3], ref[3]);
+    Merkle_Ref_Node(ref[2], ref[3], ref[2]);
+    if (Sec_merkle_build(tree, 5, root) != 3 || memcmp(root, ref[2], SEC_MERKLE_HASH_LEN) != 0)
+        Alarm(EXIT, "Merkle_Verify: wrong root for 5 leaves\n");
+
+    for (n = 1; n <= BENCH_SIG_BATCH; n++) {
+        for (i = 0; i < n; i++) {
+            pkt[0] = (unsigned char) i;
+            Merkle_Leaf(md_ctx, pkt, tree[i]);
+        }
+        Sec_merkle_build(tree, n, root);
+        for (i = 0; i < n; i++) {
+            depth = Sec_merkle_path(tree, n, i, path);
+            if (depth > BENCH_SIG_DEPTH || (1 << depth) < n || (depth > 0 && (1 << (depth - 1)) >= n))
+                Alarm(EXIT, "Merkle_Verify: bad depth %d for %d of %d\n", depth, i, n);
+            sibling = (i ^ 1) < n ? i ^ 1 : i;
+            if (depth > 0 && memcmp(path, tree[sibling], SEC_MERKLE_HASH_LEN) != 0)
+                Alarm(EXIT, "Merkle_Verify: path of %d of %d does not start at its sibling\n", i, n);
+            Sec_merkle_root(tree[i], i, depth, path, check);
+            if (memcmp(check, root, SEC_MERKLE_HASH_LEN) != 0)
+                Alarm(EXIT, "Merkle_Verify: leaf %d of %d misses the root\n", i, n);
+            if (n == 1)
+                continue;
+            Sec_merkle_root(tree[(i + 1) % n], i, depth, path, check);
+            if (memcmp(check, root, SEC_MERKLE_HASH_LEN) == 0)
+                Alarm(EXIT, "Merkle_Verify: wrong leaf reaches the root\n");
+            Sec_merkle_root(tree[i], i ^ 1, depth, path, check);
+            if ((i ^ 1) < n && memcmp(check, root, SEC_MERKLE_HASH_LEN) == 0 &&
+                memcmp(tree[i], tree[i ^ 1], SEC_MERKLE_HASH_LEN) != 0)
+                Alarm(EXIT, "Merkle_Verify: wrong index reaches the root\n");
+            path[depth * SEC_MERKLE_HASH_LEN - 1] ^= 1;
+            Sec_merkle_root(tree[i], i, depth, path, check);
+            if (memcmp(check, root, SEC_MERKLE_HASH_LEN) == 0)
+                Alarm(EXIT, "Merkle_Verify: changed path reaches the root\n");
+        }
+    }
+}
+
+/* Per message cost of batches of BENCH_SIG_BATCH: the source hashes
+ * every message and signs one root per batch; a forwarder walks every
+ * path and verifies the first root of each batch (the cache holds the
+ * root for the rest) */
+static void Bench_Batch_Signatures(const char *sign_name, const char *verify_name, EVP_PKEY *key,
+                                   unsigned char *pkt, EVP_MD_CTX *md_ctx, int ops)
+{
+    unsigned char tree[2 * BENCH_SIG_BATCH][SEC_MERKLE_HASH_LEN];
+    unsigned char paths[BENCH_SIG_BATCH][BENCH_SIG_DEPTH * SEC_MERKLE_HASH_LEN];
+    unsigned char root[SEC_MERKLE_HASH_LEN], check[SEC_MERKLE_HASH_LEN], leaf[SEC_MERKLE_HASH_LEN];
+    unsigned char cached[SEC_MERKLE_HASH_LEN], sig[512];
+    unsigned int  sig_len = 0;
+    int           i, j, depth = 0, ok;
+
+    if (Bench_Begin(sign_name)) {
+        ok = 0;
+        for (i = 0; i < ops; i++) {
+            j = i % BENCH_SIG_BATCH;
+            pkt[0] = (unsigned char) j;
+            Merkle_Leaf(md_ctx, pkt, tree[j]);
+            if (j == BENCH_SIG_BATCH - 1 || i == ops - 1) {
+                Sec_merkle_build(tree, j + 1, root);
+                ok += Sec_sign_root(root, sig, &sig_len, key);
+                for (j = 0; j <= i % BENCH_SIG_BATCH; j++)
+                    depth = Sec_merkle_path(tree, i % BENCH_SIG_BATCH + 1, j, paths[j]);
+            }
+        }
+        Bench_End(ops);
+        Sink += ok + depth;
+    }
+
+    for (j = 0; j < BENCH_SIG_BATCH; j++) {
+        pkt[0] = (unsigned char) j;
+        Merkle_Leaf(md_ctx, pkt, tree[j]);
+    }
+    Sec_merkle_build(tree, BENCH_SIG_BATCH, root);
+    for (j = 0; j < BENCH_SIG_BATCH; j++)
+        depth = Sec_merkle_path(tree, BENCH_SIG_BATCH, j, paths[j]);
+    if (!Sec_sign_root(root, sig, &sig_len, key))
+        Alarm(EXIT, "Bench_Batch_Signatures: sign failed\n");
+
+    if (Bench_Begin(verify_name)) {
+        ok = 0;
+        for (i = 0; i < ops; i++) {
+            j = i % BENCH_SIG_BATCH;
+            if (j == 0)
+                memset(cached, 0, sizeof(cached));
+            pkt[0] = (unsigned char) j;
+            Merkle_Leaf(md_ctx, pkt, leaf);
+            Sec_merkle_root(leaf, j, depth, paths[j], check);
+            if (memcmp(check, cached, SEC_MERKLE_HASH_LEN) == 0) {
+                ok++;
+            } else if (Sec_verify_root(check, sig, sig_len, key) == 1) {
+                memcpy(cached, check, SEC_MERKLE_HASH_LEN);
+                ok++;
+            }
+        }
+        Bench_End(ops);
+        if (ok != ops)
+            Alarm(EXIT, "Bench_Batch_Signatures: %d of %d messages did not verify\n", ops - ok, ops);
+        Sink += ok;
+    }
+}
+
+static void Bench_Signatures(void)
+{
+    static const char *names[2][4] = { { "sig_rsa1024_sign", "sig_rsa1024_verify",
+                                         "sig_rsa1024_batch_sign", "sig_rsa1024_batch_verify" },
+                                       { "sig_ed25519_sign", "sig_ed25519_verify",
+                                         "sig_ed25519_batch_sign", "sig_ed25519_batch_verify" } };
+    unsigned char  pkt[BENCH_SIG_PKT_SIZE], sig[512];
+    unsigned int   sig_len;
+    EVP_MD_CTX    *md_ctx;
+    EVP_PKEY      *keys[2], *ed2;
+    int            i, k, ok, ops;
+
+    /* Skip the key generation if filtered out */
+    if (Filter[0] != '\0' && strstr("sig_rsa1024_sign sig_rsa1024_verify "
+                                    "sig_rsa1024_batch_sign sig_rsa1024_batch_verify "
+                                    "sig_ed25519_sign sig_ed25519_verify "
+                                    "sig_ed25519_batch_sign sig_ed25519_batch_verify", Filter) == NULL)
+        return;
+
+    /* Public key operations are ~1000x a hash table op */
+    ops = Num_Ops / 1000 > 100 ? Num_Ops / 1000 : 100;
+    for (i = 0; i < BENCH_SIG_PKT_SIZE; i++)
+        pkt[i] = (unsigned char) Rand64();
+    md_ctx = EVP_MD_CTX_new();
+    keys[0] = Sig_Keygen(EVP_PKEY_RSA);
+    keys[1] = Sig_Keygen(EVP_PKEY_ED25519);
+    if (md_ctx == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+    ed2 = Sig_Keygen(EVP_PKEY_ED25519);
+    Sig_Verify_Schemes(keys[0], keys[1], ed2, pkt, md_ctx);
+    EVP_PKEY_free(ed2);
+    Merkle_Verify(md_ctx, pkt);
+
+    for (k = 0; k < 2; k++) {
+        if (!Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, keys[k]))
+            Alarm(EXIT, "Bench_Signatures: sign failed\n");
+
+        if (Bench_Begin(names[k][0])) {
+            ok = 0;
+            for (i = 0; i < ops; i++) {
+                pkt[0] = (unsigned char) i;
+                ok += Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, keys[k]);
+            }
+            Bench_End(ops);
+            Sink += ok;
+        }
+
+        pkt[0] = (unsigned char) (ops - 1);
+        Sig_Sign_Pkt(md_ctx, pkt, sig, &sig_len, keys[k]);
+        if (Bench_Begin(names[k][1])) {
+            ok = 0;
+            for (i = 0; i < ops; i++)
+                ok += Sig_Verify_Pkt(md_ctx, pkt, sig, sig_len, keys[k]);
+            Bench_End(ops);
+            Sink += ok;
+        }
+
+        Bench_Batch_Signatures(names[k][2], names[k][3], keys[k], pkt, md_ctx, ops);
+    }
+
+    EVP_PKEY_free(keys[0]);
+    EVP_PKEY_free(keys[1]);
+    EVP_MD_CTX_free(md_ctx);
+}
+
+/* K node-disjoint paths (daemon/multipath.c) on random overlays: every
+ * node is split into an inbound and an outbound flow node joined by a
+ * capacity 1 edge, and every undirected link becomes a capacity 1 edge
+ * each way, each with its residual twin.  "bf" is the former
+ * Ford-Fulkerson with a Bellman-Ford pass per path, "dijkstra" the
+ * daemon's successive shortest paths with Johnson potentials
+ * (daemon/flow_paths.c), and "batch" the same sharing one shortest path
+ * tree across all destinations.  One op
+ * is recomputing k = 2 paths to one destination */
+#define BENCH_MP_DEGREE     4
+#define BENCH_MP_K          2
+#define BENCH_MP_MAX_COST   100
+
+/* A flow graph for daemon/flow_paths.c, with the cost of every edge kept
+ * beside it (negated on residual edges) */
+typedef struct dummy_bench_mp_graph {
+    Flow_Graph      fg;
+    int             num_nodes;  /* Real nodes 1..num_nodes */
+    int             num_links;
+    Flow_Node      *inbound;
+    Flow_Node      *outbound;
+    Flow_Edge      *edges;
+    int32          *costs;      /* Cost of edges[i] */
+} Bench_MP_Graph;
+
+static int MP_Edge_Cost(Flow_Edge *e, void *cost_arg, int32 *ret_cost)
+{
+    Bench_MP_Graph *g = (Bench_MP_Graph*) cost_arg;
+
+    *ret_cost = g->costs[e - g->edges];
+    return 1;
+}
+
+static Flow_Edge *MP_Add_Edge(Bench_MP_Graph *g, Flow_Node *a, Flow_Node *b,
+                              int32 cost, int16u index)
+{
+    Flow_Edge *real = &g->edges[g->num_links++];
+    Flow_Edge *resid = &g->edges[g->num_links++];
+
+    real->flow = 0;
+    real->capacity = 1;
+    real->index = index;
+    real->residual = 0;
+    real->start = a;
+    real->end = b;
+    real->twin = resid;
+    real->next = g->fg.edges;
+    g->costs[real - g->edges] = cost;
+    a->outgoing[a->outgoing_num++] = real;
+
+    resid->flow = 1;
+    resid->capacity = 1;
+    resid->index = USHRT_MAX;
+    resid->residual = 1;
+    resid->start = b;
+    resid->end = a;
+    resid->twin = real;
+    resid->next = real;
+    g->costs[resid - g->edges] = -cost;
+    b->outgoing[b->outgoing_num++] = resid;
+
+    g->fg.edges = resid;
+    return real;
+}
+
+/* A ring (so every node is reachable) plus BENCH_MP_DEGREE - 2 random
+ * chords per node, with random costs */
+static void MP_Graph_Init(Bench_MP_Graph *g, int n)
+{
+    int  i, j, a, b, max_links = n * BENCH_MP_DEGREE / 2, links = 0;
+    int *ends;
+
+    g->num_nodes = n;
+    g->num_links = 0;
+    g->inbound = (Flow_Node*) calloc(n + 1, sizeof(Flow_Node));
+    g->outbound = (Flow_Node*) calloc(n + 1, sizeof(Flow_Node));
+    g->edges = (Flow_Edge*) calloc(2 * (n + 2 * max_links), sizeof(Flow_Edge));
+    g->costs = (int32*) calloc(2 * (n + 2 * max_links), sizeof(int32));
+    g->fg.inbound = (Flow_Node**) calloc(n + 1, sizeof(Flow_Node*));
+    g->fg.outbound = (Flow_Node**) calloc(n + 1, sizeof(Flow_Node*));
+    g->fg.max_id = n;
+    g->fg.src_id = 1;
+    g->fg.edges = NULL;
+    g->fg.heap = (Flow_Node**) calloc(2 * n + 1, sizeof(Flow_Node*));
+    g->fg.heap_size = 0;
+    g->fg.edge_cost = MP_Edge_Cost;
+    g->fg.cost_arg = g;
+    ends = (int*) malloc(2 * max_links * sizeof(int));
+    if (g->inbound == NULL || g->outbound == NULL || g->edges == NULL ||
+        g->costs == NULL || g->fg.inbound == NULL || g->fg.outbound == NULL ||
+        g->fg.heap == NULL || ends == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    for (i = 1; i <= n; i++) {
+        a = i;
+        b = i % n + 1;
+        ends[2 * links] = a;
+        ends[2 * links + 1] = b;
+        links++;
+    }
+    while (links < max_links) {
+        a = 1 + Rand_Below(n);
+        b = 1 + Rand_Below(n);
+        for (j = 0; j < links; j++)
+            if ((ends[2 * j] == a && ends[2 * j + 1] == b) ||
+                (ends[2 * j] == b && ends[2 * j + 1] == a))
+                break;
+        if (a == b || j < links)
+            continue;
+        ends[2 * links] = a;
+        ends[2 * links + 1] = b;
+        links++;
+    }
+
+    for (i = 1; i <= n; i++) {
+        g->fg.inbound[i] = &g->inbound[i];
+        g->fg.outbound[i] = &g->outbound[i];
+        g->inbound[i].inbound_node = 1;
+        g->inbound[i].twin = &g->outbound[i];
+        g->outbound[i].twin = &g->inbound[i];
+        g->inbound[i].outgoing = (Flow_Edge**) calloc(n + 1, sizeof(Flow_Edge*));
+        g->outbound[i].outgoing = (Flow_Edge**) calloc(n + 1, sizeof(Flow_Edge*));
+        if (g->inbound[i].outgoing == NULL || g->outbound[i].outgoing == NULL)
+            Alarm(EXIT, "sp_microbench: out of memory\n");
+        MP_Add_Edge(g, &g->inbound[i], &g->outbound[i], 0, USHRT_MAX);
+    }
+    for (j = 0; j < links; j++) {
+        a = ends[2 * j];
+        b = ends[2 * j + 1];
+        i = 1 + Rand_Below(BENCH_MP_MAX_COST);
+        MP_Add_Edge(g, &g->outbound[a], &g->inbound[b], i, j);
+        MP_Add_Edge(g, &g->outbound[b], &g->inbound[a], i, j);
+    }
+    free(ends);
+}
+
+static void MP_Graph_Finish(Bench_MP_Graph *g)
+{
+    int i;
+
+    for (i = 1; i <= g->num_nodes; i++) {
+        free(g->inbound[i].outgoing);
+        free(g->outbound[i].outgoing);
+    }
+    free(g->inbound);
+    free(g->outbound);
+    free(g->edges);
+    free(g->costs);
+    free(g->fg.inbound);
+    free(g->fg.outbound);
+    free(g->fg.heap);
+}
+
+/* The paths are the real edges carrying flow; returns their total cost */
+static long MP_Flow_Cost(Bench_MP_Graph *g)
+{
+    Flow_Edge *e;
+    long cost = 0;
+
+    for (e = g->fg.edges; e != NULL; e = e->next)
+        if (e->residual == 0 && e->flow == e->capacity)
+            cost += g->costs[e - g->edges];
+    return cost;
+}
+
+/* Same logic as the former MultiPath_Compute (Bellman-Ford relaxing every
+ * edge until nothing improves, the chosen edges kept in a hash), the
+ * reference the daemon's solver is checked against */
+static int MP_Compute_BF(Bench_MP_Graph *g, int src, int dst, int k)
+{
+    Flow_Node *t, *s = &g->outbound[src];
+    Flow_Edge *e;
+    stdhash    bag_of_edges;
+    stdit      it;
+    int32      cost;
+    int        i, path_index, progress = 0;
+
+    for (e = g->fg.edges; e != NULL; e = e->next)
+        e->flow = e->residual ? e->capacity : 0;
+    stdhash_construct(&bag_of_edges, sizeof(Flow_Edge*), 0, NULL, NULL, 0);
+
+    for (path_index = 1; path_index <= k; path_index++) {
+        for (i = 1; i <= g->num_nodes; i++) {
+            g->inbound[i].previous_edge = NULL;
+            g->inbound[i].distance = USHRT_MAX;
+            g->outbound[i].previous_edge = NULL;
+            g->outbound[i].distance = USHRT_MAX;
+        }
+        s->distance = 0;
+
+        for (i = 1; i <= g->num_nodes * 2 + 1; i++) {
+            progress = 0;
+            for (e = g->fg.edges; e != NULL; e = e->next) {
+                cost = g->costs[e - g->edges];
+                if (e->flow < e->capacity &&
+                    e->end->distance > e->start->distance + cost) {
+                    e->end->distance = e->start->distance + cost;
+                    e->end->previous_edge = e;
+                    progress = 1;
+                }
+            }
+            if (progress == 0)
+                break;
+        }
+        if (progress == 1)
+            Alarm(EXIT, "MP_Compute_BF: Negative Cycle Found\n");
+
+        if (g->inbound[dst].distance == USHRT_MAX)
+            break;
+
+        for (t = &g->inbound[dst]; t != s; t = t->previous_edge->start) {
+            if (t->previous_edge->residual == 1) {
+                stdhash_find(&bag_of_edges, &it, &(t->previous_edge->twin));
+                stdhash_erase(&bag_of_edges, &it);
+            }
+            else
+                stdhash_insert(&bag_of_edges, &it, &(t->previous_edge), 0);
+            t->previous_edge->flow = t->previous_edge->capacity;
+            t->previous_edge->twin->flow = 0;
+        }
+    }
+
+    Sink += stdhash_size(&bag_of_edges);
+    stdhash_destruct(&bag_of_edges);
+    return path_index - 1;
+}
+
+/* The daemon's MultiPath_Compute, from src */
+static int MP_Compute_Dijkstra(Bench_MP_Graph *g, int src, int dst, int k)
+{
+    g->fg.src_id = src;
+    return Flow_Compute_Paths(&g->fg, dst, k);
+}
+
+/* The daemon's MultiPath_Compute_Batch for every destination but src;
+ * paths[dst] and costs[dst] get the results */
+static void MP_Compute_Batch(Bench_MP_Graph *g, int src, int k, int *paths, long *costs)
+{
+    int dst;
+
+    g->fg.src_id = src;
+    Flow_Compute_Tree(&g->fg);
+    for (dst = 1; dst <= g->num_nodes; dst++) {
+        if (dst == src)
+            continue;
+        paths[dst] = Flow_Compute_Tree_Paths(&g->fg, dst, k);
+        costs[dst] = MP_Flow_Cost(g);
+    }
+}
+
+/* Checks that the three computations find the same number of paths at
+ * the same total cost for every pair of sources and destinations and
+ * every k; exits on any disagreement */
+static void MP_Verify(Bench_MP_Graph *g)
+{
+    int  *paths;
+    long *costs, bf_cost;
+    int   src, dst, k, bf_paths, dj_paths, checked = 0;
+
+    paths = (int*) malloc((g->num_nodes + 1) * sizeof(int));
+    costs = (long*) malloc((g->num_nodes + 1) * sizeof(long));
+    if (paths == NULL || costs == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    for (k = 1; k <= BENCH_MP_DEGREE + 1; k++) {
+        for (src = 1; src <= g->num_nodes; src += 1 + g->num_nodes / 25) {
+            MP_Compute_Batch(g, src, k, paths, costs);
+            for (dst = 1; dst <= g->num_nodes; dst++) {
+                if (dst == src)
+                    continue;
+                bf_paths = MP_Compute_BF(g, src, dst, k);
+                bf_cost = MP_Flow_Cost(g);
+                dj_paths = MP_Compute_Dijkstra(g, src, dst, k);
+                if (bf_paths != dj_paths || bf_cost != MP_Flow_Cost(g) ||
+                    bf_paths != paths[dst] || bf_cost != costs[dst])
+                    Alarm(EXIT, "sp_microbench: multipath %d -> %d (k = %d) differs: "
+                          "bf %d paths cost %ld, dijkstra %d paths cost %ld, "
+                          "batch %d paths cost %ld\n", src, dst, k, bf_paths, bf_cost,
+                          dj_paths, MP_Flow_Cost(g), paths[dst], costs[dst]);
+                checked++;
+            }
+        }
+    }
+    Alarm(PRINT, "sp_microbench: multipath verified on %d computations over "
+          "%d nodes\n", checked, g->num_nodes);
+
+    free(paths);
+    free(costs);
+}
+
+static void Bench_MultiPath(int n)
+{
+    Bench_MP_Graph g;
+    char           names[3][MAX_NAME_LEN];
+    int           *paths;
+    long          *costs;
+    int            i, dst, found, rounds = 20;
+
+    sprintf(names[0], "multipath_bf_%d", n);
+    sprintf(names[1], "multipath_dijkstra_%d", n);
+    sprintf(names[2], "multipath_batch_%d", n);
+    if (Filter[0] != '\0' && strstr(names[0], Filter) == NULL &&
+        strstr(names[1], Filter) == NULL && strstr(names[2], Filter) == NULL)
+        return;
+
+    MP_Graph_Init(&g, n);
+    MP_Verify(&g);
+    paths = (int*) malloc((n + 1) * sizeof(int));
+    costs = (long*) malloc((n + 1) * sizeof(long));
+    if (paths == NULL || costs == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    if (Bench_Begin(names[0])) {
+        found = 0;
+        for (i = 0; i < rounds; i++)
+            for (dst = 2; dst <= n; dst++)
+                found += MP_Compute_BF(&g, 1, dst, BENCH_MP_K);
+        Bench_End((long) rounds * (n - 1));
+        Sink += found;
+    }
+
+    if (Bench_Begin(names[1])) {
+        found = 0;
+        for (i = 0; i < rounds; i++)
+            for (dst = 2; dst <= n; dst++)
+                found += MP_Compute_Dijkstra(&g, 1, dst, BENCH_MP_K);
+        Bench_End((long) rounds * (n - 1));
+        Sink += found;
+    }
+
+    if (Bench_Begin(names[2])) {
+        found = 0;
+        for (i = 0; i < rounds; i++) {
+            MP_Compute_Batch(&g, 1, BENCH_MP_K, paths, costs);
+            found += paths[n];
+        }
+        Bench_End((long) rounds * (n - 1));
+        Sink += found;
+    }
+
+    free(paths);
+    free(costs);
+    MP_Graph_Finish(&g);
+}
+
+static void Bench_Timer_Fire(int code, void *data)
+{
+    Sink += code;
+}
+
+/* E_queue/E_dequeue with Num_Timers pending timers, all far enough in
+ * the future that none fires */
+static void Bench_Timers(void)
+{
+    sp_time  t;
+    int      i, code;
+
+    t.sec = 1000;
+    for (i = 0; i < Num_Timers; i++) {
+        t.usec = Rand_Below(1000000);
+        E_queue(Bench_Timer_Fire, i, NULL, t);
+    }
+
+    /* Re-arming an existing timer, e.g. a retransmission or hello timer
+     * pushed back on every packet */
+    if (Bench_Begin("timer_rearm")) {
+        for (i = 0; i < Timer_Ops; i++) {
+            t.usec = Rand_Below(1000000);
+            E_queue(Bench_Timer_Fire, Rand_Below(Num_Timers), NULL, t);
+        }
+        Bench_End(Timer_Ops);
+    }
+
+    /* Cancel then re-add, as on a link or session going away and coming
+     * back */
+    if (Bench_Begin("timer_dequeue_queue")) {
+        for (i = 0; i < Timer_Ops; i++) {
+            code = Rand_Below(Num_Timers);
+            E_dequeue(Bench_Timer_Fire, code, NULL);
+            t.usec = Rand_Below(1000000);
+            E_queue(Bench_Timer_Fire, code, NULL, t);
+        }
+        Bench_End(Timer_Ops);
+    }
+
+    /* Short-lived timers queued ahead of the long ones and cancelled
+     * before they fire, like a delayed ack */
+    t.sec = 0;
+    if (Bench_Begin("timer_short_lived")) {
+        for (i = 0; i < Timer_Ops; i++) {
+            t.usec = 1000 + Rand_Below(1000);
+            E_queue(Bench_Timer_Fire, Num_Timers + 1, NULL, t);
+            E_dequeue(Bench_Timer_Fire, Num_Timers + 1, NULL);
+        }
+        Bench_End(Timer_Ops);
+    }
+
+    E_dequeue_all_time_events();
+}
+
+int main(int argc, char *argv[])
+{
+    int32  *node_keys, *ports;
+    int     i, num_ports;
+
+    Usage(argc, argv);
+    Rand_State = 0x9E3779B97F4A7C15ULL ^ (stduint64) Seed;
+
+    Max_Results = 64;
+    Results = (Bench_Result*) calloc(Max_Results, sizeof(Bench_Result));
+    node_keys = (int32*) malloc(Num_Elems * sizeof(int32));
+    num_ports = (Num_Elems < 64000) ? Num_Elems : 64000;
+    ports = (int32*) malloc(num_ports * sizeof(int32));
+    if (Results == NULL || node_keys == NULL || ports == NULL)
+        Alarm(EXIT, "sp_microbench: out of memory\n");
+
+    for (i = 0; i < Num_Elems; i++)
+        node_keys[i] = Node_Key(i + 1);
+    Make_Ports(ports, num_ports);
+
+    E_init();
+    Mem_init_object_abort(BENCH_OBJ_SMALL, "bench_small", BENCH_SMALL_SIZE, 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_PACKET, "bench_packet", BENCH_PACKET_SIZE, 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_REF_CNT, "bench_ref_cnt", BENCH_PACKET_SIZE, 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_FLOW, "bench_flow", sizeof(Bench_Flow_Node), 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_PRIO_NS, "bench_prio_ns",
+                          sizeof(Bench_Old_NS) * (BENCH_PRIO_NGBRS + 1), 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_PRIO_PQ, "bench_prio_pq", sizeof(Bench_PQ_Node), 100, 0);
+    Mem_init_object_abort(BENCH_OBJ_PRIO_SFQ, "bench_prio_sfq", sizeof(Bench_SFQ_Node), 100, 0);
+
+    Perf_Init();
+
+    Bench_Hash_Int32("node_id", node_keys, Num_Elems);
+    Bench_Hash_Prio_Key(Num_Elems);
+    Bench_Hash_Int32("session_port", ports, num_ports);
+    Bench_Skl_Node_ID(node_keys, Num_Elems);
+    Bench_Queues(Num_Elems);
+    Bench_Memory(Num_Elems);
+    Bench_Timers();
+    Bench_Flow_Sched();
+    Bench_Prio_Queues();
+    Bench_Source_Dedup();
+    Bench_Signatures();
+    Bench_MultiPath(50);
+    Bench_MultiPath(200);
+
+    Print_Results();
+
+    if (Perf_Fd >= 0)
+        close(Perf_Fd);
+    free(node_keys);
+    free(ports);
+    free(Results);
+    return 0;
+}
+
+static void Print_Results(void)
+{
+    FILE *fp = stdout;
+    int   i;
+
+    if (Out_File[0] != '\0') {
+        fp = fopen(Out_File, "w");
+        if (fp == NULL)
+            Alarm(EXIT, "sp_microbench: cannot open %s\n", Out_File);
+    }
+
+    fprintf(fp, "{\"elements\": %d, \"ops\": %d, \"timers\": %d, \"timer_ops\": %d, "
+                "\"seed\": %d, \"results\": [\n",
+            Num_Elems, Num_Ops, Num_Timers, Timer_Ops, Seed);
+    for (i = 0; i < Num_Results; i++) {
+        fprintf(fp, "  {\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.2f, ",
+                Results[i].name, Results[i].ops, Results[i].ns_per_op);
+        if (Results[i].cache_misses >= 0)
+            fprintf(fp, "\"cache_misses\": %lld, \"cache_misses_per_op\": %.4f, ",
+                    Results[i].cache_misses,
+                    (double) Results[i].cache_misses / Results[i].ops);
+        else
+            fprintf(fp, "\"cache_misses\": null, \"cache_misses_per_op\": null, ");
+        fprintf(fp, "\"allocs\": %ld, \"frees\": %ld, \"allocs_per_op\": %.4f, "
+                    "\"pool_allocs\": %ld, \"pool_allocs_per_op\": %.4f}%s\n",
+                Results[i].allocs, Results[i].frees,
+                (double) Results[i].allocs / Results[i].ops,
+                Results[i].pool_allocs,
+                (double) Results[i].pool_allocs / Results[i].ops,
+                (i == Num_Results - 1) ? "" : ",");
+    }
+    fprintf(fp, "]}\n");
+
+    if (fp != stdout)
+        fclose(fp);
+}
+
+static void Usage(int argc, char *argv[])
+{
+    Filter[0]   = '\0';
+    Out_File[0] = '\0';
+
+    while (--argc > 0) {
+        argv++;
+
+        if (!strncmp(*argv, "-n", 3) && argc > 1) {
+            sscanf(argv[1], "%d", &Num_Elems);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-i", 3) && argc > 1) {
+            sscanf(argv[1], "%d", &Num_Ops);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-t", 3) && argc > 1) {
+            sscanf(argv[1], "%d", &Num_Timers);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-e", 3) && argc > 1) {
+            sscanf(argv[1], "%d", &Timer_Ops);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-s", 3) && argc > 1) {
+            sscanf(argv[1], "%d", &Seed);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-b", 3) && argc > 1) {
+            strncpy(Filter, argv[1], sizeof(Filter) - 1);
+            argc--; argv++;
+        } else if (!strncmp(*argv, "-o", 3) && argc > 1) {
+            strncpy(Out_File, argv[1], sizeof(Out_File) - 1);
+            argc--; argv++;
+        } else {
+            printf("Usage: sp_microbench\n"
+                   "\t[-n <elements>  ] : number of keys/objects per container, default 10000\n"
+                   "\t[-i <ops>       ] : operations per find/mix/churn benchmark, default 1000000\n"
+                   "\t[-t <timers>    ] : number of pending timers, default 4000\n"
+                   "\t[-e <timer ops> ] : operations per timer benchmark, default 20000\n"
+                   "\t[-s <seed>      ] : random seed, default 1\n"
+                   "\t[-b <substring> ] : only run benchmarks whose name contains it\n"
+                   "\t[-o <file>      ] : write JSON results to file instead of stdout\n");
+            exit(0);
+        }
+    }
+
+    if (Num_Elems < 1 || Num_Ops < 1 || Num_Timers < 1 || Timer_Ops < 1)
+        Alarm(EXIT, "sp_microbench: counts must be positive\n");
+}